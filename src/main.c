@@ -28,50 +28,262 @@
 #include <syslog.h>
 #include <unistd.h>
 
+#include "sdi-diagnostics.h"
+#include "sdi-fanout-client.h"
+#include "sdi-main-loop-watchdog.h"
 #include "sdi-notify.h"
 #include "sdi-progress-dock.h"
 #include "sdi-progress-window.h"
 #include "sdi-refresh-monitor.h"
+#include "sdi-session-monitor.h"
 #include "sdi-snapd-client-factory.h"
 #include "sdi-snapd-monitor.h"
+#include "sdi-snapd-worker.h"
+#include "sdi-startup-scheduler.h"
 #include "sdi-theme-monitor.h"
 #include "sdi-user-session-helper.h"
 
+#ifdef USE_UI_HELPER
+#include "sdi-ui-helper-client.h"
+
+/* The progress dialogs are shown by snapd-desktop-integration-ui, through
+ * a client with the same API than #SdiProgressWindow.
+ */
+typedef SdiUiHelperClient ProgressWindow;
+#define progress_window_new sdi_ui_helper_client_new
+#define progress_window_begin_refresh sdi_ui_helper_client_begin_refresh
+#define progress_window_update_progress sdi_ui_helper_client_update_progress
+#define progress_window_end_refresh sdi_ui_helper_client_end_refresh
+#define progress_window_begin_install sdi_ui_helper_client_begin_install
+#define progress_window_update_install_progress                                \
+  sdi_ui_helper_client_update_install_progress
+// the helper animates its own dialogs
+#define progress_window_set_paused(window, paused)
+#else
+typedef SdiProgressWindow ProgressWindow;
+#define progress_window_new sdi_progress_window_new
+#define progress_window_begin_refresh sdi_progress_window_begin_refresh
+#define progress_window_update_progress sdi_progress_window_update_progress
+#define progress_window_end_refresh sdi_progress_window_end_refresh
+#define progress_window_begin_install sdi_progress_window_begin_install
+#define progress_window_update_install_progress                                \
+  sdi_progress_window_update_install_progress
+#define progress_window_set_paused sdi_progress_window_set_paused
+#endif
+
 static SnapdClient *client = NULL;
 static SdiThemeMonitor *theme_monitor = NULL;
 static SdiRefreshMonitor *refresh_monitor = NULL;
 static SdiNotify *notify_manager = NULL;
 static SdiSnapdMonitor *snapd_monitor = NULL;
-static SdiProgressWindow *progress_window = NULL;
+static ProgressWindow *progress_window = NULL;
 static SdiProgressDock *progress_dock = NULL;
+static SdiMainLoopWatchdog *watchdog = NULL;
+static SdiDiagnostics *diagnostics = NULL;
+static SdiFanoutClient *fanout = NULL;
+static SdiSnapdWorker *snapd_worker = NULL;
+static SdiSessionMonitor *session_monitor = NULL;
+static SdiStartupScheduler *startup_scheduler = NULL;
+static guint theme_check_id = 0;
 
 static gchar *snapd_socket_path = NULL;
+static gint watchdog_threshold = 0;
+static gboolean use_fanout = FALSE;
+static gboolean fast_change_parser = FALSE;
+// time in ms over which the deferred startup work of the users is spread
+static gint startup_jitter = 30000;
+
+static GOptionEntry entries[] = {
+    {"snapd-socket-path", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME,
+     &snapd_socket_path, "Snapd socket path", "PATH"},
+    {"watchdog-threshold", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_INT,
+     &watchdog_threshold,
+     "Log main loop stalls longer than this value, in ms (disabled by default)",
+     "MS"},
+    {"use-fanout", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE, &use_fanout,
+     "Receive the notices and changes from the system-wide fan-out service",
+     NULL},
+    {"fast-change-parser", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_NONE,
+     &fast_change_parser,
+     "Read only the needed fields of the changes, without snapd-glib", NULL},
+    {"startup-jitter", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_INT,
+     &startup_jitter,
+     "Spread the non-urgent startup work over this time, in ms (0 disables it)",
+     "MS"},
+    {NULL}};
+
+/* The UI sinks are created the first time that a signal needs them, so
+ * nothing is built at login if there is nothing to show.
+ */
+static SdiNotify *get_notify_manager(GApplication *application) {
+  if (notify_manager == NULL) {
+    notify_manager = sdi_notify_new(application);
+    sdi_diagnostics_set_notify(diagnostics, notify_manager);
+    g_signal_connect_object(notify_manager, "ignore-snap-event",
+                            (GCallback)sdi_refresh_monitor_ignore_snap,
+                            refresh_monitor, G_CONNECT_SWAPPED);
+  }
+  return notify_manager;
+}
+
+static void cancel_install_cb(ProgressWindow *window, gchar *install_id) {
+  if (theme_monitor != NULL) {
+    sdi_theme_monitor_cancel_install(theme_monitor);
+  }
+}
+
+static ProgressWindow *get_progress_window(GApplication *application) {
+  if (progress_window == NULL) {
+    progress_window = progress_window_new(application);
+    g_signal_connect(progress_window, "cancel-install",
+                     (GCallback)cancel_install_cb, NULL);
+    progress_window_set_paused(
+        progress_window, !sdi_session_monitor_get_visible(session_monitor));
+  }
+  return progress_window;
+}
+
+static SdiProgressDock *get_progress_dock(GApplication *application) {
+  if (progress_dock == NULL) {
+    progress_dock = sdi_progress_dock_new(application);
+  }
+  return progress_dock;
+}
+
+static void notify_pending_refresh_cb(SdiRefreshMonitor *monitor,
+                                      GListModel *snaps,
+                                      GApplication *application) {
+  sdi_notify_pending_refresh(get_notify_manager(application), snaps);
+}
+
+static void notify_pending_refresh_forced_cb(SdiRefreshMonitor *monitor,
+                                             SnapdSnap *snap,
+                                             GTimeSpan remaining_time,
+                                             gboolean allow_to_ignore,
+                                             GApplication *application) {
+  sdi_notify_pending_refresh_forced(get_notify_manager(application), snap,
+                                    remaining_time, allow_to_ignore);
+}
+
+static void notify_refresh_complete_cb(SdiRefreshMonitor *monitor,
+                                       SnapdSnap *snap, const gchar *snap_name,
+                                       GApplication *application) {
+  sdi_notify_refresh_complete(get_notify_manager(application), snap, snap_name);
+}
+
+static void begin_refresh_cb(SdiRefreshMonitor *monitor, gchar *snap_name,
+                             gchar *visible_name, gchar *icon,
+                             GApplication *application) {
+  progress_window_begin_refresh(get_progress_window(application), snap_name,
+                                visible_name, icon);
+}
+
+static void refresh_progress_cb(SdiRefreshMonitor *monitor, gchar *snap_name,
+                                GStrv desktop_files, gchar *task_description,
+                                guint done_tasks, guint total_tasks,
+                                gboolean task_done,
+                                GApplication *application) {
+  // the window only updates the dialogs created by "begin-refresh"
+  if (progress_window != NULL) {
+    progress_window_update_progress(progress_window, snap_name, desktop_files,
+                                    task_description, done_tasks, total_tasks,
+                                    task_done);
+  }
+  // and the dock ignores the snaps without .desktop files
+  if ((desktop_files != NULL) && (total_tasks != 0)) {
+    sdi_progress_dock_update_progress(get_progress_dock(application), snap_name,
+                                      desktop_files, task_description,
+                                      done_tasks, total_tasks, task_done);
+  }
+}
+
+static void end_refresh_cb(GObject *monitor, gchar *snap_name) {
+  if (progress_window != NULL) {
+    progress_window_end_refresh(progress_window, snap_name);
+  }
+}
+
+/* While nobody can see the session, the refresh monitor polls the changes
+ * slowly and stops updating the progress, and the dialogs stop pulsing.
+ */
+static void visibility_changed_cb(SdiSessionMonitor *monitor,
+                                  gboolean visible) {
+  sdi_refresh_monitor_set_session_visible(refresh_monitor, visible);
+  if (progress_window != NULL) {
+    progress_window_set_paused(progress_window, !visible);
+  }
+}
 
-static GOptionEntry entries[] = {{"snapd-socket-path", 0, G_OPTION_FLAG_NONE,
-                                  G_OPTION_ARG_FILENAME, &snapd_socket_path,
-                                  "Snapd socket path", "PATH"},
-                                 {NULL}};
+static void begin_install_cb(SdiThemeMonitor *monitor, gchar *install_id,
+                             gchar *message, GApplication *application) {
+  progress_window_begin_install(get_progress_window(application), install_id,
+                                message);
+}
+
+static void install_progress_cb(SdiThemeMonitor *monitor, gchar *install_id,
+                                gchar *task_description, guint64 done_bytes,
+                                guint64 total_bytes, guint done_tasks,
+                                guint total_tasks, GApplication *application) {
+  // the window only updates the dialogs created by "begin-install"
+  if (progress_window != NULL) {
+    progress_window_update_install_progress(progress_window, install_id,
+                                            task_description, done_bytes,
+                                            total_bytes, done_tasks,
+                                            total_tasks);
+  }
+}
 
 static void do_startup(GObject *object, gpointer data) {
   sdi_snapd_client_factory_set_custom_path(snapd_socket_path);
 
+  diagnostics = sdi_diagnostics_new(G_APPLICATION(object));
+  if (watchdog_threshold > 0) {
+    watchdog = sdi_main_loop_watchdog_new(watchdog_threshold);
+    sdi_diagnostics_set_watchdog(diagnostics, watchdog);
+    sdi_main_loop_watchdog_start(watchdog);
+  }
+
+  if (use_fanout) {
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GDBusConnection) system_bus =
+        g_bus_get_sync(G_BUS_TYPE_SYSTEM, NULL, &error);
+    if (system_bus == NULL) {
+      g_warning("Failed to connect to the system bus; the fan-out service "
+                "won't be used: %s",
+                error->message);
+    } else {
+      fanout = sdi_fanout_client_new(system_bus);
+    }
+  }
+
+  startup_scheduler = sdi_startup_scheduler_new(MAX(startup_jitter, 0));
+  g_debug("The deferred startup work will start after %u ms",
+          sdi_startup_scheduler_get_offset(startup_scheduler));
+
   refresh_monitor = sdi_refresh_monitor_new();
+  sdi_diagnostics_set_refresh_monitor(diagnostics, refresh_monitor);
+  sdi_refresh_monitor_set_startup_scheduler(refresh_monitor,
+                                            startup_scheduler);
+  if (fanout != NULL) {
+    sdi_refresh_monitor_set_fanout_client(refresh_monitor, fanout);
+  } else {
+    // the notices and the changes are received in a worker thread
+    snapd_worker = sdi_snapd_worker_new();
+    sdi_refresh_monitor_set_snapd_worker(refresh_monitor, snapd_worker);
+    sdi_refresh_monitor_set_fast_change_parser(refresh_monitor,
+                                               fast_change_parser);
+  }
 
-  notify_manager = sdi_notify_new(G_APPLICATION(object));
-  g_signal_connect_object(refresh_monitor, "notify-pending-refresh",
-                          (GCallback)sdi_notify_pending_refresh, notify_manager,
-                          G_CONNECT_SWAPPED);
-  g_signal_connect_object(refresh_monitor, "notify-pending-refresh-forced",
-                          (GCallback)sdi_notify_pending_refresh_forced,
-                          notify_manager, G_CONNECT_SWAPPED);
-  g_signal_connect_object(refresh_monitor, "notify-refresh-complete",
-                          (GCallback)sdi_notify_refresh_complete,
-                          notify_manager, G_CONNECT_SWAPPED);
-  g_signal_connect_object(notify_manager, "ignore-snap-event",
-                          (GCallback)sdi_refresh_monitor_ignore_snap,
-                          refresh_monitor, G_CONNECT_SWAPPED);
+  g_signal_connect(refresh_monitor, "notify-pending-refresh",
+                   (GCallback)notify_pending_refresh_cb, object);
+  g_signal_connect(refresh_monitor, "notify-pending-refresh-forced",
+                   (GCallback)notify_pending_refresh_forced_cb, object);
+  g_signal_connect(refresh_monitor, "notify-refresh-complete",
+                   (GCallback)notify_refresh_complete_cb, object);
 
-  snapd_monitor = sdi_snapd_monitor_new();
+  snapd_monitor = (fanout != NULL)
+                      ? sdi_snapd_monitor_new_with_fanout(fanout)
+                      : sdi_snapd_monitor_new_with_worker(snapd_worker);
   /* any notice event received by the #sdi_snapd_monitor object will
    * be relayed directly to the #sdi_refresh_monitor, which will process
    * them and decide whether to show a progress bar, a notification, a
@@ -80,46 +292,82 @@ static void do_startup(GObject *object, gpointer data) {
   g_signal_connect_object(snapd_monitor, "notice-event",
                           (GCallback)sdi_refresh_monitor_notice,
                           refresh_monitor, G_CONNECT_SWAPPED);
+  sdi_snapd_monitor_add_notice_types(snapd_monitor,
+                                     sdi_refresh_monitor_get_notice_types());
 
-  progress_window = sdi_progress_window_new(G_APPLICATION(object));
-  g_signal_connect_object(refresh_monitor, "begin-refresh",
-                          (GCallback)sdi_progress_window_begin_refresh,
-                          progress_window, G_CONNECT_SWAPPED);
-  g_signal_connect_object(refresh_monitor, "refresh-progress",
-                          (GCallback)sdi_progress_window_update_progress,
-                          progress_window, G_CONNECT_SWAPPED);
-  g_signal_connect_object(refresh_monitor, "end-refresh",
-                          (GCallback)sdi_progress_window_end_refresh,
-                          progress_window, G_CONNECT_SWAPPED);
-
-  progress_dock = sdi_progress_dock_new(G_APPLICATION(object));
-  g_signal_connect_object(refresh_monitor, "refresh-progress",
-                          (GCallback)sdi_progress_dock_update_progress,
-                          progress_dock, G_CONNECT_SWAPPED);
+  g_signal_connect(refresh_monitor, "begin-refresh",
+                   (GCallback)begin_refresh_cb, object);
+  g_signal_connect(refresh_monitor, "refresh-progress",
+                   (GCallback)refresh_progress_cb, object);
+  g_signal_connect(refresh_monitor, "end-refresh", (GCallback)end_refresh_cb,
+                   NULL);
+
+  session_monitor = sdi_session_monitor_new(
+      g_application_get_dbus_connection(G_APPLICATION(object)));
+  g_signal_connect(session_monitor, "visibility-changed",
+                   (GCallback)visibility_changed_cb, NULL);
+  sdi_session_monitor_start(session_monitor);
 
   if (!sdi_snapd_monitor_start(snapd_monitor)) {
     g_message("Failed to start monitor");
   }
 }
 
+static void start_theme_monitor(gpointer data) {
+  theme_check_id = 0;
+  sdi_theme_monitor_start(theme_monitor);
+}
+
 static void do_activate(GObject *object, gpointer data) {
   // because, by default, there are no windows, so the application would quit
   g_application_hold(G_APPLICATION(object));
   client = sdi_snapd_client_factory_new_snapd_client();
 
   theme_monitor = sdi_theme_monitor_new(client);
-  sdi_theme_monitor_start(theme_monitor);
+  g_signal_connect_object(snapd_monitor, "notice-event",
+                          (GCallback)sdi_theme_monitor_notice, theme_monitor,
+                          G_CONNECT_SWAPPED);
+  sdi_snapd_monitor_add_notice_types(snapd_monitor,
+                                     sdi_theme_monitor_get_notice_types());
+  g_signal_connect(theme_monitor, "begin-install",
+                   (GCallback)begin_install_cb, object);
+  g_signal_connect(theme_monitor, "install-progress",
+                   (GCallback)install_progress_cb, object);
+  g_signal_connect(theme_monitor, "end-install", (GCallback)end_refresh_cb,
+                   NULL);
+  /* the themes are checked once the startup has finished, in the turn of
+   * this user, to not query snapd together with the other users.
+   */
+  theme_check_id = sdi_startup_scheduler_add(startup_scheduler,
+                                             SDI_STARTUP_PRIORITY_DEFERRED,
+                                             start_theme_monitor, NULL);
 }
 
 static void do_shutdown(GObject *object, gpointer data) {
-  notify_uninit();
+  if (watchdog != NULL) {
+    sdi_main_loop_watchdog_log_summary(watchdog);
+  }
+  if (theme_check_id != 0) {
+    sdi_startup_scheduler_remove(startup_scheduler, theme_check_id);
+    theme_check_id = 0;
+  }
+  // libnotify is only initialized once a notification is needed
+  if (notify_is_initted()) {
+    notify_uninit();
+  }
   g_clear_object(&client);
   g_clear_object(&theme_monitor);
+  g_clear_object(&session_monitor);
   g_clear_object(&refresh_monitor);
   g_clear_object(&progress_window);
   g_clear_object(&progress_dock);
   g_clear_object(&notify_manager);
   g_clear_object(&snapd_monitor);
+  g_clear_object(&fanout);
+  g_clear_object(&snapd_worker);
+  g_clear_object(&startup_scheduler);
+  g_clear_object(&diagnostics);
+  g_clear_object(&watchdog);
 }
 
 static int global_retval = 0;
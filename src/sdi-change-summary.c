@@ -0,0 +1,826 @@
+/*
+ * Copyright (C) 2024 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include <gio/gunixsocketaddress.h>
+#include <string.h>
+
+#include "sdi-change-summary.h"
+
+/**
+ * This module requests a change to snapd and keeps only the fields that
+ * #SdiRefreshMonitor needs. snapd-glib builds a JSON tree with the reply,
+ * and then a #SnapdChange with one #SnapdTask and one #SnapdTaskData for
+ * each task, which dominates the cost of each poll when a change has
+ * hundreds of tasks. Here the reply is scanned once, from start to end,
+ * skipping the members that aren't used, without building any tree or
+ * object. The strings that are kept are stored in a #GStringChunk, where the
+ * repeated ones, like the status of the tasks and the snap names, are stored
+ * only once.
+ *
+ * A summary can also be built from a #SnapdChange, so the refresh monitor
+ * processes all the changes in the same way, wherever they come from.
+ */
+
+// maximum nesting of the JSON values in a reply
+#define MAX_DEPTH 64
+// maximum size of a reply, in bytes
+#define MAX_REPLY_SIZE (64 * 1024 * 1024)
+#define READ_BUFFER_SIZE 16384
+
+typedef struct {
+  const gchar *status;
+  const gchar *summary;
+  // offset of the list of affected snaps in `affected_snaps`, or -1
+  gint affected_snaps;
+} Task;
+
+struct _SdiChangeSummary {
+  GStringChunk *strings;
+  const gchar *id;
+  const gchar *kind;
+  const gchar *status;
+  gboolean ready;
+  // NULL-terminated; NULL if the change data has no snap names
+  GPtrArray *snap_names;
+  GArray *tasks;
+  // the NULL-terminated lists of affected snaps of all the tasks
+  GPtrArray *affected_snaps;
+};
+
+static SdiChangeSummary *sdi_change_summary_new(void) {
+  SdiChangeSummary *self = g_malloc0(sizeof(SdiChangeSummary));
+  self->strings = g_string_chunk_new(4096);
+  self->tasks = g_array_new(FALSE, FALSE, sizeof(Task));
+  self->affected_snaps = g_ptr_array_new();
+  return self;
+}
+
+void sdi_change_summary_free(SdiChangeSummary *self) {
+  g_string_chunk_free(self->strings);
+  g_clear_pointer(&self->snap_names, g_ptr_array_unref);
+  g_array_unref(self->tasks);
+  g_ptr_array_unref(self->affected_snaps);
+  g_free(self);
+}
+
+static const gchar *intern(SdiChangeSummary *self, const gchar *string) {
+  if (string == NULL) {
+    return NULL;
+  }
+  return g_string_chunk_insert_const(self->strings, string);
+}
+
+static void add_string_list(SdiChangeSummary *self, GPtrArray *list,
+                            GStrv strv) {
+  for (gchar **p = strv; (p != NULL) && (*p != NULL); p++) {
+    g_ptr_array_add(list, (gpointer)intern(self, *p));
+  }
+  g_ptr_array_add(list, NULL);
+}
+
+static Task *add_task(SdiChangeSummary *self) {
+  Task task = {NULL, NULL, -1};
+  g_array_append_val(self->tasks, task);
+  return &g_array_index(self->tasks, Task, self->tasks->len - 1);
+}
+
+/**
+ * Builds a summary with the fields of @change.
+ */
+SdiChangeSummary *sdi_change_summary_new_from_change(SnapdChange *change) {
+  g_return_val_if_fail(SNAPD_IS_CHANGE(change), NULL);
+
+  SdiChangeSummary *self = sdi_change_summary_new();
+  self->id = intern(self, snapd_change_get_id(change));
+  self->kind = intern(self, snapd_change_get_kind(change));
+  self->status = intern(self, snapd_change_get_status(change));
+  self->ready = snapd_change_get_ready(change);
+
+  SnapdChangeData *data = snapd_change_get_data(change);
+  if (SNAPD_IS_AUTOREFRESH_CHANGE_DATA(data)) {
+    self->snap_names = g_ptr_array_new();
+    add_string_list(self, self->snap_names,
+                    snapd_autorefresh_change_data_get_snap_names(
+                        SNAPD_AUTOREFRESH_CHANGE_DATA(data)));
+  }
+
+  GPtrArray *tasks = snapd_change_get_tasks(change);
+  for (guint i = 0; (tasks != NULL) && (i < tasks->len); i++) {
+    SnapdTask *snapd_task = tasks->pdata[i];
+    Task *task = add_task(self);
+    task->status = intern(self, snapd_task_get_status(snapd_task));
+    task->summary = intern(self, snapd_task_get_summary(snapd_task));
+    SnapdTaskData *task_data = snapd_task_get_data(snapd_task);
+    if (task_data == NULL) {
+      continue;
+    }
+    GStrv affected_snaps = snapd_task_data_get_affected_snaps(task_data);
+    if (affected_snaps != NULL) {
+      task->affected_snaps = self->affected_snaps->len;
+      add_string_list(self, self->affected_snaps, affected_snaps);
+    }
+  }
+  return self;
+}
+
+/* A single pass scanner for the JSON replies of snapd. The member names
+ * and the string values are decoded into two buffers that are reused, so
+ * nothing is allocated for the members that are skipped.
+ */
+typedef struct {
+  const gchar *pos;
+  const gchar *end;
+  GString *name;
+  GString *value;
+  SdiChangeSummary *summary;
+  // where the elements of a list of strings are added
+  GPtrArray *list;
+  // the type of the reply, and the message if it is an error
+  const gchar *type;
+  const gchar *message;
+} Scanner;
+
+/* Called for each member of an object, with the scanner placed before the
+ * value, which must be consumed. @name is only valid until the scanner
+ * reads something else.
+ */
+typedef gboolean (*ScanMemberFunc)(Scanner *scanner, const gchar *name,
+                                   guint depth);
+// Called for each element of an array, which must be consumed.
+typedef gboolean (*ScanElementFunc)(Scanner *scanner, guint depth);
+
+static gboolean skip_value(Scanner *scanner, guint depth);
+
+static void skip_spaces(Scanner *scanner) {
+  while ((scanner->pos < scanner->end) &&
+         ((*scanner->pos == ' ') || (*scanner->pos == '\t') ||
+          (*scanner->pos == '\n') || (*scanner->pos == '\r'))) {
+    scanner->pos++;
+  }
+}
+
+// consumes @c if it is the next character after the spaces
+static gboolean consume(Scanner *scanner, gchar c) {
+  skip_spaces(scanner);
+  if ((scanner->pos < scanner->end) && (*scanner->pos == c)) {
+    scanner->pos++;
+    return TRUE;
+  }
+  return FALSE;
+}
+
+static gboolean scan_hex4(Scanner *scanner, gunichar *value) {
+  if (scanner->end - scanner->pos < 4) {
+    return FALSE;
+  }
+  *value = 0;
+  for (int i = 0; i < 4; i++) {
+    gint digit = g_ascii_xdigit_value(scanner->pos[i]);
+    if (digit < 0) {
+      return FALSE;
+    }
+    *value = (*value << 4) | digit;
+  }
+  scanner->pos += 4;
+  return TRUE;
+}
+
+// reads the XXXX part of a \uXXXX escape, and the low surrogate if needed
+static gboolean scan_escaped_unichar(Scanner *scanner, gunichar *value) {
+  if (!scan_hex4(scanner, value) ||
+      ((*value >= 0xDC00) && (*value <= 0xDFFF))) {
+    return FALSE;
+  }
+  if ((*value < 0xD800) || (*value > 0xDBFF)) {
+    return TRUE;
+  }
+  gunichar low;
+  if ((scanner->end - scanner->pos < 2) || (scanner->pos[0] != '\\') ||
+      (scanner->pos[1] != 'u')) {
+    return FALSE;
+  }
+  scanner->pos += 2;
+  if (!scan_hex4(scanner, &low) || (low < 0xDC00) || (low > 0xDFFF)) {
+    return FALSE;
+  }
+  *value = 0x10000 + ((*value - 0xD800) << 10) + (low - 0xDC00);
+  return TRUE;
+}
+
+/**
+ * Reads a string into @out, decoding the escape sequences, or skips it if
+ * @out is NULL.
+ */
+static gboolean scan_string(Scanner *scanner, GString *out) {
+  if (!consume(scanner, '"')) {
+    return FALSE;
+  }
+  if (out != NULL) {
+    g_string_truncate(out, 0);
+  }
+  while (scanner->pos < scanner->end) {
+    // the characters until the next quote or escape are copied at once
+    const gchar *start = scanner->pos;
+    while ((scanner->pos < scanner->end) && (*scanner->pos != '"') &&
+           (*scanner->pos != '\\')) {
+      if ((guchar)*scanner->pos < 0x20) {
+        return FALSE;
+      }
+      scanner->pos++;
+    }
+    if (out != NULL) {
+      g_string_append_len(out, start, scanner->pos - start);
+    }
+    if (scanner->pos == scanner->end) {
+      return FALSE;
+    }
+    if (*scanner->pos++ == '"') {
+      return TRUE;
+    }
+    if (scanner->pos == scanner->end) {
+      return FALSE;
+    }
+    gunichar c;
+    switch (*scanner->pos++) {
+    case '"':
+      c = '"';
+      break;
+    case '\\':
+      c = '\\';
+      break;
+    case '/':
+      c = '/';
+      break;
+    case 'b':
+      c = '\b';
+      break;
+    case 'f':
+      c = '\f';
+      break;
+    case 'n':
+      c = '\n';
+      break;
+    case 'r':
+      c = '\r';
+      break;
+    case 't':
+      c = '\t';
+      break;
+    case 'u':
+      if (!scan_escaped_unichar(scanner, &c)) {
+        return FALSE;
+      }
+      break;
+    default:
+      return FALSE;
+    }
+    if (out != NULL) {
+      g_string_append_unichar(out, c);
+    }
+  }
+  return FALSE;
+}
+
+static gboolean is_literal_char(gchar c) {
+  return g_ascii_isalnum(c) || (c == '+') || (c == '-') || (c == '.');
+}
+
+// skips a number, `true`, `false` or `null`
+static gboolean skip_literal(Scanner *scanner) {
+  skip_spaces(scanner);
+  const gchar *start = scanner->pos;
+  while ((scanner->pos < scanner->end) && is_literal_char(*scanner->pos)) {
+    scanner->pos++;
+  }
+  return scanner->pos != start;
+}
+
+static gboolean scan_keyword(Scanner *scanner, const gchar *keyword) {
+  gsize length = strlen(keyword);
+  if (((gsize)(scanner->end - scanner->pos) < length) ||
+      (strncmp(scanner->pos, keyword, length) != 0)) {
+    return FALSE;
+  }
+  scanner->pos += length;
+  return TRUE;
+}
+
+static gboolean scan_boolean(Scanner *scanner, gboolean *value) {
+  skip_spaces(scanner);
+  if (scan_keyword(scanner, "true")) {
+    *value = TRUE;
+    return TRUE;
+  }
+  if (scan_keyword(scanner, "false")) {
+    *value = FALSE;
+    return TRUE;
+  }
+  return FALSE;
+}
+
+static gboolean scan_object(Scanner *scanner, guint depth,
+                            ScanMemberFunc func) {
+  if ((depth >= MAX_DEPTH) || !consume(scanner, '{')) {
+    return FALSE;
+  }
+  if (consume(scanner, '}')) {
+    return TRUE;
+  }
+  do {
+    if (!scan_string(scanner, scanner->name) || !consume(scanner, ':') ||
+        !func(scanner, scanner->name->str, depth + 1)) {
+      return FALSE;
+    }
+  } while (consume(scanner, ','));
+  return consume(scanner, '}');
+}
+
+static gboolean scan_array(Scanner *scanner, guint depth,
+                           ScanElementFunc func) {
+  if ((depth >= MAX_DEPTH) || !consume(scanner, '[')) {
+    return FALSE;
+  }
+  if (consume(scanner, ']')) {
+    return TRUE;
+  }
+  do {
+    if (!func(scanner, depth + 1)) {
+      return FALSE;
+    }
+  } while (consume(scanner, ','));
+  return consume(scanner, ']');
+}
+
+// scans an object, or skips a null value
+static gboolean scan_optional_object(Scanner *scanner, guint depth,
+                                     ScanMemberFunc func) {
+  skip_spaces(scanner);
+  if (scan_keyword(scanner, "null")) {
+    return TRUE;
+  }
+  return scan_object(scanner, depth, func);
+}
+
+static gboolean skip_member(Scanner *scanner, const gchar *name,
+                            guint depth) {
+  return skip_value(scanner, depth);
+}
+
+static gboolean skip_value(Scanner *scanner, guint depth) {
+  skip_spaces(scanner);
+  if (scanner->pos == scanner->end) {
+    return FALSE;
+  }
+  switch (*scanner->pos) {
+  case '"':
+    return scan_string(scanner, NULL);
+  case '{':
+    return scan_object(scanner, depth, skip_member);
+  case '[':
+    return scan_array(scanner, depth, skip_value);
+  default:
+    return skip_literal(scanner);
+  }
+}
+
+// reads a string, or a null value, and stores it in the summary
+static gboolean scan_string_value(Scanner *scanner, const gchar **value) {
+  skip_spaces(scanner);
+  if (scan_keyword(scanner, "null")) {
+    *value = NULL;
+    return TRUE;
+  }
+  if (!scan_string(scanner, scanner->value)) {
+    return FALSE;
+  }
+  *value = intern(scanner->summary, scanner->value->str);
+  return TRUE;
+}
+
+static gboolean scan_list_element(Scanner *scanner, guint depth) {
+  if (!scan_string(scanner, scanner->value)) {
+    return FALSE;
+  }
+  g_ptr_array_add(scanner->list,
+                  (gpointer)intern(scanner->summary, scanner->value->str));
+  return TRUE;
+}
+
+// reads an array of strings, adding them and a NULL at the end of @list
+static gboolean scan_string_list(Scanner *scanner, guint depth,
+                                 GPtrArray *list) {
+  scanner->list = list;
+  if (!scan_array(scanner, depth, scan_list_element)) {
+    return FALSE;
+  }
+  g_ptr_array_add(list, NULL);
+  return TRUE;
+}
+
+static gboolean scan_task_data_member(Scanner *scanner, const gchar *name,
+                                      guint depth) {
+  SdiChangeSummary *summary = scanner->summary;
+  if (g_str_equal(name, "affected-snaps")) {
+    Task *task = &g_array_index(summary->tasks, Task, summary->tasks->len - 1);
+    task->affected_snaps = summary->affected_snaps->len;
+    return scan_string_list(scanner, depth, summary->affected_snaps);
+  }
+  return skip_value(scanner, depth);
+}
+
+static gboolean scan_task_member(Scanner *scanner, const gchar *name,
+                                 guint depth) {
+  SdiChangeSummary *summary = scanner->summary;
+  Task *task = &g_array_index(summary->tasks, Task, summary->tasks->len - 1);
+  if (g_str_equal(name, "status")) {
+    return scan_string_value(scanner, &task->status);
+  }
+  if (g_str_equal(name, "summary")) {
+    return scan_string_value(scanner, &task->summary);
+  }
+  if (g_str_equal(name, "data")) {
+    return scan_optional_object(scanner, depth, scan_task_data_member);
+  }
+  return skip_value(scanner, depth);
+}
+
+static gboolean scan_task(Scanner *scanner, guint depth) {
+  SdiChangeSummary *summary = scanner->summary;
+  add_task(summary);
+  if (!scan_object(scanner, depth, scan_task_member)) {
+    return FALSE;
+  }
+  // the status of each task is needed to compute the progress
+  return g_array_index(summary->tasks, Task, summary->tasks->len - 1).status !=
+         NULL;
+}
+
+static gboolean scan_change_data_member(Scanner *scanner, const gchar *name,
+                                        guint depth) {
+  SdiChangeSummary *summary = scanner->summary;
+  if (g_str_equal(name, "snap-names")) {
+    g_clear_pointer(&summary->snap_names, g_ptr_array_unref);
+    summary->snap_names = g_ptr_array_new();
+    return scan_string_list(scanner, depth, summary->snap_names);
+  }
+  return skip_value(scanner, depth);
+}
+
+static gboolean scan_change_member(Scanner *scanner, const gchar *name,
+                                   guint depth) {
+  SdiChangeSummary *summary = scanner->summary;
+  if (g_str_equal(name, "id")) {
+    return scan_string_value(scanner, &summary->id);
+  }
+  if (g_str_equal(name, "kind")) {
+    return scan_string_value(scanner, &summary->kind);
+  }
+  if (g_str_equal(name, "status")) {
+    return scan_string_value(scanner, &summary->status);
+  }
+  if (g_str_equal(name, "ready")) {
+    return scan_boolean(scanner, &summary->ready);
+  }
+  if (g_str_equal(name, "tasks")) {
+    return scan_array(scanner, depth, scan_task);
+  }
+  if (g_str_equal(name, "data")) {
+    return scan_optional_object(scanner, depth, scan_change_data_member);
+  }
+  // the result of an error reply
+  if (g_str_equal(name, "message")) {
+    return scan_string_value(scanner, &scanner->message);
+  }
+  return skip_value(scanner, depth);
+}
+
+static gboolean scan_reply_member(Scanner *scanner, const gchar *name,
+                                  guint depth) {
+  if (g_str_equal(name, "type")) {
+    return scan_string_value(scanner, &scanner->type);
+  }
+  if (g_str_equal(name, "result")) {
+    skip_spaces(scanner);
+    if ((scanner->pos < scanner->end) && (*scanner->pos == '{')) {
+      return scan_object(scanner, depth, scan_change_member);
+    }
+  }
+  return skip_value(scanner, depth);
+}
+
+/**
+ * Parses the body of the reply of snapd to a `GET /v2/changes/ID` request.
+ * Returns NULL and sets @error if it isn't valid, or if it is an error
+ * reply.
+ */
+SdiChangeSummary *sdi_change_summary_parse(const gchar *data, gsize length,
+                                           GError **error) {
+  if (!g_utf8_validate(data, length, NULL)) {
+    g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                        "The reply of snapd isn't valid UTF-8");
+    return NULL;
+  }
+
+  g_autoptr(SdiChangeSummary) summary = sdi_change_summary_new();
+  g_autoptr(GString) name = g_string_sized_new(64);
+  g_autoptr(GString) value = g_string_sized_new(256);
+  Scanner scanner = {.pos = data,
+                     .end = data + length,
+                     .name = name,
+                     .value = value,
+                     .summary = summary};
+  gboolean valid = scan_object(&scanner, 0, scan_reply_member);
+  skip_spaces(&scanner);
+  if (!valid || (scanner.pos != scanner.end)) {
+    g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                        "The reply of snapd isn't valid JSON");
+    return NULL;
+  }
+  if (g_strcmp0(scanner.type, "sync") != 0) {
+    g_set_error(error, G_IO_ERROR, G_IO_ERROR_FAILED, "snapd error: %s",
+                scanner.message == NULL ? "unknown" : scanner.message);
+    return NULL;
+  }
+  if ((summary->id == NULL) || (summary->kind == NULL) ||
+      (summary->status == NULL)) {
+    g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                        "The change returned by snapd is incomplete");
+    return NULL;
+  }
+  return g_steal_pointer(&summary);
+}
+
+const gchar *sdi_change_summary_get_id(SdiChangeSummary *self) {
+  return self->id;
+}
+
+const gchar *sdi_change_summary_get_kind(SdiChangeSummary *self) {
+  return self->kind;
+}
+
+const gchar *sdi_change_summary_get_status(SdiChangeSummary *self) {
+  return self->status;
+}
+
+gboolean sdi_change_summary_get_ready(SdiChangeSummary *self) {
+  return self->ready;
+}
+
+/**
+ * Returns the snaps in the autorefresh data of the change, or NULL if it
+ * doesn't have them.
+ */
+const gchar *const *sdi_change_summary_get_snap_names(SdiChangeSummary *self) {
+  if (self->snap_names == NULL) {
+    return NULL;
+  }
+  return (const gchar *const *)self->snap_names->pdata;
+}
+
+guint sdi_change_summary_get_n_tasks(SdiChangeSummary *self) {
+  return self->tasks->len;
+}
+
+const gchar *sdi_change_summary_get_task_status(SdiChangeSummary *self,
+                                                guint index) {
+  g_return_val_if_fail(index < self->tasks->len, NULL);
+
+  return g_array_index(self->tasks, Task, index).status;
+}
+
+const gchar *sdi_change_summary_get_task_summary(SdiChangeSummary *self,
+                                                 guint index) {
+  g_return_val_if_fail(index < self->tasks->len, NULL);
+
+  return g_array_index(self->tasks, Task, index).summary;
+}
+
+/**
+ * Returns the NULL-terminated list of snaps affected by the task @index, or
+ * NULL if the task doesn't have it.
+ */
+const gchar *const *
+sdi_change_summary_get_task_affected_snaps(SdiChangeSummary *self,
+                                           guint index) {
+  g_return_val_if_fail(index < self->tasks->len, NULL);
+
+  gint offset = g_array_index(self->tasks, Task, index).affected_snaps;
+  if (offset < 0) {
+    return NULL;
+  }
+  return (const gchar *const *)&self->affected_snaps->pdata[offset];
+}
+
+typedef struct {
+  gchar *message;
+  GSocketConnection *connection;
+  GByteArray *reply;
+  guint8 *buffer;
+  // offset of the body in the reply; 0 until the headers have been read
+  gsize body_offset;
+  // -1 if the reply has no Content-Length header
+  gint64 content_length;
+  gboolean chunked;
+} Request;
+
+static void free_request(Request *request) {
+  g_free(request->message);
+  g_clear_object(&request->connection);
+  g_byte_array_unref(request->reply);
+  g_free(request->buffer);
+  g_free(request);
+}
+
+/**
+ * Looks for the end of the headers in the data received, and reads the
+ * length and encoding of the body. Returns FALSE if they aren't complete.
+ */
+static gboolean read_headers(Request *request) {
+  if (request->body_offset != 0) {
+    return TRUE;
+  }
+  const gchar *data = (const gchar *)request->reply->data;
+  const gchar *end = g_strstr_len(data, request->reply->len, "\r\n\r\n");
+  if (end == NULL) {
+    return FALSE;
+  }
+  request->body_offset = end - data + 4;
+
+  g_autofree gchar *headers = g_strndup(data, end - data);
+  g_auto(GStrv) lines = g_strsplit(headers, "\r\n", -1);
+  // the first line is the status line
+  for (gchar **line = lines + 1; *line != NULL; line++) {
+    gchar *separator = strchr(*line, ':');
+    if (separator == NULL) {
+      continue;
+    }
+    *separator = '\0';
+    const gchar *value = g_strstrip(separator + 1);
+    if (g_ascii_strcasecmp(*line, "Content-Length") == 0) {
+      request->content_length = g_ascii_strtoll(value, NULL, 10);
+    } else if (g_ascii_strcasecmp(*line, "Transfer-Encoding") == 0) {
+      request->chunked = g_ascii_strcasecmp(value, "identity") != 0;
+    }
+  }
+  return TRUE;
+}
+
+static void return_summary(GTask *task) {
+  Request *request = g_task_get_task_data(task);
+  if (!read_headers(request)) {
+    g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+                            "Incomplete reply from snapd");
+    return;
+  }
+  // it doesn't happen with HTTP/1.0
+  if (request->chunked) {
+    g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_NOT_SUPPORTED,
+                            "Chunked replies from snapd aren't supported");
+    return;
+  }
+  gsize length = request->reply->len - request->body_offset;
+  if (request->content_length >= 0) {
+    if ((guint64)request->content_length > length) {
+      g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_PARTIAL_INPUT,
+                              "Incomplete reply from snapd");
+      return;
+    }
+    length = request->content_length;
+  }
+
+  GError *error = NULL;
+  SdiChangeSummary *summary = sdi_change_summary_parse(
+      (const gchar *)request->reply->data + request->body_offset, length,
+      &error);
+  if (summary == NULL) {
+    g_task_return_error(task, error);
+  } else {
+    g_task_return_pointer(task, summary,
+                          (GDestroyNotify)sdi_change_summary_free);
+  }
+}
+
+static void read_reply(GTask *task);
+
+static void read_cb(GObject *object, GAsyncResult *result, gpointer data) {
+  g_autoptr(GTask) task = data;
+  Request *request = g_task_get_task_data(task);
+  GError *error = NULL;
+
+  gssize n_read =
+      g_input_stream_read_finish(G_INPUT_STREAM(object), result, &error);
+  if (n_read < 0) {
+    g_task_return_error(task, error);
+    return;
+  }
+  if (n_read == 0) {
+    // snapd closes the connection after the reply to a HTTP/1.0 request
+    return_summary(task);
+    return;
+  }
+  g_byte_array_append(request->reply, request->buffer, n_read);
+  if (request->reply->len > MAX_REPLY_SIZE) {
+    g_task_return_new_error(task, G_IO_ERROR, G_IO_ERROR_MESSAGE_TOO_LARGE,
+                            "The reply of snapd is too big");
+    return;
+  }
+  if (read_headers(request) && (request->content_length >= 0) &&
+      (request->reply->len - request->body_offset >=
+       (guint64)request->content_length)) {
+    return_summary(task);
+    return;
+  }
+  read_reply(g_steal_pointer(&task));
+}
+
+static void read_reply(GTask *task) {
+  Request *request = g_task_get_task_data(task);
+  GInputStream *input =
+      g_io_stream_get_input_stream(G_IO_STREAM(request->connection));
+  g_input_stream_read_async(input, request->buffer, READ_BUFFER_SIZE,
+                            G_PRIORITY_DEFAULT, g_task_get_cancellable(task),
+                            read_cb, task);
+}
+
+static void write_cb(GObject *object, GAsyncResult *result, gpointer data) {
+  g_autoptr(GTask) task = data;
+  GError *error = NULL;
+
+  if (!g_output_stream_write_all_finish(G_OUTPUT_STREAM(object), result, NULL,
+                                        &error)) {
+    g_task_return_error(task, error);
+    return;
+  }
+  read_reply(g_steal_pointer(&task));
+}
+
+static void connect_cb(GObject *object, GAsyncResult *result, gpointer data) {
+  g_autoptr(GTask) task = data;
+  Request *request = g_task_get_task_data(task);
+  GError *error = NULL;
+
+  request->connection =
+      g_socket_client_connect_finish(G_SOCKET_CLIENT(object), result, &error);
+  if (request->connection == NULL) {
+    g_task_return_error(task, error);
+    return;
+  }
+  GOutputStream *output =
+      g_io_stream_get_output_stream(G_IO_STREAM(request->connection));
+  g_output_stream_write_all_async(output, request->message,
+                                  strlen(request->message), G_PRIORITY_DEFAULT,
+                                  g_task_get_cancellable(task), write_cb,
+                                  g_steal_pointer(&task));
+}
+
+/**
+ * Requests the change @change_id to the snapd listening in @socket_path,
+ * and returns a summary of it. The callback is called in the
+ * thread-default main context of the caller.
+ */
+void sdi_change_summary_request_async(const gchar *socket_path,
+                                      const gchar *change_id,
+                                      GCancellable *cancellable,
+                                      GAsyncReadyCallback callback,
+                                      gpointer user_data) {
+  g_return_if_fail(socket_path != NULL);
+  g_return_if_fail(change_id != NULL);
+
+  GTask *task = g_task_new(NULL, cancellable, callback, user_data);
+  g_task_set_source_tag(task, sdi_change_summary_request_async);
+
+  Request *request = g_malloc0(sizeof(Request));
+  g_autofree gchar *escaped_id = g_uri_escape_string(change_id, NULL, FALSE);
+  request->message = g_strdup_printf(
+      "GET /v2/changes/%s HTTP/1.0\r\nHost: snapd\r\n\r\n", escaped_id);
+  request->reply = g_byte_array_new();
+  request->buffer = g_malloc(READ_BUFFER_SIZE);
+  request->content_length = -1;
+  g_task_set_task_data(task, request, (GDestroyNotify)free_request);
+
+  g_autoptr(GSocketClient) client = g_socket_client_new();
+  g_autoptr(GSocketAddress) address = g_unix_socket_address_new(socket_path);
+  g_socket_client_connect_async(client, G_SOCKET_CONNECTABLE(address),
+                                cancellable, connect_cb, task);
+}
+
+SdiChangeSummary *sdi_change_summary_request_finish(GAsyncResult *result,
+                                                    GError **error) {
+  g_return_val_if_fail(g_task_is_valid(result, NULL), NULL);
+
+  return g_task_propagate_pointer(G_TASK(result), error);
+}
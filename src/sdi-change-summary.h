@@ -0,0 +1,71 @@
+/*
+ * Copyright (C) 2024 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+#include <snapd-glib/snapd-glib.h>
+
+G_BEGIN_DECLS
+
+/* The fields of a snapd change that #SdiRefreshMonitor uses: the ID, kind
+ * and status of the change, the snaps in its autorefresh data, and the
+ * status, summary and affected snaps of each task.
+ */
+typedef struct _SdiChangeSummary SdiChangeSummary;
+
+SdiChangeSummary *sdi_change_summary_parse(const gchar *data, gsize length,
+                                           GError **error);
+
+SdiChangeSummary *sdi_change_summary_new_from_change(SnapdChange *change);
+
+void sdi_change_summary_free(SdiChangeSummary *self);
+
+const gchar *sdi_change_summary_get_id(SdiChangeSummary *self);
+
+const gchar *sdi_change_summary_get_kind(SdiChangeSummary *self);
+
+const gchar *sdi_change_summary_get_status(SdiChangeSummary *self);
+
+gboolean sdi_change_summary_get_ready(SdiChangeSummary *self);
+
+const gchar *const *sdi_change_summary_get_snap_names(SdiChangeSummary *self);
+
+guint sdi_change_summary_get_n_tasks(SdiChangeSummary *self);
+
+const gchar *sdi_change_summary_get_task_status(SdiChangeSummary *self,
+                                                guint index);
+
+const gchar *sdi_change_summary_get_task_summary(SdiChangeSummary *self,
+                                                 guint index);
+
+const gchar *const *
+sdi_change_summary_get_task_affected_snaps(SdiChangeSummary *self,
+                                           guint index);
+
+void sdi_change_summary_request_async(const gchar *socket_path,
+                                      const gchar *change_id,
+                                      GCancellable *cancellable,
+                                      GAsyncReadyCallback callback,
+                                      gpointer user_data);
+
+SdiChangeSummary *sdi_change_summary_request_finish(GAsyncResult *result,
+                                                    GError **error);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(SdiChangeSummary, sdi_change_summary_free)
+
+G_END_DECLS
@@ -0,0 +1,146 @@
+/*
+ * Copyright (C) 2024 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "sdi-diagnostics.h"
+#include "io.snapcraft.SnapDesktopIntegration.Diagnostics.h"
+
+/**
+ * This class exports the io.snapcraft.SnapDesktopIntegration.Diagnostics
+ * DBus interface, which allows to query internal data of the running daemon
+ * to find performance problems in production.
+ */
+
+#define DIAGNOSTICS_PATH "/io/snapcraft/SnapDesktopIntegration/Diagnostics"
+
+struct _SdiDiagnostics {
+  GObject parent_instance;
+
+  SdiDbusDiagnostics *skeleton;
+  SdiMainLoopWatchdog *watchdog;
+  SdiRefreshMonitor *refresh_monitor;
+  SdiNotify *notify;
+};
+
+G_DEFINE_TYPE(SdiDiagnostics, sdi_diagnostics, G_TYPE_OBJECT)
+
+static gboolean handle_get_main_loop_stalls(SdiDbusDiagnostics *skeleton,
+                                            GDBusMethodInvocation *invocation,
+                                            SdiDiagnostics *self) {
+  if (self->watchdog == NULL) {
+    sdi_dbus_diagnostics_complete_get_main_loop_stalls(
+        skeleton, invocation, 0, 0, 0,
+        g_variant_new_array(G_VARIANT_TYPE("(xxs)"), NULL, 0));
+    return TRUE;
+  }
+  sdi_dbus_diagnostics_complete_get_main_loop_stalls(
+      skeleton, invocation,
+      sdi_main_loop_watchdog_get_threshold(self->watchdog),
+      sdi_main_loop_watchdog_get_n_stalls(self->watchdog),
+      sdi_main_loop_watchdog_get_max_stall(self->watchdog),
+      sdi_main_loop_watchdog_get_stalls(self->watchdog));
+  return TRUE;
+}
+
+static gboolean
+handle_get_refresh_monitor_footprint(SdiDbusDiagnostics *skeleton,
+                                     GDBusMethodInvocation *invocation,
+                                     SdiDiagnostics *self) {
+  guint n_snaps = 0, n_changes = 0, n_progress_entries = 0;
+  gsize size = 0;
+  if (self->refresh_monitor != NULL) {
+    size = sdi_refresh_monitor_get_footprint(
+        self->refresh_monitor, &n_snaps, &n_changes, &n_progress_entries);
+  }
+  sdi_dbus_diagnostics_complete_get_refresh_monitor_footprint(
+      skeleton, invocation, n_snaps, n_changes, n_progress_entries, size);
+  return TRUE;
+}
+
+static gboolean handle_get_notification_count(SdiDbusDiagnostics *skeleton,
+                                              GDBusMethodInvocation *invocation,
+                                              SdiDiagnostics *self) {
+  guint n_notifications = 0;
+  if (self->notify != NULL) {
+    n_notifications = sdi_notify_get_n_notifications(self->notify);
+  }
+  sdi_dbus_diagnostics_complete_get_notification_count(skeleton, invocation,
+                                                       n_notifications);
+  return TRUE;
+}
+
+void sdi_diagnostics_set_watchdog(SdiDiagnostics *self,
+                                  SdiMainLoopWatchdog *watchdog) {
+  g_return_if_fail(SDI_IS_DIAGNOSTICS(self));
+  g_set_object(&self->watchdog, watchdog);
+}
+
+void sdi_diagnostics_set_refresh_monitor(SdiDiagnostics *self,
+                                         SdiRefreshMonitor *refresh_monitor) {
+  g_return_if_fail(SDI_IS_DIAGNOSTICS(self));
+  g_set_object(&self->refresh_monitor, refresh_monitor);
+}
+
+void sdi_diagnostics_set_notify(SdiDiagnostics *self, SdiNotify *notify) {
+  g_return_if_fail(SDI_IS_DIAGNOSTICS(self));
+  g_set_object(&self->notify, notify);
+}
+
+static void sdi_diagnostics_dispose(GObject *object) {
+  SdiDiagnostics *self = SDI_DIAGNOSTICS(object);
+
+  if (self->skeleton != NULL) {
+    g_dbus_interface_skeleton_unexport(
+        G_DBUS_INTERFACE_SKELETON(self->skeleton));
+  }
+  g_clear_object(&self->skeleton);
+  g_clear_object(&self->watchdog);
+  g_clear_object(&self->refresh_monitor);
+  g_clear_object(&self->notify);
+
+  G_OBJECT_CLASS(sdi_diagnostics_parent_class)->dispose(object);
+}
+
+static void sdi_diagnostics_init(SdiDiagnostics *self) {
+  self->skeleton = sdi_dbus_diagnostics_skeleton_new();
+  g_signal_connect(self->skeleton, "handle-get-main-loop-stalls",
+                   (GCallback)handle_get_main_loop_stalls, self);
+  g_signal_connect(self->skeleton, "handle-get-refresh-monitor-footprint",
+                   (GCallback)handle_get_refresh_monitor_footprint, self);
+  g_signal_connect(self->skeleton, "handle-get-notification-count",
+                   (GCallback)handle_get_notification_count, self);
+}
+
+static void sdi_diagnostics_class_init(SdiDiagnosticsClass *klass) {
+  GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+
+  gobject_class->dispose = sdi_diagnostics_dispose;
+}
+
+SdiDiagnostics *sdi_diagnostics_new(GApplication *application) {
+  SdiDiagnostics *self = g_object_new(SDI_TYPE_DIAGNOSTICS, NULL);
+
+  g_autoptr(GError) error = NULL;
+  g_dbus_interface_skeleton_export(
+      G_DBUS_INTERFACE_SKELETON(self->skeleton),
+      g_application_get_dbus_connection(application), DIAGNOSTICS_PATH,
+      &error);
+  if (error != NULL) {
+    g_warning("Failed to export diagnostics DBus interface: %s",
+              error->message);
+  }
+  return self;
+}
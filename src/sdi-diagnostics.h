@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2024 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+#include "sdi-main-loop-watchdog.h"
+#include "sdi-notify.h"
+#include "sdi-refresh-monitor.h"
+
+G_BEGIN_DECLS
+
+#define SDI_TYPE_DIAGNOSTICS sdi_diagnostics_get_type()
+
+G_DECLARE_FINAL_TYPE(SdiDiagnostics, sdi_diagnostics, SDI, DIAGNOSTICS,
+                     GObject)
+
+SdiDiagnostics *sdi_diagnostics_new(GApplication *application);
+
+void sdi_diagnostics_set_watchdog(SdiDiagnostics *self,
+                                  SdiMainLoopWatchdog *watchdog);
+
+void sdi_diagnostics_set_refresh_monitor(SdiDiagnostics *self,
+                                         SdiRefreshMonitor *refresh_monitor);
+
+void sdi_diagnostics_set_notify(SdiDiagnostics *self, SdiNotify *notify);
+
+G_END_DECLS
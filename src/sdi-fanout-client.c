@@ -0,0 +1,246 @@
+/*
+ * Copyright (C) 2024 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "sdi-fanout-client.h"
+#include "sdi-snapd-variant.h"
+
+/**
+ * This class is the side of the daemon of the fan-out service
+ * (snapd-desktop-integration-fanout), which polls snapd once for all the
+ * users of the host.
+ *
+ * It emits the notices published by the service in the `notice-event`
+ * signal, with the same parameters than #SdiSnapdMonitor, and requests the
+ * changes with the same API than #SnapdClient. Each time that the service
+ * appears in the bus, including the first one, the notices that it already
+ * has are emitted with `first_run` set, so the consumers rebuild their
+ * state, as they do when snapd is restarted.
+ *
+ * The service is started through D-Bus activation. If it disappears, it is
+ * started again after FANOUT_RESTART_DELAY.
+ */
+
+#define FANOUT_INTERFACE "io.snapcraft.SnapDesktopIntegration.FanOut"
+// time in seconds before starting again the service if it disappears
+#define FANOUT_RESTART_DELAY 5
+
+struct _SdiFanoutClient {
+  GObject parent_instance;
+
+  GDBusConnection *connection;
+  guint watch_id;
+  guint notice_id;
+  guint restart_id;
+  // unique name of the service, or NULL if it isn't running
+  gchar *name_owner;
+  /* Cancelled on dispose. The requests don't keep a reference to the
+   * client, so their callbacks must return if they have been cancelled.
+   */
+  GCancellable *cancellable;
+};
+
+G_DEFINE_TYPE(SdiFanoutClient, sdi_fanout_client, G_TYPE_OBJECT)
+
+static void notice_cb(GDBusConnection *connection, const gchar *sender_name,
+                      const gchar *object_path, const gchar *interface_name,
+                      const gchar *signal_name, GVariant *parameters,
+                      SdiFanoutClient *self) {
+  if (!g_variant_is_of_type(
+          parameters, G_VARIANT_TYPE("(" SDI_SNAPD_NOTICE_VARIANT_TYPE "b)"))) {
+    return;
+  }
+  g_autoptr(GVariant) variant = NULL;
+  gboolean first_run;
+  g_variant_get(parameters, "(@" SDI_SNAPD_NOTICE_VARIANT_TYPE "b)", &variant,
+                &first_run);
+  g_autoptr(SnapdNotice) notice = sdi_snapd_variant_to_notice(variant);
+  g_signal_emit_by_name(self, "notice-event", notice, first_run);
+}
+
+static void get_notices_cb(GObject *object, GAsyncResult *result,
+                           gpointer data) {
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GVariant) reply =
+      g_dbus_connection_call_finish(G_DBUS_CONNECTION(object), result, &error);
+  if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+    return;
+  }
+  SdiFanoutClient *self = data;
+  if (reply == NULL) {
+    g_warning("Failed to get the notices from the fan-out service: %s",
+              error->message);
+    return;
+  }
+
+  g_autoptr(GVariant) notices = g_variant_get_child_value(reply, 0);
+  gsize n_notices = g_variant_n_children(notices);
+  for (gsize i = 0; i < n_notices; i++) {
+    g_autoptr(GVariant) variant = g_variant_get_child_value(notices, i);
+    g_autoptr(SnapdNotice) notice = sdi_snapd_variant_to_notice(variant);
+    g_signal_emit_by_name(self, "notice-event", notice, TRUE);
+  }
+}
+
+static void unsubscribe_notices(SdiFanoutClient *self) {
+  if (self->notice_id != 0) {
+    g_dbus_connection_signal_unsubscribe(self->connection, self->notice_id);
+    self->notice_id = 0;
+  }
+  g_clear_pointer(&self->name_owner, g_free);
+}
+
+static void name_appeared_cb(GDBusConnection *connection, const gchar *name,
+                             const gchar *name_owner, SdiFanoutClient *self) {
+  g_clear_handle_id(&self->restart_id, g_source_remove);
+  unsubscribe_notices(self);
+  self->name_owner = g_strdup(name_owner);
+  /* the unique name is used as sender because the system bus is shared
+   * with other users, who could send fake signals.
+   */
+  self->notice_id = g_dbus_connection_signal_subscribe(
+      connection, name_owner, FANOUT_INTERFACE, "Notice", SDI_FANOUT_PATH,
+      NULL, G_DBUS_SIGNAL_FLAGS_NONE, (GDBusSignalCallback)notice_cb, self,
+      NULL);
+  g_dbus_connection_call(connection, name_owner, SDI_FANOUT_PATH,
+                         FANOUT_INTERFACE, "GetNotices", NULL,
+                         G_VARIANT_TYPE("(a" SDI_SNAPD_NOTICE_VARIANT_TYPE ")"),
+                         G_DBUS_CALL_FLAGS_NONE, -1, self->cancellable,
+                         get_notices_cb, self);
+}
+
+static void start_service_cb(GObject *object, GAsyncResult *result,
+                             gpointer data) {
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GVariant) reply =
+      g_dbus_connection_call_finish(G_DBUS_CONNECTION(object), result, &error);
+  if (reply == NULL) {
+    g_debug("Failed to start the fan-out service: %s", error->message);
+  }
+}
+
+static gboolean restart_service(SdiFanoutClient *self) {
+  self->restart_id = 0;
+  g_dbus_connection_call(self->connection, "org.freedesktop.DBus",
+                         "/org/freedesktop/DBus", "org.freedesktop.DBus",
+                         "StartServiceByName",
+                         g_variant_new("(su)", SDI_FANOUT_NAME, 0), NULL,
+                         G_DBUS_CALL_FLAGS_NONE, -1, self->cancellable,
+                         start_service_cb, NULL);
+  return G_SOURCE_REMOVE;
+}
+
+static void name_vanished_cb(GDBusConnection *connection, const gchar *name,
+                             SdiFanoutClient *self) {
+  g_debug("The fan-out service isn't running");
+  unsubscribe_notices(self);
+  g_clear_handle_id(&self->restart_id, g_source_remove);
+  self->restart_id = g_timeout_add_seconds(
+      FANOUT_RESTART_DELAY, (GSourceFunc)restart_service, self);
+}
+
+static void get_change_cb(GObject *object, GAsyncResult *result,
+                          gpointer data) {
+  g_autoptr(GTask) task = data;
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GVariant) reply =
+      g_dbus_connection_call_finish(G_DBUS_CONNECTION(object), result, &error);
+  if (reply == NULL) {
+    g_task_return_error(task, g_steal_pointer(&error));
+    return;
+  }
+  g_autoptr(GVariant) change = g_variant_get_child_value(reply, 0);
+  g_task_return_pointer(task, sdi_snapd_variant_to_change(change),
+                        g_object_unref);
+}
+
+/**
+ * Requests the change @change_id to the fan-out service, which starts it
+ * if it isn't running.
+ */
+void sdi_fanout_client_get_change_async(SdiFanoutClient *self,
+                                        const gchar *change_id,
+                                        GCancellable *cancellable,
+                                        GAsyncReadyCallback callback,
+                                        gpointer user_data) {
+  g_return_if_fail(SDI_IS_FANOUT_CLIENT(self));
+
+  GTask *task = g_task_new(self, cancellable, callback, user_data);
+  g_dbus_connection_call(
+      self->connection, SDI_FANOUT_NAME, SDI_FANOUT_PATH, FANOUT_INTERFACE,
+      "GetChange", g_variant_new("(s)", change_id),
+      G_VARIANT_TYPE("(" SDI_SNAPD_CHANGE_VARIANT_TYPE ")"),
+      G_DBUS_CALL_FLAGS_NONE, -1, cancellable, get_change_cb, task);
+}
+
+SnapdChange *sdi_fanout_client_get_change_finish(SdiFanoutClient *self,
+                                                 GAsyncResult *result,
+                                                 GError **error) {
+  g_return_val_if_fail(g_task_is_valid(result, self), NULL);
+
+  return g_task_propagate_pointer(G_TASK(result), error);
+}
+
+/**
+ * Starts watching the fan-out service. The notices are emitted from the
+ * main loop once it is running.
+ */
+void sdi_fanout_client_start(SdiFanoutClient *self) {
+  g_return_if_fail(SDI_IS_FANOUT_CLIENT(self));
+
+  if (self->watch_id != 0) {
+    return;
+  }
+  self->watch_id = g_bus_watch_name_on_connection(
+      self->connection, SDI_FANOUT_NAME, G_BUS_NAME_WATCHER_FLAGS_AUTO_START,
+      (GBusNameAppearedCallback)name_appeared_cb,
+      (GBusNameVanishedCallback)name_vanished_cb, self, NULL);
+}
+
+static void sdi_fanout_client_dispose(GObject *object) {
+  SdiFanoutClient *self = SDI_FANOUT_CLIENT(object);
+
+  g_cancellable_cancel(self->cancellable);
+  g_clear_object(&self->cancellable);
+  g_clear_handle_id(&self->watch_id, g_bus_unwatch_name);
+  g_clear_handle_id(&self->restart_id, g_source_remove);
+  if (self->connection != NULL) {
+    unsubscribe_notices(self);
+  }
+  g_clear_object(&self->connection);
+
+  G_OBJECT_CLASS(sdi_fanout_client_parent_class)->dispose(object);
+}
+
+static void sdi_fanout_client_init(SdiFanoutClient *self) {
+  self->cancellable = g_cancellable_new();
+}
+
+static void sdi_fanout_client_class_init(SdiFanoutClientClass *klass) {
+  GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+
+  gobject_class->dispose = sdi_fanout_client_dispose;
+
+  g_signal_new("notice-event", G_TYPE_FROM_CLASS(klass), G_SIGNAL_RUN_LAST, 0,
+               NULL, NULL, NULL, G_TYPE_NONE, 2, SNAPD_TYPE_NOTICE,
+               G_TYPE_BOOLEAN);
+}
+
+SdiFanoutClient *sdi_fanout_client_new(GDBusConnection *connection) {
+  SdiFanoutClient *self = g_object_new(SDI_TYPE_FANOUT_CLIENT, NULL);
+  self->connection = g_object_ref(connection);
+  return self;
+}
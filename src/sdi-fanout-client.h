@@ -0,0 +1,47 @@
+/*
+ * Copyright (C) 2024 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+#include <snapd-glib/snapd-glib.h>
+
+G_BEGIN_DECLS
+
+#define SDI_FANOUT_NAME "io.snapcraft.SnapDesktopIntegration.FanOut"
+#define SDI_FANOUT_PATH "/io/snapcraft/SnapDesktopIntegration/FanOut"
+
+#define SDI_TYPE_FANOUT_CLIENT sdi_fanout_client_get_type()
+
+G_DECLARE_FINAL_TYPE(SdiFanoutClient, sdi_fanout_client, SDI, FANOUT_CLIENT,
+                     GObject)
+
+SdiFanoutClient *sdi_fanout_client_new(GDBusConnection *connection);
+
+void sdi_fanout_client_start(SdiFanoutClient *self);
+
+void sdi_fanout_client_get_change_async(SdiFanoutClient *self,
+                                        const gchar *change_id,
+                                        GCancellable *cancellable,
+                                        GAsyncReadyCallback callback,
+                                        gpointer user_data);
+
+SnapdChange *sdi_fanout_client_get_change_finish(SdiFanoutClient *self,
+                                                 GAsyncResult *result,
+                                                 GError **error);
+
+G_END_DECLS
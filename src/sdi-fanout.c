@@ -0,0 +1,302 @@
+/*
+ * Copyright (C) 2024 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+#include <gio/gio.h>
+#include <glib-unix.h>
+#include <signal.h>
+#include <snapd-glib/snapd-glib.h>
+
+#include "io.snapcraft.SnapDesktopIntegration.FanOut.h"
+#include "sdi-fanout-client.h"
+#include "sdi-notice-types.h"
+#include "sdi-snapd-client-factory.h"
+#include "sdi-snapd-monitor.h"
+#include "sdi-snapd-variant.h"
+
+/**
+ * This is snapd-desktop-integration-fanout, an optional system service for
+ * hosts with many logged-in users. Without it, the daemon of each user
+ * long-polls the snapd notices and polls every change being refreshed, so
+ * snapd receives the same requests once per user.
+ *
+ * This service does both things only once, and publishes the results in the
+ * system bus: the notices are emitted in the `Notice` signal, and the
+ * changes are returned by `GetChange`, which shares each reply of snapd
+ * between all the callers for CHANGE_CACHE_TIME, and sends only one request
+ * to snapd while there is one in flight. The daemons use it when they are
+ * launched with `--use-fanout`.
+ */
+
+/* time in ms during which a reply of snapd is shared between callers. It is
+ * the polling period of #SdiRefreshMonitor, so each change is requested to
+ * snapd at most once per period, instead of once per user and period.
+ */
+#define CHANGE_CACHE_TIME 500
+// time in seconds between removals of the unused cache entries.
+#define CACHE_GC_PERIOD 60
+// maximum number of notices kept for `GetNotices`.
+#define MAX_RETAINED_NOTICES 256
+
+/* the union of the notice types used by the monitors of the daemon; the
+ * repeated ones are ignored by `sdi_snapd_monitor_add_notice_types()`. */
+static const gchar *const notice_types[] = {SDI_REFRESH_MONITOR_NOTICE_TYPES,
+                                            SDI_THEME_MONITOR_NOTICE_TYPES,
+                                            NULL};
+
+typedef struct {
+  gchar *change_id;
+  // last reply from snapd, or NULL if there is none yet
+  GVariant *change;
+  // monotonic time when `change` was received
+  gint64 timestamp;
+  // callers waiting for the request in flight
+  GPtrArray *invocations;
+} CachedChange;
+
+static GMainLoop *loop = NULL;
+static SnapdClient *client = NULL;
+static SdiSnapdMonitor *snapd_monitor = NULL;
+static SdiDbusFanOut *skeleton = NULL;
+// the change ID is the key, and a CachedChange the value
+static GHashTable *changes = NULL;
+// the newest notice of each type and key, from the oldest to the newest
+static GPtrArray *retained_notices = NULL;
+
+static gchar *snapd_socket_path = NULL;
+
+static GOptionEntry entries[] = {
+    {"snapd-socket-path", 0, G_OPTION_FLAG_NONE, G_OPTION_ARG_FILENAME,
+     &snapd_socket_path, "Snapd socket path", "PATH"},
+    {NULL}};
+
+static void free_cached_change(CachedChange *cached) {
+  g_free(cached->change_id);
+  g_clear_pointer(&cached->change, g_variant_unref);
+  g_ptr_array_unref(cached->invocations);
+  g_free(cached);
+}
+
+static gboolean is_valid_change_id(const gchar *change_id) {
+  if (*change_id == '\0') {
+    return FALSE;
+  }
+  for (const gchar *p = change_id; *p != '\0'; p++) {
+    if (!g_ascii_isdigit(*p)) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+static void get_change_cb(GObject *object, GAsyncResult *result,
+                          gpointer data) {
+  g_autofree gchar *change_id = data;
+  g_autoptr(GError) error = NULL;
+  g_autoptr(SnapdChange) change =
+      snapd_client_get_change_finish(SNAPD_CLIENT(object), result, &error);
+
+  CachedChange *cached = g_hash_table_lookup(changes, change_id);
+  if (cached == NULL) {
+    return;
+  }
+  if (change != NULL) {
+    g_clear_pointer(&cached->change, g_variant_unref);
+    cached->change = g_variant_ref_sink(sdi_snapd_variant_from_change(change));
+    cached->timestamp = g_get_monotonic_time();
+  }
+  for (guint i = 0; i < cached->invocations->len; i++) {
+    GDBusMethodInvocation *invocation = cached->invocations->pdata[i];
+    if (change != NULL) {
+      sdi_dbus_fan_out_complete_get_change(skeleton, invocation,
+                                           cached->change);
+    } else {
+      g_dbus_method_invocation_return_gerror(invocation, error);
+    }
+  }
+  // the invocations are consumed when they are completed
+  g_ptr_array_set_size(cached->invocations, 0);
+}
+
+static gboolean handle_get_change(SdiDbusFanOut *object,
+                                  GDBusMethodInvocation *invocation,
+                                  const gchar *change_id, gpointer data) {
+  if (!is_valid_change_id(change_id)) {
+    g_dbus_method_invocation_return_error(invocation, G_DBUS_ERROR,
+                                          G_DBUS_ERROR_INVALID_ARGS,
+                                          "Invalid change ID %s", change_id);
+    return TRUE;
+  }
+
+  CachedChange *cached = g_hash_table_lookup(changes, change_id);
+  if (cached == NULL) {
+    cached = g_malloc0(sizeof(CachedChange));
+    cached->change_id = g_strdup(change_id);
+    cached->invocations = g_ptr_array_new();
+    g_hash_table_insert(changes, g_strdup(change_id), cached);
+  }
+  gint64 age = g_get_monotonic_time() - cached->timestamp;
+  if ((cached->change != NULL) && (age < CHANGE_CACHE_TIME * 1000)) {
+    sdi_dbus_fan_out_complete_get_change(object, invocation, cached->change);
+    return TRUE;
+  }
+
+  g_ptr_array_add(cached->invocations, invocation);
+  if (cached->invocations->len == 1) {
+    snapd_client_get_change_async(client, change_id, NULL, get_change_cb,
+                                  g_strdup(change_id));
+  }
+  return TRUE;
+}
+
+static gboolean handle_get_notices(SdiDbusFanOut *object,
+                                   GDBusMethodInvocation *invocation,
+                                   gpointer data) {
+  GVariantBuilder notices;
+  g_variant_builder_init(&notices,
+                         G_VARIANT_TYPE("a" SDI_SNAPD_NOTICE_VARIANT_TYPE));
+  for (guint i = 0; i < retained_notices->len; i++) {
+    g_variant_builder_add_value(&notices, retained_notices->pdata[i]);
+  }
+  sdi_dbus_fan_out_complete_get_notices(object, invocation,
+                                        g_variant_builder_end(&notices));
+  return TRUE;
+}
+
+static gboolean same_notice(GVariant *notice1, GVariant *notice2) {
+  const gchar *type1, *key1, *type2, *key2;
+  g_variant_get(notice1, "(&s&s&s@a{ss})", NULL, &type1, &key1, NULL);
+  g_variant_get(notice2, "(&s&s&s@a{ss})", NULL, &type2, &key2, NULL);
+  return g_str_equal(type1, type2) && g_str_equal(key1, key2);
+}
+
+static void retain_notice(GVariant *notice) {
+  for (guint i = 0; i < retained_notices->len; i++) {
+    if (same_notice(retained_notices->pdata[i], notice)) {
+      g_ptr_array_remove_index(retained_notices, i);
+      break;
+    }
+  }
+  g_ptr_array_add(retained_notices, g_variant_ref(notice));
+  if (retained_notices->len > MAX_RETAINED_NOTICES) {
+    g_ptr_array_remove_index(retained_notices, 0);
+  }
+}
+
+static void notice_cb(SdiSnapdMonitor *monitor, SnapdNotice *notice,
+                      gboolean first_run, gpointer data) {
+  static gboolean last_first_run = FALSE;
+
+  // the notices of a new snapd instance replace the old ones
+  if (first_run && !last_first_run) {
+    g_ptr_array_set_size(retained_notices, 0);
+  }
+  last_first_run = first_run;
+
+  g_autoptr(GVariant) variant =
+      g_variant_ref_sink(sdi_snapd_variant_from_notice(notice));
+  retain_notice(variant);
+  sdi_dbus_fan_out_emit_notice(skeleton, variant, first_run);
+}
+
+static gboolean gc_cb(gpointer data) {
+  gint64 now = g_get_monotonic_time();
+  GHashTableIter iter;
+  CachedChange *cached;
+  g_hash_table_iter_init(&iter, changes);
+  while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&cached)) {
+    if ((cached->invocations->len == 0) &&
+        (now - cached->timestamp > CACHE_GC_PERIOD * G_USEC_PER_SEC)) {
+      g_hash_table_iter_remove(&iter);
+    }
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+static void bus_acquired_cb(GDBusConnection *connection, const gchar *name,
+                            gpointer data) {
+  g_autoptr(GError) error = NULL;
+  if (!g_dbus_interface_skeleton_export(G_DBUS_INTERFACE_SKELETON(skeleton),
+                                        connection, SDI_FANOUT_PATH, &error)) {
+    g_warning("Failed to export the fan-out interface: %s", error->message);
+    g_main_loop_quit(loop);
+  }
+}
+
+static void name_acquired_cb(GDBusConnection *connection, const gchar *name,
+                             gpointer data) {
+  sdi_snapd_monitor_start(snapd_monitor);
+}
+
+static void name_lost_cb(GDBusConnection *connection, const gchar *name,
+                         gpointer data) {
+  g_warning("Failed to own the name %s", name);
+  g_main_loop_quit(loop);
+}
+
+static gboolean quit_cb(gpointer data) {
+  g_main_loop_quit(loop);
+  return G_SOURCE_REMOVE;
+}
+
+int main(int argc, char **argv) {
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GOptionContext) context =
+      g_option_context_new("- share the snapd notices and changes");
+  g_option_context_add_main_entries(context, entries, NULL);
+  if (!g_option_context_parse(context, &argc, &argv, &error)) {
+    g_printerr("%s\n", error->message);
+    return 1;
+  }
+  sdi_snapd_client_factory_set_custom_path(snapd_socket_path);
+
+  loop = g_main_loop_new(NULL, FALSE);
+  client = sdi_snapd_client_factory_new_snapd_client();
+  changes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                  (GDestroyNotify)free_cached_change);
+  retained_notices =
+      g_ptr_array_new_with_free_func((GDestroyNotify)g_variant_unref);
+
+  skeleton = sdi_dbus_fan_out_skeleton_new();
+  g_signal_connect(skeleton, "handle-get-change",
+                   (GCallback)handle_get_change, NULL);
+  g_signal_connect(skeleton, "handle-get-notices",
+                   (GCallback)handle_get_notices, NULL);
+
+  snapd_monitor = sdi_snapd_monitor_new();
+  sdi_snapd_monitor_add_notice_types(snapd_monitor, notice_types);
+  g_signal_connect(snapd_monitor, "notice-event", (GCallback)notice_cb, NULL);
+
+  guint gc_id = g_timeout_add_seconds(CACHE_GC_PERIOD, gc_cb, NULL);
+  g_unix_signal_add(SIGTERM, quit_cb, NULL);
+  g_unix_signal_add(SIGINT, quit_cb, NULL);
+  guint owner_id = g_bus_own_name(G_BUS_TYPE_SYSTEM, SDI_FANOUT_NAME,
+                                  G_BUS_NAME_OWNER_FLAGS_NONE, bus_acquired_cb,
+                                  name_acquired_cb, name_lost_cb, NULL, NULL);
+
+  g_main_loop_run(loop);
+
+  g_bus_unown_name(owner_id);
+  g_source_remove(gc_id);
+  g_clear_object(&snapd_monitor);
+  g_clear_object(&skeleton);
+  g_clear_pointer(&changes, g_hash_table_unref);
+  g_clear_pointer(&retained_notices, g_ptr_array_unref);
+  g_clear_object(&client);
+  g_clear_pointer(&loop, g_main_loop_unref);
+  return 0;
+}
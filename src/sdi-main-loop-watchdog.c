@@ -0,0 +1,272 @@
+/*
+ * Copyright (C) 2024 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "sdi-main-loop-watchdog.h"
+
+/**
+ * This class detects stalls in the main loop. It adds a high priority
+ * heartbeat source that should be dispatched every HEARTBEAT_PERIOD ms; if
+ * it is dispatched later than that plus the threshold, something blocked the
+ * main loop in the meantime, and a stall is recorded.
+ *
+ * Since the heartbeat can't know what was running, the code that does
+ * blocking calls must surround them with `sdi_main_loop_watchdog_begin_call()`
+ * and `sdi_main_loop_watchdog_end_call()`. The slowest call done between two
+ * heartbeats, together with the name of the source that was being dispatched,
+ * is blamed for the stall. Those functions do nothing if there is no watchdog
+ * running, so they can be used unconditionally.
+ */
+
+// time in ms between heartbeats
+#define HEARTBEAT_PERIOD 100
+// number of stalls kept to be returned by the DBus interface
+#define MAX_RECORDED_STALLS 20
+// time in seconds between summaries in the log, if there are new stalls
+#define SUMMARY_PERIOD 3600
+
+struct _SdiMainLoopWatchdog {
+  GObject parent_instance;
+
+  guint threshold;
+  GSource *heartbeat;
+  gint64 last_heartbeat;
+  guint summary_id;
+  guint n_stalls_in_last_summary;
+
+  const gchar *call_site;
+  gint64 call_start;
+  gint64 slowest_call_duration;
+  gchar *slowest_call_site;
+
+  guint n_stalls;
+  gint64 max_stall;
+  gint64 total_stall_time;
+  GQueue *stalls;
+};
+
+G_DEFINE_TYPE(SdiMainLoopWatchdog, sdi_main_loop_watchdog, G_TYPE_OBJECT)
+
+typedef struct {
+  gint64 time;
+  gint64 duration;
+  gchar *call_site;
+} SdiStall;
+
+static SdiMainLoopWatchdog *running_watchdog = NULL;
+
+static void free_stall(SdiStall *stall) {
+  g_free(stall->call_site);
+  g_free(stall);
+}
+
+/* Returns the name of the source being dispatched, to blame it for a stall
+ * without a marked call. The heartbeat isn't blamed for its own lateness.
+ */
+static const gchar *get_current_source_name(SdiMainLoopWatchdog *self) {
+  GSource *source = g_main_current_source();
+  if ((source == NULL) || (source == self->heartbeat)) {
+    return NULL;
+  }
+  return g_source_get_name(source);
+}
+
+static void record_stall(SdiMainLoopWatchdog *self, gint64 duration) {
+  SdiStall *stall = g_malloc0(sizeof(SdiStall));
+  stall->time = g_get_real_time();
+  stall->duration = duration;
+  if (self->slowest_call_site != NULL) {
+    stall->call_site = g_strdup(self->slowest_call_site);
+  } else {
+    const gchar *source_name = get_current_source_name(self);
+    stall->call_site = g_strdup(source_name != NULL ? source_name : "unknown");
+  }
+  g_message("Main loop stalled for %" G_GINT64_FORMAT " ms (%s)", duration,
+            stall->call_site);
+
+  self->n_stalls++;
+  self->total_stall_time += duration;
+  self->max_stall = MAX(self->max_stall, duration);
+  g_queue_push_tail(self->stalls, stall);
+  if (g_queue_get_length(self->stalls) > MAX_RECORDED_STALLS) {
+    free_stall(g_queue_pop_head(self->stalls));
+  }
+}
+
+static gboolean heartbeat_cb(SdiMainLoopWatchdog *self) {
+  gint64 now = g_get_monotonic_time();
+  gint64 lateness = (now - self->last_heartbeat) / 1000 - HEARTBEAT_PERIOD;
+  if (lateness > self->threshold) {
+    record_stall(self, lateness);
+  }
+  self->last_heartbeat = now;
+  self->slowest_call_duration = 0;
+  g_clear_pointer(&self->slowest_call_site, g_free);
+  return G_SOURCE_CONTINUE;
+}
+
+static gboolean summary_cb(SdiMainLoopWatchdog *self) {
+  if (self->n_stalls != self->n_stalls_in_last_summary) {
+    sdi_main_loop_watchdog_log_summary(self);
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+void sdi_main_loop_watchdog_begin_call(const gchar *call_site) {
+  SdiMainLoopWatchdog *self = running_watchdog;
+  if (self == NULL) {
+    return;
+  }
+  self->call_site = call_site;
+  self->call_start = g_get_monotonic_time();
+}
+
+void sdi_main_loop_watchdog_end_call(void) {
+  SdiMainLoopWatchdog *self = running_watchdog;
+  if ((self == NULL) || (self->call_site == NULL)) {
+    return;
+  }
+  gint64 duration = g_get_monotonic_time() - self->call_start;
+  if (duration > self->slowest_call_duration) {
+    GSource *source = g_main_current_source();
+    const gchar *source_name =
+        (source == NULL) ? NULL : g_source_get_name(source);
+    self->slowest_call_duration = duration;
+    g_free(self->slowest_call_site);
+    if (source_name == NULL) {
+      self->slowest_call_site = g_strdup(self->call_site);
+    } else {
+      self->slowest_call_site =
+          g_strdup_printf("%s in %s", self->call_site, source_name);
+    }
+  }
+  self->call_site = NULL;
+}
+
+void sdi_main_loop_watchdog_start(SdiMainLoopWatchdog *self) {
+  g_return_if_fail(SDI_IS_MAIN_LOOP_WATCHDOG(self));
+
+  if (self->heartbeat != NULL) {
+    return;
+  }
+  self->last_heartbeat = g_get_monotonic_time();
+  self->heartbeat = g_timeout_source_new(HEARTBEAT_PERIOD);
+  g_source_set_priority(self->heartbeat, G_PRIORITY_HIGH);
+  g_source_set_static_name(self->heartbeat, "sdi-main-loop-watchdog");
+  g_source_set_callback(self->heartbeat, (GSourceFunc)heartbeat_cb, self,
+                        NULL);
+  g_source_attach(self->heartbeat, NULL);
+  self->summary_id =
+      g_timeout_add_seconds(SUMMARY_PERIOD, (GSourceFunc)summary_cb, self);
+  running_watchdog = self;
+}
+
+void sdi_main_loop_watchdog_stop(SdiMainLoopWatchdog *self) {
+  g_return_if_fail(SDI_IS_MAIN_LOOP_WATCHDOG(self));
+
+  if (self->heartbeat == NULL) {
+    return;
+  }
+  g_source_destroy(self->heartbeat);
+  g_clear_pointer(&self->heartbeat, g_source_unref);
+  g_clear_handle_id(&self->summary_id, g_source_remove);
+  if (running_watchdog == self) {
+    running_watchdog = NULL;
+  }
+}
+
+guint sdi_main_loop_watchdog_get_threshold(SdiMainLoopWatchdog *self) {
+  g_return_val_if_fail(SDI_IS_MAIN_LOOP_WATCHDOG(self), 0);
+  return self->threshold;
+}
+
+guint sdi_main_loop_watchdog_get_n_stalls(SdiMainLoopWatchdog *self) {
+  g_return_val_if_fail(SDI_IS_MAIN_LOOP_WATCHDOG(self), 0);
+  return self->n_stalls;
+}
+
+gint64 sdi_main_loop_watchdog_get_max_stall(SdiMainLoopWatchdog *self) {
+  g_return_val_if_fail(SDI_IS_MAIN_LOOP_WATCHDOG(self), 0);
+  return self->max_stall;
+}
+
+/**
+ * Returns the last recorded stalls as an `a(xxs)` variant, with the time when
+ * each stall was detected (in microseconds since the epoch), its duration in
+ * milliseconds, and the call site blamed for it.
+ */
+GVariant *sdi_main_loop_watchdog_get_stalls(SdiMainLoopWatchdog *self) {
+  g_return_val_if_fail(SDI_IS_MAIN_LOOP_WATCHDOG(self), NULL);
+
+  g_autoptr(GVariantBuilder) builder =
+      g_variant_builder_new(G_VARIANT_TYPE("a(xxs)"));
+  for (GList *p = self->stalls->head; p != NULL; p = p->next) {
+    SdiStall *stall = p->data;
+    g_variant_builder_add(builder, "(xxs)", stall->time, stall->duration,
+                          stall->call_site);
+  }
+  return g_variant_builder_end(builder);
+}
+
+void sdi_main_loop_watchdog_log_summary(SdiMainLoopWatchdog *self) {
+  g_return_if_fail(SDI_IS_MAIN_LOOP_WATCHDOG(self));
+
+  self->n_stalls_in_last_summary = self->n_stalls;
+  if (self->n_stalls == 0) {
+    g_message("Main loop watchdog: no stalls longer than %u ms",
+              self->threshold);
+    return;
+  }
+  g_message("Main loop watchdog: %u stalls longer than %u ms, %" G_GINT64_FORMAT
+            " ms in total, the longest one of %" G_GINT64_FORMAT " ms",
+            self->n_stalls, self->threshold, self->total_stall_time,
+            self->max_stall);
+}
+
+static void sdi_main_loop_watchdog_dispose(GObject *object) {
+  SdiMainLoopWatchdog *self = SDI_MAIN_LOOP_WATCHDOG(object);
+
+  sdi_main_loop_watchdog_stop(self);
+  g_clear_pointer(&self->slowest_call_site, g_free);
+  if (self->stalls != NULL) {
+    g_queue_free_full(g_steal_pointer(&self->stalls),
+                      (GDestroyNotify)free_stall);
+  }
+
+  G_OBJECT_CLASS(sdi_main_loop_watchdog_parent_class)->dispose(object);
+}
+
+static void sdi_main_loop_watchdog_init(SdiMainLoopWatchdog *self) {
+  self->stalls = g_queue_new();
+}
+
+static void
+sdi_main_loop_watchdog_class_init(SdiMainLoopWatchdogClass *klass) {
+  GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+
+  gobject_class->dispose = sdi_main_loop_watchdog_dispose;
+}
+
+/**
+ * Creates a new watchdog that records any stall longer than `threshold`
+ * milliseconds. It does nothing until `sdi_main_loop_watchdog_start()` is
+ * called.
+ */
+SdiMainLoopWatchdog *sdi_main_loop_watchdog_new(guint threshold) {
+  SdiMainLoopWatchdog *self = g_object_new(SDI_TYPE_MAIN_LOOP_WATCHDOG, NULL);
+  self->threshold = threshold;
+  return self;
+}
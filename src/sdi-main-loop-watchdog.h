@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2024 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define SDI_TYPE_MAIN_LOOP_WATCHDOG sdi_main_loop_watchdog_get_type()
+
+G_DECLARE_FINAL_TYPE(SdiMainLoopWatchdog, sdi_main_loop_watchdog, SDI,
+                     MAIN_LOOP_WATCHDOG, GObject)
+
+SdiMainLoopWatchdog *sdi_main_loop_watchdog_new(guint threshold);
+
+void sdi_main_loop_watchdog_start(SdiMainLoopWatchdog *self);
+
+void sdi_main_loop_watchdog_stop(SdiMainLoopWatchdog *self);
+
+guint sdi_main_loop_watchdog_get_threshold(SdiMainLoopWatchdog *self);
+
+guint sdi_main_loop_watchdog_get_n_stalls(SdiMainLoopWatchdog *self);
+
+gint64 sdi_main_loop_watchdog_get_max_stall(SdiMainLoopWatchdog *self);
+
+GVariant *sdi_main_loop_watchdog_get_stalls(SdiMainLoopWatchdog *self);
+
+void sdi_main_loop_watchdog_log_summary(SdiMainLoopWatchdog *self);
+
+void sdi_main_loop_watchdog_begin_call(const gchar *call_site);
+
+void sdi_main_loop_watchdog_end_call(void);
+
+G_END_DECLS
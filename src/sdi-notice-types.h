@@ -0,0 +1,25 @@
+/*
+ * Copyright (C) 2024 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+/* Notice types processed by each consumer of the snapd notices, to be used
+ * in NULL-terminated arrays. The fan-out service requests all of them
+ * without linking the consumers.
+ */
+#define SDI_REFRESH_MONITOR_NOTICE_TYPES "change-update", "refresh-inhibit"
+#define SDI_THEME_MONITOR_NOTICE_TYPES "change-update"
@@ -19,6 +19,13 @@
 #define SNAP_STORE "snap-store_snap-store.desktop"
 #define SNAP_STORE_UPDATES "snap-store_show-updates.desktop"
 
+// time in ms during which refresh-complete events are grouped together
+#define AGGREGATION_WINDOW 500
+// maximum number of notifications shown per minute
+#define MAX_NOTIFICATIONS_PER_MINUTE 20
+// period, in seconds, of the timer that updates the forced refresh countdowns
+#define COUNTDOWN_PERIOD 60
+
 #include "sdi-notify.h"
 #include <gio/gdesktopappinfo.h>
 #include <glib/gi18n.h>
@@ -27,17 +34,355 @@
 
 #include "io.snapcraft.PrivilegedDesktopLauncher.h"
 #include "sdi-helpers.h"
+#include "sdi-main-loop-watchdog.h"
 
 enum { PROP_APPLICATION = 1, PROP_LAST };
 
+/* Data needed to show a snap in a notification. Getting it requires to read
+ * its .desktop file, so it is done in a thread (see prepare_snap_infos()).
+ */
+typedef struct {
+  gchar *snap_name;
+  gchar *name;
+  GIcon *icon;
+  gchar *desktop;
+} SnapInfo;
+
+static SnapInfo *snap_info_new(const gchar *snap_name, const gchar *name,
+                               GIcon *icon, const gchar *desktop) {
+  SnapInfo *data = g_malloc0(sizeof(SnapInfo));
+  data->snap_name = g_strdup(snap_name);
+  data->name = g_strdup(name);
+  data->icon = (icon == NULL) ? NULL : g_object_ref(icon);
+  data->desktop = g_strdup(desktop);
+  return data;
+}
+
+static void snap_info_free(SnapInfo *data) {
+  // entries of a request are NULL until they are resolved
+  if (data == NULL) {
+    return;
+  }
+  g_free(data->snap_name);
+  g_free(data->name);
+  g_clear_object(&data->icon);
+  g_free(data->desktop);
+  g_free(data);
+}
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC(SnapInfo, snap_info_free)
+
 struct _SdiNotify {
   GObject parent_instance;
 
   GApplication *application;
+
+  /* Refresh-complete events are queued and shown together when the
+   * aggregation window ends, or later if there is no budget left. */
+  GPtrArray *completed_refreshes;
+  guint flush_id;
+  // the last pending refresh list, if it couldn't be shown due to the budget
+  GListModel *deferred_pending_refresh;
+  // names of the snaps listed in the last pending refresh notification
+  GHashTable *pending_snaps;
+  // time of each notification shown during the last minute
+  GQueue *shown_times;
+  /* Index of the names, icons and .desktop files already resolved, by snap
+   * name, so notifications can be built without reading the disk. */
+  GHashTable *snap_infos;
+  SnapInfo *snap_store_info;
+
+  /* Countdowns of the snaps that will be forced to refresh, indexed by snap
+   * name. There is only one notification per snap, and its text is updated
+   * by a single timer. */
+  GHashTable *forced_refreshes;
+  guint countdown_id;
+
+#ifndef USE_GNOTIFY
+  /* Every notification shown is kept here until the notification server
+   * reports that it has been closed, which releases it along with the data
+   * of its actions. */
+  GHashTable *notifications;
+  // summary of updated apps, updated in place until it is closed
+  NotifyNotification *summary_notification;
+  guint n_apps_in_summary;
+  // last pending refresh notification, until it is closed
+  NotifyNotification *pending_notification;
+#endif
 };
 
 G_DEFINE_TYPE(SdiNotify, sdi_notify, G_TYPE_OBJECT)
 
+// a NULL snap means the snap store
+static SnapInfo *resolve_snap_info(SnapdSnap *snap) {
+  g_autoptr(GAppInfo) app_info = NULL;
+  if (snap == NULL) {
+    app_info = G_APP_INFO(g_desktop_app_info_new(SNAP_STORE));
+  } else {
+    app_info = sdi_get_desktop_file_from_snap(snap);
+  }
+
+  const gchar *name = NULL;
+  GIcon *icon = NULL;
+  const gchar *desktop = NULL;
+  if (app_info != NULL) {
+    name = g_app_info_get_display_name(app_info);
+    icon = g_app_info_get_icon(app_info);
+    desktop = g_desktop_app_info_get_filename(G_DESKTOP_APP_INFO(app_info));
+  }
+  const gchar *snap_name = (snap == NULL) ? NULL : snapd_snap_get_name(snap);
+  if (name == NULL) {
+    name = snap_name;
+  }
+  return snap_info_new(snap_name, name, icon, desktop);
+}
+
+typedef void (*SnapInfosReadyFunc)(SdiNotify *self, GPtrArray *infos,
+                                   gpointer user_data);
+
+typedef struct {
+  SdiNotify *self;
+  // resolved data, in the same order than the snaps
+  GPtrArray *infos;
+  guint n_pending;
+  SnapInfosReadyFunc callback;
+  gpointer user_data;
+  GDestroyNotify destroy;
+} SnapInfosRequest;
+
+typedef struct {
+  SnapInfosRequest *request;
+  SnapdSnap *snap;
+  guint index;
+} SnapInfoJob;
+
+static void snap_info_job_free(SnapInfoJob *job) {
+  g_clear_object(&job->snap);
+  g_free(job);
+}
+
+static void snap_infos_request_free(SnapInfosRequest *request) {
+  if (request->destroy != NULL) {
+    request->destroy(request->user_data);
+  }
+  g_ptr_array_unref(request->infos);
+  g_object_unref(request->self);
+  g_free(request);
+}
+
+static void resolve_snap_info_thread(GTask *task, gpointer source_object,
+                                     SnapInfoJob *job,
+                                     GCancellable *cancellable) {
+  g_task_return_pointer(task, resolve_snap_info(job->snap),
+                        (GDestroyNotify)snap_info_free);
+}
+
+static SnapInfo *snap_info_copy(SnapInfo *info) {
+  return snap_info_new(info->snap_name, info->name, info->icon,
+                       info->desktop);
+}
+
+/* Returns the data already resolved for a snap, or %NULL if it must be
+ * resolved. A %NULL snap means the snap store, which is only cached once it
+ * is installed.
+ */
+static SnapInfo *lookup_snap_info(SdiNotify *self, SnapdSnap *snap) {
+  if (snap == NULL) {
+    if ((self->snap_store_info == NULL) ||
+        (self->snap_store_info->desktop == NULL)) {
+      return NULL;
+    }
+    return self->snap_store_info;
+  }
+  return g_hash_table_lookup(self->snap_infos, snapd_snap_get_name(snap));
+}
+
+static void store_snap_info(SdiNotify *self, SnapdSnap *snap, SnapInfo *info) {
+  if (snap == NULL) {
+    g_clear_pointer(&self->snap_store_info, snap_info_free);
+    self->snap_store_info = snap_info_copy(info);
+    return;
+  }
+  g_hash_table_replace(self->snap_infos, g_strdup(snapd_snap_get_name(snap)),
+                       snap_info_copy(info));
+}
+
+static void snap_info_ready_cb(GObject *source_object, GAsyncResult *res,
+                               gpointer user_data) {
+  SnapInfoJob *job = g_task_get_task_data(G_TASK(res));
+  SnapInfosRequest *request = job->request;
+
+  SnapInfo *info = g_task_propagate_pointer(G_TASK(res), NULL);
+  store_snap_info(request->self, job->snap, info);
+  g_ptr_array_index(request->infos, job->index) = info;
+  if (--request->n_pending != 0) {
+    return;
+  }
+  request->callback(request->self, request->infos, request->user_data);
+  snap_infos_request_free(request);
+}
+
+/**
+ * Gets the names, icons and .desktop files of the snaps, and calls @callback
+ * in the main thread with a #SnapInfo for each one. A %NULL entry in @snaps
+ * means the snap store.
+ *
+ * Snaps already in the index are taken from there, and the rest are resolved
+ * in parallel in the GTask thread pool. If all of them are in the index,
+ * @callback is called before returning.
+ */
+static void prepare_snap_infos(SdiNotify *self, SnapdSnap **snaps,
+                               guint n_snaps, SnapInfosReadyFunc callback,
+                               gpointer user_data, GDestroyNotify destroy) {
+  SnapInfosRequest *request = g_malloc0(sizeof(SnapInfosRequest));
+  request->self = g_object_ref(self);
+  request->infos =
+      g_ptr_array_new_full(n_snaps, (GDestroyNotify)snap_info_free);
+  g_ptr_array_set_size(request->infos, n_snaps);
+  request->callback = callback;
+  request->user_data = user_data;
+  request->destroy = destroy;
+
+  g_autoptr(GPtrArray) jobs = g_ptr_array_new();
+  for (guint i = 0; i < n_snaps; i++) {
+    SnapInfo *info = lookup_snap_info(self, snaps[i]);
+    if (info != NULL) {
+      g_ptr_array_index(request->infos, i) = snap_info_copy(info);
+      continue;
+    }
+    SnapInfoJob *job = g_malloc0(sizeof(SnapInfoJob));
+    job->request = request;
+    job->snap = (snaps[i] == NULL) ? NULL : g_object_ref(snaps[i]);
+    job->index = i;
+    g_ptr_array_add(jobs, job);
+  }
+
+  if (jobs->len == 0) {
+    callback(self, request->infos, user_data);
+    snap_infos_request_free(request);
+    return;
+  }
+  request->n_pending = jobs->len;
+  for (guint i = 0; i < jobs->len; i++) {
+    g_autoptr(GTask) task = g_task_new(NULL, NULL, snap_info_ready_cb, NULL);
+    g_task_set_task_data(task, g_ptr_array_index(jobs, i),
+                         (GDestroyNotify)snap_info_job_free);
+    g_task_run_in_thread(task, (GTaskThreadFunc)resolve_snap_info_thread);
+  }
+}
+
+static GIcon *get_snap_store_icon(SdiNotify *self) {
+  return (self->snap_store_info == NULL) ? NULL : self->snap_store_info->icon;
+}
+
+typedef struct {
+  SdiNotify *self;
+  gchar *snap_name;
+  GListModel *snaps;
+  // NULL until the data of the snap has been resolved
+  SnapInfo *info;
+  // monotonic time at which snapd will force the refresh
+  gint64 deadline;
+  gboolean allow_to_ignore;
+  // text currently shown in the notification
+  gchar *title;
+#ifndef USE_GNOTIFY
+  NotifyNotification *notification;
+#endif
+} ForcedRefresh;
+
+static ForcedRefresh *forced_refresh_new(SdiNotify *self, SnapdSnap *snap) {
+  ForcedRefresh *data = g_malloc0(sizeof(ForcedRefresh));
+  data->self = self;
+  data->snap_name = g_strdup(snapd_snap_get_name(snap));
+  GListStore *snap_list = g_list_store_new(SNAPD_TYPE_SNAP);
+  g_list_store_append(snap_list, snap);
+  data->snaps = G_LIST_MODEL(snap_list);
+  return data;
+}
+
+static void forced_refresh_free(ForcedRefresh *data) {
+#ifndef USE_GNOTIFY
+  if (data->notification != NULL) {
+    g_signal_handlers_disconnect_by_data(data->notification, data);
+    g_object_unref(data->notification);
+  }
+#endif
+  g_free(data->snap_name);
+  g_object_unref(data->snaps);
+  g_clear_pointer(&data->info, snap_info_free);
+  g_free(data->title);
+  g_free(data);
+}
+
+// remaining time in seconds, rounded up
+static GTimeSpan forced_refresh_get_remaining_time(ForcedRefresh *data) {
+  gint64 remaining = data->deadline - g_get_monotonic_time();
+  return (remaining + G_USEC_PER_SEC - 1) / G_USEC_PER_SEC;
+}
+
+static gchar *get_forced_refresh_title(const gchar *name,
+                                       GTimeSpan remaining_time) {
+  if (remaining_time > SECONDS_IN_A_DAY) {
+    /// TRANSLATORS: The %s is the name of a snap that is currently running,
+    /// and it will be closed and updated in %ld days if the user doesn't
+    /// close it before. This is shown after the user has been notified several
+    /// times that there is a refresh available for a running snap, but they
+    /// hasn't closed it, to inform they that there is a time limit before the
+    /// snap is forced to quit to refresh it.
+    return g_strdup_printf(_("%s will quit and update in %ld days"), name,
+                           remaining_time / SECONDS_IN_A_DAY);
+  } else if (remaining_time > SECONDS_IN_AN_HOUR) {
+    /// TRANSLATORS: The %s is the name of a snap that is currently running,
+    /// and it will be closed and updated in %ld hours if the user doesn't
+    /// close it before.
+    return g_strdup_printf(_("%s will quit and update in %ld hours"), name,
+                           remaining_time / SECONDS_IN_AN_HOUR);
+  } else {
+    /// TRANSLATORS: The %s is the name of a snap that is currently running,
+    /// and it will be closed and updated in %ld minutes if the user doesn't
+    /// close it before.
+    return g_strdup_printf(_("%s will quit and update in %ld minutes"), name,
+                           remaining_time / SECONDS_IN_A_MINUTE);
+  }
+}
+
+static const gchar *get_forced_refresh_body() {
+  /// TRANSLATORS: This message is shown below the "%s will quit and update
+  /// in..." message.
+  return _("Save your progress and quit now to prevent data loss.");
+}
+
+/**
+ * Checks whether the budget allows to show a new notification, and if it
+ * does, takes it into account.
+ */
+static gboolean consume_budget(SdiNotify *self) {
+  gint64 now = g_get_monotonic_time();
+  while (!g_queue_is_empty(self->shown_times)) {
+    gint64 shown_time = *((gint64 *)g_queue_peek_head(self->shown_times));
+    if (now - shown_time < 60 * G_USEC_PER_SEC) {
+      break;
+    }
+    g_free(g_queue_pop_head(self->shown_times));
+  }
+  if (g_queue_get_length(self->shown_times) >= MAX_NOTIFICATIONS_PER_MINUTE) {
+    return FALSE;
+  }
+  g_queue_push_tail(self->shown_times, g_memdup2(&now, sizeof(now)));
+  return TRUE;
+}
+
+// time in ms until the budget allows to show a new notification
+static guint get_budget_delay(SdiNotify *self) {
+  if (g_queue_is_empty(self->shown_times)) {
+    return 0;
+  }
+  gint64 shown_time = *((gint64 *)g_queue_peek_head(self->shown_times));
+  gint64 delay = shown_time + 60 * G_USEC_PER_SEC - g_get_monotonic_time();
+  return (delay <= 0) ? 0 : (delay / 1000) + 1;
+}
+
 static bool launch_desktop(GApplication *app, const gchar *desktop_file) {
   g_autofree gchar *full_desktop_path = NULL;
   g_autofree gchar *desktop_file2 = NULL;
@@ -54,12 +399,14 @@ static bool launch_desktop(GApplication *app, const gchar *desktop_file) {
   }
   g_autoptr(PrivilegedDesktopLauncher) launcher = NULL;
 
+  sdi_main_loop_watchdog_begin_call("launch_desktop");
   launcher = privileged_desktop_launcher__proxy_new_sync(
       g_application_get_dbus_connection(app), G_DBUS_PROXY_FLAGS_NONE,
       "io.snapcraft.Launcher", "/io/snapcraft/PrivilegedDesktopLauncher", NULL,
       NULL);
   privileged_desktop_launcher__call_open_desktop_entry_sync(
       launcher, desktop_file2, NULL, NULL);
+  sdi_main_loop_watchdog_end_call();
   return true;
 }
 
@@ -78,6 +425,18 @@ static void sdi_notify_action_show_updates(GActionGroup *action_group,
   show_updates(self);
 }
 
+static void sdi_notify_action_launch_refreshed_app(GActionGroup *action_group,
+                                                  GVariant *desktop,
+                                                  SdiNotify *self) {
+  const gchar *desktop_file = g_variant_get_string(desktop, NULL);
+#ifdef DEBUG_TESTS
+  g_autofree gchar *param =
+      g_strdup_printf("app-launch-updated %s", desktop_file);
+  g_signal_emit_by_name(self, "notification-closed", param);
+#endif
+  launch_desktop(self->application, desktop_file);
+}
+
 static void sdi_notify_action_ignore(GActionGroup *action_group,
                                      GVariant *app_list, SdiNotify *self) {
   gsize len;
@@ -135,21 +494,36 @@ static gchar *get_icon_name_from_gicon(GIcon *icon) {
   return NULL;
 }
 
+/* The actions of the libnotify notifications only keep a weak reference to
+ * the SdiNotify: the notifications are kept in its registry until they are
+ * closed, so a strong one would never let it be disposed.
+ */
+static GWeakRef *notify_weak_ref_new(SdiNotify *self) {
+  GWeakRef *ref = g_malloc0(sizeof(GWeakRef));
+  g_weak_ref_init(ref, self);
+  return ref;
+}
+
+static void notify_weak_ref_free(GWeakRef *ref) {
+  g_weak_ref_clear(ref);
+  g_free(ref);
+}
+
 typedef struct {
-  SdiNotify *self;
+  GWeakRef self;
   GVariant *snaps;
 } IgnoreNotifyData;
 
 static IgnoreNotifyData *ignore_notify_data_new(SdiNotify *self,
                                                 GVariant *snaps) {
   IgnoreNotifyData *data = g_malloc0(sizeof(IgnoreNotifyData));
-  data->self = g_object_ref(self);
+  g_weak_ref_init(&data->self, self);
   data->snaps = g_variant_ref(snaps);
   return data;
 }
 
 static void ignore_notify_data_free(IgnoreNotifyData *data) {
-  g_object_unref(data->self);
+  g_weak_ref_clear(&data->self);
   g_variant_unref(data->snaps);
   g_free(data);
 }
@@ -157,77 +531,93 @@ static void ignore_notify_data_free(IgnoreNotifyData *data) {
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(IgnoreNotifyData, ignore_notify_data_free)
 
 typedef struct {
-  SdiNotify *self;
+  GWeakRef self;
   gchar *desktop;
 } LaunchUpdatedApp;
 
 static LaunchUpdatedApp *launch_updated_app_new(SdiNotify *self,
                                                 const gchar *desktop) {
   LaunchUpdatedApp *data = g_malloc0(sizeof(LaunchUpdatedApp));
-  data->self = g_object_ref(self);
+  g_weak_ref_init(&data->self, self);
   data->desktop = g_strdup(desktop);
   return data;
 }
 
 static void launch_updated_app_free(void *user_data) {
   LaunchUpdatedApp *data = (LaunchUpdatedApp *)user_data;
-  g_object_unref(data->self);
+  g_weak_ref_clear(&data->self);
   g_free(data->desktop);
   g_free(data);
 }
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(LaunchUpdatedApp, launch_updated_app_free)
 
+static void notification_closed_cb(NotifyNotification *notification,
+                                   SdiNotify *self) {
+  g_hash_table_remove(self->notifications, notification);
+}
+
+/* Takes ownership of the notification, and keeps it alive until it is closed.
+ * Returns the same notification, for convenience.
+ */
+static NotifyNotification *
+register_notification(SdiNotify *self, NotifyNotification *notification) {
+  g_hash_table_add(self->notifications, notification);
+  g_signal_connect_object(notification, "closed",
+                          (GCallback)notification_closed_cb, self, 0);
+  return notification;
+}
+
 static void app_close_notification(NotifyNotification *notification,
-                                   char *action, SdiNotify *self) {
+                                   char *action, GWeakRef *ref) {
 #ifdef DEBUG_TESTS
-  g_signal_emit_by_name(self, "notification-closed", "close-notification");
+  g_autoptr(SdiNotify) self = g_weak_ref_get(ref);
+  if (self != NULL) {
+    g_signal_emit_by_name(self, "notification-closed", "close-notification");
+  }
 #endif
-  g_object_unref(notification);
 }
 
 static void app_launch_updated(NotifyNotification *notification, char *action,
                                LaunchUpdatedApp *data) {
+  g_autoptr(SdiNotify) self = g_weak_ref_get(&data->self);
+  if (self == NULL) {
+    return;
+  }
 #ifdef DEBUG_TESTS
   g_autofree gchar *param =
       g_strdup_printf("app-launch-updated %s", data->desktop);
-  g_signal_emit_by_name(data->self, "notification-closed", param);
+  g_signal_emit_by_name(self, "notification-closed", param);
 #endif
-  launch_desktop(data->self->application, (const gchar *)data->desktop);
-  g_object_unref(notification);
+  launch_desktop(self->application, (const gchar *)data->desktop);
 }
 
 static void app_show_updates(NotifyNotification *notification, char *action,
-                             SdiNotify *self) {
-  show_updates(self);
-  g_object_unref(notification);
+                             GWeakRef *ref) {
+  g_autoptr(SdiNotify) self = g_weak_ref_get(ref);
+  if (self != NULL) {
+    show_updates(self);
+  }
 }
 
 static void app_ignore_snaps_notification(NotifyNotification *notification,
                                           char *action,
                                           IgnoreNotifyData *data) {
-  sdi_notify_action_ignore(NULL, data->snaps, data->self);
-  g_object_unref(notification);
+  g_autoptr(SdiNotify) self = g_weak_ref_get(&data->self);
+  if (self != NULL) {
+    sdi_notify_action_ignore(NULL, data->snaps, self);
+  }
 }
 
-static void show_pending_update_notification(SdiNotify *self,
-                                             const gchar *title,
-                                             const gchar *body, GIcon *icon,
-                                             GListModel *snaps,
-                                             gboolean allow_to_ignore) {
-  g_autofree gchar *icon_name = get_icon_name_from_gicon(icon);
-  // Don't use g_autoptr because it must survive for the actions
-  NotifyNotification *notification =
-      notify_notification_new(title, body, icon_name);
-  if (icon_name != NULL) {
-    // don't use g_autoptr with the GVariant because it is consumed in set_hint
-    notify_notification_set_hint(notification, "image-path",
-                                 g_variant_new_string(icon_name));
-  }
+static void add_pending_update_actions(SdiNotify *self,
+                                       NotifyNotification *notification,
+                                       GListModel *snaps,
+                                       gboolean allow_to_ignore) {
   notify_notification_add_action(notification, "app.show-updates",
                                  _("Show updates"),
                                  (NotifyActionCallback)app_show_updates,
-                                 g_object_ref(self), g_object_unref);
+                                 notify_weak_ref_new(self),
+                                 (GFreeFunc)notify_weak_ref_free);
   /* This is the default action, the one executed when the user clicks on the
    * notification itself. It has no button, so the _("Show updates") text is
    * really unnecesary. It's added just in case in a future notifications do
@@ -235,7 +625,8 @@ static void show_pending_update_notification(SdiNotify *self,
    */
   notify_notification_add_action(notification, "default", _("Show updates"),
                                  (NotifyActionCallback)app_show_updates,
-                                 g_object_ref(self), g_object_unref);
+                                 notify_weak_ref_new(self),
+                                 (GFreeFunc)notify_weak_ref_free);
   if (allow_to_ignore) {
     g_autoptr(GVariant) snap_list = get_snap_list(snaps);
     /// TRANSLATORS: Text for a button in a notification. Pressing it
@@ -247,7 +638,57 @@ static void show_pending_update_notification(SdiNotify *self,
         ignore_notify_data_new(self, snap_list),
         (GFreeFunc)ignore_notify_data_free);
   }
+}
+
+/* The notification returned is owned by the registry, so a reference must be
+ * taken to keep it after it has been closed.
+ */
+static NotifyNotification *
+show_pending_update_notification(SdiNotify *self, const gchar *title,
+                                 const gchar *body, GIcon *icon,
+                                 GListModel *snaps, gboolean allow_to_ignore) {
+  g_autofree gchar *icon_name = get_icon_name_from_gicon(icon);
+  NotifyNotification *notification = register_notification(
+      self, notify_notification_new(title, body, icon_name));
+  if (icon_name != NULL) {
+    // don't use g_autoptr with the GVariant because it is consumed in set_hint
+    notify_notification_set_hint(notification, "image-path",
+                                 g_variant_new_string(icon_name));
+  }
+  add_pending_update_actions(self, notification, snaps, allow_to_ignore);
   notify_notification_show(notification, NULL);
+  return notification;
+}
+
+static void forced_refresh_closed_cb(ForcedRefresh *data) {
+  g_hash_table_remove(data->self->forced_refreshes, data->snap_name);
+}
+
+static void show_forced_refresh_notification(SdiNotify *self,
+                                             ForcedRefresh *data) {
+  if (data->notification == NULL) {
+    data->notification = g_object_ref(show_pending_update_notification(
+        self, data->title, get_forced_refresh_body(), data->info->icon,
+        data->snaps, data->allow_to_ignore));
+    g_signal_connect_swapped(data->notification, "closed",
+                             (GCallback)forced_refresh_closed_cb, data);
+    return;
+  }
+  // replace the text of the notification already shown
+  g_autofree gchar *icon_name = get_icon_name_from_gicon(data->info->icon);
+  notify_notification_update(data->notification, data->title,
+                             get_forced_refresh_body(), icon_name);
+  notify_notification_clear_actions(data->notification);
+  add_pending_update_actions(self, data->notification, data->snaps,
+                             data->allow_to_ignore);
+  notify_notification_show(data->notification, NULL);
+}
+
+static void close_forced_refresh_notification(SdiNotify *self,
+                                              ForcedRefresh *data) {
+  if (data->notification != NULL) {
+    notify_notification_close(data->notification, NULL);
+  }
 }
 
 static void update_complete_notification(SdiNotify *self, const gchar *title,
@@ -255,9 +696,8 @@ static void update_complete_notification(SdiNotify *self, const gchar *title,
                                          const gchar *id,
                                          const gchar *desktop) {
   g_autofree gchar *icon_name = get_icon_name_from_gicon(icon);
-  // Don't use g_autoptr because it must survive for the actions
-  NotifyNotification *notification =
-      notify_notification_new(title, body, icon_name);
+  NotifyNotification *notification = register_notification(
+      self, notify_notification_new(title, body, icon_name));
 
   if (icon_name != NULL) {
     notify_notification_set_hint(notification, "image-path",
@@ -270,7 +710,8 @@ static void update_complete_notification(SdiNotify *self, const gchar *title,
     /// notification.
     notify_notification_add_action(notification, "default", _("Close"),
                                    (NotifyActionCallback)app_close_notification,
-                                   g_object_ref(self), g_object_unref);
+                                   notify_weak_ref_new(self),
+                                   (GFreeFunc)notify_weak_ref_free);
   } else {
     LaunchUpdatedApp *data = launch_updated_app_new(self, desktop);
     notify_notification_add_action(notification, "default", _("Close"),
@@ -280,17 +721,95 @@ static void update_complete_notification(SdiNotify *self, const gchar *title,
   notify_notification_show(notification, NULL);
 }
 
+static void app_close_summary(NotifyNotification *notification, char *action,
+                              GWeakRef *ref) {
+#ifdef DEBUG_TESTS
+  g_autoptr(SdiNotify) self = g_weak_ref_get(ref);
+  if (self != NULL) {
+    g_signal_emit_by_name(self, "notification-closed", "close-notification");
+  }
+#endif
+}
+
+static void summary_closed_cb(SdiNotify *self) {
+  g_clear_object(&self->summary_notification);
+  self->n_apps_in_summary = 0;
+}
+
+static void show_update_summary(SdiNotify *self, GPtrArray *refreshes,
+                                GIcon *icon) {
+  self->n_apps_in_summary += refreshes->len;
+  /// TRANSLATORS: title of the notification shown when several apps were
+  /// updated at the same time.
+  g_autofree gchar *title = g_strdup_printf(
+      ngettext("%d app was updated", "%d apps were updated",
+               self->n_apps_in_summary),
+      self->n_apps_in_summary);
+  const gchar *body = _("You can reopen them now.");
+  g_autofree gchar *icon_name = get_icon_name_from_gicon(icon);
+
+  if (self->summary_notification != NULL) {
+    notify_notification_update(self->summary_notification, title, body,
+                               icon_name);
+  } else {
+    self->summary_notification = g_object_ref(register_notification(
+        self, notify_notification_new(title, body, icon_name)));
+    g_signal_connect_object(self->summary_notification, "closed",
+                            (GCallback)summary_closed_cb, self,
+                            G_CONNECT_SWAPPED);
+    notify_notification_add_action(
+        self->summary_notification, "default", _("Close"),
+        (NotifyActionCallback)app_close_summary, notify_weak_ref_new(self),
+        (GFreeFunc)notify_weak_ref_free);
+  }
+  if (icon_name != NULL) {
+    notify_notification_set_hint(self->summary_notification, "image-path",
+                                 g_variant_new_string(icon_name));
+  }
+  notify_notification_show(self->summary_notification, NULL);
+}
+
+static gboolean is_summary_shown(SdiNotify *self) {
+  return self->summary_notification != NULL;
+}
+
+static void pending_notification_closed_cb(SdiNotify *self) {
+  g_clear_object(&self->pending_notification);
+}
+
+static void show_pending_refresh_notification(SdiNotify *self,
+                                              const gchar *title,
+                                              const gchar *body, GIcon *icon,
+                                              GListModel *snaps) {
+  if (self->pending_notification != NULL) {
+    g_signal_handlers_disconnect_by_func(
+        self->pending_notification, pending_notification_closed_cb, self);
+    g_clear_object(&self->pending_notification);
+  }
+  self->pending_notification = g_object_ref(
+      show_pending_update_notification(self, title, body, icon, snaps, TRUE));
+  g_signal_connect_object(self->pending_notification, "closed",
+                          (GCallback)pending_notification_closed_cb, self,
+                          G_CONNECT_SWAPPED);
+}
+
+static void close_pending_refresh_notification(SdiNotify *self) {
+  if (self->pending_notification != NULL) {
+    notify_notification_close(self->pending_notification, NULL);
+  }
+}
+
 #else
 
-static void show_pending_update_notification(SdiNotify *self,
-                                             const gchar *title,
-                                             const gchar *body, GIcon *icon,
-                                             GListModel *snaps,
-                                             gboolean allow_to_ignore) {
-  g_autoptr(GNotification) notification = g_notification_new(title);
+static GNotification *new_pending_update_notification(const gchar *title,
+                                                     const gchar *body,
+                                                     GIcon *icon,
+                                                     GListModel *snaps,
+                                                     gboolean allow_to_ignore) {
+  GNotification *notification = g_notification_new(title);
   g_notification_set_body(notification, body);
   if (icon != NULL) {
-    g_notification_set_icon(notification, g_object_ref(icon));
+    g_notification_set_icon(notification, icon);
   }
   g_notification_set_default_action_and_target(notification, "app.show-updates",
                                                "s", "pending-update");
@@ -304,14 +823,44 @@ static void show_pending_update_notification(SdiNotify *self,
       g_autoptr(SnapdSnap) snap = g_list_model_get_item(snaps, i);
       g_variant_builder_add(builder, "s", snapd_snap_get_name(snap));
     }
-    GVariant *values = g_variant_ref_sink(g_variant_builder_end(builder));
     g_notification_add_button_with_target_value(
-        notification, _("Don't remind me again"), "app.ignore-updates", values);
+        notification, _("Don't remind me again"), "app.ignore-updates",
+        g_variant_builder_end(builder));
   }
+  return notification;
+}
+
+static void show_pending_update_notification(SdiNotify *self,
+                                             const gchar *title,
+                                             const gchar *body, GIcon *icon,
+                                             GListModel *snaps,
+                                             gboolean allow_to_ignore) {
+  g_autoptr(GNotification) notification = new_pending_update_notification(
+      title, body, icon, snaps, allow_to_ignore);
   g_application_send_notification(self->application, "pending-update",
                                   notification);
 }
 
+static gchar *get_forced_refresh_id(ForcedRefresh *data) {
+  return g_strdup_printf("forced-refresh-%s", data->snap_name);
+}
+
+static void show_forced_refresh_notification(SdiNotify *self,
+                                             ForcedRefresh *data) {
+  g_autoptr(GNotification) notification = new_pending_update_notification(
+      data->title, get_forced_refresh_body(), data->info->icon, data->snaps,
+      data->allow_to_ignore);
+  g_autofree gchar *id = get_forced_refresh_id(data);
+  // using the same ID replaces the previous notification, if it's still shown
+  g_application_send_notification(self->application, id, notification);
+}
+
+static void close_forced_refresh_notification(SdiNotify *self,
+                                              ForcedRefresh *data) {
+  g_autofree gchar *id = get_forced_refresh_id(data);
+  g_application_withdraw_notification(self->application, id);
+}
+
 static void update_complete_notification(SdiNotify *self, const gchar *title,
                                          const gchar *body, GIcon *icon,
                                          const gchar *id,
@@ -319,7 +868,7 @@ static void update_complete_notification(SdiNotify *self, const gchar *title,
   g_autoptr(GNotification) notification = g_notification_new(title);
   g_notification_set_body(notification, body);
   if (icon != NULL) {
-    g_notification_set_icon(notification, g_object_ref(icon));
+    g_notification_set_icon(notification, icon);
   }
   if (desktop != NULL) {
     g_notification_set_default_action_and_target(
@@ -327,116 +876,233 @@ static void update_complete_notification(SdiNotify *self, const gchar *title,
   }
   g_application_send_notification(self->application, id, notification);
 }
-#endif
 
-void sdi_notify_pending_refresh_forced(SdiNotify *self, SnapdSnap *snap,
-                                       GTimeSpan remaining_time,
-                                       gboolean allow_to_ignore) {
-  g_return_if_fail(SDI_IS_NOTIFY(self));
-  g_return_if_fail(snap != NULL);
+static void show_update_summary(SdiNotify *self, GPtrArray *refreshes,
+                                GIcon *icon) {
+  g_autofree gchar *title = g_strdup_printf(
+      ngettext("%d app was updated", "%d apps were updated", refreshes->len),
+      refreshes->len);
+  g_autoptr(GNotification) notification = g_notification_new(title);
+  g_notification_set_body(notification, _("You can reopen them now."));
+  if (icon != NULL) {
+    g_notification_set_icon(notification, icon);
+  }
+  // using the same ID replaces the previous notification, if it's still shown
+  g_application_send_notification(self->application, "update-complete",
+                                  notification);
+}
 
-  g_autoptr(GAppInfo) app_info = sdi_get_desktop_file_from_snap(snap);
+static gboolean is_summary_shown(SdiNotify *self) { return FALSE; }
 
-  const gchar *name = snapd_snap_get_name(snap);
-  if (app_info != NULL) {
-    name = g_app_info_get_display_name(app_info);
+/* Each pending refresh notification contains all the pending refreshes, so
+ * it replaces the previous one.
+ */
+static void show_pending_refresh_notification(SdiNotify *self,
+                                              const gchar *title,
+                                              const gchar *body, GIcon *icon,
+                                              GListModel *snaps) {
+  show_pending_update_notification(self, title, body, icon, snaps, TRUE);
+}
+
+static void close_pending_refresh_notification(SdiNotify *self) {
+  g_application_withdraw_notification(self->application, "pending-update");
+}
+#endif
+
+static void show_pending_refresh(SdiNotify *self, GListModel *snaps);
+
+static void show_completed_refreshes(SdiNotify *self) {
+  g_autoptr(GPtrArray) refreshes = g_steal_pointer(&self->completed_refreshes);
+  self->completed_refreshes =
+      g_ptr_array_new_with_free_func((GDestroyNotify)snap_info_free);
+
+  if ((refreshes->len == 1) && !is_summary_shown(self)) {
+    SnapInfo *refresh = g_ptr_array_index(refreshes, 0);
+    g_autofree gchar *title =
+        g_strdup_printf(_("%s was updated"), refresh->name);
+    g_autofree gchar *id =
+        g_strdup_printf("update-complete-%s", refresh->snap_name);
+    update_complete_notification(self, title, _("You can reopen it now."),
+                                 refresh->icon, id, refresh->desktop);
+    return;
   }
+  show_update_summary(self, refreshes, get_snap_store_icon(self));
+}
 
-  g_autofree gchar *title = NULL;
+static gboolean flush_notifications(SdiNotify *self) {
+  self->flush_id = 0;
 
-  if (remaining_time > SECONDS_IN_A_DAY) {
-    /// TRANSLATORS: The %s is the name of a snap that is currently running,
-    /// and it will be closed and updated in %ld days if the user doesn't
-    /// close it before. This is shown after the user has been notified several
-    /// times that there is a refresh available for a running snap, but they
-    /// hasn't closed it, to inform they that there is a time limit before the
-    /// snap is forced to quit to refresh it.
-    title = g_strdup_printf(_("%s will quit and update in %ld days"), name,
-                            remaining_time / SECONDS_IN_A_DAY);
-  } else if (remaining_time > SECONDS_IN_AN_HOUR) {
-    /// TRANSLATORS: The %s is the name of a snap that is currently running,
-    /// and it will be closed and updated in %ld hours if the user doesn't
-    /// close it before.
-    title = g_strdup_printf(_("%s will quit and update in %ld hours"), name,
-                            remaining_time / SECONDS_IN_AN_HOUR);
-  } else {
-    /// TRANSLATORS: The %s is the name of a snap that is currently running,
-    /// and it will be closed and updated in %ld minutes if the user doesn't
-    /// close it before.
-    title = g_strdup_printf(_("%s will quit and update in %ld minutes"), name,
-                            remaining_time / SECONDS_IN_A_MINUTE);
+  if ((self->deferred_pending_refresh != NULL) && consume_budget(self)) {
+    g_autoptr(GListModel) snaps =
+        g_steal_pointer(&self->deferred_pending_refresh);
+    show_pending_refresh(self, snaps);
+  }
+  if ((self->completed_refreshes->len != 0) && consume_budget(self)) {
+    show_completed_refreshes(self);
   }
 
-  GIcon *icon = NULL;
-  if (app_info != NULL) {
-    icon = g_app_info_get_icon(app_info);
+  // if there is no budget left, retry when there is
+  if ((self->deferred_pending_refresh != NULL) ||
+      (self->completed_refreshes->len != 0)) {
+    self->flush_id = g_timeout_add(get_budget_delay(self),
+                                   G_SOURCE_FUNC(flush_notifications), self);
   }
+  return G_SOURCE_REMOVE;
+}
 
-  g_autoptr(GListStore) snap_list = g_list_store_new(SNAPD_TYPE_SNAP);
-  g_list_store_append(snap_list, snap);
-  /// TRANSLATORS: This message is shown below the "%s will quit and update
-  /// in..." message.
-  show_pending_update_notification(
-      self, title, _("Save your progress and quit now to prevent data loss."),
-      icon, G_LIST_MODEL(snap_list), allow_to_ignore);
+static void schedule_flush(SdiNotify *self, guint delay) {
+  if (self->flush_id == 0) {
+    self->flush_id =
+        g_timeout_add(delay, G_SOURCE_FUNC(flush_notifications), self);
+  }
 }
 
-static gchar *get_name_from_snap(SnapdSnap *snap) {
-  const gchar *name = snapd_snap_get_name(snap);
-  g_autoptr(GAppInfo) app_info = sdi_get_desktop_file_from_snap(snap);
-  if (app_info != NULL) {
-    const gchar *name2 = g_app_info_get_display_name(app_info);
-    if (name2 != NULL) {
-      name = name2;
+/* Updates the text of the countdown with the remaining time, and sends it
+ * again if it has changed or if @force is TRUE.
+ */
+static void update_countdown(SdiNotify *self, ForcedRefresh *data,
+                             gboolean force) {
+  g_autofree gchar *title = get_forced_refresh_title(
+      data->info->name, forced_refresh_get_remaining_time(data));
+  if (!force && (g_strcmp0(title, data->title) == 0)) {
+    return;
+  }
+  g_free(data->title);
+  data->title = g_steal_pointer(&title);
+  show_forced_refresh_notification(self, data);
+}
+
+static gboolean countdown_cb(SdiNotify *self) {
+  GHashTableIter iter;
+  ForcedRefresh *data;
+  g_hash_table_iter_init(&iter, self->forced_refreshes);
+  while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&data)) {
+    if (forced_refresh_get_remaining_time(data) <= 0) {
+      // snapd is refreshing the snap now, so the countdown is meaningless
+      close_forced_refresh_notification(self, data);
+      g_hash_table_iter_remove(&iter);
+      continue;
+    }
+    if (data->info != NULL) {
+      update_countdown(self, data, FALSE);
     }
   }
-  return g_strdup(name);
+  if (g_hash_table_size(self->forced_refreshes) == 0) {
+    self->countdown_id = 0;
+    return G_SOURCE_REMOVE;
+  }
+  return G_SOURCE_CONTINUE;
 }
 
-static gchar *build_body_message_for_two_refreshes(SnapdSnap *snap0,
-                                                   SnapdSnap *snap1) {
-  g_autofree gchar *snap_name0 = get_name_from_snap(snap0);
-  g_autofree gchar *snap_name1 = get_name_from_snap(snap1);
+static void remove_forced_refresh(SdiNotify *self, const gchar *snap_name) {
+  ForcedRefresh *data = g_hash_table_lookup(self->forced_refreshes, snap_name);
+  if (data == NULL) {
+    return;
+  }
+  close_forced_refresh_notification(self, data);
+  g_hash_table_remove(self->forced_refreshes, snap_name);
+}
+
+static void forced_refresh_ready_cb(SdiNotify *self, GPtrArray *infos,
+                                    const gchar *snap_name) {
+  ForcedRefresh *data = g_hash_table_lookup(self->forced_refreshes, snap_name);
+  /* The countdown could have been removed, or even replaced by a new one,
+   * while its data was being resolved. */
+  if ((data == NULL) || (data->info != NULL)) {
+    return;
+  }
+  data->info = g_steal_pointer(&g_ptr_array_index(infos, 0));
+  update_countdown(self, data, TRUE);
+}
+
+void sdi_notify_pending_refresh_forced(SdiNotify *self, SnapdSnap *snap,
+                                       GTimeSpan remaining_time,
+                                       gboolean allow_to_ignore) {
+  g_return_if_fail(SDI_IS_NOTIFY(self));
+  g_return_if_fail(snap != NULL);
+
+  const gchar *snap_name = snapd_snap_get_name(snap);
+  ForcedRefresh *data = g_hash_table_lookup(self->forced_refreshes, snap_name);
+  gboolean is_new = (data == NULL);
+  if (is_new) {
+    data = forced_refresh_new(self, snap);
+    g_hash_table_insert(self->forced_refreshes, g_strdup(snap_name), data);
+    /* The countdown warnings must always be shown, but they count for the
+     * budget of the other notifications. */
+    consume_budget(self);
+  }
+  data->deadline = g_get_monotonic_time() + remaining_time * G_USEC_PER_SEC;
+  gboolean actions_changed = (allow_to_ignore != data->allow_to_ignore);
+  data->allow_to_ignore = allow_to_ignore;
+
+  if (self->countdown_id == 0) {
+    self->countdown_id = g_timeout_add_seconds(
+        COUNTDOWN_PERIOD, G_SOURCE_FUNC(countdown_cb), self);
+  }
+
+  if (is_new) {
+    // it will be shown once the data of the snap has been resolved
+    prepare_snap_infos(self, &snap, 1,
+                       (SnapInfosReadyFunc)forced_refresh_ready_cb,
+                       g_strdup(snap_name), g_free);
+  } else if (data->info != NULL) {
+    /* If the notification is already shown with the same content, there is
+     * no need to send it again; the timer will update it when the text
+     * changes. */
+    update_countdown(self, data, actions_changed);
+  }
+}
+
+static gchar *build_body_message_for_two_refreshes(const gchar *snap_name0,
+                                                   const gchar *snap_name1) {
   /// TRANSLATORS: This message is used when there are two pending
   /// refreshes.
   return g_strdup_printf(_("%s and %s will update when you quit them."),
                          snap_name0, snap_name1);
 }
 
-static gchar *build_body_message_for_three_refreshes(SnapdSnap *snap0,
-                                                     SnapdSnap *snap1,
-                                                     SnapdSnap *snap2) {
-  g_autofree gchar *snap_name0 = get_name_from_snap(snap0);
-  g_autofree gchar *snap_name1 = get_name_from_snap(snap1);
-  g_autofree gchar *snap_name2 = get_name_from_snap(snap2);
+static gchar *build_body_message_for_three_refreshes(const gchar *snap_name0,
+                                                     const gchar *snap_name1,
+                                                     const gchar *snap_name2) {
   /// TRANSLATORS: This message is used when there are three pending
   /// refreshes.
   return g_strdup_printf(_("%s, %s and %s will update when you quit them."),
                          snap_name0, snap_name1, snap_name2);
 }
 
-void sdi_notify_pending_refresh(SdiNotify *self, GListModel *snaps) {
-  g_return_if_fail(SDI_IS_NOTIFY(self));
-  g_return_if_fail(snaps != NULL);
+static gchar *build_body_message_for_many_refreshes(const gchar *snap_name0,
+                                                    const gchar *snap_name1,
+                                                    const gchar *snap_name2,
+                                                    guint n_others) {
+  /// TRANSLATORS: This message is used when there are four or more pending
+  /// refreshes. The %s are the names of the first three snaps, and %d is the
+  /// number of the remaining ones.
+  return g_strdup_printf(
+      ngettext("%s, %s, %s and %d more will update when you quit them.",
+               "%s, %s, %s and %d more will update when you quit them.",
+               n_others),
+      snap_name0, snap_name1, snap_name2, n_others);
+}
 
+static const gchar *get_info_name(GPtrArray *infos, guint index) {
+  SnapInfo *info = g_ptr_array_index(infos, index);
+  return info->name;
+}
+
+static void pending_refresh_ready_cb(SdiNotify *self, GPtrArray *infos,
+                                     GListModel *snaps) {
   g_autofree gchar *title = NULL;
   g_autofree gchar *body = NULL;
-  g_autoptr(GAppInfo) app_info = NULL;
-  g_autoptr(GDesktopAppInfo) app_info2 = NULL;
 
   guint n_snaps = g_list_model_get_n_items(snaps);
 
   GIcon *icon = NULL;
   if (n_snaps == 1) {
-    g_autoptr(SnapdSnap) snap0 = g_list_model_get_item(snaps, 0);
-    g_autofree gchar *snap_name = get_name_from_snap(snap0);
+    SnapInfo *info = g_ptr_array_index(infos, 0);
     /// TRANSLATORS: The %s is the name of a snap that has an update available.
-    title = g_strdup_printf(_("Update available for %s"), snap_name);
+    title = g_strdup_printf(_("Update available for %s"), info->name);
     body = g_strdup(_("Quit the app to update it now."));
-    app_info = sdi_get_desktop_file_from_snap(snap0);
-    if (app_info != NULL) {
-      icon = g_app_info_get_icon(app_info);
-    }
+    icon = info->icon;
   } else {
     /* Although the case for 1 app is managed outside this, I put it here to
      * ensure that ngettext works as expected, and to ensure that translators
@@ -447,33 +1113,78 @@ void sdi_notify_pending_refresh(SdiNotify *self, GListModel *snaps) {
     title = g_strdup_printf(ngettext("Update available for %d app",
                                      "Updates available for %d apps", n_snaps),
                             n_snaps);
-    g_autoptr(SnapdSnap) snap0 = g_list_model_get_item(snaps, 0);
-    g_autoptr(SnapdSnap) snap1 = g_list_model_get_item(snaps, 1);
-    /* snap2 will be NULL if the number of items is less than three,
-     * so it's not a problem to do this.
-     */
-    g_autoptr(SnapdSnap) snap2 = g_list_model_get_item(snaps, 2);
     switch (n_snaps) {
     case 2:
-      body = build_body_message_for_two_refreshes(snap0, snap1);
+      body = build_body_message_for_two_refreshes(get_info_name(infos, 0),
+                                                  get_info_name(infos, 1));
       break;
     case 3:
-      body = build_body_message_for_three_refreshes(snap0, snap1, snap2);
+      body = build_body_message_for_three_refreshes(get_info_name(infos, 0),
+                                                    get_info_name(infos, 1),
+                                                    get_info_name(infos, 2));
       break;
     default:
-      /// TRANSLATORS: This message is used when there are four or more pending
-      /// refreshes.
-      body = g_strdup(_("Quit the apps to update them now."));
+      body = build_body_message_for_many_refreshes(
+          get_info_name(infos, 0), get_info_name(infos, 1),
+          get_info_name(infos, 2), n_snaps - 3);
       break;
     }
   }
   if (icon == NULL) {
-    app_info2 = g_desktop_app_info_new(SNAP_STORE);
-    if (app_info2 != NULL) {
-      icon = g_app_info_get_icon(G_APP_INFO(app_info2));
-    }
+    icon = get_snap_store_icon(self);
   }
-  show_pending_update_notification(self, title, body, icon, snaps, TRUE);
+
+  g_hash_table_remove_all(self->pending_snaps);
+  for (guint i = 0; i < n_snaps; i++) {
+    g_autoptr(SnapdSnap) snap = g_list_model_get_item(snaps, i);
+    g_hash_table_add(self->pending_snaps, g_strdup(snapd_snap_get_name(snap)));
+  }
+  show_pending_refresh_notification(self, title, body, icon, snaps);
+}
+
+static void show_pending_refresh(SdiNotify *self, GListModel *snaps) {
+  /* Only the snaps whose names are shown in the notification are needed, so
+   * the cost doesn't grow with the number of snaps. The snap store is always
+   * needed too, for the default icon.
+   */
+  SnapdSnap *snap_list[4] = {NULL};
+  guint n_named = MIN(g_list_model_get_n_items(snaps), 3);
+  for (guint i = 0; i < n_named; i++) {
+    snap_list[i] = g_list_model_get_item(snaps, i);
+  }
+  prepare_snap_infos(self, snap_list, n_named + 1,
+                     (SnapInfosReadyFunc)pending_refresh_ready_cb,
+                     g_object_ref(snaps), g_object_unref);
+  for (guint i = 0; i < n_named; i++) {
+    g_object_unref(snap_list[i]);
+  }
+}
+
+void sdi_notify_pending_refresh(SdiNotify *self, GListModel *snaps) {
+  g_return_if_fail(SDI_IS_NOTIFY(self));
+  g_return_if_fail(snaps != NULL);
+
+  /* Each call contains all the pending refreshes, so if it can't be shown
+   * now, only the last one has to be kept. */
+  if (!consume_budget(self)) {
+    g_clear_object(&self->deferred_pending_refresh);
+    self->deferred_pending_refresh = g_object_ref(snaps);
+    schedule_flush(self, get_budget_delay(self));
+    return;
+  }
+  show_pending_refresh(self, snaps);
+}
+
+static void refresh_complete_ready_cb(SdiNotify *self, GPtrArray *infos,
+                                      const gchar *snap_name) {
+  SnapInfo *info = NULL;
+  if (infos->len == 2) {
+    info = g_steal_pointer(&g_ptr_array_index(infos, 0));
+  } else {
+    info = snap_info_new(snap_name, snap_name, NULL, NULL);
+  }
+  g_ptr_array_add(self->completed_refreshes, info);
+  schedule_flush(self, AGGREGATION_WINDOW);
 }
 
 void sdi_notify_refresh_complete(SdiNotify *self, SnapdSnap *snap,
@@ -481,30 +1192,41 @@ void sdi_notify_refresh_complete(SdiNotify *self, SnapdSnap *snap,
   g_return_if_fail(SDI_IS_NOTIFY(self));
   g_return_if_fail((snap != NULL) || (snap_name != NULL));
 
-  GIcon *icon = NULL;
-  g_autoptr(GAppInfo) app_info = NULL;
-  const gchar *name = NULL;
-  const gchar *desktop = NULL;
-
   if (snap != NULL) {
-    app_info = sdi_get_desktop_file_from_snap(snap);
-    if (app_info != NULL) {
-      name = g_app_info_get_display_name(app_info);
-      icon = g_app_info_get_icon(app_info);
-      desktop = g_desktop_app_info_get_filename(G_DESKTOP_APP_INFO(app_info));
-    }
-    if (name == NULL) {
-      name = snapd_snap_get_name(snap);
-    }
+    snap_name = snapd_snap_get_name(snap);
   }
-  if (name == NULL) {
-    name = snap_name;
+
+  // the snap has been refreshed, so its countdown is no longer valid
+  remove_forced_refresh(self, snap_name);
+  // and its .desktop file could have changed
+  g_hash_table_remove(self->snap_infos, snap_name);
+  // and the pending refresh notification that lists it is outdated
+  if (g_hash_table_contains(self->pending_snaps, snap_name)) {
+    close_pending_refresh_notification(self);
+    g_hash_table_remove_all(self->pending_snaps);
   }
 
-  g_autofree gchar *title = g_strdup_printf(_("%s was updated"), name);
+  // the snap store is always needed too, for the summary icon
+  SnapdSnap *snap_list[2] = {snap, NULL};
+  prepare_snap_infos(self, (snap != NULL) ? snap_list : snap_list + 1,
+                     (snap != NULL) ? 2 : 1,
+                     (SnapInfosReadyFunc)refresh_complete_ready_cb,
+                     g_strdup(snap_name), g_free);
+}
+
+/**
+ * Returns the number of notifications kept alive because they are still
+ * shown. With GNotification they are owned by the GApplication, so it is
+ * always zero.
+ */
+guint sdi_notify_get_n_notifications(SdiNotify *self) {
+  g_return_val_if_fail(SDI_IS_NOTIFY(self), 0);
 
-  update_complete_notification(self, title, _("You can reopen it now."), icon,
-                               "update-complete", desktop);
+#ifndef USE_GNOTIFY
+  return g_hash_table_size(self->notifications);
+#else
+  return 0;
+#endif
 }
 
 static void set_actions(SdiNotify *self) {
@@ -527,6 +1249,12 @@ static void set_actions(SdiNotify *self) {
                    (GCallback)sdi_notify_action_ignore, self);
   g_signal_connect(G_OBJECT(action_show_updates), "activate",
                    (GCallback)sdi_notify_action_show_updates, self);
+  g_autoptr(GSimpleAction) action_launch_refreshed_app =
+      g_simple_action_new("launch-refreshed-app", G_VARIANT_TYPE_STRING);
+  g_action_map_add_action(G_ACTION_MAP(self->application),
+                          G_ACTION(action_launch_refreshed_app));
+  g_signal_connect(G_OBJECT(action_launch_refreshed_app), "activate",
+                   (GCallback)sdi_notify_action_launch_refreshed_app, self);
 }
 
 static void sdi_notify_set_property(GObject *object, guint prop_id,
@@ -567,12 +1295,39 @@ static void sdi_notify_dispose(GObject *object) {
   SdiNotify *self = SDI_NOTIFY(object);
 
   g_clear_object(&self->application);
+  g_clear_handle_id(&self->flush_id, g_source_remove);
+  g_clear_handle_id(&self->countdown_id, g_source_remove);
+  g_clear_pointer(&self->forced_refreshes, g_hash_table_unref);
+  g_clear_pointer(&self->completed_refreshes, g_ptr_array_unref);
+  g_clear_pointer(&self->snap_infos, g_hash_table_unref);
+  g_clear_pointer(&self->snap_store_info, snap_info_free);
+  g_clear_object(&self->deferred_pending_refresh);
+  g_clear_pointer(&self->pending_snaps, g_hash_table_unref);
+  if (self->shown_times != NULL) {
+    g_queue_free_full(g_steal_pointer(&self->shown_times), g_free);
+  }
+#ifndef USE_GNOTIFY
+  g_clear_object(&self->summary_notification);
+  g_clear_object(&self->pending_notification);
+  g_clear_pointer(&self->notifications, g_hash_table_unref);
+#endif
 
   G_OBJECT_CLASS(sdi_notify_parent_class)->dispose(object);
 }
 
 void sdi_notify_init(SdiNotify *self) {
+  self->completed_refreshes =
+      g_ptr_array_new_with_free_func((GDestroyNotify)snap_info_free);
+  self->shown_times = g_queue_new();
+  self->pending_snaps =
+      g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  self->snap_infos = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                           (GDestroyNotify)snap_info_free);
+  self->forced_refreshes = g_hash_table_new_full(
+      g_str_hash, g_str_equal, g_free, (GDestroyNotify)forced_refresh_free);
 #ifndef USE_GNOTIFY
+  self->notifications = g_hash_table_new_full(g_direct_hash, g_direct_equal,
+                                              g_object_unref, NULL);
   notify_init("Snapd Desktop Integration");
 #endif
 }
@@ -39,4 +39,6 @@ void sdi_notify_pending_refresh_forced(SdiNotify *self, SnapdSnap *snap,
                                        GTimeSpan remaining_time,
                                        gboolean allow_to_ignore);
 
+guint sdi_notify_get_n_notifications(SdiNotify *self);
+
 G_END_DECLS
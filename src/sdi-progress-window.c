@@ -33,6 +33,7 @@ struct _SdiProgressWindow {
   GApplication *application;
   GtkBox *refresh_bar_container;
   GHashTable *dialogs;
+  gboolean paused;
 };
 
 G_DEFINE_TYPE(SdiProgressWindow, sdi_progress_window, G_TYPE_OBJECT)
@@ -101,6 +102,7 @@ static void add_dialog_to_main_window(SdiProgressWindow *self,
     gtk_window_set_default_size(GTK_WINDOW(self->main_window), 0, 0);
   }
 
+  sdi_refresh_dialog_set_paused(dialog, self->paused);
   gtk_box_append(self->refresh_bar_container, GTK_WIDGET(dialog));
   gtk_widget_set_visible(GTK_WIDGET(dialog), TRUE);
   /* the 'hide-event' is emitted by the dialog when the user clicks on the
@@ -132,11 +134,65 @@ void sdi_progress_window_begin_refresh(SdiProgressWindow *self,
   add_dialog_to_main_window(self, dialog);
 }
 
+static void cancel_install_cb(SdiProgressWindow *self,
+                              SdiRefreshDialog *dialog) {
+  g_signal_emit_by_name(self, "cancel-install",
+                        sdi_refresh_dialog_get_app_name(dialog));
+}
+
+/**
+ * This callback should be connected to the `begin-install` signal from a
+ * #sdi_theme_monitor object. It works like #sdi_progress_window_begin_refresh,
+ * but the dialog has a "Cancel" button that emits the `cancel-install`
+ * signal with the install ID.
+ */
+void sdi_progress_window_begin_install(SdiProgressWindow *self,
+                                       gchar *install_id, gchar *message) {
+  if (g_hash_table_contains(self->dialogs, install_id)) {
+    return;
+  }
+  g_autoptr(SdiRefreshDialog) dialog =
+      g_object_ref_sink(sdi_refresh_dialog_new(install_id, install_id));
+  sdi_refresh_dialog_set_message(dialog, message);
+  sdi_refresh_dialog_set_cancellable(dialog, TRUE);
+  g_signal_connect_object(dialog, "cancel-event",
+                          (GCallback)cancel_install_cb, self,
+                          G_CONNECT_SWAPPED);
+  g_hash_table_insert(self->dialogs, (gpointer)g_strdup(install_id),
+                      g_object_ref(dialog));
+  add_dialog_to_main_window(self, dialog);
+}
+
+/**
+ * This callback should be connected to the `install-progress` signal from a
+ * #sdi_theme_monitor object. If the change reports the number of bytes to
+ * download, the progress bar shows them; if not, it shows the number of
+ * tasks, like during a refresh.
+ */
+void sdi_progress_window_update_install_progress(
+    SdiProgressWindow *self, gchar *install_id, gchar *task_description,
+    guint64 done_bytes, guint64 total_bytes, guint done_tasks,
+    guint total_tasks) {
+  SdiRefreshDialog *dialog =
+      (SdiRefreshDialog *)g_hash_table_lookup(self->dialogs, install_id);
+  if (dialog == NULL) {
+    return;
+  }
+  if (total_bytes > 0) {
+    sdi_refresh_dialog_set_bytes_progress(dialog, task_description,
+                                          done_bytes, total_bytes);
+  } else if (total_tasks > 0) {
+    sdi_refresh_dialog_set_n_tasks_progress(dialog, task_description,
+                                            done_tasks, total_tasks);
+  }
+}
+
 /**
  * This callback should be connected to the `end-refresh` signal from a
- * #sdi_refresh_monitor object. It will remove the dialog that corresponds
- * to the specified snap, and close the window if there aren't any more
- * refresh dialogs.
+ * #sdi_refresh_monitor object, and to the `end-install` signal from a
+ * #sdi_theme_monitor object. It will remove the dialog that corresponds
+ * to the specified snap or install, and close the window if there aren't
+ * any more refresh dialogs.
  */
 
 void sdi_progress_window_end_refresh(SdiProgressWindow *self,
@@ -173,6 +229,22 @@ void sdi_progress_window_update_progress(SdiProgressWindow *self,
   }
 }
 
+/**
+ * Pauses the animations of all the dialogs, current and future, while
+ * @paused is %TRUE. It should be used while the session isn't visible.
+ */
+void sdi_progress_window_set_paused(SdiProgressWindow *self, gboolean paused) {
+  g_return_if_fail(SDI_IS_PROGRESS_WINDOW(self));
+
+  self->paused = paused;
+  GHashTableIter iter;
+  gpointer dialog;
+  g_hash_table_iter_init(&iter, self->dialogs);
+  while (g_hash_table_iter_next(&iter, NULL, &dialog)) {
+    sdi_refresh_dialog_set_paused(dialog, paused);
+  }
+}
+
 static void sdi_progress_window_dispose(GObject *object) {
   SdiProgressWindow *self = SDI_PROGRESS_WINDOW(object);
 
@@ -187,6 +259,9 @@ static void sdi_progress_window_class_init(SdiProgressWindowClass *klass) {
   GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
 
   gobject_class->dispose = sdi_progress_window_dispose;
+
+  g_signal_new("cancel-install", G_TYPE_FROM_CLASS(klass), G_SIGNAL_RUN_LAST,
+               0, NULL, NULL, NULL, G_TYPE_NONE, 1, G_TYPE_STRING);
 }
 
 static void sdi_progress_window_init(SdiProgressWindow *self) {
@@ -41,6 +41,16 @@ void sdi_progress_window_update_progress(SdiProgressWindow *self,
 
 void sdi_progress_window_end_refresh(SdiProgressWindow *self, gchar *snap_name);
 
+void sdi_progress_window_begin_install(SdiProgressWindow *self,
+                                       gchar *install_id, gchar *message);
+
+void sdi_progress_window_update_install_progress(
+    SdiProgressWindow *self, gchar *install_id, gchar *task_description,
+    guint64 done_bytes, guint64 total_bytes, guint done_tasks,
+    guint total_tasks);
+
+void sdi_progress_window_set_paused(SdiProgressWindow *self, gboolean paused);
+
 #ifdef DEBUG_TESTS
 
 GHashTable *sdi_progress_window_get_dialogs(SdiProgressWindow *self);
@@ -26,6 +26,7 @@
 #include <unistd.h>
 
 #include "iresources.h"
+#include "sdi-main-loop-watchdog.h"
 
 #define ICON_SIZE 64
 
@@ -41,6 +42,7 @@ struct _SdiRefreshDialog {
   GtkLabel *message_label;
   GtkProgressBar *progress_bar;
   GtkImage *icon_image;
+  GtkButton *cancel_button;
 
   gchar *app_name;
   gchar *message;
@@ -56,6 +58,10 @@ static void hide_cb(SdiRefreshDialog *self) {
   g_signal_emit_by_name(self, "hide-event");
 }
 
+static void cancel_cb(SdiRefreshDialog *self) {
+  g_signal_emit_by_name(self, "cancel-event");
+}
+
 static gboolean refresh_progress_bar(SdiRefreshDialog *self) {
   if (self->pulsed) {
 #ifdef DEBUG_TESTS
@@ -109,6 +115,8 @@ static void sdi_refresh_dialog_class_init(SdiRefreshDialogClass *klass) {
 
   g_signal_new("hide-event", G_TYPE_FROM_CLASS(klass), G_SIGNAL_RUN_LAST, 0,
                NULL, NULL, NULL, G_TYPE_NONE, 0);
+  g_signal_new("cancel-event", G_TYPE_FROM_CLASS(klass), G_SIGNAL_RUN_LAST, 0,
+               NULL, NULL, NULL, G_TYPE_NONE, 0);
 
   gtk_widget_class_bind_template_child(GTK_WIDGET_CLASS(klass),
                                        SdiRefreshDialog, message_label);
@@ -185,6 +193,60 @@ void sdi_refresh_dialog_set_n_tasks_progress(SdiRefreshDialog *self,
   sdi_refresh_dialog_set_percentage_progress(self, full_text, fraction);
 }
 
+void sdi_refresh_dialog_set_bytes_progress(SdiRefreshDialog *self,
+                                           const gchar *bar_text,
+                                           guint64 done_bytes,
+                                           guint64 total_bytes) {
+  g_autofree gchar *done_text = g_format_size(done_bytes);
+  g_autofree gchar *total_text = g_format_size(total_bytes);
+  /// TRANSLATORS: the first %s is the task being done; the second and third
+  /// ones are the amount of data already downloaded and the total, like
+  /// "12.3 MB".
+  g_autofree gchar *full_text =
+      g_strdup_printf(_("%s (%s of %s)"), bar_text, done_text, total_text);
+  gdouble fraction = ((gdouble)done_bytes) / ((gdouble)total_bytes);
+  sdi_refresh_dialog_set_percentage_progress(self, full_text, fraction);
+}
+
+/**
+ * Adds a "Cancel" button to the dialog, that emits the `cancel-event` signal
+ * when clicked. Refresh dialogs don't have it, so it isn't in the template.
+ */
+void sdi_refresh_dialog_set_cancellable(SdiRefreshDialog *self,
+                                        gboolean cancellable) {
+  if (cancellable && (self->cancel_button == NULL)) {
+    /// TRANSLATORS: cancels the operation shown in the progress bar
+    self->cancel_button = GTK_BUTTON(gtk_button_new_with_label(_("Cancel")));
+    gtk_widget_set_valign(GTK_WIDGET(self->cancel_button), GTK_ALIGN_CENTER);
+    g_signal_connect_swapped(self->cancel_button, "clicked",
+                             (GCallback)cancel_cb, self);
+    gtk_box_insert_child_after(
+        GTK_BOX(gtk_widget_get_parent(GTK_WIDGET(self->progress_bar))),
+        GTK_WIDGET(self->cancel_button), GTK_WIDGET(self->progress_bar));
+  } else if (!cancellable && (self->cancel_button != NULL)) {
+    gtk_box_remove(
+        GTK_BOX(gtk_widget_get_parent(GTK_WIDGET(self->cancel_button))),
+        GTK_WIDGET(self->cancel_button));
+    self->cancel_button = NULL;
+  }
+}
+
+/**
+ * Stops the pulse animation of the progress bar while @paused is %TRUE, like
+ * when nobody can see the desktop. The same timer counts down the inactivity
+ * timeout, so it is frozen too, and continues when the dialog is resumed.
+ */
+void sdi_refresh_dialog_set_paused(SdiRefreshDialog *self, gboolean paused) {
+  g_return_if_fail(SDI_IS_REFRESH_DIALOG(self));
+
+  if (paused) {
+    g_clear_handle_id(&self->timeout_id, g_source_remove);
+  } else if (self->timeout_id == 0) {
+    self->timeout_id =
+        g_timeout_add(PULSE_REFRESH, G_SOURCE_FUNC(refresh_progress_bar), self);
+  }
+}
+
 void sdi_refresh_dialog_set_message(SdiRefreshDialog *self,
                                     const gchar *message) {
   if (message == NULL) {
@@ -253,7 +315,9 @@ void sdi_refresh_dialog_set_icon_image(SdiRefreshDialog *self,
     return;
   }
 
+  sdi_main_loop_watchdog_begin_call("gdk_pixbuf_new_from_file");
   image = gdk_pixbuf_new_from_file(icon_image, NULL);
+  sdi_main_loop_watchdog_end_call();
   set_icon_image(self, image);
 }
 
@@ -42,6 +42,16 @@ void sdi_refresh_dialog_set_n_tasks_progress(SdiRefreshDialog *dialog,
                                              const gchar *bar_text,
                                              gint done_tasks, gint total_tasks);
 
+void sdi_refresh_dialog_set_bytes_progress(SdiRefreshDialog *dialog,
+                                           const gchar *bar_text,
+                                           guint64 done_bytes,
+                                           guint64 total_bytes);
+
+void sdi_refresh_dialog_set_paused(SdiRefreshDialog *dialog, gboolean paused);
+
+void sdi_refresh_dialog_set_cancellable(SdiRefreshDialog *dialog,
+                                        gboolean cancellable);
+
 void sdi_refresh_dialog_set_message(SdiRefreshDialog *dialog,
                                     const gchar *message);
 
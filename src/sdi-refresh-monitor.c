@@ -20,17 +20,48 @@
 #include <glib/gi18n.h>
 #include <gtk/gtk.h>
 #include <snapd-glib/snapd-glib.h>
+#include <string.h>
 #include <unistd.h>
 
+#include "sdi-change-summary.h"
 #include "sdi-forced-refresh-time-constants.h"
 #include "sdi-helpers.h"
+#include "sdi-main-loop-watchdog.h"
+#include "sdi-notice-types.h"
+#include "sdi-snap-store.h"
 #include "sdi-snapd-client-factory.h"
 
 // time in ms for periodic check of each change in Refresh Monitor.
 #define CHANGE_REFRESH_PERIOD 500
-
-static void manage_change_update(SnapdClient *source, GAsyncResult *res,
+// time in ms for periodic check of each change while the session is hidden.
+#define HIDDEN_CHANGE_REFRESH_PERIOD 10000
+// number of consecutive errors allowed before a change stops being polled.
+#define MAX_CHANGE_ERRORS 8
+// maximum time in ms between retries of a change that returns errors.
+#define MAX_CHANGE_RETRY_PERIOD 30000
+// time in seconds between comparisons of the tracked changes against the
+// changes that snapd reports as in progress.
+#define RECONCILE_PERIOD 30
+
+// time in seconds between garbage collections of the internal tables.
+#define GC_PERIOD 60
+// time in seconds after which an unused snap record is evicted.
+#define SNAP_RECORD_TTL (24 * 60 * 60)
+// maximum number of snap records kept; the least recently used idle ones are
+// evicted.
+#define MAX_SNAP_RECORDS 256
+// time in seconds without updates after which a progress entry whose change
+// is no longer being polled is considered stale.
+#define PROGRESS_ENTRY_TTL 30
+// time in seconds after which the snapd data of a snap is requested again.
+#define SNAP_STORE_TTL (10 * 60)
+
+static void manage_change_update(GObject *source, GAsyncResult *res,
                                  gpointer p);
+static void manage_change_summary_update(GObject *source, GAsyncResult *res,
+                                         gpointer p);
+static void process_change(SdiRefreshMonitor *self, const gchar *change_id,
+                           SdiChangeSummary *change);
 
 enum { PROP_NOTIFY = 1, PROP_LAST };
 
@@ -38,9 +69,38 @@ struct _SdiRefreshMonitor {
   GObject parent_instance;
 
   GHashTable *snaps;
+  // the last snapd data of each snap, to avoid asking for it again
+  SdiSnapStore *snap_store;
   GHashTable *changes;
   SnapdClient *client;
+  // If not NULL, the changes are requested to the fan-out service.
+  SdiFanoutClient *fanout;
+  // If not NULL, the changes are requested from the worker thread.
+  SdiSnapdWorker *worker;
+  // If TRUE, the changes are read with #SdiChangeSummary.
+  gboolean fast_change_parser;
+  /* Cancelled on dispose. Requests don't keep a reference to the monitor,
+   * so callbacks of cancelled requests must return without touching it. */
+  GCancellable *cancellable;
   GHashTable *refreshing_snap_list;
+
+  guint reconcile_id;
+  gboolean needs_reconcile;
+  // TRUE while the startup snapshot is being requested
+  gboolean snapshot_pending;
+  // If not NULL, the check of the inhibited snaps at startup is deferred.
+  SdiStartupScheduler *scheduler;
+  guint inhibit_check_id;
+  /* TRUE while the user can't see the session; no dialogs are created and
+   * the progress isn't updated, and the changes are polled slowly. */
+  gboolean session_hidden;
+  // TRUE if the next reconciliation must request all the tracked changes
+  gboolean catch_up;
+
+  guint gc_id;
+  gint64 snap_record_ttl;
+  guint max_snap_records;
+  gint64 progress_entry_ttl;
 };
 
 G_DEFINE_TYPE(SdiRefreshMonitor, sdi_refresh_monitor, G_TYPE_OBJECT)
@@ -55,7 +115,8 @@ static SnapRefreshData *
 snap_refresh_data_new(SdiRefreshMonitor *refresh_monitor,
                       const gchar *change_id, const gchar *snap_name) {
   SnapRefreshData *data = g_malloc0(sizeof(SnapRefreshData));
-  data->self = g_object_ref(refresh_monitor);
+  // not a reference; see the `cancellable` field
+  data->self = refresh_monitor;
   data->change_id = g_strdup(change_id);
   data->snap_name = g_strdup(snap_name);
   return data;
@@ -64,20 +125,45 @@ snap_refresh_data_new(SdiRefreshMonitor *refresh_monitor,
 static void free_change_refresh_data(SnapRefreshData *data) {
   g_free(data->change_id);
   g_free(data->snap_name);
-  g_clear_object(&data->self);
   g_free(data);
 }
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC(SnapRefreshData, free_change_refresh_data);
 
+/* Tracking state of a change being polled. They are stored in the `changes`
+ * table, using the change ID as key. Async requests don't keep pointers to
+ * these structures, but the change ID, because they can be removed while
+ * the request is in flight.
+ */
+typedef struct {
+  SdiRefreshMonitor *self;
+  gchar *change_id;
+  // timer for the next request; 0 if there is none scheduled
+  guint source_id;
+  // monotonic time of the last successful request
+  gint64 last_seen;
+  // number of consecutive failed requests
+  guint errors;
+} TrackedChange;
+
+static void free_tracked_change(TrackedChange *tracked) {
+  g_clear_handle_id(&tracked->source_id, g_source_remove);
+  g_free(tracked->change_id);
+  g_free(tracked);
+}
+
 typedef struct {
   guint total_tasks;
   guint done_tasks;
+  guint last_total_tasks;
   gdouble old_progress;
   gboolean done;
   GStrv desktop_files;
   gchar *snap_name;
   gchar *task_description;
+  // the change that updated this entry last time, and when it did it
+  gchar *change_id;
+  gint64 last_update;
 } SnapProgressTaskData;
 
 static void free_progress_task_data(void *data) {
@@ -85,6 +171,7 @@ static void free_progress_task_data(void *data) {
   g_strfreev(p->desktop_files);
   g_free(p->snap_name);
   g_free(p->task_description);
+  g_free(p->change_id);
   g_free(p);
 }
 
@@ -123,6 +210,7 @@ static SnapProgressTaskData *new_progress_task_data(const gchar *snap_name) {
   retval->done = FALSE;
   retval->desktop_files = get_desktop_filenames_for_snap(snap_name);
   retval->snap_name = g_strdup(snap_name);
+  retval->last_update = g_get_monotonic_time();
   return retval;
 }
 
@@ -131,7 +219,11 @@ G_DEFINE_AUTOPTR_CLEANUP_FUNC(SnapProgressTaskData, free_progress_task_data);
 static SdiSnap *find_snap(SdiRefreshMonitor *self, const gchar *snap_name) {
   SdiSnap *snap =
       (SdiSnap *)g_hash_table_lookup(self->snaps, (gconstpointer)snap_name);
-  return (snap == NULL) ? NULL : g_object_ref(snap);
+  if (snap == NULL) {
+    return NULL;
+  }
+  sdi_snap_touch(snap);
+  return g_object_ref(snap);
 }
 
 static SdiSnap *add_snap(SdiRefreshMonitor *self, const gchar *snap_name) {
@@ -154,7 +246,6 @@ static void remove_snap(SdiRefreshMonitor *self, SdiSnap *snap) {
 static void show_snap_completed(GObject *source, GAsyncResult *res,
                                 gpointer p) {
   g_autoptr(SnapRefreshData) data = p;
-  g_autoptr(SdiRefreshMonitor) self = g_object_ref(data->self);
   g_autoptr(GError) error = NULL;
 
   g_autoptr(SnapdSnap) snap =
@@ -163,7 +254,9 @@ static void show_snap_completed(GObject *source, GAsyncResult *res,
       (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED))) {
     return;
   }
+  SdiRefreshMonitor *self = data->self;
   if ((error == NULL) && (snap != NULL)) {
+    sdi_snap_store_update(self->snap_store, snap);
     g_signal_emit_by_name(self, "notify-refresh-complete", snap, NULL);
   } else {
     g_signal_emit_by_name(self, "notify-refresh-complete", NULL,
@@ -171,12 +264,90 @@ static void show_snap_completed(GObject *source, GAsyncResult *res,
   }
 }
 
-static void refresh_change(gpointer p) {
-  g_autoptr(SnapRefreshData) data = p;
-  g_hash_table_remove(data->self->changes, data->change_id);
-  snapd_client_get_change_async(data->self->client, data->change_id, NULL,
-                                (GAsyncReadyCallback)manage_change_update,
-                                g_object_ref(data->self));
+static void request_change(SdiRefreshMonitor *self, const gchar *change_id) {
+  SnapRefreshData *data = snap_refresh_data_new(self, change_id, NULL);
+  if (self->fanout != NULL) {
+    sdi_fanout_client_get_change_async(self->fanout, change_id,
+                                       self->cancellable,
+                                       manage_change_update, data);
+  } else if (self->fast_change_parser && (self->worker != NULL)) {
+    sdi_snapd_worker_get_change_summary_async(self->worker, change_id,
+                                              self->cancellable,
+                                              manage_change_summary_update,
+                                              data);
+  } else if (self->fast_change_parser) {
+    sdi_change_summary_request_async(
+        sdi_snapd_client_factory_get_socket_path(), change_id,
+        self->cancellable, manage_change_summary_update, data);
+  } else if (self->worker != NULL) {
+    sdi_snapd_worker_get_change_async(self->worker, change_id,
+                                      self->cancellable, manage_change_update,
+                                      data);
+  } else {
+    snapd_client_get_change_async(self->client, change_id, self->cancellable,
+                                  manage_change_update, data);
+  }
+}
+
+static void refresh_change(TrackedChange *tracked) {
+  tracked->source_id = 0;
+  request_change(tracked->self, tracked->change_id);
+}
+
+static TrackedChange *track_change(SdiRefreshMonitor *self,
+                                   const gchar *change_id) {
+  TrackedChange *tracked = g_hash_table_lookup(self->changes, change_id);
+  if (tracked == NULL) {
+    tracked = g_malloc0(sizeof(TrackedChange));
+    tracked->self = self;
+    tracked->change_id = g_strdup(change_id);
+    tracked->last_seen = g_get_monotonic_time();
+    g_hash_table_insert(self->changes, g_strdup(change_id), tracked);
+  }
+  return tracked;
+}
+
+static void schedule_change_refresh(TrackedChange *tracked, guint delay) {
+  if (tracked->source_id != 0) {
+    return;
+  }
+  tracked->source_id =
+      g_timeout_add_once(delay, (GSourceOnceFunc)refresh_change, tracked);
+}
+
+static void refresh_change_now(TrackedChange *tracked) {
+  g_clear_handle_id(&tracked->source_id, g_source_remove);
+  schedule_change_refresh(tracked, 0);
+}
+
+/**
+ * Called when a request for a change fails. The change is retried with an
+ * exponential backoff until it consumes its error budget; after that it
+ * isn't polled anymore, but the next reconciliation pass will track it
+ * again if snapd still reports it as in progress.
+ */
+static void manage_change_error(SdiRefreshMonitor *self,
+                                const gchar *change_id) {
+  TrackedChange *tracked = track_change(self, change_id);
+  tracked->errors++;
+  if (tracked->errors > MAX_CHANGE_ERRORS) {
+    g_debug("Change %s failed %u times, and was last seen %" G_GINT64_FORMAT
+            " seconds ago; stop polling it",
+            change_id, tracked->errors,
+            (g_get_monotonic_time() - tracked->last_seen) / G_USEC_PER_SEC);
+    g_hash_table_remove(self->changes, change_id);
+    self->needs_reconcile = TRUE;
+    return;
+  }
+  guint delay = MIN(CHANGE_REFRESH_PERIOD << tracked->errors,
+                    MAX_CHANGE_RETRY_PERIOD);
+  g_clear_handle_id(&tracked->source_id, g_source_remove);
+  schedule_change_refresh(tracked, delay);
+}
+
+static gboolean is_refresh_change_kind(const gchar *kind) {
+  return (g_strcmp0(kind, "auto-refresh") == 0) ||
+         (g_strcmp0(kind, "refresh-snap") == 0);
 }
 
 static gboolean status_is_done(const gchar *status) {
@@ -195,18 +366,16 @@ static gboolean status_is_done(const gchar *status) {
  * it should be closed, in which case an ènd-refresh` signal will be emitted,
  * and a dialog will be shown. */
 static void process_inhibited_snaps(SdiRefreshMonitor *self,
-                                    SnapdChange *change, gboolean done,
+                                    SdiChangeSummary *change, gboolean done,
                                     gboolean cancelled) {
-  SnapdAutorefreshChangeData *change_data =
-      SNAPD_AUTOREFRESH_CHANGE_DATA(snapd_change_get_data(change));
+  const gchar *const *snap_names = sdi_change_summary_get_snap_names(change);
 
-  if (change_data == NULL) {
+  if (snap_names == NULL) {
     return;
   }
 
-  GStrv snap_names = snapd_autorefresh_change_data_get_snap_names(change_data);
-  for (gchar **p = snap_names; *p != NULL; p++) {
-    gchar *snap_name = *p;
+  for (const gchar *const *p = snap_names; *p != NULL; p++) {
+    const gchar *snap_name = *p;
     g_autoptr(SdiSnap) snap = find_snap(self, snap_name);
     if (snap == NULL) {
       continue;
@@ -229,16 +398,29 @@ static void process_inhibited_snaps(SdiRefreshMonitor *self,
        * has been refreshed and they can launch it again.
        */
       if (done) {
+        /* the stored data is from before the refresh, but the name and the
+         * apps are enough for the notification.
+         */
+        g_autoptr(SnapdSnap) stored_snap =
+            sdi_snap_store_lookup(self->snap_store, snap_name);
+        if (stored_snap != NULL) {
+          g_signal_emit_by_name(self, "notify-refresh-complete", stored_snap,
+                                NULL);
+          continue;
+        }
         g_autoptr(SnapRefreshData) data =
             snap_refresh_data_new(self, NULL, snap_name);
-        snapd_client_get_snap_async(self->client, snap_name, NULL,
-                                    show_snap_completed,
+        snapd_client_get_snap_async(self->client, snap_name,
+                                    self->cancellable, show_snap_completed,
                                     g_steal_pointer(&data));
       }
       continue;
     }
 
-    if (!sdi_snap_get_created_dialog(snap)) {
+    /* the dialog is created once the session is visible again, when the
+     * change is requested during the catch up.
+     */
+    if (!sdi_snap_get_created_dialog(snap) && !self->session_hidden) {
       // If there's no dialog, get the data for this snap and create it.
       sdi_snap_set_ignored(snap, TRUE);
       /* and mark it as it has a dialog, to avoid creating it again
@@ -246,8 +428,20 @@ static void process_inhibited_snaps(SdiRefreshMonitor *self,
        */
       sdi_snap_set_created_dialog(snap, TRUE);
 
+      /* the snap is usually stored, because it was received with the
+       * `refresh-inhibit` notice that marked it as inhibited.
+       */
       g_autoptr(SnapdSnap) client_snap =
-          snapd_client_get_snap_sync(self->client, snap_name, NULL, NULL);
+          sdi_snap_store_lookup(self->snap_store, snap_name);
+      if (client_snap == NULL) {
+        sdi_main_loop_watchdog_begin_call("snapd_client_get_snap_sync");
+        client_snap =
+            snapd_client_get_snap_sync(self->client, snap_name, NULL, NULL);
+        sdi_main_loop_watchdog_end_call();
+        if (client_snap != NULL) {
+          sdi_snap_store_update(self->snap_store, client_snap);
+        }
+      }
 
       if (client_snap == NULL) {
         // If no snap data is received, use default data and no icon
@@ -288,14 +482,19 @@ static void update_progress_bars(gpointer key, SnapProgressTaskData *task_data,
   }
   gdouble progress = task_data->done_tasks / (gdouble)task_data->total_tasks;
 
+  /* while the session is hidden only the end is sent, so the old progress
+   * is kept and the current one is sent when it is visible again.
+   */
   if (task_data->done ||
-      !G_APPROX_VALUE(progress, task_data->old_progress, DBL_EPSILON)) {
+      (!self->session_hidden &&
+       !G_APPROX_VALUE(progress, task_data->old_progress, DBL_EPSILON))) {
     task_data->old_progress = progress;
     g_signal_emit_by_name(self, "refresh-progress", task_data->snap_name,
                           task_data->desktop_files, task_data->task_description,
                           task_data->done_tasks, task_data->total_tasks,
                           task_data->done);
   }
+  task_data->last_total_tasks = task_data->total_tasks;
   task_data->done_tasks = 0;
   task_data->total_tasks = 0;
 }
@@ -307,25 +506,23 @@ static void update_progress_bars(gpointer key, SnapProgressTaskData *task_data,
  * current progress percentage for each snap being refreshed.
  */
 static void process_change_progress(SdiRefreshMonitor *self,
-                                    SnapdChange *change, gboolean done,
+                                    SdiChangeSummary *change, gboolean done,
                                     gboolean cancelled) {
-  GPtrArray *tasks = snapd_change_get_tasks(change);
+  guint n_tasks = sdi_change_summary_get_n_tasks(change);
   GSList *snaps_to_remove = NULL;
+  const gchar *change_id = sdi_change_summary_get_id(change);
+  gint64 now = g_get_monotonic_time();
 
-  for (guint i = 0; i < tasks->len; i++) {
-    SnapdTask *task = tasks->pdata[i];
-    SnapdTaskData *task_data = snapd_task_get_data(task);
-    if (task_data == NULL) {
-      continue;
-    }
-    GStrv affected_snaps = snapd_task_data_get_affected_snaps(task_data);
+  for (guint i = 0; i < n_tasks; i++) {
+    const gchar *const *affected_snaps =
+        sdi_change_summary_get_task_affected_snaps(change, i);
     if (affected_snaps == NULL) {
       continue;
     }
-    const gchar *status = snapd_task_get_status(task);
+    const gchar *status = sdi_change_summary_get_task_status(change, i);
     gboolean task_done = status_is_done(status);
-    for (gchar **p = affected_snaps; *p != NULL; p++) {
-      gchar *snap_name = *p;
+    for (const gchar *const *p = affected_snaps; *p != NULL; p++) {
+      const gchar *snap_name = *p;
       SnapProgressTaskData *progress_task_data = NULL;
       /* Each Change has one or more Tasks. Each Task has zero or more affected
        * Snaps. So we must keep a list of affected Snaps, and update the count
@@ -341,6 +538,11 @@ static void process_change_progress(SdiRefreshMonitor *self,
         progress_task_data =
             g_hash_table_lookup(self->refreshing_snap_list, snap_name);
       }
+      if (g_strcmp0(progress_task_data->change_id, change_id) != 0) {
+        g_free(progress_task_data->change_id);
+        progress_task_data->change_id = g_strdup(change_id);
+      }
+      progress_task_data->last_update = now;
       progress_task_data->total_tasks++;
       progress_task_data->done = task_done;
       if (task_done) {
@@ -348,7 +550,7 @@ static void process_change_progress(SdiRefreshMonitor *self,
       } else if ((progress_task_data->task_description == NULL) &&
                  g_str_equal("Doing", status)) {
         progress_task_data->task_description =
-            g_strdup(snapd_task_get_summary(task));
+            g_strdup(sdi_change_summary_get_task_summary(change, i));
       }
       if (done || cancelled) {
         /* If a Change is complete or has been cancelled, we must remove those
@@ -378,57 +580,198 @@ static gboolean valid_working_change_status(const gchar *status) {
          g_str_equal(status, "Done");
 }
 
+// processes the reply to a change request, or the error returned by it
+static void manage_change_reply(SnapRefreshData *data,
+                                SdiChangeSummary *change, GError *error) {
+  SdiRefreshMonitor *self = data->self;
+  if (error != NULL) {
+    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+      return;
+    }
+    g_debug("Error in manage_change_reply: %s\n", error->message);
+    manage_change_error(self, data->change_id);
+    return;
+  }
+  if (change == NULL) {
+    manage_change_error(self, data->change_id);
+    return;
+  }
+  process_change(self, data->change_id, change);
+}
+
 /**
  * This method manages the "change-update" type notices. These notices
  * include a change ID, which is requested here. That change contains
  * a set of tasks that will be, are being, or have been, done.
  */
-static void manage_change_update(SnapdClient *source, GAsyncResult *res,
+static void manage_change_update(GObject *source, GAsyncResult *res,
                                  gpointer p) {
-  g_autoptr(SdiRefreshMonitor) self = p;
+  g_autoptr(SnapRefreshData) data = p;
+  g_autoptr(GError) error = NULL;
+  g_autoptr(SnapdChange) change = NULL;
+  if (SDI_IS_FANOUT_CLIENT(source)) {
+    change = sdi_fanout_client_get_change_finish(SDI_FANOUT_CLIENT(source),
+                                                 res, &error);
+  } else if (SDI_IS_SNAPD_WORKER(source)) {
+    change = sdi_snapd_worker_get_change_finish(SDI_SNAPD_WORKER(source), res,
+                                                &error);
+  } else {
+    change = snapd_client_get_change_finish(SNAPD_CLIENT(source), res, &error);
+  }
+
+  g_autoptr(SdiChangeSummary) summary = NULL;
+  if (change != NULL) {
+    summary = sdi_change_summary_new_from_change(change);
+  }
+  manage_change_reply(data, summary, error);
+}
+
+/**
+ * Like `manage_change_update()`, but for the changes read with the fast
+ * parser, which don't build a #SnapdChange.
+ */
+static void manage_change_summary_update(GObject *source, GAsyncResult *res,
+                                         gpointer p) {
+  g_autoptr(SnapRefreshData) data = p;
   g_autoptr(GError) error = NULL;
-  g_autoptr(SnapdChange) change =
-      snapd_client_get_change_finish(source, res, &error);
+  g_autoptr(SdiChangeSummary) change = NULL;
+  if (SDI_IS_SNAPD_WORKER(source)) {
+    change = sdi_snapd_worker_get_change_summary_finish(
+        SDI_SNAPD_WORKER(source), res, &error);
+  } else {
+    change = sdi_change_summary_request_finish(res, &error);
+  }
+  manage_change_reply(data, change, error);
+}
 
-  if (error != NULL) {
-    if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
-      return;
-    }
-    g_debug("Error in manage_change_update: %s\n", error->message);
-    return;
+/**
+ * Removes from the store the snaps modified by @change, which has finished,
+ * because their revision and apps may be different now.
+ */
+static void invalidate_changed_snaps(SdiRefreshMonitor *self,
+                                     SdiChangeSummary *change) {
+  const gchar *const *snap_names = sdi_change_summary_get_snap_names(change);
+  for (const gchar *const *p = snap_names; (p != NULL) && (*p != NULL); p++) {
+    sdi_snap_store_invalidate(self->snap_store, *p);
   }
-  if (change == NULL) {
-    return;
+  guint n_tasks = sdi_change_summary_get_n_tasks(change);
+  for (guint i = 0; i < n_tasks; i++) {
+    const gchar *const *affected_snaps =
+        sdi_change_summary_get_task_affected_snaps(change, i);
+    for (const gchar *const *p = affected_snaps; (p != NULL) && (*p != NULL);
+         p++) {
+      sdi_snap_store_invalidate(self->snap_store, *p);
+    }
   }
+}
 
-  const gchar *change_status = snapd_change_get_status(change);
+/**
+ * Updates the state with the current status of @change, and keeps polling
+ * it while it is in progress.
+ */
+static void process_change(SdiRefreshMonitor *self, const gchar *change_id,
+                           SdiChangeSummary *change) {
+  const gchar *change_status = sdi_change_summary_get_status(change);
 
   gboolean done = g_str_equal(change_status, "Done");
   gboolean cancelled = cancelled_change_status(change_status);
   gboolean valid_do = valid_working_change_status(change_status);
   if (!(valid_do || cancelled)) {
+    /* The change is paused or in an unknown state, so it isn't polled
+     * anymore; if it continues, it will send a new notice, or will be
+     * found by the reconciliation pass.
+     */
     g_debug("Unknown change status %s", change_status);
+    g_hash_table_remove(self->changes, change_id);
     return;
   }
 
-  if (g_str_equal(snapd_change_get_kind(change), "auto-refresh")) {
+  if (g_str_equal(sdi_change_summary_get_kind(change), "auto-refresh")) {
     process_inhibited_snaps(self, change, done, cancelled);
   }
   process_change_progress(self, change, done, cancelled);
 
-  const gchar *change_id = snapd_change_get_id(change);
-  if (!done && !cancelled && !g_hash_table_contains(self->changes, change_id)) {
-    /* since the "change-update" notice event is sent only when new Tasks
-     * are added to a Change, or when the status of the Change has been
-     * modified, we must request periodically the Change to check which task
-     * is currently active and be able to update the progress bar.
-     */
-    SnapRefreshData *data = snap_refresh_data_new(self, change_id, NULL);
-    guint id = g_timeout_add_once(CHANGE_REFRESH_PERIOD,
-                                  (GSourceOnceFunc)refresh_change, data);
-    g_hash_table_insert(self->changes, g_strdup(change_id),
-                        GINT_TO_POINTER(id));
+  if (done || cancelled) {
+    invalidate_changed_snaps(self, change);
+    g_hash_table_remove(self->changes, change_id);
+    return;
   }
+  /* since the "change-update" notice event is sent only when new Tasks
+   * are added to a Change, or when the status of the Change has been
+   * modified, we must request periodically the Change to check which task
+   * is currently active and be able to update the progress bar.
+   */
+  TrackedChange *tracked = track_change(self, change_id);
+  tracked->last_seen = g_get_monotonic_time();
+  tracked->errors = 0;
+  schedule_change_refresh(tracked, self->session_hidden
+                                       ? HIDDEN_CHANGE_REFRESH_PERIOD
+                                       : CHANGE_REFRESH_PERIOD);
+}
+
+/**
+ * Compares the tracked changes with the refresh changes that snapd reports
+ * as in progress. Untracked changes start to be polled, and tracked changes
+ * that aren't in progress anymore are requested immediately to get their
+ * final status, so no change can be orphaned, even if its notices or some
+ * requests were lost. After the session is hidden, all the tracked changes
+ * are requested, to catch up with the progress done meanwhile.
+ */
+static void reconcile_changes(SnapdClient *source, GAsyncResult *res,
+                              gpointer p) {
+  SdiRefreshMonitor *self = p;
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GPtrArray) changes =
+      snapd_client_get_changes_finish(source, res, &error);
+
+  if (error != NULL) {
+    if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+      g_debug("Error in reconcile_changes: %s", error->message);
+    }
+    return;
+  }
+  self->needs_reconcile = FALSE;
+  gboolean catch_up = self->catch_up;
+  self->catch_up = FALSE;
+
+  g_autoptr(GHashTable) in_progress = g_hash_table_new(g_str_hash, g_str_equal);
+  for (guint i = 0; i < changes->len; i++) {
+    SnapdChange *change = changes->pdata[i];
+    if (!is_refresh_change_kind(snapd_change_get_kind(change))) {
+      continue;
+    }
+    const gchar *change_id = snapd_change_get_id(change);
+    g_hash_table_add(in_progress, (gpointer)change_id);
+    if (!g_hash_table_contains(self->changes, change_id)) {
+      g_debug("Found untracked change %s", change_id);
+      refresh_change_now(track_change(self, change_id));
+    }
+  }
+
+  GHashTableIter iter;
+  gpointer change_id, tracked;
+  g_hash_table_iter_init(&iter, self->changes);
+  while (g_hash_table_iter_next(&iter, &change_id, &tracked)) {
+    if (catch_up || !g_hash_table_contains(in_progress, change_id)) {
+      refresh_change_now(tracked);
+    }
+  }
+}
+
+static void request_changes_in_progress(SdiRefreshMonitor *self) {
+  snapd_client_get_changes_async(
+      self->client, SNAPD_CHANGE_FILTER_IN_PROGRESS, NULL, self->cancellable,
+      (GAsyncReadyCallback)reconcile_changes, self);
+}
+
+static gboolean reconcile_cb(SdiRefreshMonitor *self) {
+  // nothing can be orphaned if nothing is being tracked
+  if ((g_hash_table_size(self->changes) != 0) ||
+      (g_hash_table_size(self->refreshing_snap_list) != 0) ||
+      self->needs_reconcile) {
+    request_changes_in_progress(self);
+  }
+  return G_SOURCE_CONTINUE;
 }
 
 static gboolean notify_check_forced_refresh(SdiRefreshMonitor *self,
@@ -461,7 +804,7 @@ static gboolean notify_check_forced_refresh(SdiRefreshMonitor *self,
  */
 static void manage_refresh_inhibit(SnapdClient *source, GAsyncResult *res,
                                    gpointer p) {
-  g_autoptr(SdiRefreshMonitor) self = p;
+  SdiRefreshMonitor *self = p;
 
   g_autoptr(GError) error = NULL;
   g_autoptr(GPtrArray) snaps =
@@ -474,6 +817,7 @@ static void manage_refresh_inhibit(SnapdClient *source, GAsyncResult *res,
     g_debug("Error in manage_refresh_inhibit: %s\n", error->message);
     return;
   }
+  sdi_snap_store_update_all(self->snap_store, snaps);
   if (snaps->len == 0) {
     return;
   }
@@ -530,32 +874,111 @@ static void manage_refresh_inhibit(SnapdClient *source, GAsyncResult *res,
   }
 }
 
+/**
+ * Builds the state from the refresh changes that snapd reports as in
+ * progress, so a daemon started in the middle of a refresh shows its
+ * progress without requesting each change again.
+ */
+static void manage_startup_changes(SnapdClient *source, GAsyncResult *res,
+                                   gpointer p) {
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GPtrArray) changes =
+      snapd_client_get_changes_finish(source, res, &error);
+  if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+    return;
+  }
+  SdiRefreshMonitor *self = p;
+  self->snapshot_pending = FALSE;
+  if (error != NULL) {
+    g_debug("Error in manage_startup_changes: %s", error->message);
+    // the next reconciliation pass will find them
+    self->needs_reconcile = TRUE;
+    return;
+  }
+  self->needs_reconcile = FALSE;
+
+  for (guint i = 0; i < changes->len; i++) {
+    SnapdChange *change = changes->pdata[i];
+    const gchar *change_id = snapd_change_get_id(change);
+    if (!is_refresh_change_kind(snapd_change_get_kind(change)) ||
+        g_hash_table_contains(self->changes, change_id)) {
+      continue;
+    }
+    g_autoptr(SdiChangeSummary) summary =
+        sdi_change_summary_new_from_change(change);
+    process_change(self, change_id, summary);
+  }
+}
+
+static void request_inhibited_snaps(SdiRefreshMonitor *self) {
+  self->inhibit_check_id = 0;
+  snapd_client_get_snaps_async(
+      self->client, SNAPD_GET_SNAPS_FLAGS_REFRESH_INHIBITED, NULL,
+      self->cancellable, (GAsyncReadyCallback)manage_refresh_inhibit, self);
+}
+
+static void cancel_inhibit_check(SdiRefreshMonitor *self) {
+  if (self->inhibit_check_id != 0) {
+    sdi_startup_scheduler_remove(self->scheduler, self->inhibit_check_id);
+    self->inhibit_check_id = 0;
+  }
+}
+
+/**
+ * The notices replayed when the monitor starts, or when it reconnects to
+ * snapd, describe the past. Instead of processing them one by one, the
+ * current state is taken from a single snapshot of the refresh changes in
+ * progress and the inhibited snaps. The changes are requested first, to
+ * show their progress; the inhibited snaps can wait for the turn that the
+ * startup scheduler gives to this user.
+ */
+static void take_startup_snapshot(SdiRefreshMonitor *self) {
+  if (self->snapshot_pending) {
+    return;
+  }
+  self->snapshot_pending = TRUE;
+  snapd_client_get_changes_async(
+      self->client, SNAPD_CHANGE_FILTER_IN_PROGRESS, NULL, self->cancellable,
+      (GAsyncReadyCallback)manage_startup_changes, self);
+  if (self->scheduler == NULL) {
+    request_inhibited_snaps(self);
+  } else if (self->inhibit_check_id == 0) {
+    self->inhibit_check_id = sdi_startup_scheduler_add(
+        self->scheduler, SDI_STARTUP_PRIORITY_DEFERRED,
+        (GSourceOnceFunc)request_inhibited_snaps, self);
+  }
+}
+
+/**
+ * Returns the notice types that `sdi_refresh_monitor_notice()` processes,
+ * to be passed to `sdi_snapd_monitor_add_notice_types()`.
+ */
+const gchar *const *sdi_refresh_monitor_get_notice_types(void) {
+  static const gchar *const types[] = {SDI_REFRESH_MONITOR_NOTICE_TYPES, NULL};
+  return types;
+}
+
 void sdi_refresh_monitor_notice(SdiRefreshMonitor *self, SnapdNotice *notice,
                                 gboolean first_run) {
   GHashTable *notice_data = snapd_notice_get_last_data2(notice);
   g_autofree gchar *kind = g_strdup(g_hash_table_lookup(notice_data, "kind"));
 
+  if (first_run) {
+    take_startup_snapshot(self);
+    return;
+  }
+
   switch (snapd_notice_get_notice_type(notice)) {
   case SNAPD_NOTICE_TYPE_CHANGE_UPDATE:
-    /**
-     * During first run, we must ignore these events to avoid showing old
-     * notices that do not apply anymore.
-     */
-    if (first_run) {
+    if (!is_refresh_change_kind(kind)) {
       return;
     }
-    if (!g_str_equal(kind, "auto-refresh") &&
-        !g_str_equal(kind, "refresh-snap")) {
-      return;
-    }
-    snapd_client_get_change_async(
-        self->client, snapd_notice_get_key(notice), NULL,
-        (GAsyncReadyCallback)manage_change_update, g_object_ref(self));
+    request_change(self, snapd_notice_get_key(notice));
     break;
   case SNAPD_NOTICE_TYPE_REFRESH_INHIBIT:
-    snapd_client_get_snaps_async(
-        self->client, SNAPD_GET_SNAPS_FLAGS_REFRESH_INHIBITED, NULL, NULL,
-        (GAsyncReadyCallback)manage_refresh_inhibit, g_object_ref(self));
+    // a new notice can't wait, and makes the deferred check unneeded
+    cancel_inhibit_check(self);
+    request_inhibited_snaps(self);
     break;
   case SNAPD_NOTICE_TYPE_SNAP_RUN_INHIBIT:
     // TODO. At this moment, no notice of this kind is emmited.
@@ -565,32 +988,239 @@ void sdi_refresh_monitor_notice(SdiRefreshMonitor *self, SnapdNotice *notice,
   }
 }
 
+/**
+ * Removes the progress entries of changes that disappeared without being
+ * reported as done or cancelled. Those snaps get a final `refresh-progress`
+ * signal marked as done, to remove the progress bar from the dock, and an
+ * `end-refresh` signal if a dialog was created for them.
+ */
+static guint collect_progress_entries(SdiRefreshMonitor *self, gint64 now) {
+  g_autoptr(GPtrArray) stale_entries = g_ptr_array_new_with_free_func(g_free);
+  GHashTableIter iter;
+  gpointer key, value;
+
+  g_hash_table_iter_init(&iter, self->refreshing_snap_list);
+  while (g_hash_table_iter_next(&iter, &key, &value)) {
+    SnapProgressTaskData *task_data = value;
+    if (now - task_data->last_update <= self->progress_entry_ttl) {
+      continue;
+    }
+    if ((task_data->change_id != NULL) &&
+        g_hash_table_contains(self->changes, task_data->change_id)) {
+      continue;
+    }
+    g_ptr_array_add(stale_entries, g_strdup(key));
+  }
+
+  for (guint i = 0; i < stale_entries->len; i++) {
+    const gchar *snap_name = stale_entries->pdata[i];
+    SnapProgressTaskData *task_data =
+        g_hash_table_lookup(self->refreshing_snap_list, snap_name);
+    guint total_tasks = MAX(task_data->last_total_tasks, 1);
+    g_signal_emit_by_name(self, "refresh-progress", task_data->snap_name,
+                          task_data->desktop_files, task_data->task_description,
+                          total_tasks, total_tasks, TRUE);
+    g_hash_table_remove(self->refreshing_snap_list, snap_name);
+
+    SdiSnap *snap = g_hash_table_lookup(self->snaps, snap_name);
+    if ((snap != NULL) && sdi_snap_get_created_dialog(snap)) {
+      g_signal_emit_by_name(self, "end-refresh", snap_name);
+      g_hash_table_remove(self->snaps, snap_name);
+    }
+  }
+  return stale_entries->len;
+}
+
+static gint compare_snaps_by_last_use(SdiSnap **a, SdiSnap **b) {
+  gint64 last_used_a = sdi_snap_get_last_used(*a);
+  gint64 last_used_b = sdi_snap_get_last_used(*b);
+  return (last_used_a > last_used_b) - (last_used_a < last_used_b);
+}
+
+/**
+ * Returns whether the record of @snap only caches data, so it can be
+ * evicted. The records of snaps that are inhibited, ignored by the user,
+ * shown in a dialog or being refreshed hold state that can't be recovered,
+ * so they are kept until the refresh ends.
+ */
+static gboolean is_idle_snap_record(SdiRefreshMonitor *self, SdiSnap *snap) {
+  return !sdi_snap_get_inhibited(snap) && !sdi_snap_get_ignored(snap) &&
+         !sdi_snap_get_created_dialog(snap) &&
+         !g_hash_table_contains(self->refreshing_snap_list,
+                                sdi_snap_get_name(snap));
+}
+
+/**
+ * Evicts the idle snap records that haven't been used during the TTL and,
+ * if there are still too many records, the least recently used idle ones.
+ */
+static guint collect_snap_records(SdiRefreshMonitor *self, gint64 now) {
+  g_autoptr(GPtrArray) snaps = g_ptr_array_new_with_free_func(g_object_unref);
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init(&iter, self->snaps);
+  while (g_hash_table_iter_next(&iter, NULL, &value)) {
+    if (is_idle_snap_record(self, value)) {
+      g_ptr_array_add(snaps, g_object_ref(value));
+    }
+  }
+  g_ptr_array_sort(snaps, (GCompareFunc)compare_snaps_by_last_use);
+
+  guint n_evicted = 0;
+  for (guint i = 0; i < snaps->len; i++) {
+    SdiSnap *snap = snaps->pdata[i];
+    gboolean expired =
+        now - sdi_snap_get_last_used(snap) > self->snap_record_ttl;
+    if (!expired &&
+        (g_hash_table_size(self->snaps) <= self->max_snap_records)) {
+      break;
+    }
+    remove_snap(self, snap);
+    n_evicted++;
+  }
+  return n_evicted;
+}
+
+static void collect_garbage(SdiRefreshMonitor *self) {
+  gint64 now = g_get_monotonic_time();
+  guint n_progress_entries = collect_progress_entries(self, now);
+  guint n_snaps = collect_snap_records(self, now);
+  sdi_snap_store_remove_expired(self->snap_store);
+  if ((n_progress_entries != 0) || (n_snaps != 0)) {
+    g_debug("Refresh monitor removed %u stale progress entries and %u snap "
+            "records; now it uses about %" G_GSIZE_FORMAT " bytes",
+            n_progress_entries, n_snaps,
+            sdi_refresh_monitor_get_footprint(self, NULL, NULL, NULL));
+  }
+}
+
+static gboolean gc_cb(SdiRefreshMonitor *self) {
+  collect_garbage(self);
+  return G_SOURCE_CONTINUE;
+}
+
+static gsize get_string_footprint(const gchar *string) {
+  return (string == NULL) ? 0 : strlen(string) + 1;
+}
+
+static gsize get_strv_footprint(GStrv strv) {
+  if (strv == NULL) {
+    return 0;
+  }
+  gsize size = sizeof(gchar *);
+  for (gchar **p = strv; *p != NULL; p++) {
+    size += sizeof(gchar *) + get_string_footprint(*p);
+  }
+  return size;
+}
+
+/**
+ * Returns an estimation of the memory used by the internal tables of the
+ * refresh monitor, and optionally, the number of entries in each one.
+ */
+gsize sdi_refresh_monitor_get_footprint(SdiRefreshMonitor *self,
+                                        guint *n_snaps, guint *n_changes,
+                                        guint *n_progress_entries) {
+  g_return_val_if_fail(SDI_IS_REFRESH_MONITOR(self), 0);
+
+  // each hash table node uses a hash, a key and a value
+  const gsize node_size = sizeof(guint) + 2 * sizeof(gpointer);
+  gsize size = 0;
+  GHashTableIter iter;
+  gpointer key, value;
+
+  g_hash_table_iter_init(&iter, self->snaps);
+  while (g_hash_table_iter_next(&iter, &key, &value)) {
+    size += node_size + get_string_footprint(key) +
+            sdi_snap_get_footprint(value);
+  }
+  g_hash_table_iter_init(&iter, self->changes);
+  while (g_hash_table_iter_next(&iter, &key, NULL)) {
+    size += node_size + 2 * get_string_footprint(key) + sizeof(TrackedChange);
+  }
+  g_hash_table_iter_init(&iter, self->refreshing_snap_list);
+  while (g_hash_table_iter_next(&iter, &key, &value)) {
+    SnapProgressTaskData *task_data = value;
+    size += node_size + get_string_footprint(key) +
+            sizeof(SnapProgressTaskData);
+    size += get_strv_footprint(task_data->desktop_files);
+    size += get_string_footprint(task_data->snap_name);
+    size += get_string_footprint(task_data->task_description);
+    size += get_string_footprint(task_data->change_id);
+  }
+
+  if (n_snaps != NULL) {
+    *n_snaps = g_hash_table_size(self->snaps);
+  }
+  if (n_changes != NULL) {
+    *n_changes = g_hash_table_size(self->changes);
+  }
+  if (n_progress_entries != NULL) {
+    *n_progress_entries = g_hash_table_size(self->refreshing_snap_list);
+  }
+  return size;
+}
+
+#ifdef DEBUG_TESTS
+void sdi_refresh_monitor_set_gc_limits(SdiRefreshMonitor *self,
+                                       gint64 snap_record_ttl,
+                                       guint max_snap_records,
+                                       gint64 progress_entry_ttl) {
+  self->snap_record_ttl = snap_record_ttl * G_USEC_PER_SEC;
+  self->max_snap_records = max_snap_records;
+  self->progress_entry_ttl = progress_entry_ttl * G_USEC_PER_SEC;
+}
+
+void sdi_refresh_monitor_collect_garbage(SdiRefreshMonitor *self) {
+  collect_garbage(self);
+}
+
+void sdi_refresh_monitor_reconcile_changes(SdiRefreshMonitor *self) {
+  request_changes_in_progress(self);
+}
+#endif
+
 static void sdi_refresh_monitor_dispose(GObject *object) {
   SdiRefreshMonitor *self = SDI_REFRESH_MONITOR(object);
 
+  g_cancellable_cancel(self->cancellable);
+  g_clear_object(&self->cancellable);
+  cancel_inhibit_check(self);
+  g_clear_object(&self->scheduler);
+  g_clear_handle_id(&self->gc_id, g_source_remove);
+  g_clear_handle_id(&self->reconcile_id, g_source_remove);
   g_clear_pointer(&self->snaps, g_hash_table_unref);
+  g_clear_object(&self->snap_store);
   g_clear_object(&self->client);
+  g_clear_object(&self->fanout);
+  g_clear_object(&self->worker);
   g_clear_pointer(&self->changes, g_hash_table_unref);
   g_clear_pointer(&self->refreshing_snap_list, g_hash_table_unref);
 
   G_OBJECT_CLASS(sdi_refresh_monitor_parent_class)->dispose(object);
 }
 
-static void remove_source(gpointer data) {
-  g_source_remove(GPOINTER_TO_INT(data));
-}
-
 void sdi_refresh_monitor_init(SdiRefreshMonitor *self) {
   self->snaps =
       g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_object_unref);
-  self->changes =
-      g_hash_table_new_full(g_str_hash, g_str_equal, g_free, remove_source);
+  self->snap_store = sdi_snap_store_new(SNAP_STORE_TTL);
+  self->changes = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                        (GDestroyNotify)free_tracked_change);
   /* the key in this table is the snap name; the value is a SnapProgressTaskData
    * structure.
    */
   self->refreshing_snap_list = g_hash_table_new_full(
       g_str_hash, g_str_equal, g_free, free_progress_task_data);
   self->client = sdi_snapd_client_factory_new_snapd_client();
+  self->cancellable = g_cancellable_new();
+
+  self->snap_record_ttl = SNAP_RECORD_TTL * G_USEC_PER_SEC;
+  self->max_snap_records = MAX_SNAP_RECORDS;
+  self->progress_entry_ttl = PROGRESS_ENTRY_TTL * G_USEC_PER_SEC;
+  self->gc_id = g_timeout_add_seconds(GC_PERIOD, (GSourceFunc)gc_cb, self);
+  self->reconcile_id = g_timeout_add_seconds(
+      RECONCILE_PERIOD, (GSourceFunc)reconcile_cb, self);
 }
 
 /**
@@ -605,6 +1235,75 @@ void sdi_refresh_monitor_ignore_snap(SdiRefreshMonitor *self,
   sdi_snap_set_ignored(snap, TRUE);
 }
 
+/**
+ * Makes the monitor request the changes to the fan-out service, through
+ * @fanout, instead of polling snapd. The startup snapshot and the
+ * reconciliation passes still go to snapd, because they are rare.
+ */
+void sdi_refresh_monitor_set_fanout_client(SdiRefreshMonitor *self,
+                                           SdiFanoutClient *fanout) {
+  g_return_if_fail(SDI_IS_REFRESH_MONITOR(self));
+
+  g_set_object(&self->fanout, fanout);
+}
+
+/**
+ * Makes the monitor poll the changes from the worker thread of @worker, so
+ * the requests and the parsing of the replies don't block the main loop.
+ */
+void sdi_refresh_monitor_set_snapd_worker(SdiRefreshMonitor *self,
+                                          SdiSnapdWorker *worker) {
+  g_return_if_fail(SDI_IS_REFRESH_MONITOR(self));
+
+  g_set_object(&self->worker, worker);
+}
+
+/**
+ * If @enabled, the monitor reads each change with #SdiChangeSummary, which
+ * keeps only the fields that it uses, instead of building a #SnapdChange
+ * with all its tasks. It isn't used with the fan-out service.
+ */
+void sdi_refresh_monitor_set_fast_change_parser(SdiRefreshMonitor *self,
+                                                gboolean enabled) {
+  g_return_if_fail(SDI_IS_REFRESH_MONITOR(self));
+
+  self->fast_change_parser = enabled;
+}
+
+/**
+ * Tells the monitor whether the user can see the session. While it is
+ * hidden, the changes are polled at a slow rate and no dialogs or progress
+ * updates are emitted, except the ends of the refreshes. When it becomes
+ * visible again, a single reconciliation pass requests all the changes to
+ * bring the UI up to date.
+ */
+void sdi_refresh_monitor_set_session_visible(SdiRefreshMonitor *self,
+                                             gboolean visible) {
+  g_return_if_fail(SDI_IS_REFRESH_MONITOR(self));
+
+  if (self->session_hidden == !visible) {
+    return;
+  }
+  self->session_hidden = !visible;
+  if (visible) {
+    self->catch_up = TRUE;
+    request_changes_in_progress(self);
+  }
+}
+
+/**
+ * Makes the monitor defer the check of the inhibited snaps at startup
+ * through @scheduler, so the daemons of the users that log in together
+ * don't request them at the same time.
+ */
+void sdi_refresh_monitor_set_startup_scheduler(SdiRefreshMonitor *self,
+                                               SdiStartupScheduler *scheduler) {
+  g_return_if_fail(SDI_IS_REFRESH_MONITOR(self));
+
+  cancel_inhibit_check(self);
+  g_set_object(&self->scheduler, scheduler);
+}
+
 void sdi_refresh_monitor_class_init(SdiRefreshMonitorClass *klass) {
   GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
 
@@ -17,7 +17,10 @@
 
 #pragma once
 
+#include "sdi-fanout-client.h"
 #include "sdi-snap.h"
+#include "sdi-snapd-worker.h"
+#include "sdi-startup-scheduler.h"
 #include <gio/gio.h>
 
 G_BEGIN_DECLS
@@ -41,4 +44,36 @@ void sdi_refresh_monitor_ignore_snap(SdiRefreshMonitor *self,
 void sdi_refresh_monitor_notice(SdiRefreshMonitor *monitor, SnapdNotice *notice,
                                 gboolean first_run);
 
+const gchar *const *sdi_refresh_monitor_get_notice_types(void);
+
+void sdi_refresh_monitor_set_fanout_client(SdiRefreshMonitor *self,
+                                           SdiFanoutClient *fanout);
+
+void sdi_refresh_monitor_set_snapd_worker(SdiRefreshMonitor *self,
+                                          SdiSnapdWorker *worker);
+
+void sdi_refresh_monitor_set_fast_change_parser(SdiRefreshMonitor *self,
+                                                gboolean enabled);
+
+void sdi_refresh_monitor_set_startup_scheduler(SdiRefreshMonitor *self,
+                                               SdiStartupScheduler *scheduler);
+
+void sdi_refresh_monitor_set_session_visible(SdiRefreshMonitor *self,
+                                             gboolean visible);
+
+gsize sdi_refresh_monitor_get_footprint(SdiRefreshMonitor *self,
+                                        guint *n_snaps, guint *n_changes,
+                                        guint *n_progress_entries);
+
+#ifdef DEBUG_TESTS
+void sdi_refresh_monitor_set_gc_limits(SdiRefreshMonitor *self,
+                                       gint64 snap_record_ttl,
+                                       guint max_snap_records,
+                                       gint64 progress_entry_ttl);
+
+void sdi_refresh_monitor_collect_garbage(SdiRefreshMonitor *self);
+
+void sdi_refresh_monitor_reconcile_changes(SdiRefreshMonitor *self);
+#endif
+
 G_END_DECLS
@@ -0,0 +1,237 @@
+/*
+ * Copyright (C) 2024 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "sdi-session-monitor.h"
+
+#include "org.freedesktop.login1.Session.h"
+#include "org.freedesktop.login1.h"
+
+/**
+ * This class tracks whether the user can see the desktop. The session is
+ * considered visible while logind reports it as active (not switched away
+ * with fast user switching), not locked and not idle, and the screensaver
+ * isn't active. Each time that changes, the `visibility-changed` signal is
+ * emitted, so the daemon can stop updating the UI and slow down the polling
+ * of snapd while nobody is looking.
+ *
+ * If logind isn't available, the session is always considered visible.
+ */
+
+struct _SdiSessionMonitor {
+  GObject parent_instance;
+
+  GDBusConnection *session_bus;
+  OrgFreedesktopLogin1Session *session;
+  /* Cancelled on dispose. Requests don't keep a reference to the monitor,
+   * so callbacks of cancelled requests must return without touching it. */
+  GCancellable *cancellable;
+  guint screensaver_ids[2];
+  gboolean screensaver_active;
+  gboolean visible;
+};
+
+G_DEFINE_TYPE(SdiSessionMonitor, sdi_session_monitor, G_TYPE_OBJECT)
+
+// the interfaces that emit `ActiveChanged` when the screensaver starts or ends
+static const gchar *screensaver_interfaces[] = {"org.freedesktop.ScreenSaver",
+                                                "org.gnome.ScreenSaver"};
+
+/* a property that logind doesn't report, or that was cleared because logind
+ * left the bus, takes @default_value, so it doesn't hide the session.
+ */
+static gboolean get_session_flag(SdiSessionMonitor *self, const gchar *name,
+                                 gboolean default_value) {
+  g_autoptr(GVariant) value =
+      g_dbus_proxy_get_cached_property(G_DBUS_PROXY(self->session), name);
+  if ((value == NULL) || !g_variant_is_of_type(value, G_VARIANT_TYPE_BOOLEAN)) {
+    return default_value;
+  }
+  return g_variant_get_boolean(value);
+}
+
+static void update_visibility(SdiSessionMonitor *self) {
+  gboolean visible = !self->screensaver_active;
+  if (self->session != NULL) {
+    visible = visible && get_session_flag(self, "Active", TRUE) &&
+              !get_session_flag(self, "LockedHint", FALSE) &&
+              !get_session_flag(self, "IdleHint", FALSE);
+  }
+
+  if (visible == self->visible) {
+    return;
+  }
+  self->visible = visible;
+  g_debug("The session is now %s", visible ? "visible" : "hidden");
+  g_signal_emit_by_name(self, "visibility-changed", visible);
+}
+
+static void screensaver_changed_cb(GDBusConnection *connection,
+                                   const gchar *sender_name,
+                                   const gchar *object_path,
+                                   const gchar *interface_name,
+                                   const gchar *signal_name,
+                                   GVariant *parameters, gpointer p) {
+  SdiSessionMonitor *self = p;
+
+  if (!g_variant_is_of_type(parameters, G_VARIANT_TYPE("(b)"))) {
+    return;
+  }
+  g_variant_get(parameters, "(b)", &self->screensaver_active);
+  update_visibility(self);
+}
+
+static void session_ready_cb(GObject *source, GAsyncResult *res, gpointer p) {
+  g_autoptr(GError) error = NULL;
+  g_autoptr(OrgFreedesktopLogin1Session) session =
+      org_freedesktop_login1_session_proxy_new_for_bus_finish(res, &error);
+
+  if (session == NULL) {
+    if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+      g_message("Failed to connect to the login session: %s", error->message);
+    }
+    return;
+  }
+  SdiSessionMonitor *self = p;
+  self->session = g_steal_pointer(&session);
+  /* the generated proxy notifies each property that changes in a
+   * `PropertiesChanged` signal, and the owner when logind restarts.
+   */
+  g_signal_connect_object(self->session, "notify::active",
+                          (GCallback)update_visibility, self,
+                          G_CONNECT_SWAPPED);
+  g_signal_connect_object(self->session, "notify::locked-hint",
+                          (GCallback)update_visibility, self,
+                          G_CONNECT_SWAPPED);
+  g_signal_connect_object(self->session, "notify::idle-hint",
+                          (GCallback)update_visibility, self,
+                          G_CONNECT_SWAPPED);
+  g_signal_connect_object(self->session, "notify::g-name-owner",
+                          (GCallback)update_visibility, self,
+                          G_CONNECT_SWAPPED);
+  update_visibility(self);
+}
+
+static void get_session_cb(GObject *source, GAsyncResult *res, gpointer p) {
+  g_autoptr(GError) error = NULL;
+  g_autofree gchar *object_path = NULL;
+
+  if (!login1_manager_call_get_session_finish(LOGIN1_MANAGER(source),
+                                              &object_path, res, &error)) {
+    if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+      g_message("Failed to get the login session: %s", error->message);
+    }
+    return;
+  }
+  SdiSessionMonitor *self = p;
+  /* "auto" is only an alias, and the properties are only notified in the
+   * real path of the session.
+   */
+  org_freedesktop_login1_session_proxy_new_for_bus(
+      G_BUS_TYPE_SYSTEM, G_DBUS_PROXY_FLAGS_NONE, "org.freedesktop.login1",
+      object_path, self->cancellable, session_ready_cb, self);
+}
+
+static void manager_ready_cb(GObject *source, GAsyncResult *res, gpointer p) {
+  g_autoptr(GError) error = NULL;
+  g_autoptr(Login1Manager) manager =
+      login1_manager_proxy_new_for_bus_finish(res, &error);
+
+  if (manager == NULL) {
+    if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+      g_message("Failed to connect to logind: %s", error->message);
+    }
+    return;
+  }
+  SdiSessionMonitor *self = p;
+  // "auto" is the session of the caller, or the display session of its user
+  login1_manager_call_get_session(manager, "auto", self->cancellable,
+                                  get_session_cb, self);
+}
+
+/**
+ * Starts tracking the session. Until logind replies, the session is
+ * considered visible.
+ */
+void sdi_session_monitor_start(SdiSessionMonitor *self) {
+  g_return_if_fail(SDI_IS_SESSION_MONITOR(self));
+
+  if (self->session_bus != NULL) {
+    for (guint i = 0; i < G_N_ELEMENTS(screensaver_interfaces); i++) {
+      if (self->screensaver_ids[i] != 0) {
+        continue;
+      }
+      self->screensaver_ids[i] = g_dbus_connection_signal_subscribe(
+          self->session_bus, NULL, screensaver_interfaces[i], "ActiveChanged",
+          NULL, NULL, G_DBUS_SIGNAL_FLAGS_NONE, screensaver_changed_cb, self,
+          NULL);
+    }
+  }
+  if (self->session == NULL) {
+    login1_manager_proxy_new_for_bus(
+        G_BUS_TYPE_SYSTEM, G_DBUS_PROXY_FLAGS_NONE, "org.freedesktop.login1",
+        "/org/freedesktop/login1", self->cancellable, manager_ready_cb, self);
+  }
+}
+
+gboolean sdi_session_monitor_get_visible(SdiSessionMonitor *self) {
+  g_return_val_if_fail(SDI_IS_SESSION_MONITOR(self), TRUE);
+
+  return self->visible;
+}
+
+static void sdi_session_monitor_dispose(GObject *object) {
+  SdiSessionMonitor *self = SDI_SESSION_MONITOR(object);
+
+  g_cancellable_cancel(self->cancellable);
+  g_clear_object(&self->cancellable);
+  for (guint i = 0; i < G_N_ELEMENTS(self->screensaver_ids); i++) {
+    if (self->screensaver_ids[i] != 0) {
+      g_dbus_connection_signal_unsubscribe(self->session_bus,
+                                           self->screensaver_ids[i]);
+      self->screensaver_ids[i] = 0;
+    }
+  }
+  g_clear_object(&self->session);
+  g_clear_object(&self->session_bus);
+
+  G_OBJECT_CLASS(sdi_session_monitor_parent_class)->dispose(object);
+}
+
+static void sdi_session_monitor_init(SdiSessionMonitor *self) {
+  self->cancellable = g_cancellable_new();
+  self->visible = TRUE;
+}
+
+static void sdi_session_monitor_class_init(SdiSessionMonitorClass *klass) {
+  G_OBJECT_CLASS(klass)->dispose = sdi_session_monitor_dispose;
+
+  g_signal_new("visibility-changed", G_TYPE_FROM_CLASS(klass),
+               G_SIGNAL_RUN_LAST, 0, NULL, NULL, NULL, G_TYPE_NONE, 1,
+               G_TYPE_BOOLEAN);
+}
+
+/**
+ * Creates a new session monitor. The screensaver is watched in
+ * @session_bus; if it is %NULL, only logind is used.
+ */
+SdiSessionMonitor *sdi_session_monitor_new(GDBusConnection *session_bus) {
+  SdiSessionMonitor *self = g_object_new(SDI_TYPE_SESSION_MONITOR, NULL);
+  if (session_bus != NULL) {
+    self->session_bus = g_object_ref(session_bus);
+  }
+  return self;
+}
@@ -0,0 +1,167 @@
+/*
+ * Copyright (C) 2024 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "sdi-snap-store.h"
+
+/**
+ * This class keeps the last #SnapdSnap received from snapd for each snap,
+ * with its revision, apps, desktop files and proceed time, so the refresh
+ * monitor can read them locally instead of asking snapd again each time
+ * that it shows a dialog or a notification.
+ *
+ * It is fed by every reply with snaps, and it is updated incrementally:
+ * the entry of a snap is invalidated when a change that modifies it
+ * finishes, because its revision and apps may have changed. Entries also
+ * expire after a TTL, because snaps can be modified by changes that the
+ * monitor doesn't follow, like installs and removals.
+ */
+
+typedef struct {
+  SnapdSnap *snap;
+  gint64 timestamp;
+} StoreEntry;
+
+struct _SdiSnapStore {
+  GObject parent_instance;
+
+  // TTL in microseconds
+  gint64 ttl;
+  // snap name -> StoreEntry
+  GHashTable *entries;
+};
+
+G_DEFINE_TYPE(SdiSnapStore, sdi_snap_store, G_TYPE_OBJECT)
+
+static void free_store_entry(StoreEntry *entry) {
+  g_object_unref(entry->snap);
+  g_free(entry);
+}
+
+static gboolean is_expired(SdiSnapStore *self, StoreEntry *entry,
+                           gint64 now) {
+  return now - entry->timestamp >= self->ttl;
+}
+
+/**
+ * Returns a new reference to the stored snap called @name, or NULL if it
+ * isn't stored or it has expired.
+ */
+SnapdSnap *sdi_snap_store_lookup(SdiSnapStore *self, const gchar *name) {
+  g_return_val_if_fail(SDI_IS_SNAP_STORE(self), NULL);
+
+  if (name == NULL) {
+    return NULL;
+  }
+  StoreEntry *entry = g_hash_table_lookup(self->entries, name);
+  if (entry == NULL) {
+    return NULL;
+  }
+  if (is_expired(self, entry, g_get_monotonic_time())) {
+    g_hash_table_remove(self->entries, name);
+    return NULL;
+  }
+  return g_object_ref(entry->snap);
+}
+
+void sdi_snap_store_update(SdiSnapStore *self, SnapdSnap *snap) {
+  g_return_if_fail(SDI_IS_SNAP_STORE(self));
+  g_return_if_fail(SNAPD_IS_SNAP(snap));
+
+  const gchar *name = snapd_snap_get_name(snap);
+  if (name == NULL) {
+    return;
+  }
+  StoreEntry *entry = g_malloc0(sizeof(StoreEntry));
+  entry->snap = g_object_ref(snap);
+  entry->timestamp = g_get_monotonic_time();
+  g_hash_table_insert(self->entries, g_strdup(name), entry);
+}
+
+/**
+ * Stores all the snaps in an array returned by
+ * snapd_client_get_snaps_finish().
+ */
+void sdi_snap_store_update_all(SdiSnapStore *self, GPtrArray *snaps) {
+  g_return_if_fail(SDI_IS_SNAP_STORE(self));
+
+  if (snaps == NULL) {
+    return;
+  }
+  for (guint i = 0; i < snaps->len; i++) {
+    sdi_snap_store_update(self, snaps->pdata[i]);
+  }
+}
+
+void sdi_snap_store_invalidate(SdiSnapStore *self, const gchar *name) {
+  g_return_if_fail(SDI_IS_SNAP_STORE(self));
+
+  if (name != NULL) {
+    g_hash_table_remove(self->entries, name);
+  }
+}
+
+/**
+ * Removes the expired entries. Returns the number of removed entries.
+ */
+guint sdi_snap_store_remove_expired(SdiSnapStore *self) {
+  g_return_val_if_fail(SDI_IS_SNAP_STORE(self), 0);
+
+  gint64 now = g_get_monotonic_time();
+  guint removed = 0;
+  GHashTableIter iter;
+  StoreEntry *entry;
+  g_hash_table_iter_init(&iter, self->entries);
+  while (g_hash_table_iter_next(&iter, NULL, (gpointer *)&entry)) {
+    if (is_expired(self, entry, now)) {
+      g_hash_table_iter_remove(&iter);
+      removed++;
+    }
+  }
+  return removed;
+}
+
+guint sdi_snap_store_get_size(SdiSnapStore *self) {
+  g_return_val_if_fail(SDI_IS_SNAP_STORE(self), 0);
+
+  return g_hash_table_size(self->entries);
+}
+
+static void sdi_snap_store_dispose(GObject *object) {
+  SdiSnapStore *self = SDI_SNAP_STORE(object);
+
+  g_clear_pointer(&self->entries, g_hash_table_unref);
+
+  G_OBJECT_CLASS(sdi_snap_store_parent_class)->dispose(object);
+}
+
+void sdi_snap_store_init(SdiSnapStore *self) {
+  self->entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free,
+                                        (GDestroyNotify)free_store_entry);
+}
+
+void sdi_snap_store_class_init(SdiSnapStoreClass *klass) {
+  G_OBJECT_CLASS(klass)->dispose = sdi_snap_store_dispose;
+}
+
+/**
+ * Creates a new store whose entries expire after @ttl seconds.
+ */
+SdiSnapStore *sdi_snap_store_new(guint ttl) {
+  SdiSnapStore *self = g_object_new(SDI_TYPE_SNAP_STORE, NULL);
+  self->ttl = (gint64)ttl * G_USEC_PER_SEC;
+  return self;
+}
@@ -0,0 +1,43 @@
+/*
+ * Copyright (C) 2024 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <glib-object.h>
+#include <snapd-glib/snapd-glib.h>
+
+G_BEGIN_DECLS
+
+#define SDI_TYPE_SNAP_STORE sdi_snap_store_get_type()
+
+G_DECLARE_FINAL_TYPE(SdiSnapStore, sdi_snap_store, SDI, SNAP_STORE, GObject)
+
+SdiSnapStore *sdi_snap_store_new(guint ttl);
+
+SnapdSnap *sdi_snap_store_lookup(SdiSnapStore *self, const gchar *name);
+
+void sdi_snap_store_update(SdiSnapStore *self, SnapdSnap *snap);
+
+void sdi_snap_store_update_all(SdiSnapStore *self, GPtrArray *snaps);
+
+void sdi_snap_store_invalidate(SdiSnapStore *self, const gchar *name);
+
+guint sdi_snap_store_remove_expired(SdiSnapStore *self);
+
+guint sdi_snap_store_get_size(SdiSnapStore *self);
+
+G_END_DECLS
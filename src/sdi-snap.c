@@ -16,6 +16,7 @@
  */
 
 #include "sdi-snap.h"
+#include <string.h>
 
 enum { PROP_NAME = 1, PROP_LAST };
 
@@ -36,6 +37,10 @@ struct _SdiSnap {
 
   // Stores wether a dialog has already been requested or not
   gboolean created_dialog;
+
+  // Monotonic time of the last time this snap was looked up, used to evict
+  // the records that haven't been used for a long time
+  gint64 last_used;
 };
 
 G_DEFINE_TYPE(SdiSnap, sdi_snap, G_TYPE_OBJECT)
@@ -75,6 +80,21 @@ void sdi_snap_set_ignored(SdiSnap *self, gboolean ignore) {
   self->ignored = ignore;
 }
 
+void sdi_snap_touch(SdiSnap *self) {
+  g_return_if_fail(SDI_IS_SNAP(self));
+  self->last_used = g_get_monotonic_time();
+}
+
+gint64 sdi_snap_get_last_used(SdiSnap *self) {
+  g_return_val_if_fail(SDI_IS_SNAP(self), 0);
+  return self->last_used;
+}
+
+gsize sdi_snap_get_footprint(SdiSnap *self) {
+  g_return_val_if_fail(SDI_IS_SNAP(self), 0);
+  return sizeof(SdiSnap) + ((self->name == NULL) ? 0 : strlen(self->name) + 1);
+}
+
 static void sdi_snap_set_property(GObject *object, guint prop_id,
                                   const GValue *value, GParamSpec *pspec) {
   SdiSnap *self = SDI_SNAP(object);
@@ -112,8 +132,7 @@ static void sdi_snap_dispose(GObject *object) {
   G_OBJECT_CLASS(sdi_snap_parent_class)->dispose(object);
 }
 
-// This method is required by GObject, but there's nothing we have to do in it.
-void sdi_snap_init(SdiSnap *self) {}
+void sdi_snap_init(SdiSnap *self) { self->last_used = g_get_monotonic_time(); }
 
 void sdi_snap_class_init(SdiSnapClass *klass) {
   GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
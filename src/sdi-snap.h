@@ -42,4 +42,10 @@ void sdi_snap_set_ignored(SdiSnap *self, gboolean ignore);
 
 const gchar *sdi_snap_get_name(SdiSnap *self);
 
+void sdi_snap_touch(SdiSnap *self);
+
+gint64 sdi_snap_get_last_used(SdiSnap *self);
+
+gsize sdi_snap_get_footprint(SdiSnap *self);
+
 G_END_DECLS
@@ -34,6 +34,20 @@ void sdi_snapd_client_factory_set_custom_path(const gchar *path) {
   sdi_snapd_socket_path = g_strdup(path);
 }
 
+/**
+ * Returns the path of the snapd socket, which is the custom path if it has
+ * been set, or the same default path that #snapd_client uses.
+ */
+const gchar *sdi_snapd_client_factory_get_socket_path(void) {
+  if (sdi_snapd_socket_path != NULL) {
+    return sdi_snapd_socket_path;
+  }
+  if (g_getenv("SNAP") != NULL) {
+    return "/run/snapd-snap.socket";
+  }
+  return "/run/snapd.socket";
+}
+
 /**
  * Creates a snapd_client object using the right socket path.
  */
@@ -23,6 +23,8 @@ G_BEGIN_DECLS
 
 void sdi_snapd_client_factory_set_custom_path(const gchar *path);
 
+const gchar *sdi_snapd_client_factory_get_socket_path(void);
+
 SnapdClient *sdi_snapd_client_factory_new_snapd_client(void);
 
 G_END_DECLS
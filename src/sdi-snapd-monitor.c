@@ -16,81 +16,190 @@
  */
 
 #include "sdi-snapd-monitor.h"
-#include "sdi-helpers.h"
 #include "sdi-snapd-client-factory.h"
+#include "sdi-snapd-variant.h"
 #include <unistd.h>
 
 /**
  * This class creates a super-snapd-monitor. It is kept running no matter
  * if the socket to snapd is closed (for example, if snapd is updated)
  *
- * Internally it creates a #snapd_notices_monitor and wait for events.
- * Every received event is re-sent as-is in the `notice_cb` callback, thus
- * outside there is no difference between this class and the original.
+ * Internally it long-polls the snapd notices API and waits for events.
+ * Every received event is sent in the `notice-event` signal, with the same
+ * parameters than the #snapd_notices_monitor one, thus outside there is no
+ * difference between this class and the original.
  *
- * The difference is that, if the connection between the #snapd_notices_monitor
- * and snapd is severed for whatever reason, #sdi_snapd_monitor will create
- * a new one automagically, and continue to send new events.
+ * The differences are that, if the connection with snapd is severed for
+ * whatever reason, #sdi_snapd_monitor will reconnect automagically and
+ * continue to send new events; and that the consumers can declare which
+ * notice types they need with `sdi_snapd_monitor_add_notice_types()`, so
+ * snapd filters the notices server-side and the irrelevant ones never reach
+ * this process.
  *
  * It also uses `sdi_snapd_client_factory_new_snapd_client()` to obtain a
  * connection to snapd, so it will take into account custom paths.
+ *
+ * When it is created with `sdi_snapd_monitor_new_with_fanout()`, it doesn't
+ * talk with snapd; instead, it relays the notices published by the fan-out
+ * service that are of the declared types. And when it is created with
+ * `sdi_snapd_monitor_new_with_worker()`, it relays the notices received by
+ * the monitor that runs in the worker thread.
  */
 
-static void error_cb(GObject *object, GError *error, SdiSnapdMonitor *self);
+// Maximum time that snapd waits for new notices before replying.
+#define NOTICES_TIMEOUT (60 * G_USEC_PER_SEC)
 
 struct _SdiSnapdMonitor {
   GObject parent_instance;
 
-  SnapdNoticesMonitor *snapd_monitor;
-  guint signal_notice_id;
-  guint signal_error_id;
+  SnapdClient *client;
+  // If not NULL, the notices are received from the fan-out service.
+  SdiFanoutClient *fanout;
+  // If not NULL, the notices are received from the worker thread.
+  SdiSnapdWorker *worker;
+  // The notice type names requested by the consumers.
+  GPtrArray *notice_types;
+  // The newest notice received, to request only the ones after it.
+  SnapdNotice *last_notice;
+  gboolean first_run;
+  gboolean started;
+  /* Timer to reconnect to snapd. It is attached to the thread-default main
+   * context, like the requests, so the monitor can run in a worker thread.
+   */
+  GSource *restart_source;
+  /* Cancellable of the running notices request. It is cancelled on dispose
+   * and when the notice types change. The request doesn't keep a reference
+   * to the monitor, so its callback must return if it has been cancelled.
+   */
+  GCancellable *cancellable;
 };
 
 G_DEFINE_TYPE(SdiSnapdMonitor, sdi_snapd_monitor, G_TYPE_OBJECT)
 
-static void notice_cb(GObject *object, SnapdNotice *notice, gboolean first_run,
-                      SdiSnapdMonitor *self) {
-  g_signal_emit_by_name(self, "notice-event", notice, first_run);
-}
+static void launch_notices_request(SdiSnapdMonitor *self);
 
-static void configure_snapd_monitor(SdiSnapdMonitor *self) {
-  g_autoptr(SnapdClient) client = sdi_snapd_client_factory_new_snapd_client();
-  self->snapd_monitor = snapd_notices_monitor_new_with_client(client);
-  self->signal_notice_id = g_signal_connect(self->snapd_monitor, "notice-event",
-                                            (GCallback)notice_cb, self);
-  self->signal_error_id = g_signal_connect(self->snapd_monitor, "error-event",
-                                           (GCallback)error_cb, self);
+static void clear_restart_source(SdiSnapdMonitor *self) {
+  if (self->restart_source != NULL) {
+    g_source_destroy(self->restart_source);
+    g_clear_pointer(&self->restart_source, g_source_unref);
+  }
 }
 
-static void launch_snapd_monitor_after_error(SdiSnapdMonitor *self) {
-  configure_snapd_monitor(self);
-  snapd_notices_monitor_start(self->snapd_monitor, NULL);
+static gboolean restart_snapd_monitor(SdiSnapdMonitor *self) {
+  g_clear_pointer(&self->restart_source, g_source_unref);
+  self->client = sdi_snapd_client_factory_new_snapd_client();
+  launch_notices_request(self);
+  return G_SOURCE_REMOVE;
 }
 
-static void error_cb(GObject *object, GError *error, SdiSnapdMonitor *self) {
+static void manage_error(SdiSnapdMonitor *self, GError *error) {
   g_debug("Error in sdi-snapd-monitor %d; %s\n", error->code, error->message);
-  g_signal_handler_disconnect(self->snapd_monitor, self->signal_notice_id);
-  g_signal_handler_disconnect(self->snapd_monitor, self->signal_error_id);
-  g_clear_object(&self->snapd_monitor);
+  g_clear_object(&self->client);
+  /* a new snapd instance has its own notices, so start again as if this
+   * was a new monitor.
+   */
+  g_clear_object(&self->last_notice);
+  self->first_run = TRUE;
   /* wait one second to ensure that, in case that the error is because snapd is
    * being replaced, the new instance has created the new socket, and thus avoid
    * hundreds of error messages until it appears.
    */
-  g_timeout_add_once(1000, (GSourceOnceFunc)launch_snapd_monitor_after_error,
-                     self);
+  clear_restart_source(self);
+  self->restart_source = g_timeout_source_new(1000);
+  g_source_set_callback(self->restart_source,
+                        (GSourceFunc)restart_snapd_monitor, self, NULL);
+  g_source_attach(self->restart_source, g_main_context_get_thread_default());
+}
+
+static void get_notices_cb(GObject *object, GAsyncResult *result,
+                           gpointer user_data) {
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GPtrArray) notices =
+      snapd_client_get_notices_finish(SNAPD_CLIENT(object), result, &error);
+  if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+    return;
+  }
+  SdiSnapdMonitor *self = user_data;
+  if (notices == NULL) {
+    manage_error(self, error);
+    return;
+  }
+  for (guint i = 0; i < notices->len; i++) {
+    g_signal_emit_by_name(self, "notice-event", notices->pdata[i],
+                          self->first_run);
+  }
+  // snapd returns the notices sorted by their last occurrence
+  if (notices->len != 0) {
+    g_clear_object(&self->last_notice);
+    self->last_notice = g_object_ref(notices->pdata[notices->len - 1]);
+  }
+  self->first_run = FALSE;
+  launch_notices_request(self);
+}
+
+/**
+ * Returns the comma-separated list of notice types to pass to snapd, or
+ * NULL to receive all of them if no consumer has declared its types.
+ */
+static gchar *get_notice_types_filter(SdiSnapdMonitor *self) {
+  if (self->notice_types->len == 0) {
+    return NULL;
+  }
+  g_autoptr(GString) filter = g_string_new(NULL);
+  for (guint i = 0; i < self->notice_types->len; i++) {
+    if (i != 0) {
+      g_string_append_c(filter, ',');
+    }
+    g_string_append(filter, self->notice_types->pdata[i]);
+  }
+  return g_string_free(g_steal_pointer(&filter), FALSE);
+}
+
+static void launch_notices_request(SdiSnapdMonitor *self) {
+  g_clear_object(&self->cancellable);
+  self->cancellable = g_cancellable_new();
+  if (self->last_notice != NULL) {
+    snapd_client_notices_set_after_notice(self->client, self->last_notice);
+  }
+  g_autofree gchar *types = get_notice_types_filter(self);
+  snapd_client_get_notices_with_filters_async(
+      self->client, NULL, NULL, types, NULL, NULL, NOTICES_TIMEOUT,
+      self->cancellable, get_notices_cb, self);
+}
+
+static void relay_notice_cb(SdiSnapdMonitor *self, SnapdNotice *notice,
+                            gboolean first_run) {
+  // the source can send the notice types of all the consumers
+  const gchar *type = sdi_snapd_variant_get_notice_type_name(
+      snapd_notice_get_notice_type(notice));
+  if ((self->notice_types->len != 0) &&
+      ((type == NULL) ||
+       !g_ptr_array_find_with_equal_func(self->notice_types, type,
+                                         g_str_equal, NULL))) {
+    return;
+  }
+  g_signal_emit_by_name(self, "notice-event", notice, first_run);
 }
 
 static void sdi_snapd_monitor_dispose(GObject *object) {
   SdiSnapdMonitor *self = SDI_SNAPD_MONITOR(object);
 
-  snapd_notices_monitor_stop(self->snapd_monitor, NULL);
-  g_clear_object(&self->snapd_monitor);
+  g_cancellable_cancel(self->cancellable);
+  g_clear_object(&self->cancellable);
+  clear_restart_source(self);
+  g_clear_object(&self->client);
+  g_clear_object(&self->fanout);
+  g_clear_object(&self->worker);
+  g_clear_object(&self->last_notice);
+  g_clear_pointer(&self->notice_types, g_ptr_array_unref);
 
   G_OBJECT_CLASS(sdi_snapd_monitor_parent_class)->dispose(object);
 }
 
 static void sdi_snapd_monitor_init(SdiSnapdMonitor *self) {
-  configure_snapd_monitor(self);
+  self->client = sdi_snapd_client_factory_new_snapd_client();
+  self->notice_types = g_ptr_array_new_with_free_func(g_free);
+  self->first_run = TRUE;
 }
 
 static void sdi_snapd_monitor_class_init(SdiSnapdMonitorClass *klass) {
@@ -107,9 +216,86 @@ SdiSnapdMonitor *sdi_snapd_monitor_new() {
   return g_object_new(SDI_TYPE_SNAPD_MONITOR, NULL);
 }
 
+/**
+ * Creates a monitor that receives the notices from the fan-out service,
+ * through @fanout, instead of requesting them to snapd.
+ */
+SdiSnapdMonitor *sdi_snapd_monitor_new_with_fanout(SdiFanoutClient *fanout) {
+  g_return_val_if_fail(SDI_IS_FANOUT_CLIENT(fanout), NULL);
+
+  SdiSnapdMonitor *self = g_object_new(SDI_TYPE_SNAPD_MONITOR, NULL);
+  g_clear_object(&self->client);
+  self->fanout = g_object_ref(fanout);
+  return self;
+}
+
+/**
+ * Creates a monitor that receives the notices from the worker thread of
+ * @worker, which does the requests to snapd.
+ */
+SdiSnapdMonitor *sdi_snapd_monitor_new_with_worker(SdiSnapdWorker *worker) {
+  g_return_val_if_fail(SDI_IS_SNAPD_WORKER(worker), NULL);
+
+  SdiSnapdMonitor *self = g_object_new(SDI_TYPE_SNAPD_MONITOR, NULL);
+  g_clear_object(&self->client);
+  self->worker = g_object_ref(worker);
+  return self;
+}
+
+/**
+ * Adds the notice types in the NULL-terminated @types list (like
+ * "change-update") to the ones requested to snapd. Every consumer of the
+ * "notice-event" signal must declare the types that it needs; while none
+ * is declared, all the notices are received.
+ *
+ * It can be called after the monitor has been started; in that case, the
+ * running request is replaced with a new one that includes the new types.
+ */
+void sdi_snapd_monitor_add_notice_types(SdiSnapdMonitor *self,
+                                        const gchar *const *types) {
+  g_return_if_fail(SDI_IS_SNAPD_MONITOR(self));
+
+  if (self->worker != NULL) {
+    sdi_snapd_worker_add_notice_types(self->worker, types);
+  }
+  gboolean changed = FALSE;
+  for (; *types != NULL; types++) {
+    if (g_ptr_array_find_with_equal_func(self->notice_types, *types,
+                                         g_str_equal, NULL)) {
+      continue;
+    }
+    g_ptr_array_add(self->notice_types, g_strdup(*types));
+    changed = TRUE;
+  }
+  /* if it is waiting to reconnect, the new request will include the types;
+   * and the fan-out service and the worker do their own requests.
+   */
+  if (changed && self->started && (self->restart_source == NULL) &&
+      (self->client != NULL)) {
+    g_cancellable_cancel(self->cancellable);
+    launch_notices_request(self);
+  }
+}
+
 bool sdi_snapd_monitor_start(SdiSnapdMonitor *self) {
   g_return_val_if_fail(SDI_IS_SNAPD_MONITOR(self), false);
 
-  snapd_notices_monitor_start(self->snapd_monitor, NULL);
+  if (self->started) {
+    return true;
+  }
+  self->started = TRUE;
+  if (self->fanout != NULL) {
+    g_signal_connect_object(self->fanout, "notice-event",
+                            (GCallback)relay_notice_cb, self,
+                            G_CONNECT_SWAPPED);
+    sdi_fanout_client_start(self->fanout);
+  } else if (self->worker != NULL) {
+    g_signal_connect_object(self->worker, "notice-event",
+                            (GCallback)relay_notice_cb, self,
+                            G_CONNECT_SWAPPED);
+    sdi_snapd_worker_start(self->worker);
+  } else {
+    launch_notices_request(self);
+  }
   return true;
 }
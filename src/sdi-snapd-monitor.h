@@ -17,6 +17,8 @@
 
 #pragma once
 
+#include "sdi-fanout-client.h"
+#include "sdi-snapd-worker.h"
 #include <snapd-glib/snapd-glib.h>
 #include <stdbool.h>
 
@@ -29,6 +31,13 @@ G_DECLARE_FINAL_TYPE(SdiSnapdMonitor, sdi_snapd_monitor, SDI, SNAPD_MONITOR,
 
 SdiSnapdMonitor *sdi_snapd_monitor_new();
 
+SdiSnapdMonitor *sdi_snapd_monitor_new_with_fanout(SdiFanoutClient *fanout);
+
+SdiSnapdMonitor *sdi_snapd_monitor_new_with_worker(SdiSnapdWorker *worker);
+
+void sdi_snapd_monitor_add_notice_types(SdiSnapdMonitor *self,
+                                        const gchar *const *types);
+
 bool sdi_snapd_monitor_start(SdiSnapdMonitor *self);
 
 G_END_DECLS
@@ -0,0 +1,214 @@
+/*
+ * Copyright (C) 2024 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "sdi-snapd-variant.h"
+
+/**
+ * These functions convert the snapd-glib objects that the monitors need to
+ * and from GVariants, so the fan-out service can send them to the daemons
+ * of every user. Only the fields read by #SdiRefreshMonitor and
+ * #SdiThemeMonitor are kept; the rebuilt objects return NULL or zero for
+ * the other ones.
+ */
+
+#define TASKS_VARIANT_TYPE "a(ssssxxmas)"
+
+static const struct {
+  SnapdNoticeType type;
+  const gchar *name;
+} notice_type_names[] = {
+    {SNAPD_NOTICE_TYPE_CHANGE_UPDATE, "change-update"},
+    {SNAPD_NOTICE_TYPE_REFRESH_INHIBIT, "refresh-inhibit"},
+    {SNAPD_NOTICE_TYPE_SNAP_RUN_INHIBIT, "snap-run-inhibit"},
+};
+
+// D-Bus strings can't be NULL, so an empty string is sent instead
+static const gchar *non_null(const gchar *value) {
+  return value == NULL ? "" : value;
+}
+
+static GVariant *strv_to_variant(GStrv strv) {
+  if (strv == NULL) {
+    return g_variant_new_strv(NULL, 0);
+  }
+  return g_variant_new_strv((const gchar *const *)strv, -1);
+}
+
+static GVariant *task_to_variant(SnapdTask *task) {
+  GVariant *affected_snaps = NULL;
+  SnapdTaskData *data = snapd_task_get_data(task);
+  if (data != NULL) {
+    affected_snaps =
+        strv_to_variant(snapd_task_data_get_affected_snaps(data));
+  }
+  return g_variant_new("(ssssxxm@as)", non_null(snapd_task_get_id(task)),
+                       non_null(snapd_task_get_kind(task)),
+                       non_null(snapd_task_get_summary(task)),
+                       non_null(snapd_task_get_status(task)),
+                       snapd_task_get_progress_done(task),
+                       snapd_task_get_progress_total(task), affected_snaps);
+}
+
+static SnapdTask *task_from_variant(GVariant *variant) {
+  const gchar *id, *kind, *summary, *status;
+  gint64 progress_done, progress_total;
+  g_autoptr(GVariant) affected_snaps = NULL;
+  g_variant_get(variant, "(&s&s&s&sxxm@as)", &id, &kind, &summary, &status,
+                &progress_done, &progress_total, &affected_snaps);
+
+  g_autoptr(SnapdTaskData) data = NULL;
+  if (affected_snaps != NULL) {
+    g_auto(GStrv) snaps = g_variant_dup_strv(affected_snaps, NULL);
+    data = g_object_new(SNAPD_TYPE_TASK_DATA, "affected-snaps", snaps, NULL);
+  }
+  return g_object_new(SNAPD_TYPE_TASK, "id", id, "kind", kind, "summary",
+                      summary, "status", status, "progress-done",
+                      progress_done, "progress-total", progress_total, "data",
+                      data, NULL);
+}
+
+GVariant *sdi_snapd_variant_from_change(SnapdChange *change) {
+  g_return_val_if_fail(SNAPD_IS_CHANGE(change), NULL);
+
+  GVariantBuilder tasks;
+  g_variant_builder_init(&tasks, G_VARIANT_TYPE(TASKS_VARIANT_TYPE));
+  GPtrArray *change_tasks = snapd_change_get_tasks(change);
+  for (guint i = 0; (change_tasks != NULL) && (i < change_tasks->len); i++) {
+    g_variant_builder_add_value(&tasks,
+                                task_to_variant(change_tasks->pdata[i]));
+  }
+
+  GVariant *autorefresh = NULL;
+  SnapdChangeData *data = snapd_change_get_data(change);
+  if (SNAPD_IS_AUTOREFRESH_CHANGE_DATA(data)) {
+    SnapdAutorefreshChangeData *autorefresh_data =
+        SNAPD_AUTOREFRESH_CHANGE_DATA(data);
+    autorefresh = g_variant_new(
+        "(@as@as)",
+        strv_to_variant(
+            snapd_autorefresh_change_data_get_snap_names(autorefresh_data)),
+        strv_to_variant(snapd_autorefresh_change_data_get_refresh_forced(
+            autorefresh_data)));
+  }
+
+  return g_variant_new("(ssssb@" TASKS_VARIANT_TYPE "m@(asas))",
+                       non_null(snapd_change_get_id(change)),
+                       non_null(snapd_change_get_kind(change)),
+                       non_null(snapd_change_get_summary(change)),
+                       non_null(snapd_change_get_status(change)),
+                       snapd_change_get_ready(change),
+                       g_variant_builder_end(&tasks), autorefresh);
+}
+
+SnapdChange *sdi_snapd_variant_to_change(GVariant *variant) {
+  g_return_val_if_fail(
+      g_variant_is_of_type(variant,
+                           G_VARIANT_TYPE(SDI_SNAPD_CHANGE_VARIANT_TYPE)),
+      NULL);
+
+  const gchar *id, *kind, *summary, *status;
+  gboolean ready;
+  g_autoptr(GVariant) tasks_variant = NULL;
+  g_autoptr(GVariant) autorefresh = NULL;
+  g_variant_get(variant, "(&s&s&s&sb@" TASKS_VARIANT_TYPE "m@(asas))", &id,
+                &kind, &summary, &status, &ready, &tasks_variant,
+                &autorefresh);
+
+  g_autoptr(GPtrArray) tasks = g_ptr_array_new_with_free_func(g_object_unref);
+  gsize n_tasks = g_variant_n_children(tasks_variant);
+  for (gsize i = 0; i < n_tasks; i++) {
+    g_autoptr(GVariant) task = g_variant_get_child_value(tasks_variant, i);
+    g_ptr_array_add(tasks, task_from_variant(task));
+  }
+
+  g_autoptr(SnapdChangeData) data = NULL;
+  if (autorefresh != NULL) {
+    g_auto(GStrv) snap_names = NULL;
+    g_auto(GStrv) refresh_forced = NULL;
+    g_variant_get(autorefresh, "(^as^as)", &snap_names, &refresh_forced);
+    data = g_object_new(SNAPD_TYPE_AUTOREFRESH_CHANGE_DATA, "snap-names",
+                        snap_names, "refresh-forced", refresh_forced, NULL);
+  }
+
+  return g_object_new(SNAPD_TYPE_CHANGE, "id", id, "kind", kind, "summary",
+                      summary, "status", status, "ready", ready, "tasks",
+                      tasks, "data", data, NULL);
+}
+
+GVariant *sdi_snapd_variant_from_notice(SnapdNotice *notice) {
+  g_return_val_if_fail(SNAPD_IS_NOTICE(notice), NULL);
+
+  GVariantBuilder last_data;
+  g_variant_builder_init(&last_data, G_VARIANT_TYPE("a{ss}"));
+  GHashTable *notice_data = snapd_notice_get_last_data2(notice);
+  if (notice_data != NULL) {
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init(&iter, notice_data);
+    while (g_hash_table_iter_next(&iter, &key, &value)) {
+      g_variant_builder_add(&last_data, "{ss}", key, non_null(value));
+    }
+  }
+
+  const gchar *type_name = sdi_snapd_variant_get_notice_type_name(
+      snapd_notice_get_notice_type(notice));
+  return g_variant_new("(sssa{ss})", non_null(snapd_notice_get_id(notice)),
+                       non_null(type_name),
+                       non_null(snapd_notice_get_key(notice)), &last_data);
+}
+
+SnapdNotice *sdi_snapd_variant_to_notice(GVariant *variant) {
+  g_return_val_if_fail(
+      g_variant_is_of_type(variant,
+                           G_VARIANT_TYPE(SDI_SNAPD_NOTICE_VARIANT_TYPE)),
+      NULL);
+
+  const gchar *id, *type_name, *key;
+  g_autoptr(GVariantIter) iter = NULL;
+  g_variant_get(variant, "(&s&s&sa{ss})", &id, &type_name, &key, &iter);
+
+  g_autoptr(GHashTable) last_data =
+      g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  const gchar *data_key, *data_value;
+  while (g_variant_iter_next(iter, "{&s&s}", &data_key, &data_value)) {
+    g_hash_table_insert(last_data, g_strdup(data_key), g_strdup(data_value));
+  }
+
+  SnapdNoticeType type = SNAPD_NOTICE_TYPE_UNKNOWN;
+  for (guint i = 0; i < G_N_ELEMENTS(notice_type_names); i++) {
+    if (g_str_equal(notice_type_names[i].name, type_name)) {
+      type = notice_type_names[i].type;
+      break;
+    }
+  }
+
+  return g_object_new(SNAPD_TYPE_NOTICE, "id", id, "notice-type", type, "key",
+                      key, "last-data", last_data, NULL);
+}
+
+/**
+ * Returns the name that snapd uses for @type, like "change-update", or NULL
+ * if it isn't one of the types that the monitors use.
+ */
+const gchar *sdi_snapd_variant_get_notice_type_name(SnapdNoticeType type) {
+  for (guint i = 0; i < G_N_ELEMENTS(notice_type_names); i++) {
+    if (notice_type_names[i].type == type) {
+      return notice_type_names[i].name;
+    }
+  }
+  return NULL;
+}
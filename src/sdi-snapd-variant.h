@@ -0,0 +1,49 @@
+/*
+ * Copyright (C) 2024 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <glib.h>
+#include <snapd-glib/snapd-glib.h>
+
+G_BEGIN_DECLS
+
+/* GVariant formats used by the fan-out service to send changes and notices
+ * over D-Bus. They only contain the fields that the monitors use.
+ *
+ * A change is (id, kind, summary, status, ready, tasks, autorefresh data),
+ * where each task is (id, kind, summary, status, progress done, progress
+ * total, affected snaps), and the autorefresh data, if present, is (snap
+ * names, refresh forced).
+ *
+ * A notice is (id, type, key, last data), with the type as the name used by
+ * snapd, like "change-update".
+ */
+#define SDI_SNAPD_CHANGE_VARIANT_TYPE "(ssssba(ssssxxmas)m(asas))"
+#define SDI_SNAPD_NOTICE_VARIANT_TYPE "(sssa{ss})"
+
+GVariant *sdi_snapd_variant_from_change(SnapdChange *change);
+
+SnapdChange *sdi_snapd_variant_to_change(GVariant *variant);
+
+GVariant *sdi_snapd_variant_from_notice(SnapdNotice *notice);
+
+SnapdNotice *sdi_snapd_variant_to_notice(GVariant *variant);
+
+const gchar *sdi_snapd_variant_get_notice_type_name(SnapdNoticeType type);
+
+G_END_DECLS
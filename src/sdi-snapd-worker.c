@@ -0,0 +1,352 @@
+/*
+ * Copyright (C) 2024 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "sdi-snapd-worker.h"
+#include "sdi-snapd-client-factory.h"
+#include "sdi-snapd-monitor.h"
+
+/**
+ * This class runs the traffic with snapd that happens all the time, which is
+ * the notices long-poll and the polling of the changes, in a worker thread
+ * with its own main context. The HTTP requests and the parsing of the
+ * replies into #SnapdNotice and #SnapdChange objects happen there, so the
+ * main loop, which draws the progress bars and handles the notifications,
+ * isn't delayed by a slow snapd or by big changes.
+ *
+ * The worker thread owns a #SnapdClient and a #SdiSnapdMonitor. The notices
+ * are emitted in the `notice-event` signal in the main context of the thread
+ * that created the worker, with the same parameters than #SdiSnapdMonitor,
+ * and the changes are returned with the same API than #SnapdClient. The
+ * objects are read-only once they are built, so they can be passed from one
+ * thread to the other.
+ *
+ * Everything that runs in the worker thread only uses the fields marked as
+ * such, and the other threads only pass work to it with
+ * `g_main_context_invoke()`. The last reference to the worker must be
+ * released in the main context, because dispose waits for the thread to
+ * finish, so the work passed to the thread doesn't keep references to it.
+ * The change requests are the exception: their #GTask keeps a reference to
+ * the worker, so the worker thread never releases it. The reference is
+ * passed back to the main context with the result, and the task returns
+ * and is released there.
+ */
+
+struct _SdiSnapdWorker {
+  GObject parent_instance;
+
+  GThread *thread;
+  GMainContext *context;
+  GMainLoop *loop;
+  // the main context of the thread that created the worker
+  GMainContext *main_context;
+
+  // used only in the worker thread
+  SnapdClient *client;
+  SdiSnapdMonitor *monitor;
+};
+
+G_DEFINE_TYPE(SdiSnapdWorker, sdi_snapd_worker, G_TYPE_OBJECT)
+
+typedef struct {
+  SdiSnapdWorker *self;
+  SnapdNotice *notice;
+  gboolean first_run;
+} NoticeEvent;
+
+static void free_notice_event(NoticeEvent *event) {
+  g_object_unref(event->self);
+  g_object_unref(event->notice);
+  g_free(event);
+}
+
+typedef struct {
+  SdiSnapdWorker *self;
+  GStrv types;
+} NoticeTypes;
+
+static void free_notice_types(NoticeTypes *data) {
+  g_strfreev(data->types);
+  g_free(data);
+}
+
+// runs in the main context
+static gboolean emit_notice(NoticeEvent *event) {
+  g_signal_emit_by_name(event->self, "notice-event", event->notice,
+                        event->first_run);
+  return G_SOURCE_REMOVE;
+}
+
+// runs in the worker thread
+static void notice_cb(SdiSnapdMonitor *monitor, SnapdNotice *notice,
+                      gboolean first_run, SdiSnapdWorker *self) {
+  NoticeEvent *event = g_malloc0(sizeof(NoticeEvent));
+  event->self = g_object_ref(self);
+  event->notice = g_object_ref(notice);
+  event->first_run = first_run;
+  g_main_context_invoke_full(self->main_context, G_PRIORITY_DEFAULT,
+                             (GSourceFunc)emit_notice, event,
+                             (GDestroyNotify)free_notice_event);
+}
+
+// runs in the worker thread
+static gboolean add_notice_types_in_worker(NoticeTypes *data) {
+  // it is NULL if the worker is being destroyed
+  if (data->self->monitor != NULL) {
+    sdi_snapd_monitor_add_notice_types(data->self->monitor,
+                                       (const gchar *const *)data->types);
+  }
+  return G_SOURCE_REMOVE;
+}
+
+// runs in the worker thread
+static gboolean start_in_worker(SdiSnapdWorker *self) {
+  if (self->monitor != NULL) {
+    sdi_snapd_monitor_start(self->monitor);
+  }
+  return G_SOURCE_REMOVE;
+}
+
+typedef struct {
+  GTask *task;
+  gpointer result;
+  GDestroyNotify result_free;
+  GError *error;
+} TaskResult;
+
+static void free_task_result(TaskResult *data) {
+  g_object_unref(data->task);
+  if (data->result != NULL) {
+    data->result_free(data->result);
+  }
+  g_clear_error(&data->error);
+  g_free(data);
+}
+
+// runs in the main context
+static gboolean return_task_result(TaskResult *data) {
+  if (data->error != NULL) {
+    g_task_return_error(data->task, g_steal_pointer(&data->error));
+  } else {
+    g_task_return_pointer(data->task, g_steal_pointer(&data->result),
+                          data->result_free);
+  }
+  return G_SOURCE_REMOVE;
+}
+
+/* runs in the worker thread. It takes the reference to @task, and either
+ * @result or @error, and passes them to the main context, which returns the
+ * task and releases it.
+ */
+static void return_in_main_context(GTask *task, gpointer result,
+                                   GDestroyNotify result_free,
+                                   GError *error) {
+  SdiSnapdWorker *self = g_task_get_source_object(task);
+  TaskResult *data = g_malloc0(sizeof(TaskResult));
+  data->task = task;
+  data->result = result;
+  data->result_free = result_free;
+  data->error = error;
+  g_main_context_invoke_full(self->main_context, G_PRIORITY_DEFAULT,
+                             (GSourceFunc)return_task_result, data,
+                             (GDestroyNotify)free_task_result);
+}
+
+// runs in the worker thread
+static void get_change_cb(GObject *object, GAsyncResult *result,
+                          gpointer data) {
+  GTask *task = data;
+  GError *error = NULL;
+  SnapdChange *change =
+      snapd_client_get_change_finish(SNAPD_CLIENT(object), result, &error);
+  return_in_main_context(task, change, g_object_unref, error);
+}
+
+// runs in the worker thread, and takes the reference to @task
+static gboolean get_change_in_worker(GTask *task) {
+  SdiSnapdWorker *self = g_task_get_source_object(task);
+  if (self->client == NULL) {
+    return_in_main_context(task, NULL, NULL,
+                           g_error_new(G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                                       "The snapd worker is being destroyed"));
+    return G_SOURCE_REMOVE;
+  }
+  snapd_client_get_change_async(self->client, g_task_get_task_data(task),
+                                g_task_get_cancellable(task), get_change_cb,
+                                task);
+  return G_SOURCE_REMOVE;
+}
+
+// runs in the worker thread
+static void get_change_summary_cb(GObject *object, GAsyncResult *result,
+                                  gpointer data) {
+  GTask *task = data;
+  GError *error = NULL;
+  SdiChangeSummary *summary = sdi_change_summary_request_finish(result, &error);
+  return_in_main_context(task, summary, (GDestroyNotify)sdi_change_summary_free,
+                         error);
+}
+
+// runs in the worker thread, and takes the reference to @task
+static gboolean get_change_summary_in_worker(GTask *task) {
+  SdiSnapdWorker *self = g_task_get_source_object(task);
+  if (self->client == NULL) {
+    return_in_main_context(task, NULL, NULL,
+                           g_error_new(G_IO_ERROR, G_IO_ERROR_CANCELLED,
+                                       "The snapd worker is being destroyed"));
+    return G_SOURCE_REMOVE;
+  }
+  sdi_change_summary_request_async(
+      sdi_snapd_client_factory_get_socket_path(), g_task_get_task_data(task),
+      g_task_get_cancellable(task), get_change_summary_cb, task);
+  return G_SOURCE_REMOVE;
+}
+
+static gpointer worker_thread(SdiSnapdWorker *self) {
+  g_main_context_push_thread_default(self->context);
+
+  self->client = sdi_snapd_client_factory_new_snapd_client();
+  self->monitor = sdi_snapd_monitor_new();
+  g_signal_connect(self->monitor, "notice-event", (GCallback)notice_cb, self);
+
+  g_main_loop_run(self->loop);
+
+  /* the monitor cancels its request when it is destroyed, and the pending
+   * callbacks are dispatched to free their data.
+   */
+  g_clear_object(&self->monitor);
+  g_clear_object(&self->client);
+  while (g_main_context_iteration(self->context, FALSE)) {
+  }
+  g_main_context_pop_thread_default(self->context);
+  return NULL;
+}
+
+/**
+ * Adds the notice types in the NULL-terminated @types list to the ones
+ * requested to snapd, like `sdi_snapd_monitor_add_notice_types()`.
+ */
+void sdi_snapd_worker_add_notice_types(SdiSnapdWorker *self,
+                                       const gchar *const *types) {
+  g_return_if_fail(SDI_IS_SNAPD_WORKER(self));
+
+  NoticeTypes *data = g_malloc0(sizeof(NoticeTypes));
+  data->self = self;
+  data->types = g_strdupv((GStrv)types);
+  g_main_context_invoke_full(self->context, G_PRIORITY_DEFAULT,
+                             (GSourceFunc)add_notice_types_in_worker, data,
+                             (GDestroyNotify)free_notice_types);
+}
+
+void sdi_snapd_worker_start(SdiSnapdWorker *self) {
+  g_return_if_fail(SDI_IS_SNAPD_WORKER(self));
+
+  g_main_context_invoke(self->context, (GSourceFunc)start_in_worker, self);
+}
+
+/**
+ * Requests the change @change_id to snapd from the worker thread. The
+ * callback is called in the thread-default main context of the caller.
+ */
+void sdi_snapd_worker_get_change_async(SdiSnapdWorker *self,
+                                       const gchar *change_id,
+                                       GCancellable *cancellable,
+                                       GAsyncReadyCallback callback,
+                                       gpointer user_data) {
+  g_return_if_fail(SDI_IS_SNAPD_WORKER(self));
+
+  GTask *task = g_task_new(self, cancellable, callback, user_data);
+  g_task_set_task_data(task, g_strdup(change_id), g_free);
+  // the task is released in the main context, never in the worker thread
+  g_main_context_invoke(self->context, (GSourceFunc)get_change_in_worker, task);
+}
+
+SnapdChange *sdi_snapd_worker_get_change_finish(SdiSnapdWorker *self,
+                                                GAsyncResult *result,
+                                                GError **error) {
+  g_return_val_if_fail(g_task_is_valid(result, self), NULL);
+
+  return g_task_propagate_pointer(G_TASK(result), error);
+}
+
+/**
+ * Like `sdi_snapd_worker_get_change_async()`, but the change is read with
+ * `sdi_change_summary_request_async()`, so no #SnapdChange is built.
+ */
+void sdi_snapd_worker_get_change_summary_async(SdiSnapdWorker *self,
+                                               const gchar *change_id,
+                                               GCancellable *cancellable,
+                                               GAsyncReadyCallback callback,
+                                               gpointer user_data) {
+  g_return_if_fail(SDI_IS_SNAPD_WORKER(self));
+
+  GTask *task = g_task_new(self, cancellable, callback, user_data);
+  g_task_set_task_data(task, g_strdup(change_id), g_free);
+  // the task is released in the main context, never in the worker thread
+  g_main_context_invoke(self->context,
+                        (GSourceFunc)get_change_summary_in_worker, task);
+}
+
+SdiChangeSummary *
+sdi_snapd_worker_get_change_summary_finish(SdiSnapdWorker *self,
+                                           GAsyncResult *result,
+                                           GError **error) {
+  g_return_val_if_fail(g_task_is_valid(result, self), NULL);
+
+  return g_task_propagate_pointer(G_TASK(result), error);
+}
+
+static gboolean quit_worker(SdiSnapdWorker *self) {
+  g_main_loop_quit(self->loop);
+  return G_SOURCE_REMOVE;
+}
+
+static void sdi_snapd_worker_dispose(GObject *object) {
+  SdiSnapdWorker *self = SDI_SNAPD_WORKER(object);
+
+  if (self->thread != NULL) {
+    g_main_context_invoke(self->context, (GSourceFunc)quit_worker, self);
+    g_thread_join(g_steal_pointer(&self->thread));
+  }
+  g_clear_pointer(&self->loop, g_main_loop_unref);
+  g_clear_pointer(&self->context, g_main_context_unref);
+  g_clear_pointer(&self->main_context, g_main_context_unref);
+
+  G_OBJECT_CLASS(sdi_snapd_worker_parent_class)->dispose(object);
+}
+
+static void sdi_snapd_worker_init(SdiSnapdWorker *self) {
+  self->context = g_main_context_new();
+  self->loop = g_main_loop_new(self->context, FALSE);
+  self->main_context = g_main_context_ref_thread_default();
+}
+
+static void sdi_snapd_worker_class_init(SdiSnapdWorkerClass *klass) {
+  GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+
+  gobject_class->dispose = sdi_snapd_worker_dispose;
+
+  g_signal_new("notice-event", G_TYPE_FROM_CLASS(klass), G_SIGNAL_RUN_LAST, 0,
+               NULL, NULL, NULL, G_TYPE_NONE, 2, SNAPD_TYPE_NOTICE,
+               G_TYPE_BOOLEAN);
+}
+
+SdiSnapdWorker *sdi_snapd_worker_new(void) {
+  SdiSnapdWorker *self = g_object_new(SDI_TYPE_SNAPD_WORKER, NULL);
+  self->thread =
+      g_thread_new("sdi-snapd-worker", (GThreadFunc)worker_thread, self);
+  return self;
+}
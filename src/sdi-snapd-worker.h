@@ -0,0 +1,60 @@
+/*
+ * Copyright (C) 2024 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+#include <snapd-glib/snapd-glib.h>
+
+#include "sdi-change-summary.h"
+
+G_BEGIN_DECLS
+
+#define SDI_TYPE_SNAPD_WORKER sdi_snapd_worker_get_type()
+
+G_DECLARE_FINAL_TYPE(SdiSnapdWorker, sdi_snapd_worker, SDI, SNAPD_WORKER,
+                     GObject)
+
+SdiSnapdWorker *sdi_snapd_worker_new(void);
+
+void sdi_snapd_worker_add_notice_types(SdiSnapdWorker *self,
+                                       const gchar *const *types);
+
+void sdi_snapd_worker_start(SdiSnapdWorker *self);
+
+void sdi_snapd_worker_get_change_async(SdiSnapdWorker *self,
+                                       const gchar *change_id,
+                                       GCancellable *cancellable,
+                                       GAsyncReadyCallback callback,
+                                       gpointer user_data);
+
+SnapdChange *sdi_snapd_worker_get_change_finish(SdiSnapdWorker *self,
+                                                GAsyncResult *result,
+                                                GError **error);
+
+void sdi_snapd_worker_get_change_summary_async(SdiSnapdWorker *self,
+                                               const gchar *change_id,
+                                               GCancellable *cancellable,
+                                               GAsyncReadyCallback callback,
+                                               gpointer user_data);
+
+SdiChangeSummary *
+sdi_snapd_worker_get_change_summary_finish(SdiSnapdWorker *self,
+                                           GAsyncResult *result,
+                                           GError **error);
+
+G_END_DECLS
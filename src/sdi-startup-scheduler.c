@@ -0,0 +1,182 @@
+/*
+ * Copyright (C) 2024 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "sdi-startup-scheduler.h"
+
+#include <unistd.h>
+
+/**
+ * This class spreads the startup work of the daemon, so the instances of
+ * all the users that log in at the same time don't query snapd together.
+ *
+ * Urgent work runs as soon as the main loop is idle. Deferred work waits an
+ * offset inside the window passed to the constructor; the offset is derived
+ * from the machine id and the user id, so each user always gets the same
+ * one, but different users get different ones. Several deferred tasks are
+ * also spaced by STAGGER_INTERVAL, so they don't reach snapd together. With
+ * an empty window, deferred tasks only run after the urgent ones.
+ */
+
+// time in ms between consecutive deferred tasks
+#define STAGGER_INTERVAL 2000
+
+typedef struct {
+  SdiStartupScheduler *self;
+  GSourceOnceFunc func;
+  gpointer data;
+  guint id;
+} ScheduledTask;
+
+struct _SdiStartupScheduler {
+  GObject parent_instance;
+
+  // time when the scheduler was created, which is the start of the window
+  gint64 start_time;
+  // if 0, the deferred tasks are neither delayed nor staggered
+  guint window;
+  guint offset;
+  guint n_deferred;
+  // the key is the source id; the value is a ScheduledTask
+  GHashTable *tasks;
+};
+
+G_DEFINE_TYPE(SdiStartupScheduler, sdi_startup_scheduler, G_TYPE_OBJECT)
+
+/**
+ * Returns the offset of the current user inside @window, in ms.
+ */
+static guint get_user_offset(guint window) {
+  if (window == 0) {
+    return 0;
+  }
+  g_autofree gchar *machine_id = NULL;
+  if (!g_file_get_contents("/etc/machine-id", &machine_id, NULL, NULL)) {
+    machine_id = g_strdup("");
+  }
+  g_autofree gchar *seed =
+      g_strdup_printf("%s:%u", g_strstrip(machine_id), getuid());
+  // mix the bits, because consecutive uids give close hashes
+  guint32 hash = g_str_hash(seed);
+  hash ^= hash >> 16;
+  hash *= 0x85ebca6b;
+  hash ^= hash >> 13;
+  hash *= 0xc2b2ae35;
+  hash ^= hash >> 16;
+  return hash % window;
+}
+
+static gboolean run_task(ScheduledTask *task) {
+  GSourceOnceFunc func = task->func;
+  gpointer data = task->data;
+  // this frees the task, and the source is removed when returning
+  g_hash_table_remove(task->self->tasks, GUINT_TO_POINTER(task->id));
+  func(data);
+  return G_SOURCE_REMOVE;
+}
+
+/**
+ * Schedules @func. Urgent tasks run in the next main loop iteration, and
+ * deferred ones after the offset of the user, counted from the creation of
+ * the scheduler. A deferred task added after its turn runs immediately,
+ * but with low priority.
+ *
+ * Returns an id that can be passed to sdi_startup_scheduler_remove() while
+ * @func hasn't been called.
+ */
+guint sdi_startup_scheduler_add(SdiStartupScheduler *self,
+                                SdiStartupPriority priority,
+                                GSourceOnceFunc func, gpointer data) {
+  g_return_val_if_fail(SDI_IS_STARTUP_SCHEDULER(self), 0);
+  g_return_val_if_fail(func != NULL, 0);
+
+  guint delay = 0;
+  gint source_priority = G_PRIORITY_DEFAULT;
+  if (priority == SDI_STARTUP_PRIORITY_DEFERRED) {
+    source_priority = G_PRIORITY_LOW;
+  }
+  if ((priority == SDI_STARTUP_PRIORITY_DEFERRED) && (self->window != 0)) {
+    gint64 due_time =
+        self->start_time +
+        (self->offset + (gint64)self->n_deferred * STAGGER_INTERVAL) * 1000;
+    delay = MAX(due_time - g_get_monotonic_time(), 0) / 1000;
+    self->n_deferred++;
+  }
+
+  ScheduledTask *task = g_new0(ScheduledTask, 1);
+  task->self = self;
+  task->func = func;
+  task->data = data;
+  task->id = g_timeout_add_full(source_priority, delay, (GSourceFunc)run_task,
+                                task, NULL);
+  g_hash_table_insert(self->tasks, GUINT_TO_POINTER(task->id), task);
+  return task->id;
+}
+
+/**
+ * Removes a task added with sdi_startup_scheduler_add(). Nothing is done
+ * if it already ran.
+ */
+void sdi_startup_scheduler_remove(SdiStartupScheduler *self, guint id) {
+  g_return_if_fail(SDI_IS_STARTUP_SCHEDULER(self));
+
+  if (g_hash_table_remove(self->tasks, GUINT_TO_POINTER(id))) {
+    g_source_remove(id);
+  }
+}
+
+guint sdi_startup_scheduler_get_offset(SdiStartupScheduler *self) {
+  g_return_val_if_fail(SDI_IS_STARTUP_SCHEDULER(self), 0);
+
+  return self->offset;
+}
+
+static void sdi_startup_scheduler_dispose(GObject *object) {
+  SdiStartupScheduler *self = SDI_STARTUP_SCHEDULER(object);
+
+  if (self->tasks != NULL) {
+    GHashTableIter iter;
+    gpointer id;
+    g_hash_table_iter_init(&iter, self->tasks);
+    while (g_hash_table_iter_next(&iter, &id, NULL)) {
+      g_source_remove(GPOINTER_TO_UINT(id));
+    }
+    g_clear_pointer(&self->tasks, g_hash_table_unref);
+  }
+
+  G_OBJECT_CLASS(sdi_startup_scheduler_parent_class)->dispose(object);
+}
+
+static void sdi_startup_scheduler_init(SdiStartupScheduler *self) {
+  self->start_time = g_get_monotonic_time();
+  self->tasks =
+      g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+}
+
+static void sdi_startup_scheduler_class_init(SdiStartupSchedulerClass *klass) {
+  G_OBJECT_CLASS(klass)->dispose = sdi_startup_scheduler_dispose;
+}
+
+/**
+ * Creates a new scheduler that spreads the deferred tasks of the users
+ * over @window ms.
+ */
+SdiStartupScheduler *sdi_startup_scheduler_new(guint window) {
+  SdiStartupScheduler *self = g_object_new(SDI_TYPE_STARTUP_SCHEDULER, NULL);
+  self->window = window;
+  self->offset = get_user_offset(window);
+  return self;
+}
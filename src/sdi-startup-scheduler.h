@@ -0,0 +1,46 @@
+/*
+ * Copyright (C) 2024 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <glib-object.h>
+
+G_BEGIN_DECLS
+
+typedef enum {
+  // work needed to show what is happening now, like the active changes
+  SDI_STARTUP_PRIORITY_URGENT,
+  // work that can wait, like the theme checks and the inhibited snaps
+  SDI_STARTUP_PRIORITY_DEFERRED,
+} SdiStartupPriority;
+
+#define SDI_TYPE_STARTUP_SCHEDULER sdi_startup_scheduler_get_type()
+
+G_DECLARE_FINAL_TYPE(SdiStartupScheduler, sdi_startup_scheduler, SDI,
+                     STARTUP_SCHEDULER, GObject)
+
+SdiStartupScheduler *sdi_startup_scheduler_new(guint window);
+
+guint sdi_startup_scheduler_get_offset(SdiStartupScheduler *self);
+
+guint sdi_startup_scheduler_add(SdiStartupScheduler *self,
+                                SdiStartupPriority priority,
+                                GSourceOnceFunc func, gpointer data);
+
+void sdi_startup_scheduler_remove(SdiStartupScheduler *self, guint id);
+
+G_END_DECLS
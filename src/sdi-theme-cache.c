@@ -0,0 +1,142 @@
+/*
+ * Copyright (C) 2024 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "sdi-theme-cache.h"
+
+/**
+ * This class remembers the status returned by snapd for each theme, so
+ * switching back and forth between the same themes doesn't require asking
+ * snapd again. Entries expire after a TTL, because the availability of a
+ * theme in the store can change without us being notified, and the whole
+ * cache is invalidated whenever a snap is installed or removed.
+ */
+
+typedef struct {
+  SnapdThemeStatus status;
+  gint64 timestamp;
+} CacheEntry;
+
+struct _SdiThemeCache {
+  GObject parent_instance;
+
+  // TTL in microseconds
+  gint64 ttl;
+  // one table per kind; theme name -> CacheEntry
+  GHashTable *entries[SDI_THEME_KIND_LAST];
+};
+
+G_DEFINE_TYPE(SdiThemeCache, sdi_theme_cache, G_TYPE_OBJECT)
+
+gboolean sdi_theme_cache_lookup(SdiThemeCache *self, SdiThemeKind kind,
+                                const gchar *name, SnapdThemeStatus *status) {
+  g_return_val_if_fail(SDI_IS_THEME_CACHE(self), FALSE);
+  g_return_val_if_fail(kind < SDI_THEME_KIND_LAST, FALSE);
+
+  if (name == NULL) {
+    return FALSE;
+  }
+  CacheEntry *entry = g_hash_table_lookup(self->entries[kind], name);
+  if (entry == NULL) {
+    return FALSE;
+  }
+  if (g_get_monotonic_time() - entry->timestamp >= self->ttl) {
+    g_hash_table_remove(self->entries[kind], name);
+    return FALSE;
+  }
+  if (status != NULL) {
+    *status = entry->status;
+  }
+  return TRUE;
+}
+
+void sdi_theme_cache_store(SdiThemeCache *self, SdiThemeKind kind,
+                           const gchar *name, SnapdThemeStatus status) {
+  g_return_if_fail(SDI_IS_THEME_CACHE(self));
+  g_return_if_fail(kind < SDI_THEME_KIND_LAST);
+  g_return_if_fail(name != NULL);
+
+  CacheEntry *entry = g_malloc0(sizeof(CacheEntry));
+  entry->status = status;
+  entry->timestamp = g_get_monotonic_time();
+  g_hash_table_insert(self->entries[kind], g_strdup(name), entry);
+}
+
+/**
+ * Stores all the statuses in a table returned by
+ * snapd_client_check_themes_finish().
+ */
+void sdi_theme_cache_store_all(SdiThemeCache *self, SdiThemeKind kind,
+                               GHashTable *statuses) {
+  g_return_if_fail(SDI_IS_THEME_CACHE(self));
+
+  if (statuses == NULL) {
+    return;
+  }
+  GHashTableIter iter;
+  gpointer name, status;
+  g_hash_table_iter_init(&iter, statuses);
+  while (g_hash_table_iter_next(&iter, &name, &status)) {
+    sdi_theme_cache_store(self, kind, name, GPOINTER_TO_INT(status));
+  }
+}
+
+void sdi_theme_cache_invalidate(SdiThemeCache *self) {
+  g_return_if_fail(SDI_IS_THEME_CACHE(self));
+
+  for (guint kind = 0; kind < SDI_THEME_KIND_LAST; kind++) {
+    g_hash_table_remove_all(self->entries[kind]);
+  }
+}
+
+guint sdi_theme_cache_get_size(SdiThemeCache *self) {
+  g_return_val_if_fail(SDI_IS_THEME_CACHE(self), 0);
+
+  guint size = 0;
+  for (guint kind = 0; kind < SDI_THEME_KIND_LAST; kind++) {
+    size += g_hash_table_size(self->entries[kind]);
+  }
+  return size;
+}
+
+static void sdi_theme_cache_dispose(GObject *object) {
+  SdiThemeCache *self = SDI_THEME_CACHE(object);
+
+  for (guint kind = 0; kind < SDI_THEME_KIND_LAST; kind++) {
+    g_clear_pointer(&self->entries[kind], g_hash_table_unref);
+  }
+
+  G_OBJECT_CLASS(sdi_theme_cache_parent_class)->dispose(object);
+}
+
+void sdi_theme_cache_init(SdiThemeCache *self) {
+  for (guint kind = 0; kind < SDI_THEME_KIND_LAST; kind++) {
+    self->entries[kind] =
+        g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  }
+}
+
+void sdi_theme_cache_class_init(SdiThemeCacheClass *klass) {
+  G_OBJECT_CLASS(klass)->dispose = sdi_theme_cache_dispose;
+}
+
+/**
+ * Creates a new cache whose entries expire after @ttl seconds.
+ */
+SdiThemeCache *sdi_theme_cache_new(guint ttl) {
+  SdiThemeCache *self = g_object_new(SDI_TYPE_THEME_CACHE, NULL);
+  self->ttl = (gint64)ttl * G_USEC_PER_SEC;
+  return self;
+}
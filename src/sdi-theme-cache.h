@@ -0,0 +1,52 @@
+/*
+ * Copyright (C) 2024 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include <glib-object.h>
+#include <snapd-glib/snapd-glib.h>
+
+G_BEGIN_DECLS
+
+#define SDI_TYPE_THEME_CACHE sdi_theme_cache_get_type()
+
+G_DECLARE_FINAL_TYPE(SdiThemeCache, sdi_theme_cache, SDI, THEME_CACHE,
+                     GObject)
+
+/* snapd stores cursor themes as icon themes, so they share the same kind. */
+typedef enum {
+  SDI_THEME_KIND_GTK,
+  SDI_THEME_KIND_ICON,
+  SDI_THEME_KIND_SOUND,
+  SDI_THEME_KIND_LAST
+} SdiThemeKind;
+
+SdiThemeCache *sdi_theme_cache_new(guint ttl);
+
+gboolean sdi_theme_cache_lookup(SdiThemeCache *self, SdiThemeKind kind,
+                                const gchar *name, SnapdThemeStatus *status);
+
+void sdi_theme_cache_store(SdiThemeCache *self, SdiThemeKind kind,
+                           const gchar *name, SnapdThemeStatus status);
+
+void sdi_theme_cache_store_all(SdiThemeCache *self, SdiThemeKind kind,
+                               GHashTable *statuses);
+
+void sdi_theme_cache_invalidate(SdiThemeCache *self);
+
+guint sdi_theme_cache_get_size(SdiThemeCache *self);
+
+G_END_DECLS
@@ -16,6 +16,9 @@
  */
 
 #include "sdi-theme-monitor.h"
+#include "sdi-notice-types.h"
+#include "sdi-theme-cache.h"
+#include "sdi-theme-prefetcher.h"
 #include <glib/gi18n.h>
 #include <gtk/gtk.h>
 #include <libnotify/notify.h>
@@ -26,6 +29,9 @@ struct _SdiThemeMonitor {
 
   // Theme settings.
   GtkSettings *settings;
+  /* Cancelled on dispose. Callbacks of cancelled requests must return
+   * without touching the monitor, because it can be already freed. */
+  GCancellable *cancellable;
 
   /* Timer to delay checking after theme changes */
   guint check_delay_timer_id;
@@ -45,6 +51,15 @@ struct _SdiThemeMonitor {
   bool install_notification_answered;
   NotifyNotification *progress_notification;
 
+  // Current theme install.
+  GCancellable *install_cancellable;
+  gint64 last_progress_update;
+  bool install_dialog_shown;
+
+  // Status of the themes already checked in snapd.
+  SdiThemeCache *cache;
+  SdiThemePrefetcher *prefetcher;
+
   // Connection to snapd.
   SnapdClient *client;
 };
@@ -55,38 +70,157 @@ G_DEFINE_TYPE(SdiThemeMonitor, sdi_theme_monitor, G_TYPE_OBJECT)
  * snaps. */
 #define CHECK_THEME_TIMEOUT_SECONDS 1
 
+/* Number of seconds that the status of a theme is cached. It must expire
+ * eventually because a theme snap can be published in the store at any
+ * moment, and that isn't notified. */
+#define THEME_CACHE_TTL_SECONDS (6 * 3600)
+
+/* Number of seconds to wait before prefetching the status of the local
+ * themes, both at startup and after the cache is invalidated. */
+#define PREFETCH_DELAY_SECONDS 60
+
+/* Minimum time in ms between progress updates during a theme install. The
+ * progress dialog is shown only if the install lasts longer than this. */
+#define INSTALL_PROGRESS_PERIOD 1000
+
+/* Key used for the install in the progress window. It can't collide with a
+ * snap name, because these can't contain colons. */
+#define THEME_INSTALL_ID ":install-themes"
+
+/* GtkSettings properties that change the effective theme set. */
+static const gchar *const watched_settings[] = {
+    "gtk-theme-name", "gtk-icon-theme-name", "gtk-cursor-theme-name",
+    "gtk-sound-theme-name", NULL};
+
+/* Updates the state once the install has ended, whatever the result. */
+static void end_install(SdiThemeMonitor *self, const gchar *message) {
+  g_clear_object(&self->install_cancellable);
+  if (self->install_dialog_shown) {
+    g_signal_emit_by_name(self, "end-install", THEME_INSTALL_ID);
+    self->install_dialog_shown = false;
+  }
+
+  /* Even if it failed, some of the snaps could have been installed */
+  sdi_theme_cache_invalidate(self->cache);
+  sdi_theme_prefetcher_schedule(self->prefetcher, PREFETCH_DELAY_SECONDS);
+
+  notify_notification_clear_actions(self->progress_notification);
+  notify_notification_update(self->progress_notification,
+                             _("Installing missing theme snaps:"), message,
+                             "dialog-information");
+  notify_notification_show(self->progress_notification, NULL);
+  g_clear_object(&self->progress_notification);
+}
+
 static void install_themes_cb(GObject *object, GAsyncResult *result,
                               gpointer user_data) {
-  SdiThemeMonitor *self = user_data;
   g_autoptr(GError) error = NULL;
 
   if (snapd_client_install_themes_finish(SNAPD_CLIENT(object), result,
                                          &error)) {
     g_message("Installation complete.\n");
-    notify_notification_update(
-        self->progress_notification, _("Installing missing theme snaps:"),
-        /// TRANSLATORS: installing a missing theme snap succeed
-        _("Complete."), "dialog-information");
+    /// TRANSLATORS: installing a missing theme snap succeed
+    end_install(SDI_THEME_MONITOR(user_data), _("Complete."));
+    return;
+  }
+  /* If it was cancelled, the monitor has already been updated by
+   * sdi_theme_monitor_cancel_install(), or it has been disposed. */
+  if (g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+    return;
+  }
+  g_message("Installation failed: %s\n", error->message);
+  if (g_error_matches(error, SNAPD_ERROR, SNAPD_ERROR_AUTH_CANCELLED)) {
+    /// TRANSLATORS: installing a missing theme snap was cancelled by the user
+    end_install(SDI_THEME_MONITOR(user_data), _("Canceled by the user."));
   } else {
-    g_message("Installation failed: %s\n", error->message);
-    const gchar *error_message = NULL;
-    switch (error->code) {
-    case SNAPD_ERROR_AUTH_CANCELLED:
-      /// TRANSLATORS: installing a missing theme snap was cancelled by the user
-      error_message = _("Canceled by the user.");
-      break;
-    default:
-      /// TRANSLATORS: installing a missing theme snap failed
-      error_message = _("Failed.");
-      break;
+    /// TRANSLATORS: installing a missing theme snap failed
+    end_install(SDI_THEME_MONITOR(user_data), _("Failed."));
+  }
+}
+
+/**
+ * Gets the global progress of a change. Download tasks report their progress
+ * in bytes, while the other tasks just report whether they are done or not,
+ * so the bytes are returned only if there is at least one download task.
+ */
+static void get_change_progress(SnapdChange *change, const gchar **label,
+                                guint64 *done_bytes, guint64 *total_bytes,
+                                guint *done_tasks, guint *total_tasks) {
+  GPtrArray *tasks = snapd_change_get_tasks(change);
+
+  *label = NULL;
+  *done_bytes = 0;
+  *total_bytes = 0;
+  *done_tasks = 0;
+  *total_tasks = (tasks == NULL) ? 0 : tasks->len;
+  for (guint i = 0; i < *total_tasks; i++) {
+    SnapdTask *task = g_ptr_array_index(tasks, i);
+    const gchar *status = snapd_task_get_status(task);
+    if (g_str_equal(status, "Done")) {
+      (*done_tasks)++;
+    } else if ((*label == NULL) && g_str_equal(status, "Doing")) {
+      *label = snapd_task_get_summary(task);
+    }
+    if (snapd_task_get_progress_total(task) > 1) {
+      *done_bytes += snapd_task_get_progress_done(task);
+      *total_bytes += snapd_task_get_progress_total(task);
     }
+  }
+  if (*label == NULL) {
+    *label = snapd_change_get_summary(change);
+  }
+}
+
+static void install_progress_cb(SnapdClient *client, SnapdChange *change,
+                                gpointer deprecated, gpointer user_data) {
+  SdiThemeMonitor *self = user_data;
+
+  gint64 now = g_get_monotonic_time();
+  if (now - self->last_progress_update < INSTALL_PROGRESS_PERIOD * 1000) {
+    return;
+  }
+
+  const gchar *label;
+  guint64 done_bytes, total_bytes;
+  guint done_tasks, total_tasks;
+  get_change_progress(change, &label, &done_bytes, &total_bytes, &done_tasks,
+                      &total_tasks);
+  if (total_tasks == 0) {
+    return;
+  }
+  self->last_progress_update = now;
+
+  g_autofree gchar *body = NULL;
+  if (total_bytes > 0) {
+    g_autofree gchar *done_text = g_format_size(done_bytes);
+    g_autofree gchar *total_text = g_format_size(total_bytes);
+    /// TRANSLATORS: the first %s is the task being done; the second and third
+    /// ones are the amount of data already downloaded and the total.
+    body = g_strdup_printf(_("%s (%s of %s)"), label, done_text, total_text);
+  } else {
+    /// TRANSLATORS: the %s is the task being done; the numbers are the tasks
+    /// already done and the total.
+    body = g_strdup_printf(_("%s (%u/%u)"), label, done_tasks, total_tasks);
+  }
+  if (self->progress_notification != NULL) {
     notify_notification_update(self->progress_notification,
-                               _("Installing missing theme snaps:"),
-                               error_message, "dialog-information");
+                               _("Installing missing theme snaps:"), body,
+                               "dialog-information");
+    notify_notification_show(self->progress_notification, NULL);
   }
 
-  notify_notification_show(self->progress_notification, NULL);
-  g_clear_object(&self->progress_notification);
+  if (!self->install_dialog_shown) {
+    self->install_dialog_shown = true;
+    g_signal_emit_by_name(self, "begin-install", THEME_INSTALL_ID,
+                          _("Installing missing theme snaps:"));
+  }
+  g_signal_emit_by_name(self, "install-progress", THEME_INSTALL_ID, label,
+                        done_bytes, total_bytes, done_tasks, total_tasks);
+}
+
+static void cancel_install_cb(NotifyNotification *notification, gchar *action,
+                              gpointer user_data) {
+  sdi_theme_monitor_cancel_install(SDI_THEME_MONITOR(user_data));
 }
 
 static void notification_closed_cb(NotifyNotification *notification,
@@ -120,6 +254,10 @@ static void notify_cb(NotifyNotification *notification, gchar *action,
     g_message("Installing missing theme snaps...\n");
     self->progress_notification = notify_notification_new(
         _("Installing missing theme snaps:"), "...", "dialog-information");
+    notify_notification_add_action(
+        self->progress_notification, "cancel",
+        /// TRANSLATORS: cancels the installation of the missing theme snaps
+        _("Cancel"), cancel_install_cb, self, NULL);
     notify_notification_show(self->progress_notification, NULL);
 
     g_autoptr(GPtrArray) gtk_theme_names = g_ptr_array_new();
@@ -140,10 +278,15 @@ static void notify_cb(NotifyNotification *notification, gchar *action,
       g_ptr_array_add(sound_theme_names, self->sound_theme_name);
     }
     g_ptr_array_add(sound_theme_names, NULL);
+    /* snapd-glib polls the change and calls install_progress_cb() with it
+     * until it is done. Cancelling the request also aborts the change. */
+    self->install_cancellable = g_cancellable_new();
+    self->last_progress_update = g_get_monotonic_time();
     snapd_client_install_themes_async(
         self->client, (gchar **)gtk_theme_names->pdata,
         (gchar **)icon_theme_names->pdata, (gchar **)sound_theme_names->pdata,
-        NULL, NULL, NULL, install_themes_cb, self);
+        install_progress_cb, self, self->install_cancellable,
+        install_themes_cb, self);
   }
 }
 
@@ -153,6 +296,10 @@ static void show_install_notification(SdiThemeMonitor *self) {
     return;
   }
 
+  /* SdiNotify initializes libnotify when it is created, but that can happen
+   * after this; notify_init() does nothing if it is already initialized.
+   */
+  notify_init("Snapd Desktop Integration");
   self->install_notification = notify_notification_new(
       _("Some required theme snaps are missing."),
       _("Would you like to install them now?"), "dialog-question");
@@ -176,46 +323,21 @@ static void show_install_notification(SdiThemeMonitor *self) {
   notify_notification_show(self->install_notification, NULL);
 }
 
-static void check_themes_cb(GObject *object, GAsyncResult *result,
-                            gpointer user_data) {
-  SdiThemeMonitor *self = user_data;
-
-  g_autoptr(GHashTable) gtk_theme_status = NULL;
-  g_autoptr(GHashTable) icon_theme_status = NULL;
-  g_autoptr(GHashTable) sound_theme_status = NULL;
-  g_autoptr(GError) error = NULL;
-  if (!snapd_client_check_themes_finish(SNAPD_CLIENT(object), result,
-                                        &gtk_theme_status, &icon_theme_status,
-                                        &sound_theme_status, &error)) {
-    g_warning("Could not check themes: %s", error->message);
-    return;
-  }
-
-  if (self->gtk_theme_name) {
-    self->gtk_theme_status = GPOINTER_TO_INT(
-        g_hash_table_lookup(gtk_theme_status, self->gtk_theme_name));
-  } else {
-    self->gtk_theme_status = SNAPD_THEME_STATUS_UNAVAILABLE;
-  }
-  if (self->icon_theme_name) {
-    self->icon_theme_status = GPOINTER_TO_INT(
-        g_hash_table_lookup(icon_theme_status, self->icon_theme_name));
-  } else {
-    self->icon_theme_status = SNAPD_THEME_STATUS_UNAVAILABLE;
-  }
-  if (self->cursor_theme_name) {
-    self->cursor_theme_status = GPOINTER_TO_INT(
-        g_hash_table_lookup(icon_theme_status, self->cursor_theme_name));
-  } else {
-    self->cursor_theme_status = SNAPD_THEME_STATUS_UNAVAILABLE;
-  }
-  if (self->sound_theme_name) {
-    self->sound_theme_status = GPOINTER_TO_INT(
-        g_hash_table_lookup(sound_theme_status, self->sound_theme_name));
-  } else {
-    self->sound_theme_status = SNAPD_THEME_STATUS_UNAVAILABLE;
+/**
+ * Gets the status of a theme from the cache. A theme without name is
+ * always unavailable.
+ */
+static gboolean lookup_theme_status(SdiThemeMonitor *self, SdiThemeKind kind,
+                                    const gchar *name,
+                                    SnapdThemeStatus *status) {
+  if (name == NULL) {
+    *status = SNAPD_THEME_STATUS_UNAVAILABLE;
+    return TRUE;
   }
+  return sdi_theme_cache_lookup(self->cache, kind, name, status);
+}
 
+static void evaluate_themes_status(SdiThemeMonitor *self) {
   bool themes_available =
       self->gtk_theme_status == SNAPD_THEME_STATUS_AVAILABLE ||
       self->icon_theme_status == SNAPD_THEME_STATUS_AVAILABLE ||
@@ -232,6 +354,47 @@ static void check_themes_cb(GObject *object, GAsyncResult *result,
   show_install_notification(self);
 }
 
+static void check_themes_cb(GObject *object, GAsyncResult *result,
+                            gpointer user_data) {
+  SdiThemeMonitor *self = user_data;
+
+  g_autoptr(GHashTable) gtk_theme_status = NULL;
+  g_autoptr(GHashTable) icon_theme_status = NULL;
+  g_autoptr(GHashTable) sound_theme_status = NULL;
+  g_autoptr(GError) error = NULL;
+  if (!snapd_client_check_themes_finish(SNAPD_CLIENT(object), result,
+                                        &gtk_theme_status, &icon_theme_status,
+                                        &sound_theme_status, &error)) {
+    if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+      g_warning("Could not check themes: %s", error->message);
+    }
+    return;
+  }
+
+  sdi_theme_cache_store_all(self->cache, SDI_THEME_KIND_GTK, gtk_theme_status);
+  sdi_theme_cache_store_all(self->cache, SDI_THEME_KIND_ICON,
+                            icon_theme_status);
+  sdi_theme_cache_store_all(self->cache, SDI_THEME_KIND_SOUND,
+                            sound_theme_status);
+
+  /* The themes could have changed while waiting for snapd; any theme not
+   * in the cache now will be checked again by the next get_themes_cb(). */
+  lookup_theme_status(self, SDI_THEME_KIND_GTK, self->gtk_theme_name,
+                      &self->gtk_theme_status);
+  lookup_theme_status(self, SDI_THEME_KIND_ICON, self->icon_theme_name,
+                      &self->icon_theme_status);
+  lookup_theme_status(self, SDI_THEME_KIND_ICON, self->cursor_theme_name,
+                      &self->cursor_theme_status);
+  lookup_theme_status(self, SDI_THEME_KIND_SOUND, self->sound_theme_name,
+                      &self->sound_theme_status);
+
+  evaluate_themes_status(self);
+}
+
+/**
+ * Computes the effective theme set from the current settings, and checks
+ * the status of its themes, unless it didn't change since the last time.
+ */
 static gboolean get_themes_cb(SdiThemeMonitor *self) {
   self->check_delay_timer_id = 0;
 
@@ -271,31 +434,47 @@ static gboolean get_themes_cb(SdiThemeMonitor *self) {
   self->sound_theme_name = g_steal_pointer(&sound_theme_name);
   self->sound_theme_status = 0;
 
+  /* Only the themes whose status isn't cached are sent to snapd */
+  guint n_uncached = 0;
   g_autoptr(GPtrArray) gtk_theme_names = g_ptr_array_new();
-  if (self->gtk_theme_name) {
+  if (!lookup_theme_status(self, SDI_THEME_KIND_GTK, self->gtk_theme_name,
+                           &self->gtk_theme_status)) {
     g_ptr_array_add(gtk_theme_names, self->gtk_theme_name);
+    n_uncached++;
   }
   g_ptr_array_add(gtk_theme_names, NULL);
 
   g_autoptr(GPtrArray) icon_theme_names = g_ptr_array_new();
-  if (self->icon_theme_name) {
+  if (!lookup_theme_status(self, SDI_THEME_KIND_ICON, self->icon_theme_name,
+                           &self->icon_theme_status)) {
     g_ptr_array_add(icon_theme_names, self->icon_theme_name);
+    n_uncached++;
   }
-  if (self->cursor_theme_name) {
+  if (!lookup_theme_status(self, SDI_THEME_KIND_ICON, self->cursor_theme_name,
+                           &self->cursor_theme_status)) {
     g_ptr_array_add(icon_theme_names, self->cursor_theme_name);
+    n_uncached++;
   }
   g_ptr_array_add(icon_theme_names, NULL);
 
   g_autoptr(GPtrArray) sound_theme_names = g_ptr_array_new();
-  if (self->sound_theme_name) {
+  if (!lookup_theme_status(self, SDI_THEME_KIND_SOUND, self->sound_theme_name,
+                           &self->sound_theme_status)) {
     g_ptr_array_add(sound_theme_names, self->sound_theme_name);
+    n_uncached++;
   }
   g_ptr_array_add(sound_theme_names, NULL);
 
+  if (n_uncached == 0) {
+    g_debug("Theme status found in the cache");
+    evaluate_themes_status(self);
+    return G_SOURCE_REMOVE;
+  }
+
   snapd_client_check_themes_async(
       self->client, (gchar **)gtk_theme_names->pdata,
       (gchar **)icon_theme_names->pdata, (gchar **)sound_theme_names->pdata,
-      NULL, check_themes_cb, self);
+      self->cancellable, check_themes_cb, self);
 
   return G_SOURCE_REMOVE;
 }
@@ -308,10 +487,18 @@ static void queue_check_theme(SdiThemeMonitor *self) {
       CHECK_THEME_TIMEOUT_SECONDS, G_SOURCE_FUNC(get_themes_cb), self);
 }
 
+static void settings_notify_cb(SdiThemeMonitor *self, GParamSpec *pspec) {
+  if (g_strv_contains(watched_settings, g_param_spec_get_name(pspec))) {
+    queue_check_theme(self);
+  }
+}
+
 static void sdi_theme_monitor_dispose(GObject *object) {
   SdiThemeMonitor *self = SDI_THEME_MONITOR(object);
 
   g_clear_object(&self->settings);
+  g_cancellable_cancel(self->cancellable);
+  g_clear_object(&self->cancellable);
   g_clear_handle_id(&self->check_delay_timer_id, g_source_remove);
   g_clear_pointer(&self->gtk_theme_name, g_free);
   g_clear_pointer(&self->icon_theme_name, g_free);
@@ -319,6 +506,10 @@ static void sdi_theme_monitor_dispose(GObject *object) {
   g_clear_pointer(&self->sound_theme_name, g_free);
   g_clear_object(&self->install_notification);
   g_clear_object(&self->progress_notification);
+  g_cancellable_cancel(self->install_cancellable);
+  g_clear_object(&self->install_cancellable);
+  g_clear_object(&self->prefetcher);
+  g_clear_object(&self->cache);
   g_clear_object(&self->client);
 
   G_OBJECT_CLASS(sdi_theme_monitor_parent_class)->dispose(object);
@@ -326,27 +517,81 @@ static void sdi_theme_monitor_dispose(GObject *object) {
 
 void sdi_theme_monitor_init(SdiThemeMonitor *self) {
   self->settings = gtk_settings_get_default();
+  self->cancellable = g_cancellable_new();
+  self->cache = sdi_theme_cache_new(THEME_CACHE_TTL_SECONDS);
 }
 
 void sdi_theme_monitor_class_init(SdiThemeMonitorClass *klass) {
   G_OBJECT_CLASS(klass)->dispose = sdi_theme_monitor_dispose;
+
+  g_signal_new("begin-install", G_TYPE_FROM_CLASS(klass), G_SIGNAL_RUN_LAST, 0,
+               NULL, NULL, NULL, G_TYPE_NONE, 2, G_TYPE_STRING, G_TYPE_STRING);
+  g_signal_new("install-progress", G_TYPE_FROM_CLASS(klass), G_SIGNAL_RUN_LAST,
+               0, NULL, NULL, NULL, G_TYPE_NONE, 6, G_TYPE_STRING,
+               G_TYPE_STRING, G_TYPE_UINT64, G_TYPE_UINT64, G_TYPE_UINT,
+               G_TYPE_UINT);
+  g_signal_new("end-install", G_TYPE_FROM_CLASS(klass), G_SIGNAL_RUN_LAST, 0,
+               NULL, NULL, NULL, G_TYPE_NONE, 1, G_TYPE_STRING);
 }
 
 SdiThemeMonitor *sdi_theme_monitor_new(SnapdClient *client) {
   SdiThemeMonitor *self = g_object_new(SDI_TYPE_THEME_MONITOR, NULL);
   self->client = g_object_ref(client);
+  self->prefetcher = sdi_theme_prefetcher_new(client, self->cache);
   return self;
 }
 
 void sdi_theme_monitor_start(SdiThemeMonitor *self) {
-  /* Listen for theme changes. */
-  g_signal_connect_swapped(self->settings, "notify::gtk-theme-name",
-                           G_CALLBACK(queue_check_theme), self);
-  g_signal_connect_swapped(self->settings, "notify::gtk-icon-theme-name",
-                           G_CALLBACK(queue_check_theme), self);
-  g_signal_connect_swapped(self->settings, "notify::gtk-cursor-theme-name",
-                           G_CALLBACK(queue_check_theme), self);
-  g_signal_connect_swapped(self->settings, "notify::gtk-sound-theme-name",
-                           G_CALLBACK(queue_check_theme), self);
+  /* Listen for theme changes. All of them end in queue_check_theme(), so a
+   * burst of changes results in a single evaluation of the theme set. */
+  g_signal_connect_object(self->settings, "notify",
+                          G_CALLBACK(settings_notify_cb), self,
+                          G_CONNECT_SWAPPED);
   get_themes_cb(self);
+  sdi_theme_prefetcher_schedule(self->prefetcher, PREFETCH_DELAY_SECONDS);
+}
+
+/**
+ * Cancels the theme install in progress, if there is one. This should be
+ * connected to the `cancel-install` signal from a #sdi_progress_window.
+ */
+void sdi_theme_monitor_cancel_install(SdiThemeMonitor *self) {
+  if (self->install_cancellable == NULL) {
+    return;
+  }
+  g_message("Cancelling theme install\n");
+  g_cancellable_cancel(self->install_cancellable);
+  /// TRANSLATORS: installing a missing theme snap was cancelled by the user
+  end_install(self, _("Canceled by the user."));
+}
+
+/**
+ * Returns the notice types that `sdi_theme_monitor_notice()` processes,
+ * to be passed to `sdi_snapd_monitor_add_notice_types()`.
+ */
+const gchar *const *sdi_theme_monitor_get_notice_types(void) {
+  static const gchar *const types[] = {SDI_THEME_MONITOR_NOTICE_TYPES, NULL};
+  return types;
+}
+
+/**
+ * Installing or removing a snap can change the status of any theme, so
+ * the cache is emptied and the themes will be checked again in snapd the
+ * next time they are used.
+ */
+void sdi_theme_monitor_notice(SdiThemeMonitor *self, SnapdNotice *notice,
+                              gboolean first_run) {
+  if (first_run ||
+      snapd_notice_get_notice_type(notice) != SNAPD_NOTICE_TYPE_CHANGE_UPDATE) {
+    return;
+  }
+
+  GHashTable *notice_data = snapd_notice_get_last_data2(notice);
+  const gchar *kind = g_hash_table_lookup(notice_data, "kind");
+  if ((g_strcmp0(kind, "install-snap") == 0) ||
+      (g_strcmp0(kind, "remove-snap") == 0) ||
+      (g_strcmp0(kind, "install-themes") == 0)) {
+    sdi_theme_cache_invalidate(self->cache);
+    sdi_theme_prefetcher_schedule(self->prefetcher, PREFETCH_DELAY_SECONDS);
+  }
 }
@@ -31,4 +31,11 @@ SdiThemeMonitor *sdi_theme_monitor_new(SnapdClient *client);
 
 void sdi_theme_monitor_start(SdiThemeMonitor *monitor);
 
+void sdi_theme_monitor_cancel_install(SdiThemeMonitor *monitor);
+
+void sdi_theme_monitor_notice(SdiThemeMonitor *monitor, SnapdNotice *notice,
+                              gboolean first_run);
+
+const gchar *const *sdi_theme_monitor_get_notice_types(void);
+
 G_END_DECLS
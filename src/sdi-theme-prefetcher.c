@@ -0,0 +1,249 @@
+/*
+ * Copyright (C) 2024 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "sdi-theme-prefetcher.h"
+#include <gio/gio.h>
+
+/**
+ * This class fills the theme cache with the status of every theme installed
+ * in the system, so when the user switches to one of them, the theme monitor
+ * doesn't have to wait for snapd.
+ *
+ * The theme folders are read in a thread, and all the themes not already
+ * in the cache are checked with a single request, at low priority.
+ */
+
+// maximum number of themes of each kind sent to snapd, to limit the URL size
+#define MAX_PREFETCHED_THEMES 64
+
+struct _SdiThemePrefetcher {
+  GObject parent_instance;
+
+  SnapdClient *client;
+  SdiThemeCache *cache;
+  guint timer_id;
+  GCancellable *cancellable;
+};
+
+G_DEFINE_TYPE(SdiThemePrefetcher, sdi_theme_prefetcher, G_TYPE_OBJECT)
+
+typedef struct {
+  GPtrArray *gtk_theme_names;
+  GPtrArray *icon_theme_names;
+  GPtrArray *sound_theme_names;
+} LocalThemes;
+
+static void free_local_themes(LocalThemes *themes) {
+  g_ptr_array_unref(themes->gtk_theme_names);
+  g_ptr_array_unref(themes->icon_theme_names);
+  g_ptr_array_unref(themes->sound_theme_names);
+  g_free(themes);
+}
+
+/**
+ * Adds to @names each folder inside @path that contains any of the
+ * specified @children.
+ */
+static void add_themes_from_dir(GHashTable *names, const gchar *path,
+                                const gchar *const *children) {
+  g_autoptr(GDir) dir = g_dir_open(path, 0, NULL);
+  if (dir == NULL) {
+    return;
+  }
+  const gchar *name;
+  while ((name = g_dir_read_name(dir)) != NULL) {
+    if (g_str_equal(name, "default") || g_str_equal(name, "hicolor")) {
+      continue;
+    }
+    for (const gchar *const *child = children; *child != NULL; child++) {
+      g_autofree gchar *child_path = g_build_filename(path, name, *child, NULL);
+      if (g_file_test(child_path, G_FILE_TEST_EXISTS)) {
+        g_hash_table_add(names, g_strdup(name));
+        break;
+      }
+    }
+  }
+}
+
+static GPtrArray *find_themes(const gchar *home_folder, const gchar *folder,
+                              const gchar *const *children) {
+  g_autoptr(GHashTable) names =
+      g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+  if (home_folder != NULL) {
+    g_autofree gchar *path =
+        g_build_filename(g_get_home_dir(), home_folder, NULL);
+    add_themes_from_dir(names, path, children);
+  }
+  g_autofree gchar *user_path =
+      g_build_filename(g_get_user_data_dir(), folder, NULL);
+  add_themes_from_dir(names, user_path, children);
+  for (const gchar *const *data_dir = g_get_system_data_dirs();
+       *data_dir != NULL; data_dir++) {
+    g_autofree gchar *path = g_build_filename(*data_dir, folder, NULL);
+    add_themes_from_dir(names, path, children);
+  }
+
+  GPtrArray *themes = g_ptr_array_new_with_free_func(g_free);
+  GHashTableIter iter;
+  gpointer name;
+  g_hash_table_iter_init(&iter, names);
+  while (g_hash_table_iter_next(&iter, &name, NULL)) {
+    g_ptr_array_add(themes, g_strdup(name));
+  }
+  return themes;
+}
+
+static void find_local_themes(GTask *task, gpointer source_object,
+                              gpointer task_data, GCancellable *cancellable) {
+  static const gchar *const gtk_children[] = {"gtk-3.0", NULL};
+  // cursor themes are stored as icon themes, but can lack an index
+  static const gchar *const icon_children[] = {"index.theme", "cursors", NULL};
+  static const gchar *const sound_children[] = {"index.theme", NULL};
+
+  LocalThemes *themes = g_malloc0(sizeof(LocalThemes));
+  themes->gtk_theme_names = find_themes(".themes", "themes", gtk_children);
+  themes->icon_theme_names = find_themes(".icons", "icons", icon_children);
+  themes->sound_theme_names = find_themes(NULL, "sounds", sound_children);
+  g_task_return_pointer(task, themes, (GDestroyNotify)free_local_themes);
+}
+
+static void check_themes_cb(GObject *object, GAsyncResult *result,
+                            gpointer user_data) {
+  SdiThemePrefetcher *self = user_data;
+  g_autoptr(GHashTable) gtk_theme_status = NULL;
+  g_autoptr(GHashTable) icon_theme_status = NULL;
+  g_autoptr(GHashTable) sound_theme_status = NULL;
+  g_autoptr(GError) error = NULL;
+
+  if (!snapd_client_check_themes_finish(SNAPD_CLIENT(object), result,
+                                        &gtk_theme_status, &icon_theme_status,
+                                        &sound_theme_status, &error)) {
+    if (!g_error_matches(error, G_IO_ERROR, G_IO_ERROR_CANCELLED)) {
+      g_debug("Could not prefetch theme status: %s", error->message);
+    }
+    return;
+  }
+
+  sdi_theme_cache_store_all(self->cache, SDI_THEME_KIND_GTK, gtk_theme_status);
+  sdi_theme_cache_store_all(self->cache, SDI_THEME_KIND_ICON,
+                            icon_theme_status);
+  sdi_theme_cache_store_all(self->cache, SDI_THEME_KIND_SOUND,
+                            sound_theme_status);
+  g_debug("Theme cache prefetched; %u themes cached",
+          sdi_theme_cache_get_size(self->cache));
+}
+
+/**
+ * Builds a NULL-terminated list with the themes in @names that aren't in
+ * the cache. The strings belong to @names.
+ */
+static GPtrArray *get_uncached_themes(SdiThemePrefetcher *self,
+                                      SdiThemeKind kind, GPtrArray *names,
+                                      guint *n_uncached) {
+  GPtrArray *uncached = g_ptr_array_new();
+  for (guint i = 0; i < names->len; i++) {
+    const gchar *name = g_ptr_array_index(names, i);
+    if (uncached->len == MAX_PREFETCHED_THEMES) {
+      break;
+    }
+    if (!sdi_theme_cache_lookup(self->cache, kind, name, NULL)) {
+      g_ptr_array_add(uncached, (gpointer)name);
+    }
+  }
+  *n_uncached += uncached->len;
+  g_ptr_array_add(uncached, NULL);
+  return uncached;
+}
+
+static void find_local_themes_cb(GObject *object, GAsyncResult *result,
+                                 gpointer user_data) {
+  SdiThemePrefetcher *self = SDI_THEME_PREFETCHER(object);
+  g_autoptr(GError) error = NULL;
+
+  LocalThemes *themes = g_task_propagate_pointer(G_TASK(result), &error);
+  if (themes == NULL) {
+    return;
+  }
+
+  guint n_uncached = 0;
+  g_autoptr(GPtrArray) gtk_theme_names = get_uncached_themes(
+      self, SDI_THEME_KIND_GTK, themes->gtk_theme_names, &n_uncached);
+  g_autoptr(GPtrArray) icon_theme_names = get_uncached_themes(
+      self, SDI_THEME_KIND_ICON, themes->icon_theme_names, &n_uncached);
+  g_autoptr(GPtrArray) sound_theme_names = get_uncached_themes(
+      self, SDI_THEME_KIND_SOUND, themes->sound_theme_names, &n_uncached);
+
+  if (n_uncached != 0) {
+    // snapd-glib copies the names, so they can be freed after this call
+    snapd_client_check_themes_async(
+        self->client, (gchar **)gtk_theme_names->pdata,
+        (gchar **)icon_theme_names->pdata, (gchar **)sound_theme_names->pdata,
+        self->cancellable, check_themes_cb, self);
+  }
+  free_local_themes(themes);
+}
+
+static gboolean prefetch_cb(SdiThemePrefetcher *self) {
+  self->timer_id = 0;
+
+  g_autoptr(GTask) task =
+      g_task_new(self, self->cancellable, find_local_themes_cb, NULL);
+  g_task_set_priority(task, G_PRIORITY_LOW);
+  g_task_run_in_thread(task, find_local_themes);
+  return G_SOURCE_REMOVE;
+}
+
+/**
+ * Prefetches the status of the local themes after @delay seconds. If
+ * already scheduled, the timer is restarted, so bursts of calls, like
+ * several notices while installing snaps, result in a single prefetch.
+ */
+void sdi_theme_prefetcher_schedule(SdiThemePrefetcher *self, guint delay) {
+  g_return_if_fail(SDI_IS_THEME_PREFETCHER(self));
+
+  g_clear_handle_id(&self->timer_id, g_source_remove);
+  self->timer_id = g_timeout_add_seconds_full(
+      G_PRIORITY_LOW, delay, G_SOURCE_FUNC(prefetch_cb), self, NULL);
+}
+
+static void sdi_theme_prefetcher_dispose(GObject *object) {
+  SdiThemePrefetcher *self = SDI_THEME_PREFETCHER(object);
+
+  g_clear_handle_id(&self->timer_id, g_source_remove);
+  g_cancellable_cancel(self->cancellable);
+  g_clear_object(&self->cancellable);
+  g_clear_object(&self->cache);
+  g_clear_object(&self->client);
+
+  G_OBJECT_CLASS(sdi_theme_prefetcher_parent_class)->dispose(object);
+}
+
+void sdi_theme_prefetcher_init(SdiThemePrefetcher *self) {
+  self->cancellable = g_cancellable_new();
+}
+
+void sdi_theme_prefetcher_class_init(SdiThemePrefetcherClass *klass) {
+  G_OBJECT_CLASS(klass)->dispose = sdi_theme_prefetcher_dispose;
+}
+
+SdiThemePrefetcher *sdi_theme_prefetcher_new(SnapdClient *client,
+                                             SdiThemeCache *cache) {
+  SdiThemePrefetcher *self = g_object_new(SDI_TYPE_THEME_PREFETCHER, NULL);
+  self->client = g_object_ref(client);
+  self->cache = g_object_ref(cache);
+  return self;
+}
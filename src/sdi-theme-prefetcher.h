@@ -0,0 +1,35 @@
+/*
+ * Copyright (C) 2024 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#pragma once
+
+#include "sdi-theme-cache.h"
+#include <glib-object.h>
+#include <snapd-glib/snapd-glib.h>
+
+G_BEGIN_DECLS
+
+#define SDI_TYPE_THEME_PREFETCHER sdi_theme_prefetcher_get_type()
+
+G_DECLARE_FINAL_TYPE(SdiThemePrefetcher, sdi_theme_prefetcher, SDI,
+                     THEME_PREFETCHER, GObject)
+
+SdiThemePrefetcher *sdi_theme_prefetcher_new(SnapdClient *client,
+                                             SdiThemeCache *cache);
+
+void sdi_theme_prefetcher_schedule(SdiThemePrefetcher *self, guint delay);
+
+G_END_DECLS
@@ -0,0 +1,232 @@
+/*
+ * Copyright (C) 2024 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "sdi-ui-helper-client.h"
+
+/**
+ * This class sends the progress window requests to the UI helper
+ * (snapd-desktop-integration-ui), which shows the progress dialogs in a
+ * separate process when the daemon is built with the `ui-helper` option.
+ * It has the same API than #SdiProgressWindow, including the
+ * `cancel-install` signal.
+ *
+ * The helper isn't kept running: the first request starts it through D-Bus
+ * activation, and it exits by itself when no dialog has been shown for a
+ * while. The calls don't wait for a reply, and the D-Bus daemon queues them
+ * in order while the helper is being started.
+ *
+ * Only the refreshes and installs begun through this object are sent to the
+ * helper, because any call to it starts it, and the refresh monitor sends
+ * the progress of every snap being refreshed, even if it has no dialog.
+ */
+
+#define PROGRESS_WINDOW_INTERFACE                                              \
+  "io.snapcraft.SnapDesktopIntegration.ProgressWindow"
+
+struct _SdiUiHelperClient {
+  GObject parent_instance;
+
+  GDBusConnection *connection;
+  guint helper_watch_id;
+  guint cancel_install_id;
+  // IDs of the refreshes and installs begun in the helper
+  GHashTable *active_ids;
+};
+
+G_DEFINE_TYPE(SdiUiHelperClient, sdi_ui_helper_client, G_TYPE_OBJECT)
+
+static void call_cb(GObject *object, GAsyncResult *result, gpointer data) {
+  const gchar *method = data;
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GVariant) reply =
+      g_dbus_connection_call_finish(G_DBUS_CONNECTION(object), result, &error);
+  if (reply == NULL) {
+    g_warning("Failed to call %s in the UI helper: %s", method,
+              error->message);
+  }
+}
+
+/* @method must be a static string, because it is used in the callback.
+ * @parameters is consumed if it is floating.
+ */
+static void call_ui_helper(SdiUiHelperClient *self, const gchar *method,
+                           GVariant *parameters) {
+  g_dbus_connection_call(self->connection, SDI_UI_HELPER_NAME,
+                         SDI_UI_HELPER_PROGRESS_WINDOW_PATH,
+                         PROGRESS_WINDOW_INTERFACE, method, parameters, NULL,
+                         G_DBUS_CALL_FLAGS_NONE, -1, NULL, call_cb,
+                         (gpointer)method);
+}
+
+// D-Bus strings can't be NULL, so an empty string is sent instead
+static const gchar *non_null(const gchar *value) {
+  return value == NULL ? "" : value;
+}
+
+static void cancel_install_cb(GDBusConnection *connection,
+                              const gchar *sender_name,
+                              const gchar *object_path,
+                              const gchar *interface_name,
+                              const gchar *signal_name, GVariant *parameters,
+                              SdiUiHelperClient *self) {
+  const gchar *install_id = NULL;
+  g_variant_get(parameters, "(&s)", &install_id);
+  g_signal_emit_by_name(self, "cancel-install", install_id);
+}
+
+static void unsubscribe_cancel_install(SdiUiHelperClient *self) {
+  if (self->cancel_install_id != 0) {
+    g_dbus_connection_signal_unsubscribe(self->connection,
+                                         self->cancel_install_id);
+    self->cancel_install_id = 0;
+  }
+}
+
+/* The helper has a different unique name each time that it is started, so
+ * the signal is subscribed again with the new name when it appears.
+ */
+static void helper_appeared_cb(GDBusConnection *connection, const gchar *name,
+                               const gchar *name_owner,
+                               SdiUiHelperClient *self) {
+  unsubscribe_cancel_install(self);
+  self->cancel_install_id = g_dbus_connection_signal_subscribe(
+      self->connection, name_owner, PROGRESS_WINDOW_INTERFACE,
+      "CancelInstall", SDI_UI_HELPER_PROGRESS_WINDOW_PATH, NULL,
+      G_DBUS_SIGNAL_FLAGS_NONE, (GDBusSignalCallback)cancel_install_cb, self,
+      NULL);
+}
+
+/* The dialogs of the helper are gone with it, so their updates must not
+ * start it again. This is also called when the watch starts before the
+ * helper is running, and then the refreshes just begun are kept.
+ */
+static void helper_vanished_cb(GDBusConnection *connection,
+                               const gchar *name, SdiUiHelperClient *self) {
+  if (self->cancel_install_id != 0) {
+    g_hash_table_remove_all(self->active_ids);
+  }
+  unsubscribe_cancel_install(self);
+}
+
+void sdi_ui_helper_client_begin_refresh(SdiUiHelperClient *self,
+                                        gchar *snap_name, gchar *visible_name,
+                                        gchar *icon) {
+  g_return_if_fail(SDI_IS_UI_HELPER_CLIENT(self));
+
+  g_hash_table_add(self->active_ids, g_strdup(non_null(snap_name)));
+  call_ui_helper(self, "BeginRefresh",
+                 g_variant_new("(sss)", non_null(snap_name),
+                               non_null(visible_name), non_null(icon)));
+}
+
+void sdi_ui_helper_client_update_progress(SdiUiHelperClient *self,
+                                          gchar *snap_name,
+                                          GStrv desktop_files,
+                                          gchar *task_description,
+                                          guint done_tasks, guint total_tasks,
+                                          gboolean task_done) {
+  g_return_if_fail(SDI_IS_UI_HELPER_CLIENT(self));
+
+  if (snap_name == NULL ||
+      !g_hash_table_contains(self->active_ids, snap_name)) {
+    return;
+  }
+  GVariant *files = (desktop_files == NULL)
+                        ? g_variant_new_strv(NULL, 0)
+                        : g_variant_new_strv(
+                              (const gchar *const *)desktop_files, -1);
+  call_ui_helper(self, "UpdateProgress",
+                 g_variant_new("(s@assuub)", snap_name, files,
+                               non_null(task_description), done_tasks,
+                               total_tasks, task_done));
+}
+
+void sdi_ui_helper_client_end_refresh(SdiUiHelperClient *self,
+                                      gchar *snap_name) {
+  g_return_if_fail(SDI_IS_UI_HELPER_CLIENT(self));
+
+  if (!g_hash_table_remove(self->active_ids, non_null(snap_name))) {
+    return;
+  }
+  call_ui_helper(self, "EndRefresh",
+                 g_variant_new("(s)", non_null(snap_name)));
+}
+
+void sdi_ui_helper_client_begin_install(SdiUiHelperClient *self,
+                                        gchar *install_id, gchar *message) {
+  g_return_if_fail(SDI_IS_UI_HELPER_CLIENT(self));
+
+  g_hash_table_add(self->active_ids, g_strdup(non_null(install_id)));
+  call_ui_helper(
+      self, "BeginInstall",
+      g_variant_new("(ss)", non_null(install_id), non_null(message)));
+}
+
+void sdi_ui_helper_client_update_install_progress(
+    SdiUiHelperClient *self, gchar *install_id, gchar *task_description,
+    guint64 done_bytes, guint64 total_bytes, guint done_tasks,
+    guint total_tasks) {
+  g_return_if_fail(SDI_IS_UI_HELPER_CLIENT(self));
+
+  if (!g_hash_table_contains(self->active_ids, non_null(install_id))) {
+    return;
+  }
+  call_ui_helper(self, "UpdateInstallProgress",
+                 g_variant_new("(ssttuu)", non_null(install_id),
+                               non_null(task_description), done_bytes,
+                               total_bytes, done_tasks, total_tasks));
+}
+
+static void sdi_ui_helper_client_dispose(GObject *object) {
+  SdiUiHelperClient *self = SDI_UI_HELPER_CLIENT(object);
+
+  if (self->helper_watch_id != 0) {
+    g_bus_unwatch_name(self->helper_watch_id);
+    self->helper_watch_id = 0;
+  }
+  unsubscribe_cancel_install(self);
+  g_clear_object(&self->connection);
+  g_clear_pointer(&self->active_ids, g_hash_table_unref);
+
+  G_OBJECT_CLASS(sdi_ui_helper_client_parent_class)->dispose(object);
+}
+
+static void sdi_ui_helper_client_class_init(SdiUiHelperClientClass *klass) {
+  GObjectClass *gobject_class = G_OBJECT_CLASS(klass);
+
+  gobject_class->dispose = sdi_ui_helper_client_dispose;
+
+  g_signal_new("cancel-install", G_TYPE_FROM_CLASS(klass), G_SIGNAL_RUN_LAST,
+               0, NULL, NULL, NULL, G_TYPE_NONE, 1, G_TYPE_STRING);
+}
+
+static void sdi_ui_helper_client_init(SdiUiHelperClient *self) {
+  self->active_ids =
+      g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+}
+
+SdiUiHelperClient *sdi_ui_helper_client_new(GApplication *application) {
+  SdiUiHelperClient *self = g_object_new(SDI_TYPE_UI_HELPER_CLIENT, NULL);
+  self->connection =
+      g_object_ref(g_application_get_dbus_connection(application));
+  // watching the name doesn't start the helper
+  self->helper_watch_id = g_bus_watch_name_on_connection(
+      self->connection, SDI_UI_HELPER_NAME, G_BUS_NAME_WATCHER_FLAGS_NONE,
+      (GBusNameAppearedCallback)helper_appeared_cb,
+      (GBusNameVanishedCallback)helper_vanished_cb, self, NULL);
+  return self;
+}
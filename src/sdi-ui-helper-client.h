@@ -0,0 +1,57 @@
+/*
+ * Copyright (C) 2024 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+#define SDI_UI_HELPER_NAME "io.snapcraft.SnapDesktopIntegration.UI"
+#define SDI_UI_HELPER_PROGRESS_WINDOW_PATH                                     \
+  "/io/snapcraft/SnapDesktopIntegration/ProgressWindow"
+
+#define SDI_TYPE_UI_HELPER_CLIENT sdi_ui_helper_client_get_type()
+
+G_DECLARE_FINAL_TYPE(SdiUiHelperClient, sdi_ui_helper_client, SDI,
+                     UI_HELPER_CLIENT, GObject)
+
+SdiUiHelperClient *sdi_ui_helper_client_new(GApplication *application);
+
+void sdi_ui_helper_client_begin_refresh(SdiUiHelperClient *self,
+                                        gchar *snap_name, gchar *visible_name,
+                                        gchar *icon);
+
+void sdi_ui_helper_client_update_progress(SdiUiHelperClient *self,
+                                          gchar *snap_name,
+                                          GStrv desktop_files,
+                                          gchar *task_description,
+                                          guint done_tasks, guint total_tasks,
+                                          gboolean task_done);
+
+void sdi_ui_helper_client_end_refresh(SdiUiHelperClient *self,
+                                      gchar *snap_name);
+
+void sdi_ui_helper_client_begin_install(SdiUiHelperClient *self,
+                                        gchar *install_id, gchar *message);
+
+void sdi_ui_helper_client_update_install_progress(
+    SdiUiHelperClient *self, gchar *install_id, gchar *task_description,
+    guint64 done_bytes, guint64 total_bytes, guint done_tasks,
+    guint total_tasks);
+
+G_END_DECLS
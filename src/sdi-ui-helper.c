@@ -0,0 +1,181 @@
+/*
+ * Copyright (C) 2024 Canonical Ltd
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 3 as
+ * published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+
+#include "config.h"
+#include <glib/gi18n.h>
+#include <gtk/gtk.h>
+#include <locale.h>
+
+#include "io.snapcraft.SnapDesktopIntegration.ProgressWindow.h"
+#include "sdi-progress-window.h"
+#include "sdi-ui-helper-client.h"
+
+/**
+ * This is snapd-desktop-integration-ui, the UI helper used when the daemon is
+ * built with the `ui-helper` option, so the daemon doesn't need to keep the
+ * progress dialogs in memory all the time.
+ *
+ * It is started through D-Bus activation by #SdiUiHelperClient, and exports
+ * a #SdiProgressWindow in the
+ * io.snapcraft.SnapDesktopIntegration.ProgressWindow interface. The
+ * application is held while there are dialogs, and it exits after
+ * INACTIVITY_TIMEOUT without them.
+ */
+
+// time in ms without dialogs after which the helper exits
+#define INACTIVITY_TIMEOUT 30000
+
+static SdiProgressWindow *progress_window = NULL;
+static SdiDbusProgressWindow *skeleton = NULL;
+// IDs of the refreshes and installs being shown
+static GHashTable *active_ids = NULL;
+
+// D-Bus strings can't be NULL, so an empty string means NULL
+static gchar *nullable(const gchar *value) {
+  return (value == NULL || *value == '\0') ? NULL : (gchar *)value;
+}
+
+static void hold_id(GApplication *application, const gchar *id) {
+  if (!g_hash_table_contains(active_ids, id)) {
+    g_hash_table_add(active_ids, g_strdup(id));
+    g_application_hold(application);
+  }
+}
+
+static void release_id(GApplication *application, const gchar *id) {
+  if (g_hash_table_remove(active_ids, id)) {
+    g_application_release(application);
+  }
+}
+
+static gboolean handle_begin_refresh(SdiDbusProgressWindow *object,
+                                     GDBusMethodInvocation *invocation,
+                                     const gchar *snap_name,
+                                     const gchar *visible_name,
+                                     const gchar *icon,
+                                     GApplication *application) {
+  hold_id(application, snap_name);
+  sdi_progress_window_begin_refresh(progress_window, (gchar *)snap_name,
+                                    nullable(visible_name), nullable(icon));
+  sdi_dbus_progress_window_complete_begin_refresh(object, invocation);
+  return TRUE;
+}
+
+static gboolean
+handle_update_progress(SdiDbusProgressWindow *object,
+                       GDBusMethodInvocation *invocation,
+                       const gchar *snap_name,
+                       const gchar *const *desktop_files,
+                       const gchar *task_description, guint done_tasks,
+                       guint total_tasks, gboolean task_done,
+                       GApplication *application) {
+  sdi_progress_window_update_progress(
+      progress_window, (gchar *)snap_name, (GStrv)desktop_files,
+      nullable(task_description), done_tasks, total_tasks, task_done);
+  sdi_dbus_progress_window_complete_update_progress(object, invocation);
+  return TRUE;
+}
+
+static gboolean handle_end_refresh(SdiDbusProgressWindow *object,
+                                   GDBusMethodInvocation *invocation,
+                                   const gchar *id,
+                                   GApplication *application) {
+  sdi_progress_window_end_refresh(progress_window, (gchar *)id);
+  release_id(application, id);
+  sdi_dbus_progress_window_complete_end_refresh(object, invocation);
+  return TRUE;
+}
+
+static gboolean handle_begin_install(SdiDbusProgressWindow *object,
+                                     GDBusMethodInvocation *invocation,
+                                     const gchar *install_id,
+                                     const gchar *message,
+                                     GApplication *application) {
+  hold_id(application, install_id);
+  sdi_progress_window_begin_install(progress_window, (gchar *)install_id,
+                                    (gchar *)message);
+  sdi_dbus_progress_window_complete_begin_install(object, invocation);
+  return TRUE;
+}
+
+static gboolean handle_update_install_progress(
+    SdiDbusProgressWindow *object, GDBusMethodInvocation *invocation,
+    const gchar *install_id, const gchar *task_description,
+    guint64 done_bytes, guint64 total_bytes, guint done_tasks,
+    guint total_tasks, GApplication *application) {
+  sdi_progress_window_update_install_progress(
+      progress_window, (gchar *)install_id, nullable(task_description),
+      done_bytes, total_bytes, done_tasks, total_tasks);
+  sdi_dbus_progress_window_complete_update_install_progress(object,
+                                                            invocation);
+  return TRUE;
+}
+
+static void cancel_install_cb(SdiProgressWindow *window, gchar *install_id) {
+  sdi_dbus_progress_window_emit_cancel_install(skeleton, install_id);
+}
+
+static void do_startup(GObject *object, gpointer data) {
+  GApplication *application = G_APPLICATION(object);
+
+  active_ids = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  progress_window = sdi_progress_window_new(application);
+  g_signal_connect(progress_window, "cancel-install",
+                   (GCallback)cancel_install_cb, NULL);
+
+  skeleton = sdi_dbus_progress_window_skeleton_new();
+  g_signal_connect(skeleton, "handle-begin-refresh",
+                   (GCallback)handle_begin_refresh, application);
+  g_signal_connect(skeleton, "handle-update-progress",
+                   (GCallback)handle_update_progress, application);
+  g_signal_connect(skeleton, "handle-end-refresh",
+                   (GCallback)handle_end_refresh, application);
+  g_signal_connect(skeleton, "handle-begin-install",
+                   (GCallback)handle_begin_install, application);
+  g_signal_connect(skeleton, "handle-update-install-progress",
+                   (GCallback)handle_update_install_progress, application);
+
+  g_autoptr(GError) error = NULL;
+  if (!g_dbus_interface_skeleton_export(
+          G_DBUS_INTERFACE_SKELETON(skeleton),
+          g_application_get_dbus_connection(application),
+          SDI_UI_HELPER_PROGRESS_WINDOW_PATH, &error)) {
+    g_warning("Failed to export progress window DBus interface: %s",
+              error->message);
+  }
+}
+
+static void do_shutdown(GObject *object, gpointer data) {
+  g_dbus_interface_skeleton_unexport(G_DBUS_INTERFACE_SKELETON(skeleton));
+  g_clear_object(&skeleton);
+  g_clear_object(&progress_window);
+  g_clear_pointer(&active_ids, g_hash_table_unref);
+}
+
+int main(int argc, char **argv) {
+  setlocale(LC_ALL, "");
+  bindtextdomain(GETTEXT_PACKAGE, LOCALEDIR);
+  textdomain(GETTEXT_PACKAGE);
+
+  g_autoptr(GtkApplication) app =
+      gtk_application_new(SDI_UI_HELPER_NAME, G_APPLICATION_IS_SERVICE);
+  g_application_set_inactivity_timeout(G_APPLICATION(app), INACTIVITY_TIMEOUT);
+  g_signal_connect(G_OBJECT(app), "startup", G_CALLBACK(do_startup), NULL);
+  g_signal_connect(G_OBJECT(app), "shutdown", G_CALLBACK(do_shutdown), NULL);
+
+  return g_application_run(G_APPLICATION(app), argc, argv);
+}
@@ -16,6 +16,7 @@
  */
 
 #include "sdi-user-session-helper.h"
+#include "sdi-main-loop-watchdog.h"
 
 #include <stdbool.h>
 
@@ -36,9 +37,12 @@ static bool sdi_session_is_desktop(const gchar *object_path) {
   GVariant *user_data = NULL;
   const gchar *session_type = NULL;
 
+  sdi_main_loop_watchdog_begin_call(
+      "org_freedesktop_login1_session_proxy_new_for_bus_sync");
   session = org_freedesktop_login1_session_proxy_new_for_bus_sync(
       G_BUS_TYPE_SYSTEM, G_DBUS_PROXY_FLAGS_NONE, "org.freedesktop.login1",
       object_path, NULL, NULL);
+  sdi_main_loop_watchdog_end_call();
   user_data = org_freedesktop_login1_session_get_user(session);
   if (user_data == NULL) {
     g_message("Failed to read the session user data. Forcing a reload.");
@@ -79,8 +83,10 @@ static gboolean sdi_check_graphical_sessions(GMainLoop *loop) {
   GVariant *sessions = NULL;
   gboolean got_session_list;
 
+  sdi_main_loop_watchdog_begin_call("login1_manager_call_list_sessions_sync");
   got_session_list = login1_manager_call_list_sessions_sync(
       login_manager, &sessions, NULL, NULL);
+  sdi_main_loop_watchdog_end_call();
 
   if (got_session_list) {
     /* check if there is already a graphical session opened for us, in which
@@ -127,9 +133,11 @@ static void new_session(Login1Manager *manager, const gchar *session_id,
 
 void sdi_wait_for_graphical_session(void) {
   g_autoptr(GMainLoop) loop = g_main_loop_new(NULL, TRUE);
+  sdi_main_loop_watchdog_begin_call("login1_manager_proxy_new_for_bus_sync");
   login_manager = login1_manager_proxy_new_for_bus_sync(
       G_BUS_TYPE_SYSTEM, G_DBUS_PROXY_FLAGS_NONE, "org.freedesktop.login1",
       "/org/freedesktop/login1", NULL, NULL);
+  sdi_main_loop_watchdog_end_call();
   guint session_new_id = g_signal_connect(login_manager, "session-new",
                                           G_CALLBACK(new_session), loop);
   /* Check if we are already in a graphical session to avoid race conditions
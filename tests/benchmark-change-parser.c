@@ -0,0 +1,269 @@
+// needed for RUSAGE_THREAD
+#define _GNU_SOURCE
+
+#include "../src/sdi-change-summary.h"
+#include "../src/sdi-snapd-client-factory.h"
+#include "mock-snapd.h"
+
+#include <sys/resource.h>
+
+/* Benchmark of the fast change parser against snapd-glib.
+ *
+ * It populates mock-snapd with a change with many tasks, each one of them
+ * affecting several snaps, and requests it repeatedly in two ways: with
+ * snapd-glib, converting the #SnapdChange into a #SdiChangeSummary as the
+ * refresh monitor does, and with `sdi_change_summary_request_async()`. The
+ * tasks are already complete, so the mock returns the same change every
+ * time.
+ *
+ * It prints the wall time, the CPU time and the allocations done by the
+ * main thread per request for each path. It returns a non-zero value if
+ * both paths don't return the same summary, or if the fast path isn't
+ * faster than snapd-glib by the factor passed in --min-speedup.
+ */
+
+static gint n_tasks = 500;
+static gint n_snaps = 2;
+static gint n_requests = 20;
+static gdouble min_speedup = 0;
+
+static GOptionEntry entries[] = {
+    {"tasks", 0, 0, G_OPTION_ARG_INT, &n_tasks, "Tasks in the change", "M"},
+    {"snaps", 0, 0, G_OPTION_ARG_INT, &n_snaps, "Snaps affected by each task",
+     "K"},
+    {"requests", 0, 0, G_OPTION_ARG_INT, &n_requests,
+     "Number of requests done with each parser", "N"},
+    {"min-speedup", 0, 0, G_OPTION_ARG_DOUBLE, &min_speedup,
+     "Fail if the CPU time of snapd-glib divided by the one of the fast "
+     "parser is smaller than this value",
+     "FACTOR"},
+    {NULL}};
+
+/* Allocations are counted by interposing the allocator, like in
+ * benchmark-refresh-monitor. Only the allocations done in the main thread
+ * are counted, so the ones done by mock-snapd's own thread are ignored.
+ */
+#ifdef __GLIBC__
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static __thread gboolean count_allocations = FALSE;
+static guint64 n_allocations = 0;
+
+void *malloc(size_t size) {
+  if (count_allocations)
+    n_allocations++;
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+  if (count_allocations)
+    n_allocations++;
+  return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+  if (count_allocations)
+    n_allocations++;
+  return __libc_realloc(ptr, size);
+}
+#endif
+
+typedef struct {
+  gint64 wall_time;
+  gdouble cpu_time;
+  guint64 allocations;
+} Measure;
+
+static gdouble get_thread_cpu_time(void) {
+  struct rusage usage;
+  if (getrusage(RUSAGE_THREAD, &usage) != 0) {
+    return 0;
+  }
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+         (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0;
+}
+
+static void begin_measure(Measure *measure) {
+  measure->wall_time = g_get_monotonic_time();
+  measure->cpu_time = get_thread_cpu_time();
+#ifdef __GLIBC__
+  n_allocations = 0;
+  count_allocations = TRUE;
+#endif
+}
+
+static void end_measure(Measure *measure) {
+#ifdef __GLIBC__
+  count_allocations = FALSE;
+  measure->allocations = n_allocations;
+#endif
+  measure->cpu_time = get_thread_cpu_time() - measure->cpu_time;
+  measure->wall_time = g_get_monotonic_time() - measure->wall_time;
+}
+
+static const gchar *populate_mock_snapd(MockSnapd *snapd) {
+  static const gchar *statuses[] = {"Done", "Doing", "Do"};
+
+  MockChange *change = mock_snapd_add_change(snapd);
+  mock_change_set_kind(change, "auto-refresh");
+  for (gint t = 0; t < n_tasks; t++) {
+    MockTask *task = mock_change_add_task(change, "download");
+    // complete tasks aren't advanced by the mock
+    mock_task_set_progress(task, 1, 1);
+    mock_task_set_status(task, statuses[t * G_N_ELEMENTS(statuses) / n_tasks]);
+    for (gint s = 0; s < n_snaps; s++) {
+      g_autofree gchar *snap_name = g_strdup_printf("bench-snap-%d", s);
+      mock_task_add_affected_snap(task, snap_name);
+    }
+  }
+  // the change stays in progress
+  mock_change_set_status(change, "Doing");
+  return mock_change_get_id(change);
+}
+
+static SdiChangeSummary *request_with_snapd_glib(SnapdClient *client,
+                                                 const gchar *change_id) {
+  g_autoptr(GError) error = NULL;
+  g_autoptr(SnapdChange) change =
+      snapd_client_get_change_sync(client, change_id, NULL, &error);
+  if (change == NULL) {
+    g_printerr("Failed to get the change with snapd-glib: %s\n",
+               error->message);
+    return NULL;
+  }
+  return sdi_change_summary_new_from_change(change);
+}
+
+static void request_cb(GObject *object, GAsyncResult *result,
+                       GAsyncResult **out) {
+  *out = g_object_ref(result);
+}
+
+static SdiChangeSummary *request_with_fast_parser(const gchar *change_id) {
+  g_autoptr(GAsyncResult) result = NULL;
+  sdi_change_summary_request_async(sdi_snapd_client_factory_get_socket_path(),
+                                   change_id, NULL,
+                                   (GAsyncReadyCallback)request_cb, &result);
+  while (result == NULL) {
+    g_main_context_iteration(NULL, TRUE);
+  }
+
+  g_autoptr(GError) error = NULL;
+  SdiChangeSummary *summary = sdi_change_summary_request_finish(result, &error);
+  if (summary == NULL) {
+    g_printerr("Failed to get the change with the fast parser: %s\n",
+               error->message);
+  }
+  return summary;
+}
+
+static gboolean strv_equal(const gchar *const *a, const gchar *const *b) {
+  if ((a == NULL) || (b == NULL)) {
+    return a == b;
+  }
+  return g_strv_equal(a, b);
+}
+
+static gboolean summaries_are_equal(SdiChangeSummary *a, SdiChangeSummary *b) {
+  guint n_tasks = sdi_change_summary_get_n_tasks(a);
+  if ((g_strcmp0(sdi_change_summary_get_id(a), sdi_change_summary_get_id(b)) !=
+       0) ||
+      (g_strcmp0(sdi_change_summary_get_status(a),
+                 sdi_change_summary_get_status(b)) != 0) ||
+      (n_tasks != sdi_change_summary_get_n_tasks(b))) {
+    return FALSE;
+  }
+  for (guint i = 0; i < n_tasks; i++) {
+    if ((g_strcmp0(sdi_change_summary_get_task_status(a, i),
+                   sdi_change_summary_get_task_status(b, i)) != 0) ||
+        (g_strcmp0(sdi_change_summary_get_task_summary(a, i),
+                   sdi_change_summary_get_task_summary(b, i)) != 0) ||
+        !strv_equal(sdi_change_summary_get_task_affected_snaps(a, i),
+                    sdi_change_summary_get_task_affected_snaps(b, i))) {
+      return FALSE;
+    }
+  }
+  return TRUE;
+}
+
+static void print_measure(const gchar *name, Measure *measure) {
+  g_print("%s: %.3f ms, CPU %.3f ms", name,
+          measure->wall_time / 1000.0 / n_requests,
+          measure->cpu_time * 1000 / n_requests);
+#ifdef __GLIBC__
+  g_print(", %.1f allocations", measure->allocations / (gdouble)n_requests);
+#endif
+  g_print(" per request\n");
+}
+
+int main(int argc, char **argv) {
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GOptionContext) context =
+      g_option_context_new("- benchmark the fast change parser");
+  g_option_context_add_main_entries(context, entries, NULL);
+  if (!g_option_context_parse(context, &argc, &argv, &error)) {
+    g_printerr("%s\n", error->message);
+    return 1;
+  }
+  if ((n_tasks <= 0) || (n_snaps <= 0) || (n_requests <= 0)) {
+    g_printerr("Tasks, snaps and requests must be greater than zero\n");
+    return 1;
+  }
+
+  g_autoptr(MockSnapd) snapd = mock_snapd_new();
+  g_autofree gchar *change_id = g_strdup(populate_mock_snapd(snapd));
+  sdi_snapd_client_factory_set_custom_path(
+      (gchar *)mock_snapd_get_socket_path(snapd));
+  if (!mock_snapd_start(snapd, &error)) {
+    g_printerr("Failed to start mock snapd: %s\n", error->message);
+    return 1;
+  }
+  g_autoptr(SnapdClient) client = sdi_snapd_client_factory_new_snapd_client();
+
+  // the first requests check that both paths return the same summary
+  g_autoptr(SdiChangeSummary) expected =
+      request_with_snapd_glib(client, change_id);
+  g_autoptr(SdiChangeSummary) summary = request_with_fast_parser(change_id);
+  if ((expected == NULL) || (summary == NULL)) {
+    return 1;
+  }
+  if (!summaries_are_equal(expected, summary)) {
+    g_printerr("The fast parser returned a different change\n");
+    return 1;
+  }
+
+  Measure snapd_glib_measure = {0};
+  begin_measure(&snapd_glib_measure);
+  for (gint i = 0; i < n_requests; i++) {
+    g_autoptr(SdiChangeSummary) s = request_with_snapd_glib(client, change_id);
+  }
+  end_measure(&snapd_glib_measure);
+
+  Measure fast_parser_measure = {0};
+  begin_measure(&fast_parser_measure);
+  for (gint i = 0; i < n_requests; i++) {
+    g_autoptr(SdiChangeSummary) s = request_with_fast_parser(change_id);
+  }
+  end_measure(&fast_parser_measure);
+
+  g_print("scenario: tasks=%d snaps=%d requests=%d\n", n_tasks, n_snaps,
+          n_requests);
+  print_measure("snapd-glib", &snapd_glib_measure);
+  print_measure("fast parser", &fast_parser_measure);
+  gdouble speedup = fast_parser_measure.cpu_time > 0
+                        ? snapd_glib_measure.cpu_time /
+                              fast_parser_measure.cpu_time
+                        : 0;
+  g_print("CPU speedup: %.2f\n", speedup);
+
+  int retval = 0;
+  if ((min_speedup > 0) && (speedup < min_speedup)) {
+    g_printerr("The fast parser is too slow: speedup %.2f (limit is %.2f)\n",
+               speedup, min_speedup);
+    retval = 1;
+  }
+  mock_snapd_stop(snapd);
+  return retval;
+}
@@ -0,0 +1,382 @@
+// RUSAGE_THREAD is a Linux extension
+#define _GNU_SOURCE
+
+#include "../src/sdi-refresh-monitor.h"
+#include "../src/sdi-snapd-client-factory.h"
+#include "mock-snapd.h"
+
+#include <stdbool.h>
+#include <sys/resource.h>
+
+/* Synthetic load benchmark for SdiRefreshMonitor.
+ *
+ * It populates mock-snapd with N concurrent changes of M tasks each, every
+ * one of them affecting K snaps, and then feeds `change-update` (and,
+ * optionally, `refresh-inhibit`) notices to the refresh monitor in bursts,
+ * exactly as the daemon would receive them from snapd. The mock advances
+ * one task step each time a change is requested, so the number of requests
+ * needed to finish every change is fixed and the results are reproducible
+ * without a real snapd.
+ *
+ * At the end it prints the number of snapd requests issued, the CPU time
+ * and the number of allocations done by the main loop per poll, and the
+ * emission rate of each signal. It returns a non-zero value if the run
+ * doesn't settle before the timeout, or if the polls per change exceed the
+ * value passed in --max-requests-per-change.
+ */
+
+// time in ms without snapd requests to consider that the monitor is idle
+#define QUIESCENT_PERIOD 1500
+#define CHECK_PERIOD 250
+
+static gint n_changes = 10;
+static gint n_tasks = 5;
+static gint n_snaps = 2;
+static gint n_task_steps = 2;
+static gint n_bursts = 3;
+static gint burst_size = 0;
+static gint burst_interval = 1000;
+static gboolean use_inhibited = FALSE;
+static gint timeout_seconds = 60;
+static gint max_requests_per_change = 0;
+
+static GOptionEntry entries[] = {
+    {"changes", 0, 0, G_OPTION_ARG_INT, &n_changes,
+     "Number of concurrent changes", "N"},
+    {"tasks", 0, 0, G_OPTION_ARG_INT, &n_tasks, "Tasks per change", "M"},
+    {"snaps", 0, 0, G_OPTION_ARG_INT, &n_snaps, "Snaps affected by each change",
+     "K"},
+    {"task-steps", 0, 0, G_OPTION_ARG_INT, &n_task_steps,
+     "Progress steps needed to complete each task", "STEPS"},
+    {"notice-bursts", 0, 0, G_OPTION_ARG_INT, &n_bursts,
+     "Number of notice bursts", "B"},
+    {"burst-size", 0, 0, G_OPTION_ARG_INT, &burst_size,
+     "Notices per burst (default: one per change)", "S"},
+    {"burst-interval", 0, 0, G_OPTION_ARG_INT, &burst_interval,
+     "Time between bursts, in ms", "MS"},
+    {"inhibited", 0, 0, G_OPTION_ARG_NONE, &use_inhibited,
+     "Use inhibited snaps and auto-refresh changes", NULL},
+    {"timeout", 0, 0, G_OPTION_ARG_INT, &timeout_seconds,
+     "Maximum duration of the run, in seconds", "SECONDS"},
+    {"max-requests-per-change", 0, 0, G_OPTION_ARG_INT,
+     &max_requests_per_change,
+     "Fail if a change is requested more times than this on average", "N"},
+    {NULL}};
+
+typedef struct {
+  const gchar *name;
+  guint count;
+} SignalCounter;
+
+static SignalCounter signal_counters[] = {
+    {"notify-pending-refresh", 0}, {"notify-pending-refresh-forced", 0},
+    {"notify-refresh-complete", 0}, {"begin-refresh", 0},
+    {"refresh-progress", 0},        {"end-refresh", 0},
+};
+
+typedef struct {
+  GMainLoop *loop;
+  MockSnapd *snapd;
+  SdiRefreshMonitor *refresh_monitor;
+  GPtrArray *notices;
+  guint next_notice;
+  guint bursts_sent;
+  guint last_request_count;
+  gint64 last_activity_time;
+  gint64 start_time;
+  gboolean timed_out;
+} BenchmarkData;
+
+/* Allocations are counted by interposing the allocator, which works with
+ * glibc because the symbols defined in the executable take precedence over
+ * the ones in the shared libraries. Only the allocations done in the main
+ * thread are counted, so the ones done by mock-snapd's own thread are
+ * ignored.
+ */
+#ifdef __GLIBC__
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static __thread gboolean count_allocations = FALSE;
+static guint64 n_allocations = 0;
+
+void *malloc(size_t size) {
+  if (count_allocations)
+    n_allocations++;
+  return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size) {
+  if (count_allocations)
+    n_allocations++;
+  return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size) {
+  if (count_allocations)
+    n_allocations++;
+  return __libc_realloc(ptr, size);
+}
+#endif
+
+static void count_signal(SignalCounter *counter) { counter->count++; }
+
+static gdouble get_thread_cpu_time(void) {
+  struct rusage usage;
+  if (getrusage(RUSAGE_THREAD, &usage) != 0) {
+    return 0;
+  }
+  return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+         (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1000000.0;
+}
+
+static MockNotice *add_notice(MockSnapd *snapd, const gchar *type,
+                              const gchar *key) {
+  static int id_counter = 1;
+
+  g_autofree gchar *id = g_strdup_printf("%d", id_counter);
+  MockNotice *notice = mock_snapd_add_notice(snapd, id, key, type);
+  g_autoptr(GTimeZone) timezone = g_time_zone_new_utc();
+  g_autoptr(GDateTime) base = g_date_time_new(timezone, 2024, 3, 1, 0, 0, 0);
+  g_autoptr(GDateTime) date = g_date_time_add_seconds(base, id_counter);
+  mock_notice_set_dates(notice, date, date, date, 1);
+  id_counter++;
+  return notice;
+}
+
+static void populate_mock_snapd(BenchmarkData *data) {
+  for (gint c = 0; c < n_changes; c++) {
+    MockChange *change = mock_snapd_add_change(data->snapd);
+    mock_change_set_kind(change, use_inhibited ? "auto-refresh"
+                                               : "refresh-snap");
+
+    g_autoptr(GPtrArray) snap_names = g_ptr_array_new_with_free_func(g_free);
+    for (gint s = 0; s < n_snaps; s++) {
+      gchar *snap_name = g_strdup_printf("bench-snap-%d-%d", c, s);
+      MockSnap *snap = mock_snapd_add_snap(data->snapd, snap_name);
+      if (use_inhibited) {
+        g_autoptr(GDateTime) now = g_date_time_new_now_utc();
+        g_autoptr(GDateTime) proceed = g_date_time_add_days(now, 10);
+        g_autofree gchar *proceed_time =
+            g_date_time_format(proceed, "%Y-%m-%dT%T%z");
+        mock_snap_set_proceed_time(snap, proceed_time);
+      }
+      g_ptr_array_add(snap_names, snap_name);
+    }
+
+    for (gint t = 0; t < n_tasks; t++) {
+      MockTask *task = mock_change_add_task(change, "download");
+      mock_task_set_progress(task, 0, n_task_steps);
+      for (guint s = 0; s < snap_names->len; s++) {
+        mock_task_add_affected_snap(task, snap_names->pdata[s]);
+      }
+    }
+
+    if (use_inhibited) {
+      g_autoptr(JsonBuilder) builder = json_builder_new();
+      json_builder_begin_object(builder);
+      json_builder_set_member_name(builder, "snap-names");
+      json_builder_begin_array(builder);
+      for (guint s = 0; s < snap_names->len; s++) {
+        json_builder_add_string_value(builder, snap_names->pdata[s]);
+      }
+      json_builder_end_array(builder);
+      json_builder_end_object(builder);
+      g_autoptr(JsonNode) change_data = json_builder_get_root(builder);
+      mock_change_add_data(change, change_data);
+    }
+  }
+
+  /* The notices of every burst are created now, before the mock server
+   * starts, and fetched with a single request; then they are delivered to
+   * the refresh monitor in slices, one per burst.
+   */
+  gint notices_per_burst = (burst_size > 0) ? burst_size : n_changes;
+  for (gint b = 0; b < n_bursts; b++) {
+    if (use_inhibited) {
+      add_notice(data->snapd, "refresh-inhibit", "-");
+    }
+    for (gint n = 0; n < notices_per_burst; n++) {
+      // change IDs in mock-snapd start at 1
+      g_autofree gchar *change_id = g_strdup_printf("%d", 1 + n % n_changes);
+      MockNotice *notice = add_notice(data->snapd, "change-update", change_id);
+      mock_notice_add_data_pair(notice, "kind", use_inhibited ? "auto-refresh"
+                                                              : "refresh-snap");
+    }
+  }
+}
+
+static void send_burst(BenchmarkData *data) {
+  gint notices_per_burst = ((burst_size > 0) ? burst_size : n_changes) +
+                           (use_inhibited ? 1 : 0);
+
+  for (gint n = 0; n < notices_per_burst; n++) {
+    if (data->next_notice >= data->notices->len) {
+      break;
+    }
+    SnapdNotice *notice = data->notices->pdata[data->next_notice++];
+    sdi_refresh_monitor_notice(data->refresh_monitor, notice, FALSE);
+  }
+  data->bursts_sent++;
+}
+
+static gboolean burst_cb(BenchmarkData *data) {
+  send_burst(data);
+  return (data->bursts_sent < (guint)n_bursts) ? G_SOURCE_CONTINUE
+                                               : G_SOURCE_REMOVE;
+}
+
+static gboolean check_finished_cb(BenchmarkData *data) {
+  gint64 now = g_get_monotonic_time();
+  guint requests = mock_snapd_get_request_count(data->snapd, NULL);
+  if (requests != data->last_request_count) {
+    data->last_request_count = requests;
+    data->last_activity_time = now;
+  }
+
+  if (now - data->start_time > timeout_seconds * G_USEC_PER_SEC) {
+    data->timed_out = TRUE;
+    g_main_loop_quit(data->loop);
+    return G_SOURCE_REMOVE;
+  }
+  if ((data->bursts_sent == (guint)n_bursts) &&
+      (now - data->last_activity_time > QUIESCENT_PERIOD * 1000)) {
+    g_main_loop_quit(data->loop);
+    return G_SOURCE_REMOVE;
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+static void get_notices_cb(SnapdClient *client, GAsyncResult *res,
+                           BenchmarkData *data) {
+  g_autoptr(GError) error = NULL;
+  data->notices = snapd_client_get_notices_finish(client, res, &error);
+  if (data->notices == NULL) {
+    g_printerr("Failed to get notices: %s\n", error->message);
+  }
+  g_main_loop_quit(data->loop);
+}
+
+static void print_report(BenchmarkData *data, gdouble cpu_time,
+                         guint64 allocations) {
+  gdouble elapsed =
+      (data->last_activity_time - data->start_time) / (gdouble)G_USEC_PER_SEC;
+  guint requests = mock_snapd_get_request_count(data->snapd, NULL);
+  guint polls = mock_snapd_get_request_count(data->snapd, "/v2/changes/");
+  guint snap_requests = mock_snapd_get_request_count(data->snapd, "/v2/snaps");
+
+  g_print("scenario: changes=%d tasks=%d snaps=%d task-steps=%d bursts=%d "
+          "burst-size=%d inhibited=%s\n",
+          n_changes, n_tasks, n_snaps, n_task_steps, n_bursts,
+          (burst_size > 0) ? burst_size : n_changes,
+          use_inhibited ? "yes" : "no");
+  g_print("elapsed: %.3f s\n", elapsed);
+  g_print("snapd requests: %u (changes: %u, snaps: %u)\n", requests, polls,
+          snap_requests);
+  g_print("polls per change: %.2f (minimum %d)\n",
+          polls / (gdouble)MAX(n_changes, 1), n_tasks * n_task_steps);
+  g_print("main loop CPU time: %.3f ms (%.3f ms per poll)\n", cpu_time * 1000,
+          polls == 0 ? 0 : cpu_time * 1000 / polls);
+#ifdef __GLIBC__
+  g_print("main loop allocations: %" G_GUINT64_FORMAT " (%.1f per poll)\n",
+          allocations, polls == 0 ? 0 : allocations / (gdouble)polls);
+#else
+  g_print("main loop allocations: not available\n");
+#endif
+  for (guint i = 0; i < G_N_ELEMENTS(signal_counters); i++) {
+    g_print("signal %s: %u (%.2f/s)\n", signal_counters[i].name,
+            signal_counters[i].count,
+            elapsed > 0 ? signal_counters[i].count / elapsed : 0);
+  }
+}
+
+int main(int argc, char **argv) {
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GOptionContext) context =
+      g_option_context_new("- benchmark the refresh monitor");
+  g_option_context_add_main_entries(context, entries, NULL);
+  if (!g_option_context_parse(context, &argc, &argv, &error)) {
+    g_printerr("%s\n", error->message);
+    return 1;
+  }
+  if ((n_changes <= 0) || (n_tasks <= 0) || (n_snaps <= 0) ||
+      (n_task_steps <= 0) || (n_bursts <= 0)) {
+    g_printerr("Changes, tasks, snaps, task steps and bursts must be greater "
+               "than zero\n");
+    return 1;
+  }
+
+  g_autoptr(GMainLoop) loop = g_main_loop_new(NULL, FALSE);
+  g_autoptr(MockSnapd) snapd = mock_snapd_new();
+  BenchmarkData data = {0};
+  data.loop = loop;
+  data.snapd = snapd;
+
+  populate_mock_snapd(&data);
+  sdi_snapd_client_factory_set_custom_path(
+      (gchar *)mock_snapd_get_socket_path(snapd));
+  if (!mock_snapd_start(snapd, &error)) {
+    g_printerr("Failed to start mock snapd: %s\n", error->message);
+    return 1;
+  }
+
+  g_autoptr(SnapdClient) client = sdi_snapd_client_factory_new_snapd_client();
+  snapd_client_get_notices_async(client, NULL, 0, NULL,
+                                 (GAsyncReadyCallback)get_notices_cb, &data);
+  g_main_loop_run(loop);
+  if (data.notices == NULL) {
+    return 1;
+  }
+
+  data.refresh_monitor = sdi_refresh_monitor_new(NULL);
+  for (guint i = 0; i < G_N_ELEMENTS(signal_counters); i++) {
+    g_signal_connect_swapped(data.refresh_monitor, signal_counters[i].name,
+                             (GCallback)count_signal, &signal_counters[i]);
+  }
+
+  mock_snapd_reset_request_counts(snapd);
+  data.start_time = data.last_activity_time = g_get_monotonic_time();
+  gdouble cpu_start = get_thread_cpu_time();
+#ifdef __GLIBC__
+  n_allocations = 0;
+  count_allocations = TRUE;
+#endif
+
+  send_burst(&data);
+  if (n_bursts > 1) {
+    g_timeout_add(burst_interval, (GSourceFunc)burst_cb, &data);
+  }
+  g_timeout_add(CHECK_PERIOD, (GSourceFunc)check_finished_cb, &data);
+  g_main_loop_run(loop);
+
+#ifdef __GLIBC__
+  count_allocations = FALSE;
+#endif
+  gdouble cpu_time = get_thread_cpu_time() - cpu_start;
+  guint64 allocations = 0;
+#ifdef __GLIBC__
+  allocations = n_allocations;
+#endif
+
+  print_report(&data, cpu_time, allocations);
+
+  int retval = 0;
+  if (data.timed_out) {
+    g_printerr("The refresh monitor didn't settle after %d seconds\n",
+               timeout_seconds);
+    retval = 1;
+  }
+  guint polls = mock_snapd_get_request_count(snapd, "/v2/changes/");
+  if ((max_requests_per_change > 0) &&
+      (polls > (guint)(max_requests_per_change * n_changes))) {
+    g_printerr("Too many change requests: %u (limit is %d per change)\n", polls,
+               max_requests_per_change);
+    retval = 1;
+  }
+
+  g_clear_object(&data.refresh_monitor);
+  g_clear_pointer(&data.notices, g_ptr_array_unref);
+  mock_snapd_stop(snapd);
+  return retval;
+}
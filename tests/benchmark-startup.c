@@ -0,0 +1,255 @@
+#include "mock-snapd.h"
+
+#include <gio/gio.h>
+#include <glib-unix.h>
+#include <glib/gstdio.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "config.h"
+
+/* Startup benchmark for the daemon.
+ *
+ * It launches snapd-desktop-integration several times against mock-snapd,
+ * inside a private session bus, and measures the time from exec until the
+ * daemon is ready, which is when it issues its first notices request to
+ * snapd, because by then do_startup() has finished and the main loop is
+ * running. At that moment it also reads the resident set size of the daemon.
+ *
+ * It prints the results of each run and their minimum, median and maximum,
+ * and returns a non-zero value if the daemon doesn't become ready before the
+ * timeout, or if the medians exceed the values passed in --max-ready-time or
+ * --max-rss.
+ */
+
+static gint n_runs = 5;
+static gint timeout_seconds = 10;
+static gint max_ready_time = 0;
+static gint max_rss = 0;
+
+static GOptionEntry entries[] = {
+    {"runs", 0, 0, G_OPTION_ARG_INT, &n_runs, "Number of launches", "N"},
+    {"timeout", 0, 0, G_OPTION_ARG_INT, &timeout_seconds,
+     "Maximum time to become ready, in seconds", "SECONDS"},
+    {"max-ready-time", 0, 0, G_OPTION_ARG_INT, &max_ready_time,
+     "Fail if the median time to become ready exceeds this value, in ms",
+     "MS"},
+    {"max-rss", 0, 0, G_OPTION_ARG_INT, &max_rss,
+     "Fail if the median RSS when ready exceeds this value, in KiB", "KIB"},
+    {NULL}};
+
+static GSubprocess *launch_dbus_daemon(gchar **address, GError **error) {
+  int address_pipe_fds[2];
+  if (!g_unix_open_pipe(address_pipe_fds, FD_CLOEXEC, error)) {
+    return NULL;
+  }
+  g_autoptr(GSubprocessLauncher) launcher = g_subprocess_launcher_new(
+      G_SUBPROCESS_FLAGS_STDOUT_SILENCE | G_SUBPROCESS_FLAGS_STDERR_SILENCE);
+  g_subprocess_launcher_take_fd(launcher, address_pipe_fds[1],
+                                address_pipe_fds[1]);
+  g_autofree gchar *address_fd_arg = g_strdup_printf("%d", address_pipe_fds[1]);
+  g_autoptr(GSubprocess) subprocess = g_subprocess_launcher_spawn(
+      launcher, error, "dbus-daemon", "--nofork", "--session",
+      "--print-address", address_fd_arg, NULL);
+  if (subprocess == NULL) {
+    close(address_pipe_fds[0]);
+    return NULL;
+  }
+
+  gchar buffer[1024];
+  gssize n_read = read(address_pipe_fds[0], buffer, sizeof(buffer) - 1);
+  close(address_pipe_fds[0]);
+  if (n_read <= 0) {
+    g_set_error_literal(error, G_IO_ERROR, G_IO_ERROR_FAILED,
+                        "Failed to read the D-Bus address");
+    return NULL;
+  }
+  buffer[n_read] = '\0';
+  *address = g_strdup(g_strstrip(buffer));
+  return g_steal_pointer(&subprocess);
+}
+
+/**
+ * The daemon forks at startup, and the parent just waits for the child, so
+ * the RSS must be read from the child. Returns 0 if it isn't available.
+ */
+static guint64 get_daemon_rss(const gchar *pid) {
+  g_autofree gchar *children_path =
+      g_strdup_printf("/proc/%s/task/%s/children", pid, pid);
+  g_autofree gchar *children = NULL;
+  if (!g_file_get_contents(children_path, &children, NULL, NULL)) {
+    return 0;
+  }
+  g_auto(GStrv) child_pids = g_strsplit(g_strstrip(children), " ", -1);
+  if ((child_pids[0] == NULL) || (*child_pids[0] == '\0')) {
+    return 0;
+  }
+
+  g_autofree gchar *status_path =
+      g_strdup_printf("/proc/%s/status", child_pids[0]);
+  g_autofree gchar *status = NULL;
+  if (!g_file_get_contents(status_path, &status, NULL, NULL)) {
+    return 0;
+  }
+  const gchar *rss = strstr(status, "VmRSS:");
+  if (rss == NULL) {
+    return 0;
+  }
+  return g_ascii_strtoull(rss + strlen("VmRSS:"), NULL, 10);
+}
+
+/**
+ * Launches the daemon and waits until it requests the notices to snapd.
+ * Returns the time it took, in microseconds, or -1 if it failed.
+ */
+static gint64 run_daemon(MockSnapd *snapd, const gchar *dbus_address,
+                         const gchar *temp_dir, guint64 *rss) {
+  g_autoptr(GSubprocessLauncher) launcher = g_subprocess_launcher_new(
+      G_SUBPROCESS_FLAGS_STDOUT_SILENCE | G_SUBPROCESS_FLAGS_STDERR_SILENCE);
+  g_subprocess_launcher_setenv(launcher, "LC_ALL", "C", TRUE);
+  g_subprocess_launcher_setenv(launcher, "LANG", "C", TRUE);
+  g_subprocess_launcher_setenv(launcher, "XDG_CONFIG_HOME", temp_dir, TRUE);
+  g_subprocess_launcher_setenv(launcher, "GSETTINGS_BACKEND", "memory", TRUE);
+  g_subprocess_launcher_setenv(launcher, "DBUS_SESSION_BUS_ADDRESS",
+                               dbus_address, TRUE);
+
+  g_autofree gchar *daemon_path =
+      g_build_filename(DAEMON_BUILDDIR, "snapd-desktop-integration", NULL);
+  g_autofree gchar *snapd_socket_path_arg = g_strdup_printf(
+      "--snapd-socket-path=%s", mock_snapd_get_socket_path(snapd));
+
+  mock_snapd_reset_request_counts(snapd);
+  gint64 start_time = g_get_monotonic_time();
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GSubprocess) subprocess = g_subprocess_launcher_spawn(
+      launcher, &error, daemon_path, snapd_socket_path_arg, NULL);
+  if (subprocess == NULL) {
+    g_printerr("Failed to launch the daemon: %s\n", error->message);
+    return -1;
+  }
+  g_autofree gchar *pid = g_strdup(g_subprocess_get_identifier(subprocess));
+
+  gint64 ready_time = -1;
+  gint64 deadline = start_time + timeout_seconds * G_USEC_PER_SEC;
+  while (g_get_monotonic_time() < deadline) {
+    if (mock_snapd_get_request_count(snapd, "/v2/notices") != 0) {
+      ready_time = g_get_monotonic_time() - start_time;
+      *rss = get_daemon_rss(pid);
+      break;
+    }
+    // the identifier is cleared when the process exits
+    g_main_context_iteration(NULL, FALSE);
+    if (g_subprocess_get_identifier(subprocess) == NULL) {
+      g_printerr("The daemon exited before becoming ready\n");
+      return -1;
+    }
+    g_usleep(1000);
+  }
+  if (ready_time < 0) {
+    g_printerr("The daemon didn't become ready after %d seconds\n",
+               timeout_seconds);
+  }
+
+  // the parent process kills the daemon when it receives SIGTERM
+  g_subprocess_send_signal(subprocess, SIGTERM);
+  g_subprocess_wait(subprocess, NULL, NULL);
+  return ready_time;
+}
+
+static gint compare_int64(gconstpointer a, gconstpointer b, gpointer data) {
+  gint64 v1 = *(const gint64 *)a;
+  gint64 v2 = *(const gint64 *)b;
+  return (v1 > v2) - (v1 < v2);
+}
+
+static gint compare_uint64(gconstpointer a, gconstpointer b, gpointer data) {
+  guint64 v1 = *(const guint64 *)a;
+  guint64 v2 = *(const guint64 *)b;
+  return (v1 > v2) - (v1 < v2);
+}
+
+int main(int argc, char **argv) {
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GOptionContext) context =
+      g_option_context_new("- benchmark the daemon startup");
+  g_option_context_add_main_entries(context, entries, NULL);
+  if (!g_option_context_parse(context, &argc, &argv, &error)) {
+    g_printerr("%s\n", error->message);
+    return 1;
+  }
+  if ((n_runs <= 0) || (timeout_seconds <= 0)) {
+    g_printerr("Runs and timeout must be greater than zero\n");
+    return 1;
+  }
+
+  g_autofree gchar *temp_dir =
+      g_dir_make_tmp("snapd-desktop-integration-XXXXXX", &error);
+  if (temp_dir == NULL) {
+    g_printerr("Failed to make temporary directory: %s\n", error->message);
+    return 1;
+  }
+
+  g_autoptr(MockSnapd) snapd = mock_snapd_new();
+  if (!mock_snapd_start(snapd, &error)) {
+    g_printerr("Failed to start mock snapd: %s\n", error->message);
+    return 1;
+  }
+
+  g_autofree gchar *dbus_address = NULL;
+  g_autoptr(GSubprocess) dbus_daemon =
+      launch_dbus_daemon(&dbus_address, &error);
+  if (dbus_daemon == NULL) {
+    g_printerr("Failed to launch dbus-daemon: %s\n", error->message);
+    return 1;
+  }
+
+  int retval = 0;
+  g_autofree gint64 *ready_times = g_new0(gint64, n_runs);
+  g_autofree guint64 *rss_values = g_new0(guint64, n_runs);
+  for (gint i = 0; i < n_runs; i++) {
+    ready_times[i] = run_daemon(snapd, dbus_address, temp_dir, &rss_values[i]);
+    if (ready_times[i] < 0) {
+      retval = 1;
+      break;
+    }
+    g_print("run %d: ready in %.1f ms, RSS %" G_GUINT64_FORMAT " KiB\n", i + 1,
+            ready_times[i] / 1000.0, rss_values[i]);
+  }
+
+  if (retval == 0) {
+    g_qsort_with_data(ready_times, n_runs, sizeof(gint64), compare_int64,
+                      NULL);
+    g_qsort_with_data(rss_values, n_runs, sizeof(guint64), compare_uint64,
+                      NULL);
+    gint64 median_time = ready_times[n_runs / 2];
+    guint64 median_rss = rss_values[n_runs / 2];
+    g_print("ready time: min %.1f ms, median %.1f ms, max %.1f ms\n",
+            ready_times[0] / 1000.0, median_time / 1000.0,
+            ready_times[n_runs - 1] / 1000.0);
+    if (median_rss == 0) {
+      g_print("RSS when ready: not available\n");
+    } else {
+      g_print("RSS when ready: min %" G_GUINT64_FORMAT
+              " KiB, median %" G_GUINT64_FORMAT " KiB, max %" G_GUINT64_FORMAT
+              " KiB\n",
+              rss_values[0], median_rss, rss_values[n_runs - 1]);
+    }
+    if ((max_ready_time > 0) && (median_time > max_ready_time * 1000L)) {
+      g_printerr("Startup is too slow: %.1f ms (limit is %d ms)\n",
+                 median_time / 1000.0, max_ready_time);
+      retval = 1;
+    }
+    if ((max_rss > 0) && (median_rss > (guint64)max_rss)) {
+      g_printerr("RSS is too big: %" G_GUINT64_FORMAT
+                 " KiB (limit is %d KiB)\n",
+                 median_rss, max_rss);
+      retval = 1;
+    }
+  }
+
+  g_subprocess_force_exit(dbus_daemon);
+  mock_snapd_stop(snapd);
+  g_rmdir(temp_dir);
+  return retval;
+}
@@ -128,7 +128,8 @@ static void handle_notifications_method_call_child(
  * @mock: a #MockFdoNotifications
  * @timeout: timeout in milliseconds
  *
- * Waits for a notification to arrive to the server, and returns its data.
+ * Waits for a notification to arrive to the server, and returns its data. The
+ * default main context is iterated while waiting.
  *
  * Returns: (transfer none) (allow-none): a pointer to a #MockNotificationsData
  * struct with the data of the received notification, or %NULL if timed out. The
@@ -147,8 +148,23 @@ mock_fdo_notifications_wait_for_notification(MockFdoNotifications *self,
   poll_fd.events = POLLIN;
   poll_fd.revents = 0;
 
-  if (poll(&poll_fd, 1, timeout) <= 0) {
-    return NULL;
+  /* Notifications can be prepared asynchronously, so the main loop must keep
+   * running while waiting for them. */
+  gint64 deadline = g_get_monotonic_time() + timeout * G_TIME_SPAN_MILLISECOND;
+  while (TRUE) {
+    g_main_context_iteration(NULL, FALSE);
+    gint64 remaining =
+        (deadline - g_get_monotonic_time()) / G_TIME_SPAN_MILLISECOND;
+    if (remaining <= 0) {
+      return NULL;
+    }
+    int retval = poll(&poll_fd, 1, MIN(remaining, 10));
+    if (retval < 0) {
+      return NULL;
+    }
+    if (retval > 0) {
+      break;
+    }
   }
 
   read_size = read(self->notification_pipes[0], &parameters_size,
@@ -128,6 +128,7 @@ struct _MockSnapd {
   GList *logs;
   GList *notices;
   gchar *notices_parameters;
+  GHashTable *request_counts;
 };
 
 G_DEFINE_TYPE(MockSnapd, mock_snapd, G_TYPE_OBJECT)
@@ -5000,8 +5001,9 @@ static void handle_notices(MockSnapd *self, SoupServerMessage *message,
 
   g_autoptr(GDateTime) after = NULL;
   guint after_nanoseconds = -1;
+  g_auto(GStrv) types = NULL;
 
-  // Check if the petition has an "after" parameter
+  // Check if the petition has "after" or "types" parameters
   if (self->notices_parameters != NULL) {
     g_autoptr(GHashTable) parameters = g_uri_parse_params(
         self->notices_parameters, -1, "&", G_URI_PARAMS_NONE, NULL);
@@ -5012,12 +5014,21 @@ static void handle_notices(MockSnapd *self, SoupServerMessage *message,
       gchar *dot_pos = strchr(after_str, '.');
       after_nanoseconds = (dot_pos == NULL) ? 0 : atoi(1 + dot_pos);
     }
+    if (g_hash_table_contains(parameters, "types")) {
+      types = g_strsplit(g_hash_table_lookup(parameters, "types"), ",", -1);
+    }
   }
 
   // Send the notices
   for (GList *link = self->notices; link; link = link->next) {
     MockNotice *notice = link->data;
 
+    // if there is a "types" parameter, send only notices of those types
+    if ((types != NULL) &&
+        !g_strv_contains((const gchar *const *)types, notice->type)) {
+      continue;
+    }
+
     /* but if there is an "after" parameter, send only those that
      * happened after the specified date-time
      */
@@ -5171,6 +5182,11 @@ static void handle_request(SoupServer *server, SoupServerMessage *message,
       g_boxed_copy(SOUP_TYPE_MESSAGE_HEADERS, request_headers);
 #endif
 
+  guint count =
+      GPOINTER_TO_UINT(g_hash_table_lookup(self->request_counts, path));
+  g_hash_table_insert(self->request_counts, g_strdup(path),
+                      GUINT_TO_POINTER(count + 1));
+
   if (strcmp(path, "/v2/system-info") == 0)
     handle_system_info(self, message);
   else if (strcmp(path, "/v2/login") == 0)
@@ -5314,6 +5330,7 @@ static void mock_snapd_finalize(GObject *object) {
     self->notices = NULL;
   }
   g_clear_pointer(&self->notices_parameters, g_free);
+  g_clear_pointer(&self->request_counts, g_hash_table_unref);
 
   g_cond_clear(&self->condition);
   g_mutex_clear(&self->mutex);
@@ -5418,6 +5435,30 @@ gchar *mock_snapd_get_notices_parameters(MockSnapd *self) {
   return self->notices_parameters;
 }
 
+guint mock_snapd_get_request_count(MockSnapd *self, const gchar *path_prefix) {
+  g_return_val_if_fail(MOCK_IS_SNAPD(self), 0);
+
+  g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&self->mutex);
+
+  guint count = 0;
+  GHashTableIter iter;
+  gpointer path, value;
+  g_hash_table_iter_init(&iter, self->request_counts);
+  while (g_hash_table_iter_next(&iter, &path, &value)) {
+    if (path_prefix == NULL || g_str_has_prefix(path, path_prefix))
+      count += GPOINTER_TO_UINT(value);
+  }
+
+  return count;
+}
+
+void mock_snapd_reset_request_counts(MockSnapd *self) {
+  g_return_if_fail(MOCK_IS_SNAPD(self));
+
+  g_autoptr(GMutexLocker) locker = g_mutex_locker_new(&self->mutex);
+  g_hash_table_remove_all(self->request_counts);
+}
+
 void mock_snapd_stop(MockSnapd *self) {
   g_return_if_fail(MOCK_IS_SNAPD(self));
 
@@ -5449,6 +5490,8 @@ static void mock_snapd_init(MockSnapd *self) {
       g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
   self->sound_theme_status =
       g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  self->request_counts =
+      g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
   g_autoptr(GError) error = NULL;
   self->dir_path = g_dir_make_tmp("mock-snapd-XXXXXX", &error);
   if (self->dir_path == NULL)
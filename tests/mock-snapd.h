@@ -411,6 +411,10 @@ void mock_notice_set_key(MockNotice *notice, const gchar *key);
 
 gchar *mock_snapd_get_notices_parameters(MockSnapd *snapd);
 
+guint mock_snapd_get_request_count(MockSnapd *snapd, const gchar *path_prefix);
+
+void mock_snapd_reset_request_counts(MockSnapd *snapd);
+
 G_END_DECLS
 
 #endif /* __MOCK_SNAPD_H__ */
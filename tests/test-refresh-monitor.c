@@ -986,6 +986,227 @@ test_refresh_inhibit_with_negative_value_dont_shows_notifications(void) {
   g_assert_true(assert_no_more_signals());
 }
 
+static void test_gc_evicts_snap_records(void) {
+  reset_mock_snapd();
+  // snaps with an old proceed time get a record, but aren't inhibited
+  MockSnap *snap1 = mock_snapd_add_snap(snapd, "snap1");
+  set_snap_as_inhibited(snap1, -ONE_DAY);
+  MockSnap *snap2 = mock_snapd_add_snap(snapd, "snap2");
+  set_snap_as_inhibited(snap2, -ONE_DAY);
+  MockSnap *snap3 = mock_snapd_add_snap(snapd, "snap3");
+  set_snap_as_inhibited(snap3, -ONE_DAY);
+  new_notice("refresh-inhibit");
+  g_assert_true(wait_for_notice());
+  g_assert_true(wait_for_timeout(500));
+  // the user asked to ignore this one, so it must never be evicted
+  sdi_refresh_monitor_ignore_snap(refresh_monitor, "snap4");
+
+  guint n_snaps = 0;
+  gsize size =
+      sdi_refresh_monitor_get_footprint(refresh_monitor, &n_snaps, NULL, NULL);
+  g_assert_cmpint(n_snaps, ==, 4);
+  g_assert_cmpint(size, >, 0);
+
+  // only the least recently used idle records must be evicted
+  sdi_refresh_monitor_set_gc_limits(refresh_monitor, ONE_HOUR, 2, ONE_HOUR);
+  sdi_refresh_monitor_collect_garbage(refresh_monitor);
+  sdi_refresh_monitor_get_footprint(refresh_monitor, &n_snaps, NULL, NULL);
+  g_assert_cmpint(n_snaps, ==, 2);
+
+  // and now all of them, because they are too old, but not the ignored one
+  g_usleep(1000);
+  sdi_refresh_monitor_set_gc_limits(refresh_monitor, 0, 2, ONE_HOUR);
+  sdi_refresh_monitor_collect_garbage(refresh_monitor);
+  size = sdi_refresh_monitor_get_footprint(refresh_monitor, &n_snaps, NULL,
+                                           NULL);
+  g_assert_cmpint(n_snaps, ==, 1);
+  g_assert_cmpint(size, >, 0);
+  g_assert_true(assert_no_more_signals());
+}
+
+static void test_gc_removes_vanished_changes(void) {
+  reset_mock_snapd();
+  mock_snapd_add_snap(snapd, "kicad");
+  MockChange *change1 = mock_snapd_add_change(snapd);
+  mock_change_set_kind(change1, "refresh-snap");
+  MockTask *task1 = mock_change_add_task(change1, "download");
+  mock_task_add_affected_snap(task1, "kicad");
+  mock_task_set_progress(task1, 0, 50);
+
+  MockNotice *notice1 = new_notice("change-update");
+  mock_notice_set_key(notice1, mock_change_get_id(change1));
+  mock_notice_add_data_pair(notice1, "kind", "refresh-snap");
+  g_assert_true(wait_for_notice());
+  g_autoptr(ReceivedSignalData) data1 =
+      wait_for_signal(RECEIVED_SIGNAL_REFRESH_PROGRESS, 100);
+  g_assert_nonnull(data1);
+  g_assert_false(data1->task_done);
+
+  // an unknown status stops the polling without removing the progress data
+  mock_change_set_status(change1, "Wait");
+  g_assert_true(wait_for_timeout(1000));
+  guint n_changes = 0, n_progress_entries = 0;
+  sdi_refresh_monitor_get_footprint(refresh_monitor, NULL, &n_changes,
+                                    &n_progress_entries);
+  g_assert_cmpint(n_changes, ==, 0);
+  g_assert_cmpint(n_progress_entries, ==, 1);
+
+  // the stale entry must be removed, and the progress bar closed
+  sdi_refresh_monitor_set_gc_limits(refresh_monitor, ONE_HOUR, 256, 0);
+  sdi_refresh_monitor_collect_garbage(refresh_monitor);
+  g_autoptr(ReceivedSignalData) data2 =
+      get_next_signal(RECEIVED_SIGNAL_REFRESH_PROGRESS);
+  g_assert_nonnull(data2);
+  g_assert_true(data2->task_done);
+  g_assert_cmpstr(data2->snap_name, ==, "kicad");
+  g_assert_true(assert_no_more_signals());
+  sdi_refresh_monitor_get_footprint(refresh_monitor, NULL, NULL,
+                                    &n_progress_entries);
+  g_assert_cmpint(n_progress_entries, ==, 0);
+}
+
+static void test_polling_survives_errors(void) {
+  reset_mock_snapd();
+  mock_snapd_add_snap(snapd, "kicad");
+  MockChange *change1 = mock_snapd_add_change(snapd);
+  mock_change_set_kind(change1, "refresh-snap");
+  MockTask *task1 = mock_change_add_task(change1, "download");
+  MockTask *task2 = mock_change_add_task(change1, "install");
+  mock_task_add_affected_snap(task1, "kicad");
+  mock_task_set_progress(task1, 0, 100);
+  mock_task_add_affected_snap(task2, "kicad");
+  mock_task_set_progress(task2, 0, 100);
+
+  MockNotice *notice1 = new_notice("change-update");
+  mock_notice_set_key(notice1, mock_change_get_id(change1));
+  mock_notice_add_data_pair(notice1, "kind", "refresh-snap");
+  g_assert_true(wait_for_notice());
+  g_autoptr(ReceivedSignalData) data1 =
+      wait_for_signal(RECEIVED_SIGNAL_REFRESH_PROGRESS, 100);
+  g_assert_nonnull(data1);
+  g_assert_cmpint(data1->done_tasks, ==, 0);
+
+  // snapd fails for a while...
+  mock_snapd_set_close_on_request(snapd, TRUE);
+  g_assert_true(wait_for_timeout(1500));
+  mock_snapd_set_close_on_request(snapd, FALSE);
+
+  // ...but the change must continue being polled after that
+  mock_task_set_progress(task1, 100, 100);
+  mock_task_set_status(task1, "Done");
+  g_autoptr(ReceivedSignalData) data2 =
+      wait_for_signal(RECEIVED_SIGNAL_REFRESH_PROGRESS, 5000);
+  g_assert_nonnull(data2);
+  g_assert_cmpint(data2->done_tasks, ==, 1);
+  g_assert_cmpint(data2->total_tasks, ==, 2);
+  g_assert_cmpstr(data2->snap_name, ==, "kicad");
+}
+
+static void test_reconcile_finds_orphaned_changes(void) {
+  reset_mock_snapd();
+  mock_snapd_add_snap(snapd, "kicad");
+  MockChange *change1 = mock_snapd_add_change(snapd);
+  mock_change_set_kind(change1, "refresh-snap");
+  MockTask *task1 = mock_change_add_task(change1, "download");
+  mock_task_add_affected_snap(task1, "kicad");
+  mock_task_set_progress(task1, 0, 100);
+
+  // no notice was received for this change, but it must be found anyway
+  sdi_refresh_monitor_reconcile_changes(refresh_monitor);
+  g_autoptr(ReceivedSignalData) data =
+      wait_for_signal(RECEIVED_SIGNAL_REFRESH_PROGRESS, 1000);
+  g_assert_nonnull(data);
+  g_assert_cmpint(data->done_tasks, ==, 0);
+  g_assert_cmpint(data->total_tasks, ==, 1);
+  g_assert_cmpstr(data->snap_name, ==, "kicad");
+  guint n_changes = 0;
+  sdi_refresh_monitor_get_footprint(refresh_monitor, NULL, &n_changes, NULL);
+  g_assert_cmpint(n_changes, ==, 1);
+}
+
+static void test_startup_snapshot_builds_state(void) {
+  reset_mock_snapd();
+  mock_snapd_add_snap(snapd, "kicad");
+  MockChange *change1 = mock_snapd_add_change(snapd);
+  mock_change_set_kind(change1, "refresh-snap");
+  MockTask *task1 = mock_change_add_task(change1, "download");
+  MockTask *task2 = mock_change_add_task(change1, "install");
+  mock_task_add_affected_snap(task1, "kicad");
+  mock_task_set_progress(task1, 100, 100);
+  mock_task_set_status(task1, "Done");
+  mock_task_add_affected_snap(task2, "kicad");
+  mock_task_set_progress(task2, 0, 100);
+
+  MockNotice *notice1 = new_notice("change-update");
+  mock_notice_set_key(notice1, mock_change_get_id(change1));
+  mock_notice_add_data_pair(notice1, "kind", "refresh-snap");
+  g_autoptr(ReceivedSignalData) notice_data =
+      wait_for_signal(RECEIVED_SIGNAL_NOTICE, 0);
+  g_assert_nonnull(notice_data);
+
+  // the whole first-run replay must result in a single snapshot
+  mock_snapd_reset_request_counts(snapd);
+  sdi_refresh_monitor_notice(refresh_monitor, notice_data->notice, TRUE);
+  sdi_refresh_monitor_notice(refresh_monitor, notice_data->notice, TRUE);
+  g_autoptr(ReceivedSignalData) data =
+      wait_for_signal(RECEIVED_SIGNAL_REFRESH_PROGRESS, 1000);
+  g_assert_nonnull(data);
+  g_assert_cmpint(data->done_tasks, ==, 1);
+  g_assert_cmpint(data->total_tasks, ==, 2);
+  g_assert_cmpstr(data->snap_name, ==, "kicad");
+  g_assert_cmpint(mock_snapd_get_request_count(snapd, "/v2/changes/"), ==, 0);
+  g_assert_cmpint(mock_snapd_get_request_count(snapd, "/v2/changes"), ==, 1);
+  g_assert_cmpint(mock_snapd_get_request_count(snapd, "/v2/snaps"), ==, 1);
+  guint n_changes = 0;
+  sdi_refresh_monitor_get_footprint(refresh_monitor, NULL, &n_changes, NULL);
+  g_assert_cmpint(n_changes, ==, 1);
+}
+
+static void test_hidden_session_throttles_polling(void) {
+  reset_mock_snapd();
+  mock_snapd_add_snap(snapd, "kicad");
+  MockChange *change1 = mock_snapd_add_change(snapd);
+  mock_change_set_kind(change1, "refresh-snap");
+  MockTask *task1 = mock_change_add_task(change1, "download");
+  MockTask *task2 = mock_change_add_task(change1, "install");
+  mock_task_add_affected_snap(task1, "kicad");
+  mock_task_set_progress(task1, 0, 100);
+  mock_task_add_affected_snap(task2, "kicad");
+  mock_task_set_progress(task2, 0, 100);
+  g_autofree gchar *change_path =
+      g_strdup_printf("/v2/changes/%s", mock_change_get_id(change1));
+
+  MockNotice *notice1 = new_notice("change-update");
+  mock_notice_set_key(notice1, mock_change_get_id(change1));
+  mock_notice_add_data_pair(notice1, "kind", "refresh-snap");
+  g_assert_true(wait_for_notice());
+  g_autoptr(ReceivedSignalData) data1 =
+      wait_for_signal(RECEIVED_SIGNAL_REFRESH_PROGRESS, 100);
+  g_assert_nonnull(data1);
+  g_assert_cmpint(data1->done_tasks, ==, 0);
+
+  // the poll already scheduled runs, and the next one is delayed
+  sdi_refresh_monitor_set_session_visible(refresh_monitor, FALSE);
+  g_assert_true(wait_for_timeout(1000));
+  mock_snapd_reset_request_counts(snapd);
+
+  // nothing is polled nor emitted while the session is hidden...
+  mock_task_set_progress(task1, 100, 100);
+  mock_task_set_status(task1, "Done");
+  g_assert_true(wait_for_timeout(2000));
+  g_assert_cmpint(mock_snapd_get_request_count(snapd, change_path), ==, 0);
+
+  // ...and a single reconciliation catches up when it is visible again
+  sdi_refresh_monitor_set_session_visible(refresh_monitor, TRUE);
+  g_autoptr(ReceivedSignalData) data2 =
+      wait_for_signal(RECEIVED_SIGNAL_REFRESH_PROGRESS, 1000);
+  g_assert_nonnull(data2);
+  g_assert_cmpint(data2->done_tasks, ==, 1);
+  g_assert_cmpint(data2->total_tasks, ==, 2);
+  g_assert_cmpstr(data2->snap_name, ==, "kicad");
+  g_assert_cmpint(mock_snapd_get_request_count(snapd, "/v2/changes"), ==, 1);
+}
+
 // End of tests
 
 static void do_activate(GObject *object, gpointer data) {
@@ -997,6 +1218,18 @@ static void do_activate(GObject *object, gpointer data) {
       "/others/test-no-negative-values",
       test_refresh_inhibit_with_negative_value_dont_shows_notifications);
   g_test_add_func("/others/test-sdi-snap", test_sdi_snap);
+  g_test_add_func("/others/gc-evicts-snap-records",
+                  test_gc_evicts_snap_records);
+  g_test_add_func("/others/gc-removes-vanished-changes",
+                  test_gc_removes_vanished_changes);
+  g_test_add_func("/others/polling-survives-errors",
+                  test_polling_survives_errors);
+  g_test_add_func("/others/startup-snapshot-builds-state",
+                  test_startup_snapshot_builds_state);
+  g_test_add_func("/others/reconcile-finds-orphaned-changes",
+                  test_reconcile_finds_orphaned_changes);
+  g_test_add_func("/others/hidden-session-throttles-polling",
+                  test_hidden_session_throttles_polling);
   g_test_add_func("/refresh/no-pending", test_refresh_inhibit_no_pending);
   g_test_add_func("/refresh/one-pending", test_refresh_inhibit_one_pending);
   g_test_add_func("/refresh/three-pending", test_refresh_inhibit_three_pending);
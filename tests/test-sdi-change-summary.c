@@ -0,0 +1,199 @@
+#include "../src/sdi-change-summary.h"
+#include "../src/sdi-snapd-client-factory.h"
+#include "mock-snapd.h"
+
+#include <string.h>
+
+static const gchar *change_reply =
+    "{\"type\": \"sync\", \"status-code\": 200, \"status\": \"OK\",\n"
+    " \"result\": {\"id\": \"42\", \"kind\": \"auto-refresh\",\n"
+    "  \"summary\": \"Auto-refresh \\\"snap1\\\"\", \"status\": \"Doing\",\n"
+    "  \"tasks\": [\n"
+    "   {\"id\": \"1\", \"kind\": \"download-snap\",\n"
+    "    \"summary\": \"Download snap \\u201csnap1\\u201d \\ud83d\\ude00\",\n"
+    "    \"status\": \"Done\", \"progress\": {\"label\": \"\", \"done\": 10,\n"
+    "    \"total\": 10}, \"spawn-time\": \"2024-03-01T20:29:58Z\",\n"
+    "    \"data\": {\"affected-snaps\": [\"snap1\", \"snap2\"]}},\n"
+    "   {\"id\": \"2\", \"kind\": \"link-snap\", \"summary\": null,\n"
+    "    \"status\": \"Doing\", \"extra\": [[1, 2.5e3], {\"a\": [true]}]}\n"
+    "  ],\n"
+    "  \"ready\": false, \"spawn-time\": \"2024-03-01T20:29:58Z\",\n"
+    "  \"data\": {\"snap-names\": [\"snap1\", \"snap2\"],\n"
+    "   \"refresh-forced\": [\"snap2\"]}}}";
+
+static void test_parse(void) {
+  g_autoptr(GError) error = NULL;
+  g_autoptr(SdiChangeSummary) summary =
+      sdi_change_summary_parse(change_reply, strlen(change_reply), &error);
+  g_assert_no_error(error);
+  g_assert_nonnull(summary);
+
+  g_assert_cmpstr(sdi_change_summary_get_id(summary), ==, "42");
+  g_assert_cmpstr(sdi_change_summary_get_kind(summary), ==, "auto-refresh");
+  g_assert_cmpstr(sdi_change_summary_get_status(summary), ==, "Doing");
+  g_assert_false(sdi_change_summary_get_ready(summary));
+  const gchar *snap_names[] = {"snap1", "snap2", NULL};
+  g_assert_cmpstrv(sdi_change_summary_get_snap_names(summary), snap_names);
+
+  g_assert_cmpuint(sdi_change_summary_get_n_tasks(summary), ==, 2);
+  g_assert_cmpstr(sdi_change_summary_get_task_status(summary, 0), ==, "Done");
+  g_assert_cmpstr(sdi_change_summary_get_task_summary(summary, 0), ==,
+                  "Download snap \u201csnap1\u201d \U0001F600");
+  g_assert_cmpstrv(sdi_change_summary_get_task_affected_snaps(summary, 0),
+                   snap_names);
+  // the repeated strings are stored only once
+  g_assert_true(sdi_change_summary_get_task_affected_snaps(summary, 0)[0] ==
+                sdi_change_summary_get_snap_names(summary)[0]);
+  g_assert_cmpstr(sdi_change_summary_get_task_status(summary, 1), ==,
+                  "Doing");
+  g_assert_null(sdi_change_summary_get_task_summary(summary, 1));
+  g_assert_null(sdi_change_summary_get_task_affected_snaps(summary, 1));
+}
+
+static void test_parse_error_reply(void) {
+  const gchar *reply =
+      "{\"type\": \"error\", \"status-code\": 404, \"status\": \"Not Found\","
+      " \"result\": {\"message\": \"cannot find change with id \\\"42\\\"\","
+      " \"kind\": \"\"}}";
+  g_autoptr(GError) error = NULL;
+  g_autoptr(SdiChangeSummary) summary =
+      sdi_change_summary_parse(reply, strlen(reply), &error);
+  g_assert_null(summary);
+  g_assert_error(error, G_IO_ERROR, G_IO_ERROR_FAILED);
+  g_assert_nonnull(strstr(error->message, "cannot find change"));
+}
+
+static void test_parse_invalid(void) {
+  const gchar *replies[] = {
+      // truncated
+      "{\"type\": \"sync\", \"result\": {\"id\": \"42\", \"tasks\": [",
+      // trailing data
+      "{\"type\": \"sync\", \"result\": {}} {}",
+      // invalid escape sequence
+      "{\"type\": \"sync\", \"result\": {\"id\": \"4\\x\"}}",
+      // unpaired surrogate
+      "{\"type\": \"sync\", \"result\": {\"id\": \"\\udc00\"}}",
+      // a task without status
+      "{\"type\": \"sync\", \"result\": {\"id\": \"42\", \"kind\": \"k\","
+      " \"status\": \"Do\", \"tasks\": [{\"summary\": \"s\"}]}}",
+      // a change without status
+      "{\"type\": \"sync\", \"result\": {\"id\": \"42\", \"kind\": \"k\"}}",
+      NULL};
+  for (const gchar **reply = replies; *reply != NULL; reply++) {
+    g_autoptr(GError) error = NULL;
+    g_autoptr(SdiChangeSummary) summary =
+        sdi_change_summary_parse(*reply, strlen(*reply), &error);
+    g_assert_null(summary);
+    g_assert_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+  }
+
+  // deep nesting fails instead of overflowing the stack
+  g_autoptr(GString) reply =
+      g_string_new("{\"type\": \"sync\", \"result\": {\"extra\": ");
+  for (int i = 0; i < 100000; i++) {
+    g_string_append_c(reply, '[');
+  }
+  g_autoptr(GError) error = NULL;
+  g_autoptr(SdiChangeSummary) summary =
+      sdi_change_summary_parse(reply->str, reply->len, &error);
+  g_assert_null(summary);
+  g_assert_error(error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA);
+}
+
+static void test_new_from_change(void) {
+  gchar *affected_snaps[] = {"snap1", NULL};
+  gchar *snap_names[] = {"snap1", NULL};
+  g_autoptr(SnapdTaskData) task_data = g_object_new(
+      SNAPD_TYPE_TASK_DATA, "affected-snaps", affected_snaps, NULL);
+  g_autoptr(GPtrArray) tasks = g_ptr_array_new_with_free_func(g_object_unref);
+  g_ptr_array_add(tasks, g_object_new(SNAPD_TYPE_TASK, "status", "Doing",
+                                      "summary", "Download snap", "data",
+                                      task_data, NULL));
+  g_ptr_array_add(tasks, g_object_new(SNAPD_TYPE_TASK, "status", "Do", NULL));
+  g_autoptr(SnapdChangeData) data = g_object_new(
+      SNAPD_TYPE_AUTOREFRESH_CHANGE_DATA, "snap-names", snap_names, NULL);
+  g_autoptr(SnapdChange) change = g_object_new(
+      SNAPD_TYPE_CHANGE, "id", "42", "kind", "auto-refresh", "status", "Doing",
+      "ready", FALSE, "tasks", tasks, "data", data, NULL);
+
+  g_autoptr(SdiChangeSummary) summary =
+      sdi_change_summary_new_from_change(change);
+  g_assert_cmpstr(sdi_change_summary_get_id(summary), ==, "42");
+  g_assert_cmpstr(sdi_change_summary_get_kind(summary), ==, "auto-refresh");
+  g_assert_cmpstr(sdi_change_summary_get_status(summary), ==, "Doing");
+  g_assert_cmpstrv(sdi_change_summary_get_snap_names(summary), snap_names);
+  g_assert_cmpuint(sdi_change_summary_get_n_tasks(summary), ==, 2);
+  g_assert_cmpstr(sdi_change_summary_get_task_summary(summary, 0), ==,
+                  "Download snap");
+  g_assert_cmpstrv(sdi_change_summary_get_task_affected_snaps(summary, 0),
+                   affected_snaps);
+  g_assert_cmpstr(sdi_change_summary_get_task_status(summary, 1), ==, "Do");
+  g_assert_null(sdi_change_summary_get_task_affected_snaps(summary, 1));
+}
+
+typedef struct {
+  GMainLoop *loop;
+  SdiChangeSummary *summary;
+  GError *error;
+} RequestData;
+
+static void request_cb(GObject *object, GAsyncResult *result,
+                       RequestData *data) {
+  data->summary = sdi_change_summary_request_finish(result, &data->error);
+  g_main_loop_quit(data->loop);
+}
+
+static void test_request(void) {
+  g_autoptr(GMainLoop) loop = g_main_loop_new(NULL, FALSE);
+  g_autoptr(MockSnapd) snapd = mock_snapd_new();
+  MockChange *change = mock_snapd_add_change(snapd);
+  mock_change_set_kind(change, "refresh-snap");
+  MockTask *task = mock_change_add_task(change, "download");
+  mock_task_set_progress(task, 0, 5);
+  mock_task_add_affected_snap(task, "snap1");
+  task = mock_change_add_task(change, "link");
+  mock_task_add_affected_snap(task, "snap1");
+  g_autoptr(GError) error = NULL;
+  g_assert_true(mock_snapd_start(snapd, &error));
+
+  RequestData data = {loop, NULL, NULL};
+  sdi_change_summary_request_async(mock_snapd_get_socket_path(snapd),
+                                   mock_change_get_id(change), NULL,
+                                   (GAsyncReadyCallback)request_cb, &data);
+  g_main_loop_run(loop);
+  g_assert_no_error(data.error);
+  g_autoptr(SdiChangeSummary) summary = data.summary;
+  g_assert_cmpstr(sdi_change_summary_get_id(summary), ==,
+                  mock_change_get_id(change));
+  g_assert_cmpstr(sdi_change_summary_get_kind(summary), ==, "refresh-snap");
+  g_assert_null(sdi_change_summary_get_snap_names(summary));
+  g_assert_cmpuint(sdi_change_summary_get_n_tasks(summary), ==, 2);
+  // the mock advances the first task when the change is requested
+  g_assert_cmpstr(sdi_change_summary_get_task_status(summary, 0), ==,
+                  "Doing");
+  const gchar *affected_snaps[] = {"snap1", NULL};
+  g_assert_cmpstrv(sdi_change_summary_get_task_affected_snaps(summary, 1),
+                   affected_snaps);
+
+  // an unknown change returns the error of snapd
+  data.summary = NULL;
+  sdi_change_summary_request_async(mock_snapd_get_socket_path(snapd), "1000",
+                                   NULL, (GAsyncReadyCallback)request_cb,
+                                   &data);
+  g_main_loop_run(loop);
+  g_assert_null(data.summary);
+  g_assert_error(data.error, G_IO_ERROR, G_IO_ERROR_FAILED);
+  g_clear_error(&data.error);
+}
+
+int main(int argc, char **argv) {
+  g_test_init(&argc, &argv, NULL);
+  g_test_add_func("/sdi-change-summary/parse", test_parse);
+  g_test_add_func("/sdi-change-summary/parse-error-reply",
+                  test_parse_error_reply);
+  g_test_add_func("/sdi-change-summary/parse-invalid", test_parse_invalid);
+  g_test_add_func("/sdi-change-summary/new-from-change",
+                  test_new_from_change);
+  g_test_add_func("/sdi-change-summary/request", test_request);
+  return g_test_run();
+}
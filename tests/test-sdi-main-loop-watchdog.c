@@ -0,0 +1,63 @@
+#include "../src/sdi-main-loop-watchdog.h"
+
+static void block_main_loop(gpointer data) {
+  sdi_main_loop_watchdog_begin_call("blocking-call");
+  g_usleep(400 * 1000);
+  sdi_main_loop_watchdog_end_call();
+}
+
+static void quit_loop(GMainLoop *loop) { g_main_loop_quit(loop); }
+
+static void run_loop(guint time) {
+  g_autoptr(GMainLoop) loop = g_main_loop_new(NULL, FALSE);
+  g_timeout_add_once(time, (GSourceOnceFunc)quit_loop, loop);
+  g_main_loop_run(loop);
+}
+
+static void test_no_stalls(void) {
+  g_autoptr(SdiMainLoopWatchdog) watchdog = sdi_main_loop_watchdog_new(200);
+  sdi_main_loop_watchdog_start(watchdog);
+  run_loop(500);
+  g_assert_cmpint(sdi_main_loop_watchdog_get_threshold(watchdog), ==, 200);
+  g_assert_cmpint(sdi_main_loop_watchdog_get_n_stalls(watchdog), ==, 0);
+  g_assert_cmpint(sdi_main_loop_watchdog_get_max_stall(watchdog), ==, 0);
+}
+
+static void test_stall_is_detected(void) {
+  g_autoptr(SdiMainLoopWatchdog) watchdog = sdi_main_loop_watchdog_new(200);
+  sdi_main_loop_watchdog_start(watchdog);
+  g_timeout_add_once(150, block_main_loop, NULL);
+  run_loop(800);
+
+  g_assert_cmpint(sdi_main_loop_watchdog_get_n_stalls(watchdog), ==, 1);
+  g_assert_cmpint(sdi_main_loop_watchdog_get_max_stall(watchdog), >, 200);
+
+  g_autoptr(GVariant) stalls = sdi_main_loop_watchdog_get_stalls(watchdog);
+  g_variant_ref_sink(stalls);
+  g_assert_cmpint(g_variant_n_children(stalls), ==, 1);
+  gint64 time, duration;
+  const gchar *call_site;
+  g_variant_get_child(stalls, 0, "(xx&s)", &time, &duration, &call_site);
+  g_assert_cmpint(duration, >, 200);
+  g_assert_true(g_str_has_prefix(call_site, "blocking-call"));
+}
+
+static void test_stopped_watchdog(void) {
+  g_autoptr(SdiMainLoopWatchdog) watchdog = sdi_main_loop_watchdog_new(200);
+  sdi_main_loop_watchdog_start(watchdog);
+  sdi_main_loop_watchdog_stop(watchdog);
+  g_timeout_add_once(150, block_main_loop, NULL);
+  run_loop(800);
+
+  g_assert_cmpint(sdi_main_loop_watchdog_get_n_stalls(watchdog), ==, 0);
+}
+
+int main(int argc, char **argv) {
+  g_test_init(&argc, &argv, NULL);
+  g_test_add_func("/sdi-main-loop-watchdog/no-stalls", test_no_stalls);
+  g_test_add_func("/sdi-main-loop-watchdog/stall-is-detected",
+                  test_stall_is_detected);
+  g_test_add_func("/sdi-main-loop-watchdog/stopped-watchdog",
+                  test_stopped_watchdog);
+  return g_test_run();
+}
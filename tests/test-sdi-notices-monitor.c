@@ -97,9 +97,54 @@ static void test_notices_events_are_received(void) {
   g_object_unref(data->snapd); // it has two references
 }
 
+static void test_notices_types_are_filtered_cb(SdiSnapdMonitor *self,
+                                               SnapdNotice *notice,
+                                               gboolean first_set,
+                                               AsyncData *data) {
+  data->counter++;
+  g_assert_cmpint(snapd_notice_get_notice_type(notice), ==,
+                  SNAPD_NOTICE_TYPE_REFRESH_INHIBIT);
+}
+
+static void test_notices_types_are_filtered(void) {
+  g_autoptr(GMainLoop) loop = g_main_loop_new(NULL, FALSE);
+
+  g_autoptr(MockSnapd) snapd = mock_snapd_new();
+  g_autoptr(AsyncData) data = async_data_new(loop, snapd);
+
+  const gchar *path = mock_snapd_get_socket_path(snapd);
+  sdi_snapd_client_factory_set_custom_path((gchar *)path);
+  g_autoptr(GError) error = NULL;
+  g_assert_true(mock_snapd_start(snapd, &error));
+
+  g_autoptr(SdiSnapdMonitor) snapd_monitor = sdi_snapd_monitor_new();
+  g_signal_connect(G_OBJECT(snapd_monitor), "notice-event",
+                   G_CALLBACK(test_notices_types_are_filtered_cb), data);
+  const gchar *types[] = {"refresh-inhibit", NULL};
+  sdi_snapd_monitor_add_notice_types(snapd_monitor, types);
+  // adding the same type again must not duplicate it
+  sdi_snapd_monitor_add_notice_types(snapd_monitor, types);
+
+  create_notice(snapd, "change-update");
+  create_notice(snapd, "refresh-inhibit");
+
+  g_assert_true(sdi_snapd_monitor_start(snapd_monitor));
+  g_timeout_add_once(500, (GSourceOnceFunc)g_main_loop_quit, loop);
+  g_main_loop_run(loop);
+  g_assert_cmpint(data->counter, ==, 1);
+
+  g_autoptr(GHashTable) parameters =
+      g_uri_parse_params(mock_snapd_get_notices_parameters(snapd), -1, "&",
+                         G_URI_PARAMS_NONE, NULL);
+  g_assert_cmpstr(g_hash_table_lookup(parameters, "types"), ==,
+                  "refresh-inhibit");
+}
+
 int main(int argc, char **argv) {
   g_test_init(&argc, &argv, NULL);
   g_test_add_func("/sdi-snapd-monitor/receive-notices",
                   test_notices_events_are_received);
+  g_test_add_func("/sdi-snapd-monitor/filter-notice-types",
+                  test_notices_types_are_filtered);
   return g_test_run();
 }
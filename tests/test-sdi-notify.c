@@ -111,6 +111,28 @@ static gchar *wait_for_notification_close() {
   return wait_for_notification_close_cb(NULL, NULL, NULL);
 }
 
+static void quit_loop(GMainLoop *loop) { g_main_loop_quit(loop); }
+
+/* Refresh-complete notifications are shown after an aggregation window,
+ * so the main loop must run before waiting for them. */
+static void wait_for_aggregation() {
+  g_autoptr(GMainLoop) loop = g_main_loop_new(NULL, FALSE);
+  g_timeout_add_once(700, (GSourceOnceFunc)quit_loop, loop);
+  g_main_loop_run(loop);
+}
+
+/* Notifications are released when the server reports that they have been
+ * closed, which happens after the action has been processed. */
+static void wait_for_notifications_released() {
+  gint64 deadline = g_get_monotonic_time() + G_USEC_PER_SEC;
+  while ((sdi_notify_get_n_notifications(notifier) != 0) &&
+         (g_get_monotonic_time() < deadline)) {
+    if (!g_main_context_iteration(NULL, FALSE)) {
+      g_usleep(10000);
+    }
+  }
+}
+
 /**
  * Test functions
  */
@@ -377,7 +399,9 @@ void test_update_available_6() {
   g_assert_nonnull(data);
 
   g_assert_cmpstr(data->title, ==, "Updates available for 4 apps");
-  g_assert_cmpstr(data->body, ==, "Quit the apps to update them now.");
+  g_assert_cmpstr(data->body, ==,
+                  "Test app 6_1, Test app 6_2, Test app 6_3 and 1 more will "
+                  "update when you quit them.");
   g_assert_true(g_str_has_suffix(data->icon_path, "/app-center.png"));
   g_assert_cmpint(g_strv_length(data->actions), ==, 6);
   g_assert_true(has_action(data->actions, "app.show-updates", "Show updates"));
@@ -405,6 +429,7 @@ void test_update_available_7() {
   g_autoptr(GPtrArray) apps1 = add_app(NULL, "test_app7", desktop_file1);
   g_autoptr(SnapdSnap) snap1 = create_snap("test_snap7", apps1);
   sdi_notify_refresh_complete(notifier, snap1, "test_snap7");
+  wait_for_aggregation();
 
   MockNotificationsData *data =
       mock_fdo_notifications_wait_for_notification(mock_notifications, 1000);
@@ -523,6 +548,145 @@ void test_update_available_10() {
   g_assert_cmpint(signal_counter, ==, 1);
 }
 
+void test_update_forced_in_place() {
+  g_autofree gchar *icon_path = get_data_path("icon1.svg");
+  g_autofree gchar *desktop_file1 =
+      create_desktop_file("test12", "Test app 12", icon_path);
+  g_autoptr(GPtrArray) apps1 = add_app(NULL, "test_app12", desktop_file1);
+  g_autoptr(SnapdSnap) snap1 = create_snap("test_snap12", apps1);
+  sdi_notify_pending_refresh_forced(notifier, snap1, SECONDS_IN_A_DAY * 2,
+                                    TRUE);
+  MockNotificationsData *data =
+      mock_fdo_notifications_wait_for_notification(mock_notifications, 1000);
+  g_assert_nonnull(data);
+  g_assert_cmpstr(data->title, ==,
+                  "Test app 12 will quit and update in 2 days");
+  guint32 uid = data->uid;
+
+  // the same countdown must not be shown again
+  sdi_notify_pending_refresh_forced(notifier, snap1, SECONDS_IN_A_DAY * 2,
+                                    TRUE);
+  data = mock_fdo_notifications_wait_for_notification(mock_notifications, 500);
+  g_assert_null(data);
+
+  // a new remaining time must replace the existing notification
+  sdi_notify_pending_refresh_forced(notifier, snap1, SECONDS_IN_AN_HOUR * 5,
+                                    FALSE);
+  data = mock_fdo_notifications_wait_for_notification(mock_notifications, 1000);
+  g_assert_nonnull(data);
+  g_assert_cmpstr(data->title, ==,
+                  "Test app 12 will quit and update in 5 hours");
+  g_assert_cmpint(data->replaces_id, ==, uid);
+  g_assert_cmpint(g_strv_length(data->actions), ==, 4);
+
+  mock_fdo_notifications_send_action(mock_notifications, data->uid, "default");
+  g_autofree gchar *result = wait_for_notification_close(NULL, NULL);
+  unlink(desktop_file1); // delete desktop file
+  g_assert_cmpstr(result, ==, "show-updates");
+}
+
+void test_update_complete_burst() {
+  g_autofree gchar *icon_path = get_data_path("icon1.svg");
+  g_autoptr(GPtrArray) desktop_files = g_ptr_array_new_with_free_func(g_free);
+  for (int i = 0; i < 3; i++) {
+    g_autofree gchar *name = g_strdup_printf("test11_%d", i);
+    g_autofree gchar *visible_name = g_strdup_printf("Test app 11_%d", i);
+    gchar *desktop_file = create_desktop_file(name, visible_name, icon_path);
+    g_ptr_array_add(desktop_files, desktop_file);
+    g_autoptr(GPtrArray) apps = add_app(NULL, name, desktop_file);
+    g_autoptr(SnapdSnap) snap = create_snap(name, apps);
+    sdi_notify_refresh_complete(notifier, snap, name);
+  }
+  wait_for_aggregation();
+
+  // the three events must be shown in a single notification
+  MockNotificationsData *data =
+      mock_fdo_notifications_wait_for_notification(mock_notifications, 1000);
+  g_assert_nonnull(data);
+
+  g_assert_cmpstr(data->title, ==, "3 apps were updated");
+  g_assert_cmpstr(data->body, ==, "You can reopen them now.");
+  g_assert_true(g_str_has_suffix(data->icon_path, "/app-center.png"));
+  g_assert_true(has_action(data->actions, "default", NULL));
+
+  mock_fdo_notifications_send_action(mock_notifications, data->uid, "default");
+
+  g_autofree gchar *result = wait_for_notification_close(NULL, NULL);
+  for (guint i = 0; i < desktop_files->len; i++) {
+    unlink(g_ptr_array_index(desktop_files, i)); // delete desktop file
+  }
+  g_assert_cmpstr(result, ==, "close-notification");
+}
+
+void test_notifications_released() {
+  g_autofree gchar *icon_path = get_data_path("icon1.svg");
+  g_autofree gchar *desktop_file1 =
+      create_desktop_file("test13", "Test app 13", icon_path);
+  g_autoptr(GPtrArray) apps1 = add_app(NULL, "test_app13", desktop_file1);
+  g_autoptr(SnapdSnap) snap1 = create_snap("test_snap13", apps1);
+  wait_for_notifications_released();
+  g_assert_cmpint(sdi_notify_get_n_notifications(notifier), ==, 0);
+
+  sdi_notify_pending_refresh_forced(notifier, snap1, SECONDS_IN_AN_HOUR * 5,
+                                    TRUE);
+  MockNotificationsData *data =
+      mock_fdo_notifications_wait_for_notification(mock_notifications, 1000);
+  g_assert_nonnull(data);
+  g_assert_cmpint(sdi_notify_get_n_notifications(notifier), ==, 1);
+
+  mock_fdo_notifications_send_action(mock_notifications, data->uid, "default");
+  g_autofree gchar *result = wait_for_notification_close(NULL, NULL);
+  unlink(desktop_file1); // delete desktop file
+  g_assert_cmpstr(result, ==, "show-updates");
+
+  // closing the notification must release it
+  wait_for_notifications_released();
+  g_assert_cmpint(sdi_notify_get_n_notifications(notifier), ==, 0);
+}
+
+void test_notify_released() {
+  g_autofree gchar *icon_path = get_data_path("icon1.svg");
+  g_autofree gchar *desktop_file1 =
+      create_desktop_file("test15", "Test app 15", icon_path);
+  g_autoptr(GPtrArray) apps1 = add_app(NULL, "test_app15", desktop_file1);
+  g_autoptr(SnapdSnap) snap1 = create_snap("test_snap15", apps1);
+
+  SdiNotify *notify = sdi_notify_new(g_application_get_default());
+  g_object_add_weak_pointer(G_OBJECT(notify), (gpointer *)&notify);
+  sdi_notify_pending_refresh_forced(notify, snap1, SECONDS_IN_AN_HOUR * 5,
+                                    TRUE);
+  MockNotificationsData *data =
+      mock_fdo_notifications_wait_for_notification(mock_notifications, 1000);
+  g_assert_nonnull(data);
+  g_assert_cmpint(sdi_notify_get_n_notifications(notify), ==, 1);
+
+  // the actions of the open notification must not keep the notifier alive
+  g_object_unref(notify);
+  unlink(desktop_file1); // delete desktop file
+  g_assert_null(notify);
+}
+
+static gboolean activate_launch_refreshed_app(gchar *desktop_file) {
+  g_action_group_activate_action(
+      G_ACTION_GROUP(g_application_get_default()), "launch-refreshed-app",
+      g_variant_new_string(desktop_file));
+  return G_SOURCE_REMOVE;
+}
+
+void test_launch_refreshed_app_action() {
+  g_autofree gchar *icon_path = get_data_path("icon1.svg");
+  g_autofree gchar *desktop_file1 =
+      create_desktop_file("test14", "Test app 14", icon_path);
+
+  // this is the action used by GNotification in update complete notifications
+  g_idle_add(G_SOURCE_FUNC(activate_launch_refreshed_app), desktop_file1);
+  g_autofree gchar *result = wait_for_notification_close(NULL, NULL);
+  unlink(desktop_file1); // delete desktop file
+  g_autofree gchar *expected =
+      g_strdup_printf("app-launch-updated %s", desktop_file1);
+  g_assert_cmpstr(result, ==, expected);
+}
+
 /**
  * Notify emulator callbacks
  */
@@ -552,6 +716,11 @@ static void do_activate(GObject *object, gpointer data) {
   g_test_add_func("/update_forced/test8", test_update_available_8);
   g_test_add_func("/update_forced/test9", test_update_available_9);
   g_test_add_func("/update_forced/test10", test_update_available_10);
+  g_test_add_func("/update_done/test11", test_update_complete_burst);
+  g_test_add_func("/update_forced/test12", test_update_forced_in_place);
+  g_test_add_func("/notifications/test13", test_notifications_released);
+  g_test_add_func("/notifications/test14", test_launch_refreshed_app_action);
+  g_test_add_func("/notifications/test15", test_notify_released);
 
   g_test_run();
   g_application_release(G_APPLICATION(object));
@@ -508,6 +508,83 @@ static void test_dual_progress_bar4() {
   g_assert_cmpint(count_progress_childs(), ==, -1);
 }
 
+static void cancel_install_cb(SdiProgressWindow *window, gchar *install_id,
+                              gchar **cancelled_id) {
+  g_free(*cancelled_id);
+  *cancelled_id = g_strdup(install_id);
+}
+
+static void test_install_progress() {
+  g_autofree gchar *cancelled_id = NULL;
+  g_signal_connect(progress_window, "cancel-install",
+                   (GCallback)cancel_install_cb, &cancelled_id);
+
+  sdi_progress_window_begin_install(progress_window, ":install",
+                                    "Installing snaps");
+  wait_for_timeout(0);
+  g_assert_cmpint(count_hash_childs(), ==, 1);
+  g_assert_cmpint(count_progress_childs(), ==, 1);
+
+  GHashTable *dialogs = sdi_progress_window_get_dialogs(progress_window);
+  GtkWidget *element = g_hash_table_lookup(dialogs, ":install");
+  g_assert_nonnull(element);
+  g_assert_cmpint(check_widgets_visibility(element), ==, ALL_BUT_ICON_VISIBLE);
+
+  sdi_progress_window_update_install_progress(progress_window, ":install",
+                                              "Download", 500000, 1000000, 0,
+                                              4);
+  g_autoptr(GSList) progress_bars =
+      find_widgets_by_type(element, GTK_TYPE_PROGRESS_BAR);
+  g_assert_cmpint(g_slist_length(progress_bars), ==, 1);
+  GtkProgressBar *progress_bar = (GtkProgressBar *)progress_bars->data;
+  g_assert_cmpstr(gtk_progress_bar_get_text(progress_bar), ==,
+                  "Download (500.0 kB of 1.0 MB)");
+  g_assert_cmpfloat_with_epsilon(gtk_progress_bar_get_fraction(progress_bar),
+                                 0.5, DBL_EPSILON);
+
+  // without bytes, the number of tasks is shown
+  sdi_progress_window_update_install_progress(progress_window, ":install",
+                                              "Setup", 0, 0, 3, 4);
+  g_assert_cmpstr(gtk_progress_bar_get_text(progress_bar), ==, "Setup (3/4)");
+
+  g_autoptr(GSList) buttons = find_widgets_by_type(element, GTK_TYPE_BUTTON);
+  g_assert_cmpint(g_slist_length(buttons), ==, 2);
+  for (GSList *button = buttons; button != NULL; button = button->next) {
+    if (g_str_equal(gtk_button_get_label(GTK_BUTTON(button->data)),
+                    "Cancel")) {
+      gtk_widget_activate(GTK_WIDGET(button->data));
+    }
+  }
+  wait_for_timeout(0);
+  g_assert_cmpstr(cancelled_id, ==, ":install");
+
+  sdi_progress_window_end_refresh(progress_window, ":install");
+  g_assert_cmpint(count_hash_childs(), ==, 0);
+  g_assert_cmpint(count_progress_childs(), ==, -1);
+  g_signal_handlers_disconnect_by_func(progress_window, cancel_install_cb,
+                                       &cancelled_id);
+}
+
+static void test_paused_bar() {
+  sdi_progress_window_set_paused(progress_window, TRUE);
+  show_progress_window("E-SNAP", *app_list);
+  GtkWidget *element = find_progress_by_description("KiCad-no-icon");
+  g_assert_nonnull(element);
+
+  // a paused dialog doesn't switch to pulse mode
+  set_progress_bar("E-SNAP", 1, 10);
+  wait_for_timeout(7);
+  g_assert_cmpint(progress_bar_pulse_status(element), ==, PROGRESS_BAR_VALUE);
+
+  sdi_progress_window_set_paused(progress_window, FALSE);
+  wait_for_timeout(7);
+  g_assert_cmpint(progress_bar_pulse_status(element), ==, PROGRESS_BAR_PULSING);
+
+  sdi_progress_window_end_refresh(progress_window, "E-SNAP");
+  wait_for_timeout(0);
+  g_assert_cmpint(count_hash_childs(), ==, 0);
+}
+
 /**
  * GApplication callbacks
  */
@@ -533,6 +610,9 @@ static void do_activate(GApplication *app, gpointer data) {
                   test_dual_progress_bar3);
   g_test_add_func("/progress_window/test_dual_progress_bar_4",
                   test_dual_progress_bar4);
+  g_test_add_func("/progress_window/test_install_progress",
+                  test_install_progress);
+  g_test_add_func("/progress_window/test_paused_bar", test_paused_bar);
 
   g_test_run();
   g_application_release(app);
@@ -0,0 +1,81 @@
+#include "../src/sdi-snap-store.h"
+
+static SnapdSnap *new_snap(const gchar *name, const gchar *revision) {
+  return g_object_new(SNAPD_TYPE_SNAP, "name", name, "revision", revision,
+                      NULL);
+}
+
+static void test_lookup(void) {
+  g_autoptr(SdiSnapStore) store = sdi_snap_store_new(60);
+  g_assert_null(sdi_snap_store_lookup(store, "snap1"));
+  g_assert_null(sdi_snap_store_lookup(store, NULL));
+
+  g_autoptr(SnapdSnap) original = new_snap("snap1", "10");
+  sdi_snap_store_update(store, original);
+  g_autoptr(SnapdSnap) snap = sdi_snap_store_lookup(store, "snap1");
+  g_assert_true(snap == original);
+  g_assert_null(sdi_snap_store_lookup(store, "snap2"));
+}
+
+static void test_update(void) {
+  g_autoptr(SdiSnapStore) store = sdi_snap_store_new(60);
+  g_autoptr(SnapdSnap) old_snap = new_snap("snap1", "10");
+  g_autoptr(SnapdSnap) new_snap1 = new_snap("snap1", "11");
+  sdi_snap_store_update(store, old_snap);
+  sdi_snap_store_update(store, new_snap1);
+  g_assert_cmpint(sdi_snap_store_get_size(store), ==, 1);
+
+  g_autoptr(SnapdSnap) snap = sdi_snap_store_lookup(store, "snap1");
+  g_assert_cmpstr(snapd_snap_get_revision(snap), ==, "11");
+}
+
+static void test_update_all(void) {
+  g_autoptr(SdiSnapStore) store = sdi_snap_store_new(60);
+  g_autoptr(GPtrArray) snaps = g_ptr_array_new_with_free_func(g_object_unref);
+  g_ptr_array_add(snaps, new_snap("snap1", "10"));
+  g_ptr_array_add(snaps, new_snap("snap2", "20"));
+  sdi_snap_store_update_all(store, snaps);
+  sdi_snap_store_update_all(store, NULL);
+  g_assert_cmpint(sdi_snap_store_get_size(store), ==, 2);
+
+  g_autoptr(SnapdSnap) snap = sdi_snap_store_lookup(store, "snap2");
+  g_assert_nonnull(snap);
+}
+
+static void test_invalidate(void) {
+  g_autoptr(SdiSnapStore) store = sdi_snap_store_new(60);
+  g_autoptr(SnapdSnap) snap1 = new_snap("snap1", "10");
+  g_autoptr(SnapdSnap) snap2 = new_snap("snap2", "20");
+  sdi_snap_store_update(store, snap1);
+  sdi_snap_store_update(store, snap2);
+
+  sdi_snap_store_invalidate(store, "snap1");
+  sdi_snap_store_invalidate(store, NULL);
+  g_assert_null(sdi_snap_store_lookup(store, "snap1"));
+  g_assert_cmpint(sdi_snap_store_get_size(store), ==, 1);
+}
+
+static void test_expiration(void) {
+  g_autoptr(SdiSnapStore) store = sdi_snap_store_new(1);
+  g_autoptr(SnapdSnap) snap1 = new_snap("snap1", "10");
+  g_autoptr(SnapdSnap) snap2 = new_snap("snap2", "20");
+  sdi_snap_store_update(store, snap1);
+  sdi_snap_store_update(store, snap2);
+  g_assert_cmpint(sdi_snap_store_remove_expired(store), ==, 0);
+
+  g_usleep(1100 * 1000);
+  g_assert_null(sdi_snap_store_lookup(store, "snap1"));
+  g_assert_cmpint(sdi_snap_store_get_size(store), ==, 1);
+  g_assert_cmpint(sdi_snap_store_remove_expired(store), ==, 1);
+  g_assert_cmpint(sdi_snap_store_get_size(store), ==, 0);
+}
+
+int main(int argc, char **argv) {
+  g_test_init(&argc, &argv, NULL);
+  g_test_add_func("/sdi-snap-store/lookup", test_lookup);
+  g_test_add_func("/sdi-snap-store/update", test_update);
+  g_test_add_func("/sdi-snap-store/update-all", test_update_all);
+  g_test_add_func("/sdi-snap-store/invalidate", test_invalidate);
+  g_test_add_func("/sdi-snap-store/expiration", test_expiration);
+  return g_test_run();
+}
@@ -0,0 +1,132 @@
+#include "../src/sdi-snapd-variant.h"
+
+static SnapdTask *new_task(const gchar *id, const gchar *status,
+                           gint64 progress_done, GStrv affected_snaps) {
+  g_autoptr(SnapdTaskData) data = NULL;
+  if (affected_snaps != NULL) {
+    data = g_object_new(SNAPD_TYPE_TASK_DATA, "affected-snaps", affected_snaps,
+                        NULL);
+  }
+  return g_object_new(SNAPD_TYPE_TASK, "id", id, "kind", "download-snap",
+                      "summary", "Download snap", "status", status,
+                      "progress-done", progress_done, "progress-total",
+                      (gint64)10, "data", data, NULL);
+}
+
+static void test_change(void) {
+  gchar *affected_snaps[] = {"snap1", "snap2", NULL};
+  gchar *snap_names[] = {"snap1", "snap2", NULL};
+  gchar *refresh_forced[] = {"snap2", NULL};
+
+  g_autoptr(GPtrArray) tasks = g_ptr_array_new_with_free_func(g_object_unref);
+  g_ptr_array_add(tasks, new_task("1", "Done", 10, affected_snaps));
+  g_ptr_array_add(tasks, new_task("2", "Doing", 3, NULL));
+  g_autoptr(SnapdChangeData) data =
+      g_object_new(SNAPD_TYPE_AUTOREFRESH_CHANGE_DATA, "snap-names",
+                   snap_names, "refresh-forced", refresh_forced, NULL);
+  g_autoptr(SnapdChange) original = g_object_new(
+      SNAPD_TYPE_CHANGE, "id", "42", "kind", "auto-refresh", "summary",
+      "Auto-refresh", "status", "Doing", "ready", FALSE, "tasks", tasks,
+      "data", data, NULL);
+
+  g_autoptr(GVariant) variant =
+      g_variant_ref_sink(sdi_snapd_variant_from_change(original));
+  g_assert_true(g_variant_is_of_type(
+      variant, G_VARIANT_TYPE(SDI_SNAPD_CHANGE_VARIANT_TYPE)));
+  g_autoptr(SnapdChange) change = sdi_snapd_variant_to_change(variant);
+
+  g_assert_cmpstr(snapd_change_get_id(change), ==, "42");
+  g_assert_cmpstr(snapd_change_get_kind(change), ==, "auto-refresh");
+  g_assert_cmpstr(snapd_change_get_status(change), ==, "Doing");
+  g_assert_false(snapd_change_get_ready(change));
+
+  GPtrArray *change_tasks = snapd_change_get_tasks(change);
+  g_assert_cmpint(change_tasks->len, ==, 2);
+  SnapdTask *task = change_tasks->pdata[0];
+  g_assert_cmpstr(snapd_task_get_id(task), ==, "1");
+  g_assert_cmpstr(snapd_task_get_status(task), ==, "Done");
+  g_assert_cmpstr(snapd_task_get_summary(task), ==, "Download snap");
+  g_assert_cmpint(snapd_task_get_progress_done(task), ==, 10);
+  g_assert_cmpint(snapd_task_get_progress_total(task), ==, 10);
+  SnapdTaskData *task_data = snapd_task_get_data(task);
+  g_assert_nonnull(task_data);
+  g_assert_cmpstrv(snapd_task_data_get_affected_snaps(task_data),
+                   affected_snaps);
+  task = change_tasks->pdata[1];
+  g_assert_cmpint(snapd_task_get_progress_done(task), ==, 3);
+  g_assert_null(snapd_task_get_data(task));
+
+  SnapdChangeData *change_data = snapd_change_get_data(change);
+  g_assert_true(SNAPD_IS_AUTOREFRESH_CHANGE_DATA(change_data));
+  SnapdAutorefreshChangeData *autorefresh_data =
+      SNAPD_AUTOREFRESH_CHANGE_DATA(change_data);
+  g_assert_cmpstrv(
+      snapd_autorefresh_change_data_get_snap_names(autorefresh_data),
+      snap_names);
+  g_assert_cmpstrv(
+      snapd_autorefresh_change_data_get_refresh_forced(autorefresh_data),
+      refresh_forced);
+}
+
+static void test_change_without_data(void) {
+  g_autoptr(GPtrArray) tasks = g_ptr_array_new_with_free_func(g_object_unref);
+  g_autoptr(SnapdChange) original =
+      g_object_new(SNAPD_TYPE_CHANGE, "id", "7", "kind", "install-snap",
+                   "status", "Done", "ready", TRUE, "tasks", tasks, NULL);
+
+  g_autoptr(GVariant) variant =
+      g_variant_ref_sink(sdi_snapd_variant_from_change(original));
+  g_autoptr(SnapdChange) change = sdi_snapd_variant_to_change(variant);
+
+  g_assert_cmpstr(snapd_change_get_id(change), ==, "7");
+  g_assert_true(snapd_change_get_ready(change));
+  g_assert_cmpint(snapd_change_get_tasks(change)->len, ==, 0);
+  g_assert_null(snapd_change_get_data(change));
+}
+
+static void test_notice(void) {
+  g_autoptr(GHashTable) last_data =
+      g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  g_hash_table_insert(last_data, g_strdup("kind"), g_strdup("auto-refresh"));
+  g_autoptr(SnapdNotice) original = g_object_new(
+      SNAPD_TYPE_NOTICE, "id", "3", "notice-type",
+      SNAPD_NOTICE_TYPE_CHANGE_UPDATE, "key", "42", "last-data", last_data,
+      NULL);
+
+  g_autoptr(GVariant) variant =
+      g_variant_ref_sink(sdi_snapd_variant_from_notice(original));
+  g_assert_true(g_variant_is_of_type(
+      variant, G_VARIANT_TYPE(SDI_SNAPD_NOTICE_VARIANT_TYPE)));
+  g_autoptr(SnapdNotice) notice = sdi_snapd_variant_to_notice(variant);
+
+  g_assert_cmpstr(snapd_notice_get_id(notice), ==, "3");
+  g_assert_cmpint(snapd_notice_get_notice_type(notice), ==,
+                  SNAPD_NOTICE_TYPE_CHANGE_UPDATE);
+  g_assert_cmpstr(snapd_notice_get_key(notice), ==, "42");
+  GHashTable *notice_data = snapd_notice_get_last_data2(notice);
+  g_assert_cmpint(g_hash_table_size(notice_data), ==, 1);
+  g_assert_cmpstr(g_hash_table_lookup(notice_data, "kind"), ==,
+                  "auto-refresh");
+}
+
+static void test_notice_type_names(void) {
+  g_assert_cmpstr(
+      sdi_snapd_variant_get_notice_type_name(SNAPD_NOTICE_TYPE_CHANGE_UPDATE),
+      ==, "change-update");
+  g_assert_cmpstr(
+      sdi_snapd_variant_get_notice_type_name(SNAPD_NOTICE_TYPE_REFRESH_INHIBIT),
+      ==, "refresh-inhibit");
+  g_assert_null(
+      sdi_snapd_variant_get_notice_type_name(SNAPD_NOTICE_TYPE_UNKNOWN));
+}
+
+int main(int argc, char **argv) {
+  g_test_init(&argc, &argv, NULL);
+  g_test_add_func("/sdi-snapd-variant/change", test_change);
+  g_test_add_func("/sdi-snapd-variant/change-without-data",
+                  test_change_without_data);
+  g_test_add_func("/sdi-snapd-variant/notice", test_notice);
+  g_test_add_func("/sdi-snapd-variant/notice-type-names",
+                  test_notice_type_names);
+  return g_test_run();
+}
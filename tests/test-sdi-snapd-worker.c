@@ -0,0 +1,103 @@
+#include "../src/sdi-snapd-client-factory.h"
+#include "../src/sdi-snapd-worker.h"
+#include "mock-snapd.h"
+
+static GThread *main_thread = NULL;
+
+static MockSnapd *start_mock_snapd(void) {
+  MockSnapd *snapd = mock_snapd_new();
+  const gchar *path = mock_snapd_get_socket_path(snapd);
+  sdi_snapd_client_factory_set_custom_path((gchar *)path);
+  g_autoptr(GError) error = NULL;
+  g_assert_true(mock_snapd_start(snapd, &error));
+  return snapd;
+}
+
+static void add_notice(MockSnapd *snapd, const gchar *kind) {
+  MockNotice *notice = mock_snapd_add_notice(snapd, "1", "8473", kind);
+  g_autoptr(GTimeZone) timezone = g_time_zone_new_utc();
+
+  g_autoptr(GDateTime) first_occurred =
+      g_date_time_new(timezone, 2024, 3, 1, 20, 29, 58);
+  g_autoptr(GDateTime) last_occurred =
+      g_date_time_new(timezone, 2024, 3, 2, 23, 28, 8);
+  g_autoptr(GDateTime) last_repeated =
+      g_date_time_new(timezone, 2024, 3, 3, 22, 20, 7);
+  mock_notice_set_dates(notice, first_occurred, last_occurred, last_repeated,
+                        5);
+}
+
+static void notice_cb(SdiSnapdWorker *worker, SnapdNotice *notice,
+                      gboolean first_run, GMainLoop *loop) {
+  // the notices must be received in the main thread
+  g_assert_true(g_thread_self() == main_thread);
+  g_assert_true(first_run);
+  g_assert_cmpint(snapd_notice_get_notice_type(notice), ==,
+                  SNAPD_NOTICE_TYPE_CHANGE_UPDATE);
+  g_main_loop_quit(loop);
+}
+
+static void test_notices_are_received(void) {
+  g_autoptr(GMainLoop) loop = g_main_loop_new(NULL, FALSE);
+  g_autoptr(MockSnapd) snapd = start_mock_snapd();
+  add_notice(snapd, "change-update");
+
+  g_autoptr(SdiSnapdWorker) worker = sdi_snapd_worker_new();
+  g_signal_connect(worker, "notice-event", G_CALLBACK(notice_cb), loop);
+  const gchar *types[] = {"change-update", NULL};
+  sdi_snapd_worker_add_notice_types(worker, types);
+  sdi_snapd_worker_start(worker);
+  g_main_loop_run(loop);
+}
+
+typedef struct {
+  GMainLoop *loop;
+  const gchar *change_id;
+} GetChangeData;
+
+static void get_change_cb(GObject *object, GAsyncResult *result,
+                          GetChangeData *data) {
+  g_assert_true(g_thread_self() == main_thread);
+  g_autoptr(GError) error = NULL;
+  g_autoptr(SnapdChange) change = sdi_snapd_worker_get_change_finish(
+      SDI_SNAPD_WORKER(object), result, &error);
+  if (data->change_id == NULL) {
+    g_assert_null(change);
+    g_assert_nonnull(error);
+  } else {
+    g_assert_no_error(error);
+    g_assert_cmpstr(snapd_change_get_id(change), ==, data->change_id);
+    g_assert_cmpstr(snapd_change_get_kind(change), ==, "auto-refresh");
+  }
+  g_main_loop_quit(data->loop);
+}
+
+static void test_get_change(void) {
+  g_autoptr(GMainLoop) loop = g_main_loop_new(NULL, FALSE);
+  g_autoptr(MockSnapd) snapd = start_mock_snapd();
+  MockChange *change = mock_snapd_add_change(snapd);
+  mock_change_set_kind(change, "auto-refresh");
+
+  g_autoptr(SdiSnapdWorker) worker = sdi_snapd_worker_new();
+  GetChangeData data = {loop, mock_change_get_id(change)};
+  sdi_snapd_worker_get_change_async(worker, data.change_id, NULL,
+                                    (GAsyncReadyCallback)get_change_cb,
+                                    &data);
+  g_main_loop_run(loop);
+
+  // an unknown change returns an error
+  data.change_id = NULL;
+  sdi_snapd_worker_get_change_async(worker, "1000", NULL,
+                                    (GAsyncReadyCallback)get_change_cb,
+                                    &data);
+  g_main_loop_run(loop);
+}
+
+int main(int argc, char **argv) {
+  g_test_init(&argc, &argv, NULL);
+  main_thread = g_thread_self();
+  g_test_add_func("/sdi-snapd-worker/receive-notices",
+                  test_notices_are_received);
+  g_test_add_func("/sdi-snapd-worker/get-change", test_get_change);
+  return g_test_run();
+}
@@ -0,0 +1,114 @@
+#include "../src/sdi-startup-scheduler.h"
+
+static GString *order = NULL;
+
+static void append_task(gpointer data) {
+  g_string_append(order, (const gchar *)data);
+}
+
+static void wait_ms(guint time) {
+  gint64 end_time = g_get_monotonic_time() + time * 1000;
+  while (g_get_monotonic_time() < end_time) {
+    g_main_context_iteration(NULL, FALSE);
+    g_usleep(1000);
+  }
+}
+
+static void test_urgent_first(void) {
+  g_autoptr(SdiStartupScheduler) scheduler = sdi_startup_scheduler_new(0);
+  order = g_string_new("");
+  sdi_startup_scheduler_add(scheduler, SDI_STARTUP_PRIORITY_DEFERRED,
+                            append_task, "d");
+  sdi_startup_scheduler_add(scheduler, SDI_STARTUP_PRIORITY_URGENT,
+                            append_task, "u");
+  wait_ms(100);
+  g_assert_cmpstr(order->str, ==, "ud");
+  g_string_free(order, TRUE);
+}
+
+static void test_deferred_are_staggered(void) {
+  g_autoptr(SdiStartupScheduler) scheduler = sdi_startup_scheduler_new(1);
+  order = g_string_new("");
+  sdi_startup_scheduler_add(scheduler, SDI_STARTUP_PRIORITY_DEFERRED,
+                            append_task, "1");
+  sdi_startup_scheduler_add(scheduler, SDI_STARTUP_PRIORITY_DEFERRED,
+                            append_task, "2");
+  wait_ms(500);
+  g_assert_cmpstr(order->str, ==, "1");
+  wait_ms(2000);
+  g_assert_cmpstr(order->str, ==, "12");
+  g_string_free(order, TRUE);
+}
+
+static void test_empty_window(void) {
+  g_autoptr(SdiStartupScheduler) scheduler = sdi_startup_scheduler_new(0);
+  order = g_string_new("");
+  sdi_startup_scheduler_add(scheduler, SDI_STARTUP_PRIORITY_DEFERRED,
+                            append_task, "1");
+  sdi_startup_scheduler_add(scheduler, SDI_STARTUP_PRIORITY_DEFERRED,
+                            append_task, "2");
+  // nothing is staggered when the jitter is disabled
+  wait_ms(100);
+  g_assert_cmpstr(order->str, ==, "12");
+  g_string_free(order, TRUE);
+}
+
+static void test_offset(void) {
+  g_autoptr(SdiStartupScheduler) scheduler1 = sdi_startup_scheduler_new(5000);
+  g_autoptr(SdiStartupScheduler) scheduler2 = sdi_startup_scheduler_new(5000);
+  g_autoptr(SdiStartupScheduler) scheduler3 = sdi_startup_scheduler_new(0);
+  // the offset is the same each time for the same user
+  guint offset = sdi_startup_scheduler_get_offset(scheduler1);
+  g_assert_cmpuint(offset, <, 5000);
+  g_assert_cmpuint(sdi_startup_scheduler_get_offset(scheduler2), ==, offset);
+  g_assert_cmpuint(sdi_startup_scheduler_get_offset(scheduler3), ==, 0);
+
+  order = g_string_new("");
+  sdi_startup_scheduler_add(scheduler1, SDI_STARTUP_PRIORITY_DEFERRED,
+                            append_task, "d");
+  if (offset > 100) {
+    wait_ms(offset - 100);
+    g_assert_cmpstr(order->str, ==, "");
+  }
+  wait_ms(300);
+  g_assert_cmpstr(order->str, ==, "d");
+  g_string_free(order, TRUE);
+}
+
+static void test_remove(void) {
+  g_autoptr(SdiStartupScheduler) scheduler = sdi_startup_scheduler_new(0);
+  order = g_string_new("");
+  guint id = sdi_startup_scheduler_add(
+      scheduler, SDI_STARTUP_PRIORITY_URGENT, append_task, "u");
+  sdi_startup_scheduler_add(scheduler, SDI_STARTUP_PRIORITY_DEFERRED,
+                            append_task, "d");
+  sdi_startup_scheduler_remove(scheduler, id);
+  wait_ms(100);
+  g_assert_cmpstr(order->str, ==, "d");
+  // removing a task that already ran does nothing
+  sdi_startup_scheduler_remove(scheduler, id);
+  g_string_free(order, TRUE);
+}
+
+static void test_dispose(void) {
+  SdiStartupScheduler *scheduler = sdi_startup_scheduler_new(0);
+  order = g_string_new("");
+  sdi_startup_scheduler_add(scheduler, SDI_STARTUP_PRIORITY_URGENT,
+                            append_task, "u");
+  g_object_unref(scheduler);
+  wait_ms(100);
+  g_assert_cmpstr(order->str, ==, "");
+  g_string_free(order, TRUE);
+}
+
+int main(int argc, char **argv) {
+  g_test_init(&argc, &argv, NULL);
+  g_test_add_func("/sdi-startup-scheduler/urgent-first", test_urgent_first);
+  g_test_add_func("/sdi-startup-scheduler/deferred-are-staggered",
+                  test_deferred_are_staggered);
+  g_test_add_func("/sdi-startup-scheduler/empty-window", test_empty_window);
+  g_test_add_func("/sdi-startup-scheduler/offset", test_offset);
+  g_test_add_func("/sdi-startup-scheduler/remove", test_remove);
+  g_test_add_func("/sdi-startup-scheduler/dispose", test_dispose);
+  return g_test_run();
+}
@@ -0,0 +1,74 @@
+#include "../src/sdi-theme-cache.h"
+
+static void test_lookup(void) {
+  g_autoptr(SdiThemeCache) cache = sdi_theme_cache_new(60);
+  SnapdThemeStatus status = 0;
+
+  g_assert_false(sdi_theme_cache_lookup(cache, SDI_THEME_KIND_GTK, "Theme1",
+                                        &status));
+  sdi_theme_cache_store(cache, SDI_THEME_KIND_GTK, "Theme1",
+                        SNAPD_THEME_STATUS_AVAILABLE);
+  g_assert_true(sdi_theme_cache_lookup(cache, SDI_THEME_KIND_GTK, "Theme1",
+                                       &status));
+  g_assert_cmpint(status, ==, SNAPD_THEME_STATUS_AVAILABLE);
+
+  // the same name in other kinds must not be found
+  g_assert_false(sdi_theme_cache_lookup(cache, SDI_THEME_KIND_ICON, "Theme1",
+                                        &status));
+  g_assert_false(sdi_theme_cache_lookup(cache, SDI_THEME_KIND_SOUND, "Theme1",
+                                        &status));
+  g_assert_false(
+      sdi_theme_cache_lookup(cache, SDI_THEME_KIND_GTK, NULL, &status));
+}
+
+static void test_store_all(void) {
+  g_autoptr(SdiThemeCache) cache = sdi_theme_cache_new(60);
+  g_autoptr(GHashTable) statuses = g_hash_table_new(g_str_hash, g_str_equal);
+  g_hash_table_insert(statuses, "Icons1",
+                      GINT_TO_POINTER(SNAPD_THEME_STATUS_INSTALLED));
+  g_hash_table_insert(statuses, "Cursor1",
+                      GINT_TO_POINTER(SNAPD_THEME_STATUS_UNAVAILABLE));
+  sdi_theme_cache_store_all(cache, SDI_THEME_KIND_ICON, statuses);
+  g_assert_cmpint(sdi_theme_cache_get_size(cache), ==, 2);
+
+  SnapdThemeStatus status = 0;
+  g_assert_true(sdi_theme_cache_lookup(cache, SDI_THEME_KIND_ICON, "Cursor1",
+                                       &status));
+  g_assert_cmpint(status, ==, SNAPD_THEME_STATUS_UNAVAILABLE);
+}
+
+static void test_invalidate(void) {
+  g_autoptr(SdiThemeCache) cache = sdi_theme_cache_new(60);
+  sdi_theme_cache_store(cache, SDI_THEME_KIND_GTK, "Theme1",
+                        SNAPD_THEME_STATUS_INSTALLED);
+  sdi_theme_cache_store(cache, SDI_THEME_KIND_SOUND, "Sound1",
+                        SNAPD_THEME_STATUS_AVAILABLE);
+  g_assert_cmpint(sdi_theme_cache_get_size(cache), ==, 2);
+
+  sdi_theme_cache_invalidate(cache);
+  g_assert_cmpint(sdi_theme_cache_get_size(cache), ==, 0);
+  g_assert_false(
+      sdi_theme_cache_lookup(cache, SDI_THEME_KIND_GTK, "Theme1", NULL));
+}
+
+static void test_expiration(void) {
+  g_autoptr(SdiThemeCache) cache = sdi_theme_cache_new(1);
+  sdi_theme_cache_store(cache, SDI_THEME_KIND_GTK, "Theme1",
+                        SNAPD_THEME_STATUS_INSTALLED);
+  g_assert_true(
+      sdi_theme_cache_lookup(cache, SDI_THEME_KIND_GTK, "Theme1", NULL));
+
+  g_usleep(1100 * 1000);
+  g_assert_false(
+      sdi_theme_cache_lookup(cache, SDI_THEME_KIND_GTK, "Theme1", NULL));
+  g_assert_cmpint(sdi_theme_cache_get_size(cache), ==, 0);
+}
+
+int main(int argc, char **argv) {
+  g_test_init(&argc, &argv, NULL);
+  g_test_add_func("/sdi-theme-cache/lookup", test_lookup);
+  g_test_add_func("/sdi-theme-cache/store-all", test_store_all);
+  g_test_add_func("/sdi-theme-cache/invalidate", test_invalidate);
+  g_test_add_func("/sdi-theme-cache/expiration", test_expiration);
+  return g_test_run();
+}
@@ -0,0 +1,137 @@
+#include "../src/sdi-theme-prefetcher.h"
+#include "mock-snapd.h"
+
+#include <glib/gstdio.h>
+
+#define THEMES_PATH "/v2/accessories/themes"
+
+static MockSnapd *start_mock_snapd(void) {
+  MockSnapd *snapd = mock_snapd_new();
+  mock_snapd_set_gtk_theme_status(snapd, "GtkTheme1", "installed");
+  mock_snapd_set_icon_theme_status(snapd, "IconTheme1", "available");
+  g_autoptr(GError) error = NULL;
+  g_assert_true(mock_snapd_start(snapd, &error));
+  return snapd;
+}
+
+static SnapdClient *new_client(MockSnapd *snapd) {
+  SnapdClient *client = snapd_client_new();
+  snapd_client_set_socket_path(client, mock_snapd_get_socket_path(snapd));
+  return client;
+}
+
+static void create_theme(const gchar *folder, const gchar *name,
+                         const gchar *child, gboolean is_dir) {
+  g_autofree gchar *path =
+      g_build_filename(g_get_user_data_dir(), folder, name, child, NULL);
+  if (is_dir) {
+    g_assert_cmpint(g_mkdir_with_parents(path, 0700), ==, 0);
+  } else {
+    g_autofree gchar *dir = g_path_get_dirname(path);
+    g_assert_cmpint(g_mkdir_with_parents(dir, 0700), ==, 0);
+    g_assert_true(g_file_set_contents(path, "", -1, NULL));
+  }
+}
+
+// the directories are isolated for each test, so they start empty
+static void create_local_themes(void) {
+  create_theme("themes", "GtkTheme1", "gtk-3.0", TRUE);
+  create_theme("icons", "IconTheme1", "index.theme", FALSE);
+  create_theme("sounds", "SoundTheme1", "index.theme", FALSE);
+}
+
+static void wait_for_cache_size(SdiThemeCache *cache, guint size,
+                                guint timeout) {
+  gint64 end_time = g_get_monotonic_time() + timeout * 1000;
+  while (g_get_monotonic_time() < end_time &&
+         sdi_theme_cache_get_size(cache) != size) {
+    g_main_context_iteration(NULL, FALSE);
+    g_usleep(1000);
+  }
+}
+
+static void wait_ms(guint time) {
+  gint64 end_time = g_get_monotonic_time() + time * 1000;
+  while (g_get_monotonic_time() < end_time) {
+    g_main_context_iteration(NULL, FALSE);
+    g_usleep(1000);
+  }
+}
+
+static void test_prefetch(void) {
+  g_autoptr(MockSnapd) snapd = start_mock_snapd();
+  g_autoptr(SnapdClient) client = new_client(snapd);
+  g_autoptr(SdiThemeCache) cache = sdi_theme_cache_new(60);
+  g_autoptr(SdiThemePrefetcher) prefetcher =
+      sdi_theme_prefetcher_new(client, cache);
+  create_local_themes();
+
+  sdi_theme_prefetcher_schedule(prefetcher, 0);
+  wait_for_cache_size(cache, 3, 2000);
+  g_assert_cmpuint(sdi_theme_cache_get_size(cache), ==, 3);
+  // all the themes are checked with a single request
+  g_assert_cmpuint(mock_snapd_get_request_count(snapd, THEMES_PATH), ==, 1);
+
+  SnapdThemeStatus status = 0;
+  g_assert_true(sdi_theme_cache_lookup(cache, SDI_THEME_KIND_GTK, "GtkTheme1",
+                                       &status));
+  g_assert_cmpint(status, ==, SNAPD_THEME_STATUS_INSTALLED);
+  g_assert_true(sdi_theme_cache_lookup(cache, SDI_THEME_KIND_ICON,
+                                       "IconTheme1", &status));
+  g_assert_cmpint(status, ==, SNAPD_THEME_STATUS_AVAILABLE);
+  g_assert_true(sdi_theme_cache_lookup(cache, SDI_THEME_KIND_SOUND,
+                                       "SoundTheme1", &status));
+  g_assert_cmpint(status, ==, SNAPD_THEME_STATUS_UNAVAILABLE);
+}
+
+static void test_cache_hit(void) {
+  g_autoptr(MockSnapd) snapd = start_mock_snapd();
+  g_autoptr(SnapdClient) client = new_client(snapd);
+  g_autoptr(SdiThemeCache) cache = sdi_theme_cache_new(60);
+  g_autoptr(SdiThemePrefetcher) prefetcher =
+      sdi_theme_prefetcher_new(client, cache);
+  create_local_themes();
+  sdi_theme_cache_store(cache, SDI_THEME_KIND_GTK, "GtkTheme1",
+                        SNAPD_THEME_STATUS_INSTALLED);
+  sdi_theme_cache_store(cache, SDI_THEME_KIND_ICON, "IconTheme1",
+                        SNAPD_THEME_STATUS_AVAILABLE);
+  sdi_theme_cache_store(cache, SDI_THEME_KIND_SOUND, "SoundTheme1",
+                        SNAPD_THEME_STATUS_UNAVAILABLE);
+
+  // nothing is requested if every local theme is already cached
+  sdi_theme_prefetcher_schedule(prefetcher, 0);
+  wait_ms(500);
+  g_assert_cmpuint(mock_snapd_get_request_count(snapd, THEMES_PATH), ==, 0);
+  g_assert_cmpuint(sdi_theme_cache_get_size(cache), ==, 3);
+}
+
+static void test_failed_request(void) {
+  g_autoptr(MockSnapd) snapd = start_mock_snapd();
+  g_autoptr(SnapdClient) client = new_client(snapd);
+  g_autoptr(SdiThemeCache) cache = sdi_theme_cache_new(60);
+  g_autoptr(SdiThemePrefetcher) prefetcher =
+      sdi_theme_prefetcher_new(client, cache);
+  create_local_themes();
+
+  // nothing is cached if snapd fails
+  mock_snapd_set_close_on_request(snapd, TRUE);
+  sdi_theme_prefetcher_schedule(prefetcher, 0);
+  wait_ms(500);
+  g_assert_cmpuint(sdi_theme_cache_get_size(cache), ==, 0);
+
+  // and the next prefetch works again
+  mock_snapd_set_close_on_request(snapd, FALSE);
+  sdi_theme_prefetcher_schedule(prefetcher, 0);
+  wait_for_cache_size(cache, 3, 2000);
+  g_assert_cmpuint(sdi_theme_cache_get_size(cache), ==, 3);
+}
+
+int main(int argc, char **argv) {
+  // the themes are searched in the XDG folders, which are isolated per test
+  g_test_init(&argc, &argv, G_TEST_OPTION_ISOLATE_DIRS, NULL);
+  g_test_add_func("/sdi-theme-prefetcher/prefetch", test_prefetch);
+  g_test_add_func("/sdi-theme-prefetcher/cache-hit", test_cache_hit);
+  g_test_add_func("/sdi-theme-prefetcher/failed-request",
+                  test_failed_request);
+  return g_test_run();
+}
@@ -0,0 +1,224 @@
+#include "../src/sdi-ui-helper-client.h"
+#include "io.snapcraft.SnapDesktopIntegration.ProgressWindow.h"
+
+static GTestDBus *test_bus = NULL;
+static GApplication *application = NULL;
+
+// fake helper, in its own connection so it has a different unique name
+static GDBusConnection *helper_connection = NULL;
+static SdiDbusProgressWindow *helper = NULL;
+static guint helper_owner_id = 0;
+static GString *calls = NULL;
+static gchar *cancelled_id = NULL;
+
+static void wait_ms(guint time) {
+  gint64 end_time = g_get_monotonic_time() + time * 1000;
+  while (g_get_monotonic_time() < end_time) {
+    g_main_context_iteration(NULL, FALSE);
+    g_usleep(1000);
+  }
+}
+
+static void add_call(const gchar *method, const gchar *id) {
+  g_string_append_printf(calls, "%s:%s ", method, id);
+}
+
+static gboolean handle_begin_refresh(SdiDbusProgressWindow *object,
+                                     GDBusMethodInvocation *invocation,
+                                     const gchar *snap_name,
+                                     const gchar *visible_name,
+                                     const gchar *icon) {
+  add_call("BeginRefresh", snap_name);
+  sdi_dbus_progress_window_complete_begin_refresh(object, invocation);
+  return TRUE;
+}
+
+static gboolean handle_update_progress(
+    SdiDbusProgressWindow *object, GDBusMethodInvocation *invocation,
+    const gchar *snap_name, const gchar *const *desktop_files,
+    const gchar *task_description, guint done_tasks, guint total_tasks,
+    gboolean task_done) {
+  add_call("UpdateProgress", snap_name);
+  sdi_dbus_progress_window_complete_update_progress(object, invocation);
+  return TRUE;
+}
+
+static gboolean handle_end_refresh(SdiDbusProgressWindow *object,
+                                   GDBusMethodInvocation *invocation,
+                                   const gchar *id) {
+  add_call("EndRefresh", id);
+  sdi_dbus_progress_window_complete_end_refresh(object, invocation);
+  return TRUE;
+}
+
+static gboolean handle_begin_install(SdiDbusProgressWindow *object,
+                                     GDBusMethodInvocation *invocation,
+                                     const gchar *install_id,
+                                     const gchar *message) {
+  add_call("BeginInstall", install_id);
+  sdi_dbus_progress_window_complete_begin_install(object, invocation);
+  return TRUE;
+}
+
+static gboolean handle_update_install_progress(
+    SdiDbusProgressWindow *object, GDBusMethodInvocation *invocation,
+    const gchar *install_id, const gchar *task_description,
+    guint64 done_bytes, guint64 total_bytes, guint done_tasks,
+    guint total_tasks) {
+  add_call("UpdateInstallProgress", install_id);
+  sdi_dbus_progress_window_complete_update_install_progress(object,
+                                                            invocation);
+  return TRUE;
+}
+
+static void own_helper_name(void) {
+  helper_owner_id = g_bus_own_name_on_connection(
+      helper_connection, SDI_UI_HELPER_NAME, G_BUS_NAME_OWNER_FLAGS_NONE, NULL,
+      NULL, NULL, NULL);
+  wait_ms(200);
+}
+
+static void start_helper(void) {
+  g_autoptr(GError) error = NULL;
+  helper_connection = g_dbus_connection_new_for_address_sync(
+      g_test_dbus_get_bus_address(test_bus),
+      G_DBUS_CONNECTION_FLAGS_AUTHENTICATION_CLIENT |
+          G_DBUS_CONNECTION_FLAGS_MESSAGE_BUS_CONNECTION,
+      NULL, NULL, &error);
+  g_assert_no_error(error);
+
+  helper = sdi_dbus_progress_window_skeleton_new();
+  g_signal_connect(helper, "handle-begin-refresh",
+                   (GCallback)handle_begin_refresh, NULL);
+  g_signal_connect(helper, "handle-update-progress",
+                   (GCallback)handle_update_progress, NULL);
+  g_signal_connect(helper, "handle-end-refresh",
+                   (GCallback)handle_end_refresh, NULL);
+  g_signal_connect(helper, "handle-begin-install",
+                   (GCallback)handle_begin_install, NULL);
+  g_signal_connect(helper, "handle-update-install-progress",
+                   (GCallback)handle_update_install_progress, NULL);
+  g_dbus_interface_skeleton_export(G_DBUS_INTERFACE_SKELETON(helper),
+                                   helper_connection,
+                                   SDI_UI_HELPER_PROGRESS_WINDOW_PATH, &error);
+  g_assert_no_error(error);
+  own_helper_name();
+}
+
+static void cancel_install_cb(SdiUiHelperClient *client, gchar *install_id) {
+  g_free(cancelled_id);
+  cancelled_id = g_strdup(install_id);
+}
+
+static void test_only_begun_ids(void) {
+  g_autoptr(SdiUiHelperClient) client = sdi_ui_helper_client_new(application);
+  calls = g_string_new("");
+
+  gchar *desktop_files[] = {"snap1_app.desktop", NULL};
+  // nothing is sent for the snaps without a dialog
+  sdi_ui_helper_client_update_progress(client, "snap1", desktop_files, NULL, 1,
+                                       5, FALSE);
+  sdi_ui_helper_client_begin_refresh(client, "snap1", "Snap 1", NULL);
+  sdi_ui_helper_client_update_progress(client, "snap1", desktop_files, NULL, 2,
+                                       5, FALSE);
+  sdi_ui_helper_client_update_progress(client, "snap2", NULL, NULL, 1, 5,
+                                       FALSE);
+  sdi_ui_helper_client_end_refresh(client, "snap1");
+  sdi_ui_helper_client_update_progress(client, "snap1", desktop_files, NULL, 5,
+                                       5, TRUE);
+  sdi_ui_helper_client_end_refresh(client, "snap2");
+
+  sdi_ui_helper_client_begin_install(client, "install1", "Installing");
+  sdi_ui_helper_client_update_install_progress(client, "install1", NULL, 10,
+                                               100, 1, 3);
+  sdi_ui_helper_client_update_install_progress(client, "install2", NULL, 10,
+                                               100, 1, 3);
+  sdi_ui_helper_client_end_refresh(client, "install1");
+  wait_ms(200);
+
+  g_assert_cmpstr(calls->str, ==,
+                  "BeginRefresh:snap1 UpdateProgress:snap1 EndRefresh:snap1 "
+                  "BeginInstall:install1 UpdateInstallProgress:install1 "
+                  "EndRefresh:install1 ");
+  g_string_free(calls, TRUE);
+}
+
+static void test_helper_vanished(void) {
+  g_autoptr(SdiUiHelperClient) client = sdi_ui_helper_client_new(application);
+  calls = g_string_new("");
+  // wait for the client to see the helper
+  wait_ms(200);
+
+  sdi_ui_helper_client_begin_refresh(client, "snap1", "Snap 1", NULL);
+  wait_ms(200);
+
+  // the dialogs are lost if the helper exits, so their updates are dropped
+  g_clear_handle_id(&helper_owner_id, g_bus_unown_name);
+  wait_ms(200);
+  own_helper_name();
+  sdi_ui_helper_client_update_progress(client, "snap1", NULL, NULL, 2, 5,
+                                       FALSE);
+  sdi_ui_helper_client_end_refresh(client, "snap1");
+  wait_ms(200);
+
+  g_assert_cmpstr(calls->str, ==, "BeginRefresh:snap1 ");
+  g_string_free(calls, TRUE);
+}
+
+static void test_cancel_install(void) {
+  g_autoptr(SdiUiHelperClient) client = sdi_ui_helper_client_new(application);
+  g_signal_connect(client, "cancel-install", (GCallback)cancel_install_cb,
+                   NULL);
+  // wait for the client to see the helper
+  wait_ms(200);
+
+  // the signal is ignored if it doesn't come from the helper
+  g_autoptr(GError) error = NULL;
+  g_dbus_connection_emit_signal(
+      g_application_get_dbus_connection(application), NULL,
+      SDI_UI_HELPER_PROGRESS_WINDOW_PATH,
+      "io.snapcraft.SnapDesktopIntegration.ProgressWindow", "CancelInstall",
+      g_variant_new("(s)", "install2"), &error);
+  g_assert_no_error(error);
+  wait_ms(200);
+  g_assert_null(cancelled_id);
+
+  sdi_dbus_progress_window_emit_cancel_install(helper, "install1");
+  wait_ms(200);
+  g_assert_cmpstr(cancelled_id, ==, "install1");
+  g_clear_pointer(&cancelled_id, g_free);
+
+  // and it is no longer received once the client is destroyed
+  g_clear_object(&client);
+  sdi_dbus_progress_window_emit_cancel_install(helper, "install1");
+  wait_ms(200);
+  g_assert_null(cancelled_id);
+}
+
+static void do_activate(GApplication *app, gpointer data) {
+  application = app;
+  start_helper();
+  g_test_add_func("/ui-helper-client/only-begun-ids", test_only_begun_ids);
+  g_test_add_func("/ui-helper-client/helper-vanished", test_helper_vanished);
+  g_test_add_func("/ui-helper-client/cancel-install", test_cancel_install);
+  g_test_run();
+}
+
+int main(int argc, char **argv) {
+  g_test_init(&argc, &argv, NULL);
+
+  // a private bus, so the fake helper can own the name of the helper
+  test_bus = g_test_dbus_new(G_TEST_DBUS_NONE);
+  g_test_dbus_up(test_bus);
+
+  g_autoptr(GApplication) app = g_application_new(
+      "io.snapcraft.SdiUiHelperClientTest", G_APPLICATION_DEFAULT_FLAGS);
+  g_signal_connect(app, "activate", (GCallback)do_activate, NULL);
+  int retval = g_application_run(app, argc, argv);
+
+  g_clear_object(&helper);
+  g_clear_object(&helper_connection);
+  g_test_dbus_down(test_bus);
+  g_clear_object(&test_bus);
+  return retval;
+}
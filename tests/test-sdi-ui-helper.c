@@ -0,0 +1,127 @@
+#include "../src/sdi-ui-helper-client.h"
+
+#include "config.h"
+
+#define PROGRESS_WINDOW_INTERFACE                                              \
+  "io.snapcraft.SnapDesktopIntegration.ProgressWindow"
+
+static GTestDBus *test_bus = NULL;
+static GDBusConnection *connection = NULL;
+static GSubprocess *helper = NULL;
+
+static void wait_ms(guint time) {
+  gint64 end_time = g_get_monotonic_time() + time * 1000;
+  while (g_get_monotonic_time() < end_time) {
+    g_main_context_iteration(NULL, FALSE);
+    g_usleep(1000);
+  }
+}
+
+static gchar *get_helper_owner(void) {
+  g_autoptr(GVariant) reply = g_dbus_connection_call_sync(
+      connection, "org.freedesktop.DBus", "/org/freedesktop/DBus",
+      "org.freedesktop.DBus", "GetNameOwner",
+      g_variant_new("(s)", SDI_UI_HELPER_NAME), G_VARIANT_TYPE("(s)"),
+      G_DBUS_CALL_FLAGS_NONE, -1, NULL, NULL);
+  if (reply == NULL) {
+    return NULL;
+  }
+  gchar *owner = NULL;
+  g_variant_get(reply, "(s)", &owner);
+  return owner;
+}
+
+static void call_helper(const gchar *method, GVariant *parameters) {
+  g_autoptr(GError) error = NULL;
+  g_autoptr(GVariant) reply = g_dbus_connection_call_sync(
+      connection, SDI_UI_HELPER_NAME, SDI_UI_HELPER_PROGRESS_WINDOW_PATH,
+      PROGRESS_WINDOW_INTERFACE, method, parameters, NULL,
+      G_DBUS_CALL_FLAGS_NO_AUTO_START, 5000, NULL, &error);
+  g_assert_no_error(error);
+}
+
+static void start_helper(void) {
+  g_autoptr(GSubprocessLauncher) launcher =
+      g_subprocess_launcher_new(G_SUBPROCESS_FLAGS_NONE);
+  g_subprocess_launcher_setenv(launcher, "DBUS_SESSION_BUS_ADDRESS",
+                               g_test_dbus_get_bus_address(test_bus), TRUE);
+  g_subprocess_launcher_setenv(launcher, "GTK_A11Y", "none", TRUE);
+  g_autofree gchar *helper_path =
+      g_build_filename(DAEMON_BUILDDIR, "snapd-desktop-integration-ui", NULL);
+  g_autoptr(GError) error = NULL;
+  helper = g_subprocess_launcher_spawn(launcher, &error, helper_path, NULL);
+  g_assert_no_error(error);
+
+  for (int i = 0; i < 50; i++) {
+    g_autofree gchar *owner = get_helper_owner();
+    if (owner != NULL) {
+      return;
+    }
+    wait_ms(100);
+  }
+  g_assert_not_reached();
+}
+
+static void test_refresh(void) {
+  const gchar *desktop_files[] = {"snap1_app.desktop", NULL};
+  call_helper("BeginRefresh", g_variant_new("(sss)", "snap1", "Snap 1", ""));
+  call_helper("UpdateProgress",
+              g_variant_new("(s^assuub)", "snap1", desktop_files,
+                            "Downloading", 1, 5, FALSE));
+  call_helper("UpdateProgress",
+              g_variant_new("(s^assuub)", "snap1", desktop_files, "", 5, 5,
+                            TRUE));
+  call_helper("EndRefresh", g_variant_new("(s)", "snap1"));
+}
+
+static void test_install(void) {
+  call_helper("BeginInstall", g_variant_new("(ss)", "install1", "Installing"));
+  call_helper("UpdateInstallProgress",
+              g_variant_new("(ssttuu)", "install1", "Downloading",
+                            (guint64)10, (guint64)100, 1, 3));
+  call_helper("EndRefresh", g_variant_new("(s)", "install1"));
+}
+
+static void test_unknown_ids(void) {
+  // the updates for IDs without a dialog are ignored
+  const gchar *desktop_files[] = {NULL};
+  call_helper("UpdateProgress",
+              g_variant_new("(s^assuub)", "snap2", desktop_files, "", 1, 5,
+                            FALSE));
+  call_helper("UpdateInstallProgress",
+              g_variant_new("(ssttuu)", "install2", "", (guint64)10,
+                            (guint64)100, 1, 3));
+  call_helper("EndRefresh", g_variant_new("(s)", "snap2"));
+}
+
+static void test_keeps_running(void) {
+  // after the dialogs are closed the helper waits for new requests
+  wait_ms(1000);
+  g_autofree gchar *owner = get_helper_owner();
+  g_assert_nonnull(owner);
+}
+
+int main(int argc, char **argv) {
+  g_test_init(&argc, &argv, NULL);
+
+  test_bus = g_test_dbus_new(G_TEST_DBUS_NONE);
+  g_test_dbus_up(test_bus);
+  g_autoptr(GError) error = NULL;
+  connection = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, &error);
+  g_assert_no_error(error);
+  start_helper();
+
+  g_test_add_func("/ui-helper/refresh", test_refresh);
+  g_test_add_func("/ui-helper/install", test_install);
+  g_test_add_func("/ui-helper/unknown-ids", test_unknown_ids);
+  g_test_add_func("/ui-helper/keeps-running", test_keeps_running);
+  int retval = g_test_run();
+
+  g_subprocess_force_exit(helper);
+  g_subprocess_wait(helper, NULL, NULL);
+  g_clear_object(&helper);
+  g_clear_object(&connection);
+  g_test_dbus_down(test_bus);
+  g_clear_object(&test_bus);
+  return retval;
+}
@@ -39,6 +39,10 @@ static GSubprocess *dbus_subprocess = NULL;
 static gchar *dbus_address = NULL;
 static guint32 next_notification_id = 1;
 
+/* Each round uses new theme names, because the daemon caches the status of
+ * the themes that it has already checked. */
+static guint test_round = 0;
+
 enum {
   STATE_GET_EXISTING_THEME_STATUS,
   STATE_GET_NEW_THEME_STATUS,
@@ -89,56 +93,91 @@ static void send_snapd_response(SoupServerMessage *message, guint status_code,
                            SOUP_MEMORY_COPY, json, strlen(json));
 }
 
+static void set_themes(guint theme_number) {
+  g_autofree gchar *gtk_theme = g_strdup_printf("GtkTheme%u", theme_number);
+  g_autofree gchar *icon_theme = g_strdup_printf("IconTheme%u", theme_number);
+  g_autofree gchar *cursor_theme =
+      g_strdup_printf("CursorTheme%u", theme_number);
+  g_autofree gchar *sound_theme =
+      g_strdup_printf("SoundTheme%u", theme_number);
+  set_setting("org.gnome.desktop.interface", "gtk-theme", gtk_theme);
+  set_setting("org.gnome.desktop.interface", "icon-theme", icon_theme);
+  set_setting("org.gnome.desktop.interface", "cursor-theme", cursor_theme);
+  set_setting("org.gnome.desktop.sound", "theme-name", sound_theme);
+}
+
 static void handle_snapd_themes_request(SoupServerMessage *message) {
   const gchar *query = g_uri_get_query(soup_server_message_get_uri(message));
-  switch (state) {
-  case STATE_GET_EXISTING_THEME_STATUS:
-    g_assert_cmpstr(soup_server_message_get_method(message), ==, "GET");
-    g_assert_cmpstr(query, ==,
-                    "gtk-theme=GtkTheme1&icon-theme=IconTheme1&icon-theme="
-                    "CursorTheme1&sound-theme=SoundTheme1");
+  guint existing = test_round * 2 + 1;
+  guint new = test_round * 2 + 2;
+
+  /* The daemon can also prefetch the status of the themes installed in the
+   * system; those requests don't contain the test themes. */
+  if (g_str_equal(soup_server_message_get_method(message), "GET") &&
+      (query == NULL || strstr(query, "GtkTheme") == NULL)) {
     send_snapd_response(
         message, 200,
         "{\"type\":\"sync\",\"status-code\":200,\"status\":\"OK\",\"result\":{"
-        "\"gtk-themes\":{\"GtkTheme1\":\"installed\"},\"icon-themes\":{"
-        "\"IconTheme1\":\"installed\",\"CursorTheme1\":\"installed\"},\"sound-"
-        "themes\":{\"SoundTheme1\":\"installed\"}}}");
+        "\"gtk-themes\":{},\"icon-themes\":{},\"sound-themes\":{}}}");
+    return;
+  }
+
+  switch (state) {
+  case STATE_GET_EXISTING_THEME_STATUS: {
+    g_assert_cmpstr(soup_server_message_get_method(message), ==, "GET");
+    g_autofree gchar *expected_query = g_strdup_printf(
+        "gtk-theme=GtkTheme%u&icon-theme=IconTheme%u&icon-theme="
+        "CursorTheme%u&sound-theme=SoundTheme%u",
+        existing, existing, existing, existing);
+    g_assert_cmpstr(query, ==, expected_query);
+    g_autofree gchar *response = g_strdup_printf(
+        "{\"type\":\"sync\",\"status-code\":200,\"status\":\"OK\",\"result\":{"
+        "\"gtk-themes\":{\"GtkTheme%u\":\"installed\"},\"icon-themes\":{"
+        "\"IconTheme%u\":\"installed\",\"CursorTheme%u\":\"installed\"},"
+        "\"sound-themes\":{\"SoundTheme%u\":\"installed\"}}}",
+        existing, existing, existing, existing);
+    send_snapd_response(message, 200, response);
 
     // After first contact, change the themes.
-    set_setting("org.gnome.desktop.interface", "gtk-theme", "GtkTheme2");
-    set_setting("org.gnome.desktop.interface", "icon-theme", "IconTheme2");
-    set_setting("org.gnome.desktop.interface", "cursor-theme", "CursorTheme2");
-    set_setting("org.gnome.desktop.sound", "theme-name", "SoundTheme2");
+    set_themes(new);
 
     state = STATE_GET_NEW_THEME_STATUS;
     break;
-  case STATE_GET_NEW_THEME_STATUS:
+  }
+  case STATE_GET_NEW_THEME_STATUS: {
     g_assert_cmpstr(soup_server_message_get_method(message), ==, "GET");
-    g_assert_cmpstr(query, ==,
-                    "gtk-theme=GtkTheme2&icon-theme=IconTheme2&icon-theme="
-                    "CursorTheme2&sound-theme=SoundTheme2");
-    send_snapd_response(
-        message, 200,
+    g_autofree gchar *expected_query = g_strdup_printf(
+        "gtk-theme=GtkTheme%u&icon-theme=IconTheme%u&icon-theme="
+        "CursorTheme%u&sound-theme=SoundTheme%u",
+        new, new, new, new);
+    g_assert_cmpstr(query, ==, expected_query);
+    g_autofree gchar *response = g_strdup_printf(
         "{\"type\":\"sync\",\"status-code\":200,\"status\":\"OK\",\"result\":{"
-        "\"gtk-themes\":{\"GtkTheme2\":\"available\"},\"icon-themes\":{"
-        "\"IconTheme2\":\"installed\",\"CursorTheme2\":\"unavailable\"},"
-        "\"sound-themes\":{\"SoundTheme2\":\"available\"}}}");
+        "\"gtk-themes\":{\"GtkTheme%u\":\"available\"},\"icon-themes\":{"
+        "\"IconTheme%u\":\"installed\",\"CursorTheme%u\":\"unavailable\"},"
+        "\"sound-themes\":{\"SoundTheme%u\":\"available\"}}}",
+        new, new, new, new);
+    send_snapd_response(message, 200, response);
     state = STATE_PROMPT_INSTALL;
     break;
-  case STATE_INSTALL_THEMES:
+  }
+  case STATE_INSTALL_THEMES: {
     g_assert_cmpstr(soup_server_message_get_method(message), ==, "POST");
     g_assert_cmpstr(soup_message_headers_get_content_type(
                         soup_server_message_get_request_headers(message), NULL),
                     ==, "application/json");
     g_autofree gchar *json =
         get_json(soup_server_message_get_request_body(message));
-    g_assert_cmpstr(json, ==,
-                    "{\"gtk-themes\":[\"GtkTheme2\"],\"icon-themes\":[],"
-                    "\"sound-themes\":[\"SoundTheme2\"]}");
+    g_autofree gchar *expected_json = g_strdup_printf(
+        "{\"gtk-themes\":[\"GtkTheme%u\"],\"icon-themes\":[],"
+        "\"sound-themes\":[\"SoundTheme%u\"]}",
+        new, new);
+    g_assert_cmpstr(json, ==, expected_json);
     send_snapd_response(message, 200,
                         "{\"type\":\"async\", \"change\": \"1234\"}");
     state = STATE_NOTIFY_COMPLETE;
     break;
+  }
   default:
     break;
   }
@@ -245,8 +284,11 @@ static gboolean launch_snapd_desktop_integration() {
       g_strdup_printf("--snapd-socket-path=%s", snapd_socket_path);
 
   g_autoptr(GError) error = NULL;
-  g_autoptr(GSubprocess) subprocess = g_subprocess_launcher_spawn(
-      launcher, &error, daemon_path, snapd_socket_path_arg, NULL);
+  // the themes must be checked without waiting for the turn of the user
+  g_autoptr(GSubprocess) subprocess =
+      g_subprocess_launcher_spawn(launcher, &error, daemon_path,
+                                  snapd_socket_path_arg, "--startup-jitter=0",
+                                  NULL);
   if (subprocess == NULL) {
     return FALSE;
   }
@@ -434,12 +476,7 @@ void timeout_no_install(GMainLoop *loop) {
   g_main_loop_quit(loop);
 }
 
-static void set_test_settings() {
-  set_setting("org.gnome.desktop.interface", "gtk-theme", "GtkTheme1");
-  set_setting("org.gnome.desktop.interface", "icon-theme", "IconTheme1");
-  set_setting("org.gnome.desktop.interface", "cursor-theme", "CursorTheme1");
-  set_setting("org.gnome.desktop.sound", "theme-name", "SoundTheme1");
-}
+static void set_test_settings() { set_themes(test_round * 2 + 1); }
 
 int main(int argc, char **argv) {
   loop = g_main_loop_new(NULL, FALSE);
@@ -480,6 +517,7 @@ int main(int argc, char **argv) {
   // doesn't break the system.
   exit_code = SNAPD_EXIT_FAILURE;
   state = STATE_GET_EXISTING_THEME_STATUS;
+  test_round++;
   set_test_settings();
   actions_to_send = ACTION_SEND_YES | ACTION_SEND_DEFAULT | ACTION_SEND_CLOSE;
 
@@ -491,6 +529,7 @@ int main(int argc, char **argv) {
   // Test that answering NO won't update the themes
   exit_code = SNAPD_EXIT_FAILURE;
   state = STATE_GET_EXISTING_THEME_STATUS;
+  test_round++;
   set_test_settings();
   actions_to_send = ACTION_SEND_NO | ACTION_SEND_CLOSE;
   g_timeout_add_once(4000, (GSourceOnceFunc)timeout_no_install, loop);
@@ -503,6 +542,7 @@ int main(int argc, char **argv) {
   // Test that clicking on the notification does install the theme
   exit_code = SNAPD_EXIT_FAILURE;
   state = STATE_GET_EXISTING_THEME_STATUS;
+  test_round++;
   set_test_settings();
   actions_to_send = ACTION_SEND_DEFAULT | ACTION_SEND_CLOSE;
 
@@ -515,6 +555,7 @@ int main(int argc, char **argv) {
   // and continues to respond to new changes.
   exit_code = SNAPD_EXIT_FAILURE;
   state = STATE_GET_EXISTING_THEME_STATUS;
+  test_round++;
   set_test_settings();
   actions_to_send = ACTION_SEND_YES | ACTION_SEND_CLOSE;
 